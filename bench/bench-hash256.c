@@ -0,0 +1,120 @@
+/*!
+ * bench-hash256.c - header mining benchmark for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+
+#include <mako/crypto/hash.h>
+#include <mako/header.h>
+#include <mako/util.h>
+
+#include "../test/lib/tests.h"
+
+/*
+ * Constants
+ */
+
+#define BENCH_NONCES (1 << 21)
+
+/*
+ * Helpers
+ */
+
+static void
+bench_print(const char *name, int64_t elapsed) {
+  double sec = (double)elapsed / 1000000.0;
+
+  printf("%-20s %8.3f ms (%.2f MH/s)\n",
+         name, (double)elapsed / 1000.0,
+         (double)BENCH_NONCES / 1000000.0 / (sec > 0.0 ? sec : 1e-9));
+}
+
+/*
+ * Reference
+ */
+
+static int
+ref_mine(btc_header_t *hdr, uint32_t limit) {
+  /* Per-nonce context copy and finalization. */
+  btc_hash256_t pre, ctx;
+  uint32_t attempt = 0;
+  uint8_t target[32];
+  uint8_t hash[32];
+  uint8_t raw[80];
+
+  ASSERT(btc_compact_export(target, hdr->bits));
+
+  btc_header_write(raw, hdr);
+
+  btc_hash256_init(&pre);
+  btc_hash256_update(&pre, raw, 76);
+
+  do {
+    ctx = pre;
+
+    raw[76] = hdr->nonce >> 0;
+    raw[77] = hdr->nonce >> 8;
+    raw[78] = hdr->nonce >> 16;
+    raw[79] = hdr->nonce >> 24;
+
+    btc_hash256_update(&ctx, raw + 76, 4);
+    btc_hash256_final(&ctx, hash);
+
+    if (btc_hash_compare(hash, target) <= 0)
+      return 1;
+
+    hdr->nonce++;
+
+    if (++attempt == limit)
+      return 0;
+  } while (hdr->nonce != 0);
+
+  return 0;
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  btc_header_t hdr;
+  int64_t start;
+
+  btc_header_init(&hdr);
+
+  memset(hdr.prev_block, 0xaa, 32);
+  memset(hdr.merkle_root, 0x55, 32);
+
+  hdr.version = 0x20000000;
+  hdr.time = 1600000000;
+  hdr.bits = 0x1d00ffff;
+  hdr.nonce = 0;
+
+  start = btc_time_usec();
+
+  ASSERT(!ref_mine(&hdr, BENCH_NONCES));
+
+  bench_print("per-nonce", btc_time_usec() - start);
+
+  ASSERT(hdr.nonce == BENCH_NONCES);
+
+  hdr.nonce = 0;
+
+  start = btc_time_usec();
+
+  ASSERT(!btc_header_mine(&hdr, BENCH_NONCES));
+
+  bench_print("btc_header_mine", btc_time_usec() - start);
+
+  ASSERT(hdr.nonce == BENCH_NONCES);
+
+  return 0;
+}
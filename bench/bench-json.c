@@ -0,0 +1,266 @@
+/*!
+ * bench-json.c - json and base16 benchmark for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+
+#include <mako/encoding.h>
+#include <mako/json.h>
+
+#include "../test/lib/tests.h"
+
+/*
+ * Constants
+ */
+
+#define BENCH_BLOCK_SIZE (1 << 20)
+#define BENCH_BATCH 5000
+#define BENCH_ROUNDS 20
+
+/*
+ * Helpers
+ */
+
+static uint32_t bench_seed = 0x12345678;
+
+static uint32_t
+bench_rand(void) {
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 17;
+  bench_seed ^= bench_seed << 5;
+  return bench_seed;
+}
+
+static void
+bench_print(const char *name, size_t size, int64_t elapsed) {
+  double mb = (double)size * BENCH_ROUNDS / (1024.0 * 1024.0);
+  double sec = (double)elapsed / 1000000.0;
+
+  printf("%-20s %8.3f ms/op (%.0f MB/s)\n",
+         name, (double)elapsed / 1000.0 / BENCH_ROUNDS,
+         mb / (sec > 0.0 ? sec : 1e-9));
+}
+
+/*
+ * Scalar Reference
+ */
+
+static int
+ref_value(int ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+
+  return -1;
+}
+
+static int
+ref_decode(uint8_t *zp, const char *xp, size_t xn) {
+  if (xn & 1)
+    return 0;
+
+  xn >>= 1;
+
+  while (xn--) {
+    int hi = ref_value(*xp++);
+    int lo = ref_value(*xp++);
+
+    if ((hi | lo) < 0)
+      return 0;
+
+    *zp++ = (hi << 4) | lo;
+  }
+
+  return 1;
+}
+
+static void
+ref_encode(char *zp, const uint8_t *xp, size_t xn) {
+  static const char *charset = "0123456789abcdef";
+
+  while (xn--) {
+    *zp++ = charset[*xp >> 4];
+    *zp++ = charset[*xp & 15];
+    xp++;
+  }
+
+  *zp = '\0';
+}
+
+/*
+ * Payloads
+ */
+
+static char *
+create_submitblock(uint8_t *raw, size_t *length) {
+  json_writer w;
+  size_t i;
+
+  for (i = 0; i < BENCH_BLOCK_SIZE; i++)
+    raw[i] = bench_rand();
+
+  json_writer_init(&w);
+  json_write_object(&w);
+  json_write_key(&w, "method");
+  json_write_string(&w, "submitblock");
+  json_write_key(&w, "params");
+  json_write_array(&w);
+  json_write_hex(&w, raw, BENCH_BLOCK_SIZE);
+  json_write_array_end(&w);
+  json_write_key(&w, "id");
+  json_write_integer(&w, 1);
+  json_write_object_end(&w);
+
+  return json_writer_encode(&w, length);
+}
+
+static char *
+create_batch(size_t *length) {
+  uint8_t hash[32];
+  json_writer w;
+  int i, j;
+
+  json_writer_init(&w);
+  json_write_array(&w);
+
+  for (i = 0; i < BENCH_BATCH; i++) {
+    for (j = 0; j < 32; j++)
+      hash[j] = bench_rand();
+
+    json_write_object(&w);
+    json_write_key(&w, "jsonrpc");
+    json_write_string(&w, "1.0");
+    json_write_key(&w, "method");
+    json_write_string(&w, "gettxout");
+    json_write_key(&w, "params");
+    json_write_array(&w);
+    json_write_hash(&w, hash);
+    json_write_integer(&w, i & 3);
+    json_write_boolean(&w, 1);
+    json_write_array_end(&w);
+    json_write_key(&w, "id");
+    json_write_integer(&w, i);
+    json_write_object_end(&w);
+  }
+
+  json_write_array_end(&w);
+
+  return json_writer_encode(&w, length);
+}
+
+/*
+ * Benchmarks
+ */
+
+static void
+bench_parse(const char *name, const char *json, size_t length) {
+  json_value *obj;
+  int64_t start;
+  int i;
+
+  start = btc_time_usec();
+
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    obj = json_decode(json, length);
+
+    ASSERT(obj != NULL);
+
+    json_builder_free(obj);
+  }
+
+  bench_print(name, length, btc_time_usec() - start);
+}
+
+static void
+bench_base16(const uint8_t *raw, const char *str) {
+  size_t len = BENCH_BLOCK_SIZE * 2;
+  uint8_t *data = malloc(BENCH_BLOCK_SIZE);
+  char *out = malloc(len + 1);
+  int64_t start;
+  int i;
+
+  ASSERT(data != NULL && out != NULL);
+
+  start = btc_time_usec();
+
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    ASSERT(ref_decode(data, str, len));
+
+  bench_print("decode (scalar)", len, btc_time_usec() - start);
+
+  start = btc_time_usec();
+
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    ASSERT(btc_base16_decode(data, str, len));
+
+  bench_print("decode", len, btc_time_usec() - start);
+
+  ASSERT(memcmp(data, raw, BENCH_BLOCK_SIZE) == 0);
+
+  start = btc_time_usec();
+
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    ref_encode(out, data, BENCH_BLOCK_SIZE);
+
+  bench_print("encode (scalar)", len, btc_time_usec() - start);
+
+  start = btc_time_usec();
+
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    btc_base16_encode(out, data, BENCH_BLOCK_SIZE);
+
+  bench_print("encode", len, btc_time_usec() - start);
+
+  ASSERT(memcmp(out, str, len) == 0);
+
+  free(data);
+  free(out);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  uint8_t *raw = malloc(BENCH_BLOCK_SIZE);
+  size_t block_len, batch_len;
+  char *block, *batch, *hex;
+  json_value *obj;
+
+  ASSERT(raw != NULL);
+
+  block = create_submitblock(raw, &block_len);
+  batch = create_batch(&batch_len);
+
+  bench_parse("parse submitblock", block, block_len);
+  bench_parse("parse batch", batch, batch_len);
+
+  obj = json_decode(block, block_len);
+
+  ASSERT(obj != NULL);
+
+  hex = obj->u.object.values[1].value->u.array.values[0]->u.string.ptr;
+
+  bench_base16(raw, hex);
+
+  json_builder_free(obj);
+
+  free(block);
+  free(batch);
+  free(raw);
+
+  return 0;
+}
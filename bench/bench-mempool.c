@@ -0,0 +1,301 @@
+/*!
+ * bench-mempool.c - mempool benchmark for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/chain.h>
+#include <node/mempool.h>
+#include <node/miner.h>
+
+#include <mako/address.h>
+#include <mako/bip152.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/crypto/ecc.h>
+#include <mako/entry.h>
+#include <mako/network.h>
+#include <mako/tx.h>
+#include <mako/vector.h>
+
+#include "../test/lib/tests.h"
+
+/*
+ * Constants
+ */
+
+#define BENCH_FUNDS 40
+#define BENCH_FANOUT 50
+#define BENCH_FEE 10000
+
+/*
+ * Helpers
+ */
+
+static btc_tx_t *
+create_spend(const btc_tx_t *prev,
+             uint32_t index,
+             int32_t height,
+             const btc_address_t *addr,
+             const uint8_t *priv,
+             int outputs) {
+  btc_view_t *view = btc_view_create();
+  btc_tx_t *tx = btc_tx_create();
+  const btc_output_t *output;
+  btc_tx_cache_t cache;
+  btc_outpoint_t prevout;
+  int64_t value;
+  int i;
+
+  ASSERT(index < prev->outputs.length);
+
+  output = prev->outputs.items[index];
+  value = (output->value - BENCH_FEE) / outputs;
+
+  btc_outpoint_set(&prevout, prev->hash, index);
+  btc_view_put(view, &prevout, btc_tx_coin(prev, index, height));
+
+  btc_tx_add_outpoint(tx, &prevout);
+
+  for (i = 0; i < outputs; i++)
+    btc_tx_add_output(tx, addr, value);
+
+  memset(&cache, 0, sizeof(cache));
+
+  ASSERT(btc_tx_sign_step(tx, view, priv, &cache) == 1);
+
+  btc_tx_refresh(tx);
+  btc_view_destroy(view);
+
+  return tx;
+}
+
+static void
+bench_run(const char *name,
+          btc_logger_t *logger,
+          btc_chain_t *chain,
+          const btc_vector_t *txs,
+          int threads,
+          int pipeline) {
+  btc_mempool_t *mp = btc_mempool_create(btc_regtest, chain);
+  int64_t start, elapsed;
+  double sec;
+  size_t i;
+
+  btc_mempool_set_logger(mp, logger);
+  btc_mempool_set_threads(mp, threads);
+
+  ASSERT(btc_mempool_open(mp, NULL, 0));
+
+  start = btc_time_usec();
+
+  for (i = 0; i < txs->length; i++) {
+    const btc_tx_t *tx = txs->items[i];
+
+    if (pipeline)
+      ASSERT(btc_mempool_enqueue(mp, tx, 0));
+    else
+      ASSERT(btc_mempool_add(mp, tx, 0));
+  }
+
+  btc_mempool_flush(mp);
+
+  elapsed = btc_time_usec() - start;
+  sec = (double)elapsed / 1000000.0;
+
+  ASSERT(btc_mempool_size(mp) == txs->length);
+
+  printf("%-10s %6lu txs in %8.3f s (%.0f tx/s)\n",
+         name, (unsigned long)txs->length, sec,
+         (double)txs->length / (sec > 0.0 ? sec : 1e-9));
+
+  btc_mempool_close(mp);
+  btc_mempool_destroy(mp);
+}
+
+static void
+bench_compact(btc_logger_t *logger,
+              btc_chain_t *chain,
+              const btc_tx_t *coinbase,
+              const btc_vector_t *txs) {
+  btc_mempool_t *mp = btc_mempool_create(btc_regtest, chain);
+  btc_block_t *block = btc_block_create();
+  int64_t start, index, scan;
+  btc_cmpct_t *cmpct;
+  size_t i;
+
+  btc_mempool_set_logger(mp, logger);
+
+  ASSERT(btc_mempool_open(mp, NULL, 0));
+
+  btc_txvec_push(&block->txs, btc_tx_clone(coinbase));
+
+  for (i = 0; i < txs->length; i++) {
+    const btc_tx_t *tx = txs->items[i];
+
+    ASSERT(btc_mempool_add(mp, tx, 0));
+
+    btc_txvec_push(&block->txs, btc_tx_clone(tx));
+  }
+
+  cmpct = btc_cmpct_create();
+
+  btc_cmpct_set_block(cmpct, block, 1);
+
+  ASSERT(btc_cmpct_setup(cmpct) == 1);
+
+  start = btc_time_usec();
+
+  ASSERT(btc_mempool_fill_compact(mp, cmpct, 1));
+
+  index = btc_time_usec() - start;
+
+  ASSERT(btc_cmpct_setup(cmpct) == 1);
+
+  start = btc_time_usec();
+
+  ASSERT(btc_cmpct_fill_mempool(cmpct, btc_mempool_map(mp), 1));
+
+  scan = btc_time_usec() - start;
+
+  printf("%-10s %6lu txs in %8.3f ms (map scan: %.3f ms)\n",
+         "compact", (unsigned long)txs->length,
+         (double)index / 1000.0, (double)scan / 1000.0);
+
+  btc_cmpct_destroy(cmpct);
+  btc_block_destroy(block);
+  btc_mempool_close(mp);
+  btc_mempool_destroy(mp);
+}
+
+/*
+ * Main
+ */
+
+int
+main(int argc, char **argv) {
+  const btc_network_t *network = btc_regtest;
+  int threads = argc > 1 ? atoi(argv[1]) : 0;
+  btc_vector_t funds, spends;
+  btc_block_t *tip;
+  btc_address_t addr;
+  btc_logger_t *logger;
+  btc_loop_t *loop;
+  btc_chain_t *chain;
+  btc_mempool_t *mp;
+  btc_miner_t *miner;
+  uint8_t priv[32];
+  uint8_t pub[33];
+  int32_t height;
+  size_t i;
+  int j;
+
+  memset(priv, 0x01, sizeof(priv));
+
+  ASSERT(btc_ecdsa_pubkey_create(pub, priv, 1));
+
+  /* Segwit is not yet active this early on regtest. */
+  btc_address_set_p2pk(&addr, pub, 33);
+
+  btc_rimraf(BTC_PREFIX);
+
+  loop = btc_loop_create();
+  logger = btc_logger_create();
+  chain = btc_chain_create(network);
+  mp = btc_mempool_create(network, chain);
+  miner = btc_miner_create(network, loop, chain, mp);
+
+  btc_logger_set_silent(logger, 1);
+
+  btc_chain_set_logger(chain, logger);
+  btc_mempool_set_logger(mp, logger);
+  btc_miner_set_logger(miner, logger);
+
+  btc_chain_set_threads(chain, 1);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_mempool_open(mp, NULL, 0));
+  ASSERT(btc_miner_open(miner, 0));
+
+  /* Mature some coinbases. */
+  btc_miner_generate(miner, 100 + BENCH_FUNDS, &addr);
+
+  btc_vector_init(&funds);
+  btc_vector_init(&spends);
+
+  /* Fan each coinbase out to many outputs. */
+  for (height = 1; height <= BENCH_FUNDS; height++) {
+    const btc_entry_t *entry = btc_chain_by_height(chain, height);
+    btc_block_t *block = btc_chain_get_block(chain, entry);
+    btc_tx_t *tx;
+
+    ASSERT(block != NULL);
+
+    tx = create_spend(block->txs.items[0], 0, height,
+                      &addr, priv, BENCH_FANOUT);
+
+    ASSERT(btc_mempool_add(mp, tx, 0));
+
+    btc_vector_push(&funds, tx);
+    btc_block_destroy(block);
+  }
+
+  btc_miner_generate(miner, 1, &addr);
+
+  for (i = 0; i < funds.length; i++)
+    ASSERT(btc_chain_has_coins(chain, funds.items[i]));
+
+  height = btc_chain_height(chain);
+
+  /* Create the synthetic flood. */
+  for (i = 0; i < funds.length; i++) {
+    for (j = 0; j < BENCH_FANOUT; j++) {
+      btc_tx_t *tx = create_spend(funds.items[i], j, height, &addr, priv, 1);
+
+      btc_vector_push(&spends, tx);
+    }
+  }
+
+  bench_run("serial", logger, chain, &spends, 1, 0);
+  bench_run("pipeline", logger, chain, &spends, threads, 1);
+
+  tip = btc_chain_get_block(chain, btc_chain_tip(chain));
+
+  ASSERT(tip != NULL);
+
+  bench_compact(logger, chain, tip->txs.items[0], &spends);
+
+  btc_block_destroy(tip);
+
+  for (i = 0; i < funds.length; i++)
+    btc_tx_destroy(funds.items[i]);
+
+  for (i = 0; i < spends.length; i++)
+    btc_tx_destroy(spends.items[i]);
+
+  btc_vector_clear(&funds);
+  btc_vector_clear(&spends);
+
+  btc_miner_close(miner);
+  btc_mempool_close(mp);
+  btc_chain_close(chain);
+
+  btc_miner_destroy(miner);
+  btc_mempool_destroy(mp);
+  btc_chain_destroy(chain);
+  btc_logger_destroy(logger);
+  btc_loop_destroy(loop);
+
+  btc_rimraf(BTC_PREFIX);
+
+  return 0;
+}
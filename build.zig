@@ -190,6 +190,7 @@ pub fn build(b: *Builder) void {
     "src/json/json_builder.c",
     "src/json/json_extra.c",
     "src/json/json_parser.c",
+    "src/json/json_writer.c",
     "src/map/addrmap.c",
     "src/map/addrset.c",
     "src/map/hashmap.c",
@@ -330,8 +331,10 @@ pub fn build(b: *Builder) void {
     "src/node/mempool.c",
     "src/node/miner.c",
     "src/node/node.c",
+    "src/node/notifier.c",
     "src/node/pool.c",
-    "src/node/rpc.c"
+    "src/node/rpc.c",
+    "src/node/stratum.c"
   };
 
   const wallet_sources = [_][]const u8{
@@ -530,7 +533,9 @@ pub fn build(b: *Builder) void {
       "chain",
       "mempool",
       "miner",
+      "pool",
       "rpc",
+      "stratum",
       // wallet
       "wallet"
     };
@@ -603,6 +608,7 @@ pub fn build(b: *Builder) void {
     "header",
     "heap",
     "input",
+    "json",
     "list",
     "map",
     "mpi",
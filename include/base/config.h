@@ -27,6 +27,7 @@ struct btc_conf_s {
   int network_active;
   int disable_wallet;
   int cache_size;
+  int mempool_size;
   int checkpoints;
   int prune;
   int workers;
@@ -40,6 +41,8 @@ struct btc_conf_s {
   int max_connections;
   int max_inbound;
   int max_outbound;
+  int net_threads;
+  int max_upload;
   int ban_time;
   int discover;
   int upnp;
@@ -51,11 +54,22 @@ struct btc_conf_s {
   enum btc_ipnet only_net;
   int rpc_port;
   btc_vector_t rpc_bind;
-  char rpc_connect[64];
+  char rpc_path[1024];
+  char rpc_connect[1024];
   char rpc_user[64];
   char rpc_pass[64];
+  int rpc_threads;
+  int rpc_max_connections;
+  int rpc_timeout;
+  int rest;
+  char notify[1024];
+  int notify_port;
+  int stratum_port;
+  int stratum_difficulty;
   int version;
   int help;
+  int stdin_batch;
+  int batch_size;
   const char *method;
   const char *params[8];
   size_t length;
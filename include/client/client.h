@@ -43,11 +43,20 @@ btc_client_close(btc_client_t *client);
 BTC_EXTERN void
 btc_client_auth(btc_client_t *client, const char *user, const char *pass);
 
+BTC_EXTERN struct _json_value *
+btc_client_result(struct _json_value *obj, const char *method);
+
 BTC_EXTERN struct _json_value *
 btc_client_call(btc_client_t *client,
                 const char *method,
                 struct _json_value *params);
 
+BTC_EXTERN int
+btc_client_send(btc_client_t *client, struct _json_value *calls);
+
+BTC_EXTERN struct _json_value *
+btc_client_recv(btc_client_t *client);
+
 #ifdef __cplusplus
 }
 #endif
@@ -198,6 +198,9 @@ btc_fs_seek(btc_fd_t fd, int64_t pos);
 BTC_EXTERN int64_t
 btc_fs_read(btc_fd_t fd, void *dst, size_t len);
 
+BTC_EXTERN int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos);
+
 BTC_EXTERN int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len);
 
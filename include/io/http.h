@@ -12,6 +12,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include "core.h"
 #include "loop.h"
 #include "../mako/common.h"
@@ -88,20 +89,31 @@ typedef struct http_head {
 
 typedef struct http_req {
   unsigned int method;
+  unsigned int major;
+  unsigned int minor;
   http_string_t path;
   http_head_t headers;
   http_string_t user;
   http_string_t pass;
   http_string_t body;
+  struct http_req *next;
 } http_req_t;
 
+struct http_server;
+
 typedef struct http_res {
   btc_socket_t *socket;
   http_head_t headers;
+  struct http_server *server;
+  void *conn;
+  int deferred;
+  int chunked;
+  unsigned int status;
+  const char *type;
+  http_string_t body;
+  struct http_res *next;
 } http_res_t;
 
-struct http_server;
-
 typedef int http_server_request_cb(struct http_server *,
                                    http_req_t *,
                                    http_res_t *);
@@ -111,6 +123,18 @@ typedef struct http_server {
   btc_server_t *tcp;
   http_server_request_cb *on_request;
   void *data;
+  btc_timer_t *timer;
+  struct http_conn_s *head;
+  struct http_conn_s *tail;
+  size_t connections;
+  size_t max_connections;
+  int64_t timeout;
+  http_req_t *reqs;
+  http_res_t *ress;
+  size_t nreqs;
+  size_t nress;
+  int64_t now;
+  char date[64];
 } http_server_t;
 
 typedef struct http_options {
@@ -130,6 +154,7 @@ typedef struct http_msg {
   unsigned int status;
   http_head_t headers;
   http_string_t body;
+  struct http_msg *next;
 } http_msg_t;
 
 typedef struct http_client http_client_t;
@@ -161,12 +186,27 @@ http_res_send_data(http_res_t *res,
                    void *body,
                    size_t length);
 
+BTC_EXTERN void
+http_res_begin(http_res_t *res, unsigned int status, const char *type);
+
+BTC_EXTERN void
+http_res_chunk(http_res_t *res, void *data, size_t length);
+
+BTC_EXTERN void
+http_res_end(http_res_t *res);
+
 BTC_EXTERN void
 http_res_error(http_res_t *res, unsigned int status);
 
 BTC_EXTERN void
 http_res_unauthorized(http_res_t *res, const char *realm);
 
+BTC_EXTERN void
+http_res_defer(http_res_t *res);
+
+BTC_EXTERN void
+http_res_finish(http_res_t *res);
+
 /*
  * Server
  */
@@ -180,6 +220,12 @@ http_server_destroy(http_server_t *server);
 BTC_EXTERN const char *
 http_server_strerror(http_server_t *server);
 
+BTC_EXTERN void
+http_server_set_max_connections(http_server_t *server, size_t max);
+
+BTC_EXTERN void
+http_server_set_timeout(http_server_t *server, int64_t timeout);
+
 BTC_EXTERN int
 http_server_listen(http_server_t *server, const btc_sockaddr_t *addr);
 
@@ -189,6 +235,9 @@ http_server_listen_local(http_server_t *server, int port);
 BTC_EXTERN int
 http_server_listen_external(http_server_t *server, int port);
 
+BTC_EXTERN int
+http_server_listen_unix(http_server_t *server, const char *path);
+
 BTC_EXTERN void
 http_server_close(http_server_t *server);
 
@@ -244,6 +293,12 @@ http_client_open(http_client_t *client,
 BTC_EXTERN void
 http_client_close(http_client_t *client);
 
+BTC_EXTERN int
+http_client_send(http_client_t *client, const http_options_t *options);
+
+BTC_EXTERN http_msg_t *
+http_client_recv(http_client_t *client);
+
 BTC_EXTERN http_msg_t *
 http_client_request(http_client_t *client, const http_options_t *options);
 
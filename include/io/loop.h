@@ -12,6 +12,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include "../mako/common.h"
 
 /*
@@ -21,10 +22,21 @@ extern "C" {
 typedef struct btc_loop_s btc_loop_t;
 typedef struct btc_socket_s btc_socket_t;
 typedef struct btc_server_s btc_server_t;
+typedef struct btc_timer_s btc_timer_t;
+
+typedef struct btc_iobuf_s {
+  struct btc_loop_s *loop;
+  unsigned char *data;
+  size_t length;
+  size_t alloc;
+  int refs;
+  struct btc_iobuf_s *next;
+} btc_iobuf_t;
 
 struct btc_sockaddr_s;
 
 typedef void btc_loop_tick_cb(void *arg);
+typedef void btc_timer_cb(void *arg);
 typedef void btc_socket_socket_cb(btc_socket_t *, btc_socket_t *);
 typedef void btc_socket_connect_cb(btc_socket_t *);
 typedef void btc_socket_close_cb(btc_socket_t *);
@@ -85,6 +97,9 @@ btc_socket_set_nodelay(btc_socket_t *socket, int value);
 BTC_EXTERN int
 btc_socket_write(btc_socket_t *socket, void *data, size_t len);
 
+BTC_EXTERN int
+btc_socket_write_buf(btc_socket_t *socket, btc_iobuf_t *buf);
+
 BTC_EXTERN int
 btc_socket_send(btc_socket_t *socket,
                 void *data,
@@ -97,6 +112,9 @@ btc_socket_close(btc_socket_t *socket);
 BTC_EXTERN void
 btc_socket_timeout(btc_socket_t *socket);
 
+BTC_EXTERN void
+btc_socket_detach(btc_socket_t *socket);
+
 /*
  * Loop
  */
@@ -113,21 +131,33 @@ btc_loop_on_tick(btc_loop_t *loop, btc_loop_tick_cb *handler, void *data);
 BTC_EXTERN void
 btc_loop_off_tick(btc_loop_t *loop, btc_loop_tick_cb *handler, void *data);
 
+BTC_EXTERN void
+btc_loop_wakeup(btc_loop_t *loop);
+
 BTC_EXTERN const char *
 btc_loop_strerror(btc_loop_t *loop);
 
 BTC_EXTERN btc_socket_t *
 btc_loop_listen(btc_loop_t *loop, const struct btc_sockaddr_s *addr);
 
+BTC_EXTERN btc_socket_t *
+btc_loop_listen_unix(btc_loop_t *loop, const char *path);
+
 BTC_EXTERN btc_socket_t *
 btc_loop_connect(btc_loop_t *loop, const struct btc_sockaddr_s *addr);
 
+BTC_EXTERN btc_socket_t *
+btc_loop_connect_unix(btc_loop_t *loop, const char *path);
+
 BTC_EXTERN btc_socket_t *
 btc_loop_bind(btc_loop_t *loop, const struct btc_sockaddr_s *addr);
 
 BTC_EXTERN btc_socket_t *
 btc_loop_talk(btc_loop_t *loop, int family);
 
+BTC_EXTERN int
+btc_loop_attach(btc_loop_t *loop, btc_socket_t *socket);
+
 BTC_EXTERN void
 btc_loop_start(btc_loop_t *loop);
 
@@ -146,6 +176,38 @@ btc_loop_close(btc_loop_t *loop);
 BTC_EXTERN int
 btc_loop_fd_setsize(void);
 
+/*
+ * I/O Buffer
+ */
+
+BTC_EXTERN btc_iobuf_t *
+btc_iobuf_create(btc_loop_t *loop, size_t length);
+
+BTC_EXTERN btc_iobuf_t *
+btc_iobuf_ref(btc_iobuf_t *buf);
+
+BTC_EXTERN void
+btc_iobuf_destroy(btc_iobuf_t *buf);
+
+/*
+ * Timer
+ */
+
+BTC_EXTERN btc_timer_t *
+btc_timer_create(btc_loop_t *loop, btc_timer_cb *handler, void *data);
+
+BTC_EXTERN void
+btc_timer_destroy(btc_timer_t *timer);
+
+BTC_EXTERN void
+btc_timer_start(btc_timer_t *timer, int64_t timeout, int64_t repeat);
+
+BTC_EXTERN void
+btc_timer_stop(btc_timer_t *timer);
+
+BTC_EXTERN int
+btc_timer_active(const btc_timer_t *timer);
+
 /*
  * Server
  */
@@ -162,6 +224,9 @@ btc_server_strerror(btc_server_t *server);
 BTC_EXTERN int
 btc_server_listen(btc_server_t *server, const btc_sockaddr_t *addr);
 
+BTC_EXTERN int
+btc_server_listen_unix(btc_server_t *server, const char *path);
+
 BTC_EXTERN int
 btc_server_listen_local(btc_server_t *server, int port);
 
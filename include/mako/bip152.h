@@ -72,6 +72,12 @@ btc_cmpct_setup(btc_cmpct_t *blk);
 BTC_EXTERN int
 btc_cmpct_fill_mempool(btc_cmpct_t *blk, const btc_hashmap_t *map, int witness);
 
+BTC_EXTERN int
+btc_cmpct_fill_hashes(btc_cmpct_t *blk,
+                      const uint8_t *hashes,
+                      btc_tx_t *const *txs,
+                      size_t length);
+
 BTC_EXTERN int
 btc_cmpct_fill_missing(btc_cmpct_t *blk, const btc_blocktxn_t *msg);
 
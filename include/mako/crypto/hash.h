@@ -45,6 +45,12 @@ btc_hash256(uint8_t *out, const void *data, size_t size);
 BTC_EXTERN void
 btc_hash256_root(uint8_t *out, const void *left, const void *right);
 
+BTC_EXTERN int
+btc_hash256_scan(uint8_t *hash,
+                 uint8_t *raw,
+                 const uint8_t *target,
+                 uint32_t limit);
+
 BTC_EXTERN uint32_t
 btc_checksum(const void *data, size_t size);
 
@@ -28,6 +28,12 @@ btc_siphash_mod(const uint8_t *data,
                 const uint8_t *key,
                 uint64_t mod);
 
+BTC_EXTERN void
+btc_siphash_batch(uint64_t *out,
+                  const uint8_t *data,
+                  size_t count,
+                  const uint8_t *key);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,30 @@
 #define json_print btc_json_print
 #define json_print_ex btc_json_print_ex
 
+#define json_writer_init btc_json_writer_init
+#define json_writer_clear btc_json_writer_clear
+#define json_writer_create btc_json_writer_create
+#define json_writer_destroy btc_json_writer_destroy
+#define json_writer_concat btc_json_writer_concat
+#define json_writer_shift btc_json_writer_shift
+#define json_writer_encode btc_json_writer_encode
+#define json_write_data btc_json_write_data
+#define json_write_object btc_json_write_object
+#define json_write_object_end btc_json_write_object_end
+#define json_write_array btc_json_write_array
+#define json_write_array_end btc_json_write_array_end
+#define json_write_key btc_json_write_key
+#define json_write_string btc_json_write_string
+#define json_write_string_length btc_json_write_string_length
+#define json_write_integer btc_json_write_integer
+#define json_write_amount btc_json_write_amount
+#define json_write_double btc_json_write_double
+#define json_write_boolean btc_json_write_boolean
+#define json_write_null btc_json_write_null
+#define json_write_hex btc_json_write_hex
+#define json_write_hash btc_json_write_hash
+#define json_write_value btc_json_write_value
+
 #define json_raw_new btc_json_raw_new
 #define json_raw_get btc_json_raw_get
 #define json_hash_new btc_json_hash_new
@@ -56,6 +80,9 @@
 #define json_entry_new_ex btc_json_entry_new_ex
 #define json_block_new_ex btc_json_block_new_ex
 
+#define json_tx_write btc_json_tx_write
+#define json_block_write btc_json_block_write
+
 #define json_tx_base btc_json_tx_base
 #define json_tx_base_get btc_json_tx_base_get
 #define json_tx_raw btc_json_tx_raw
@@ -70,6 +97,24 @@
 extern "C" {
 #endif
 
+/*
+ * Types
+ */
+
+typedef struct json_chunk {
+  char *data;
+  size_t length;
+  size_t size;
+  struct json_chunk *next;
+} json_chunk;
+
+typedef struct json_writer {
+  json_chunk *head;
+  json_chunk *tail;
+  size_t total;
+  int comma;
+} json_writer;
+
 /*
  * JSON Extras
  */
@@ -124,6 +169,79 @@ json_print_ex(json_value *value,
               int (*json_puts)(const char *),
               json_serialize_opts opts);
 
+/*
+ * JSON Writer
+ */
+
+BTC_EXTERN void
+json_writer_init(json_writer *w);
+
+BTC_EXTERN void
+json_writer_clear(json_writer *w);
+
+BTC_EXTERN json_writer *
+json_writer_create(void);
+
+BTC_EXTERN void
+json_writer_destroy(json_writer *w);
+
+BTC_EXTERN void
+json_writer_concat(json_writer *z, json_writer *x);
+
+BTC_EXTERN int
+json_writer_shift(json_writer *w, char **data, size_t *length);
+
+BTC_EXTERN char *
+json_writer_encode(json_writer *w, size_t *length);
+
+BTC_EXTERN void
+json_write_data(json_writer *w, const char *xp, size_t xn);
+
+BTC_EXTERN void
+json_write_object(json_writer *w);
+
+BTC_EXTERN void
+json_write_object_end(json_writer *w);
+
+BTC_EXTERN void
+json_write_array(json_writer *w);
+
+BTC_EXTERN void
+json_write_array_end(json_writer *w);
+
+BTC_EXTERN void
+json_write_key(json_writer *w, const char *key);
+
+BTC_EXTERN void
+json_write_string(json_writer *w, const char *str);
+
+BTC_EXTERN void
+json_write_string_length(json_writer *w, const char *str, size_t len);
+
+BTC_EXTERN void
+json_write_integer(json_writer *w, int64_t x);
+
+BTC_EXTERN void
+json_write_amount(json_writer *w, int64_t x);
+
+BTC_EXTERN void
+json_write_double(json_writer *w, double x);
+
+BTC_EXTERN void
+json_write_boolean(json_writer *w, int x);
+
+BTC_EXTERN void
+json_write_null(json_writer *w);
+
+BTC_EXTERN void
+json_write_hex(json_writer *w, const uint8_t *xp, size_t xn);
+
+BTC_EXTERN void
+json_write_hash(json_writer *w, const uint8_t *hash);
+
+BTC_EXTERN void
+json_write_value(json_writer *w, json_value *value);
+
 /*
  * JSON Objects
  */
@@ -232,6 +350,26 @@ json_block_new_ex(const btc_block_t *block,
                   int details,
                   const btc_network_t *network);
 
+/*
+ * JSON Streams
+ */
+
+BTC_EXTERN void
+json_tx_write(json_writer *w,
+              const btc_tx_t *tx,
+              const btc_view_t *view,
+              const btc_network_t *network);
+
+BTC_EXTERN void
+json_block_write(json_writer *w,
+                 const btc_block_t *block,
+                 const btc_entry_t *entry,
+                 const btc_view_t *view,
+                 int confirmations,
+                 const uint8_t *next,
+                 int details,
+                 const btc_network_t *network);
+
 /*
  * Hexification
  */
@@ -121,6 +121,18 @@ enum btc_net_services {
 
 #define BTC_NET_MAX_MESSAGE (4 * 1000 * 1000)
 
+/**
+ * Largest receive buffer a peer keeps between messages.
+ */
+
+#define BTC_NET_PARSER_RETAIN (256 * 1024)
+
+/**
+ * Receive buffer allocated up front for a message body.
+ */
+
+#define BTC_NET_PARSER_INITIAL (64 * 1024)
+
 /**
  * Amount of time to ban misbheaving peers.
  */
@@ -151,6 +163,30 @@ enum btc_net_services {
 
 #define BTC_NET_MAX_BLOCK_REQUEST (50000 + 1000)
 
+/**
+ * Number of blocks ahead of the tip to download during sync.
+ */
+
+#define BTC_NET_BLOCK_WINDOW 1024
+
+/**
+ * Maximum number of blocks in flight per peer during sync.
+ */
+
+#define BTC_NET_MAX_BLOCKS_IN_FLIGHT 16
+
+/**
+ * Maximum number of headers to hold ahead of the tip.
+ */
+
+#define BTC_NET_MAX_HEADER_AHEAD 100000
+
+/**
+ * Maximum size of out-of-order blocks to buffer during sync.
+ */
+
+#define BTC_NET_MAX_BLOCK_BUFFER (128 << 20)
+
 /**
  * Maximum number of tx requests.
  */
@@ -119,23 +119,31 @@ extern "C" {
 #define BTC_MEMPOOL_MAX_ANCESTORS 25
 
 /**
- * Default maximum mempool size in bytes.
+ * Default maximum mempool memory usage in bytes.
  */
 
 #define BTC_MEMPOOL_MAX_SIZE (100 * 1000000)
 
 /**
- * Default threshold mempool size in bytes.
+ * Time at which transactions
+ * fall out of the mempool.
  */
 
-#define BTC_MEMPOOL_THRESHOLD (BTC_MEMPOOL_MAX_SIZE - BTC_MEMPOOL_MAX_SIZE / 10)
+#define BTC_MEMPOOL_EXPIRY_TIME (72 * 60 * 60)
 
 /**
- * Time at which transactions
- * fall out of the mempool.
+ * Maximum number of transactions a
+ * replacement may evict (BIP125).
  */
 
-#define BTC_MEMPOOL_EXPIRY_TIME (72 * 60 * 60)
+#define BTC_MEMPOOL_MAX_REPLACEMENTS 100
+
+/**
+ * Maximum input sequence which signals
+ * replaceability (BIP125).
+ */
+
+#define BTC_MAX_RBF_SEQUENCE 0xfffffffd
 
 /**
  * Maximum number of orphan transactions.
@@ -143,6 +151,20 @@ extern "C" {
 
 #define BTC_MEMPOOL_MAX_ORPHANS 100
 
+/**
+ * Maximum number of transactions awaiting
+ * script verification before a flush.
+ */
+
+#define BTC_MEMPOOL_MAX_PENDING 256
+
+/**
+ * Number of evicted and orphaned transactions
+ * kept around for compact block reconstruction.
+ */
+
+#define BTC_MEMPOOL_MAX_EXTRA 100
+
 /**
  * Minimum block size to create. Block will be
  * filled with free transactions until block
@@ -42,6 +42,7 @@ typedef struct btc_selopt_s {
   int round;
   int smart;
   int watch;
+  int rbf;
 } btc_selopt_t;
 
 typedef struct btc_selector_s {
@@ -258,6 +258,7 @@ typedef struct btc_mpentry_s {
   uint8_t locks;
   int64_t desc_fee;
   int64_t desc_size;
+  size_t _index;
 } btc_mpentry_t;
 
 /* https://github.com/satoshilabs/slips/blob/master/slip-0132.md */
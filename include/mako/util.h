@@ -167,6 +167,9 @@ btc_now(void);
 BTC_EXTERN double
 btc_difficulty(uint32_t bits);
 
+BTC_EXTERN void
+btc_difficulty_target(uint8_t *target, double difficulty);
+
 #ifdef __cplusplus
 }
 #endif
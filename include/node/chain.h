@@ -191,6 +191,21 @@ btc_chain_has_coins(btc_chain_t *chain, const btc_tx_t *tx);
 BTC_EXTERN btc_coin_t *
 btc_chain_coin(btc_chain_t *chain, const uint8_t *hash, size_t index);
 
+BTC_EXTERN const btc_snapshot_t *
+btc_chain_snapshot(btc_chain_t *chain);
+
+BTC_EXTERN void
+btc_chain_release(btc_chain_t *chain, const btc_snapshot_t *snapshot);
+
+BTC_EXTERN btc_coin_t *
+btc_chain_coin_at(btc_chain_t *chain,
+                  const btc_snapshot_t *snapshot,
+                  const uint8_t *hash,
+                  size_t index);
+
+BTC_EXTERN btc_coin_t *
+btc_chain_tx_coin(btc_chain_t *chain, const uint8_t *hash);
+
 BTC_EXTERN int
 btc_chain_get_coins(btc_chain_t *chain,
                     btc_view_t *view,
@@ -205,6 +220,12 @@ btc_chain_get_raw_block(btc_chain_t *chain,
                         size_t *length,
                         const btc_entry_t *entry);
 
+BTC_EXTERN int
+btc_chain_get_block_data(btc_chain_t *chain,
+                         uint8_t **data,
+                         size_t *length,
+                         const btc_entry_t *entry);
+
 BTC_EXTERN btc_view_t *
 btc_chain_get_undo(btc_chain_t *chain,
                    const btc_entry_t *entry,
@@ -30,6 +30,10 @@ typedef void btc_mempool_badorphan_cb(const btc_verify_error_t *err,
                                       unsigned int id,
                                       void *arg);
 
+typedef void btc_mempool_reject_cb(const btc_verify_error_t *err,
+                                   unsigned int id,
+                                   void *arg);
+
 /*
  * Mempool
  */
@@ -46,6 +50,12 @@ btc_mempool_set_logger(btc_mempool_t *mp, btc_logger_t *logger);
 BTC_EXTERN void
 btc_mempool_set_timedata(btc_mempool_t *mp, const btc_timedata_t *td);
 
+BTC_EXTERN void
+btc_mempool_set_threads(btc_mempool_t *mp, int threads);
+
+BTC_EXTERN void
+btc_mempool_set_limit(btc_mempool_t *mp, size_t limit);
+
 BTC_EXTERN void
 btc_mempool_on_tx(btc_mempool_t *mp, btc_mempool_tx_cb *handler);
 
@@ -53,6 +63,9 @@ BTC_EXTERN void
 btc_mempool_on_badorphan(btc_mempool_t *mp,
                          btc_mempool_badorphan_cb *handler);
 
+BTC_EXTERN void
+btc_mempool_on_reject(btc_mempool_t *mp, btc_mempool_reject_cb *handler);
+
 BTC_EXTERN void
 btc_mempool_set_context(btc_mempool_t *mp, void *arg);
 
@@ -70,6 +83,17 @@ btc_mempool_add(btc_mempool_t *mp,
                 const btc_tx_t *tx,
                 unsigned int id);
 
+BTC_EXTERN int
+btc_mempool_enqueue(btc_mempool_t *mp,
+                    const btc_tx_t *tx,
+                    unsigned int id);
+
+BTC_EXTERN void
+btc_mempool_flush(btc_mempool_t *mp);
+
+BTC_EXTERN void
+btc_mempool_tick(void *ptr);
+
 BTC_EXTERN void
 btc_mempool_add_block(btc_mempool_t *mp,
                       const btc_entry_t *entry,
@@ -89,6 +113,18 @@ btc_mempool_error(btc_mempool_t *mp);
 BTC_EXTERN size_t
 btc_mempool_size(btc_mempool_t *mp);
 
+BTC_EXTERN size_t
+btc_mempool_bytes(btc_mempool_t *mp);
+
+BTC_EXTERN uint32_t
+btc_mempool_sequence(btc_mempool_t *mp);
+
+BTC_EXTERN size_t
+btc_mempool_usage(btc_mempool_t *mp);
+
+BTC_EXTERN size_t
+btc_mempool_limit(btc_mempool_t *mp);
+
 BTC_EXTERN int
 btc_mempool_has(btc_mempool_t *mp, const uint8_t *hash);
 
@@ -98,6 +134,12 @@ btc_mempool_get(btc_mempool_t *mp, const uint8_t *hash);
 BTC_EXTERN btc_coin_t *
 btc_mempool_coin(btc_mempool_t *mp, const uint8_t *hash, size_t index);
 
+BTC_EXTERN int
+btc_mempool_is_spent(btc_mempool_t *mp, const uint8_t *hash, size_t index);
+
+BTC_EXTERN int
+btc_mempool_has_pending(btc_mempool_t *mp, const uint8_t *hash);
+
 BTC_EXTERN int
 btc_mempool_has_orphan(btc_mempool_t *mp, const uint8_t *hash);
 
@@ -110,6 +152,11 @@ btc_mempool_missing(btc_mempool_t *mp, const btc_tx_t *tx);
 BTC_EXTERN const btc_hashmap_t *
 btc_mempool_map(const btc_mempool_t *mp);
 
+BTC_EXTERN int
+btc_mempool_fill_compact(btc_mempool_t *mp,
+                         struct btc_cmpct_s *blk,
+                         int witness);
+
 #ifdef __cplusplus
 }
 #endif
@@ -136,6 +136,11 @@ btc_tmpl_submitwork(const btc_tmpl_t *bt,
                     uint32_t nonce1,
                     uint32_t nonce2);
 
+BTC_EXTERN btc_block_t *
+btc_tmpl_rebuild(const btc_tmpl_t *bt,
+                 const btc_header_t *hdr,
+                 btc_tx_t *cb);
+
 BTC_EXTERN btc_block_t *
 btc_tmpl_mine(const btc_tmpl_t *bt);
 
@@ -188,6 +193,12 @@ btc_miner_update_time(btc_miner_t *miner, btc_tmpl_t *bt);
 BTC_EXTERN btc_tmpl_t *
 btc_miner_template(btc_miner_t *miner);
 
+BTC_EXTERN const btc_tmpl_t *
+btc_miner_get_template(btc_miner_t *miner);
+
+BTC_EXTERN btc_block_t *
+btc_miner_rebuild(btc_miner_t *miner, const btc_header_t *hdr, btc_tx_t *cb);
+
 BTC_EXTERN int
 btc_miner_getgenerate(btc_miner_t *miner);
 
@@ -0,0 +1,89 @@
+/*!
+ * notifier.h - block and tx notifications for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_NOTIFIER_H
+#define BTC_NOTIFIER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "types.h"
+#include "../mako/common.h"
+#include "../mako/types.h"
+
+/*
+ * Constants
+ */
+
+/* A subscriber writes a single byte holding the
+ * topics it wants (the most recent byte wins) and
+ * reads back frames of the form:
+ *
+ *   topic (1) | sequence (4, LE) | length (4, LE) | payload
+ *
+ * Hashes are in internal byte order. Sequence
+ * payloads are a hash followed by one of 'C'
+ * (connect), 'D' (disconnect), 'R' (reorg, new
+ * tip) or 'A' (tx accepted to the mempool).
+ */
+
+enum btc_notify_topic {
+  BTC_NOTIFY_HASHBLOCK = 1 << 0,
+  BTC_NOTIFY_HASHTX = 1 << 1,
+  BTC_NOTIFY_RAWBLOCK = 1 << 2,
+  BTC_NOTIFY_RAWTX = 1 << 3,
+  BTC_NOTIFY_SEQUENCE = 1 << 4,
+  BTC_NOTIFY_ALL = (1 << 5) - 1
+};
+
+/*
+ * Notifier
+ */
+
+BTC_EXTERN btc_notifier_t *
+btc_notifier_create(struct btc_loop_s *loop);
+
+BTC_EXTERN void
+btc_notifier_destroy(btc_notifier_t *notifier);
+
+BTC_EXTERN void
+btc_notifier_set_logger(btc_notifier_t *notifier, btc_logger_t *logger);
+
+BTC_EXTERN void
+btc_notifier_set_path(btc_notifier_t *notifier, const char *path);
+
+BTC_EXTERN void
+btc_notifier_set_port(btc_notifier_t *notifier, int port);
+
+BTC_EXTERN int
+btc_notifier_open(btc_notifier_t *notifier, const char *prefix);
+
+BTC_EXTERN void
+btc_notifier_close(btc_notifier_t *notifier);
+
+BTC_EXTERN void
+btc_notifier_connect(btc_notifier_t *notifier,
+                     const btc_entry_t *entry,
+                     const btc_block_t *block);
+
+BTC_EXTERN void
+btc_notifier_disconnect(btc_notifier_t *notifier, const btc_entry_t *entry);
+
+BTC_EXTERN void
+btc_notifier_reorganize(btc_notifier_t *notifier,
+                        const btc_entry_t *old,
+                        const btc_entry_t *new_);
+
+BTC_EXTERN void
+btc_notifier_tx(btc_notifier_t *notifier, const btc_tx_t *tx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTC_NOTIFIER_H */
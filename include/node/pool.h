@@ -14,8 +14,43 @@ extern "C" {
 #include <stddef.h>
 #include "types.h"
 #include "../mako/common.h"
+#include "../mako/netmsg.h"
 #include "../mako/types.h"
 
+/*
+ * Types
+ */
+
+typedef struct btc_traffic_s {
+  uint64_t bytes_sent;
+  uint64_t bytes_recv;
+  uint64_t sent[BTC_MSG_UNKNOWN + 1];
+  uint64_t recv[BTC_MSG_UNKNOWN + 1];
+} btc_traffic_t;
+
+typedef struct btc_peerinfo_s {
+  unsigned int id;
+  btc_netaddr_t addr;
+  btc_netaddr_t local;
+  int outbound;
+  uint64_t services;
+  uint32_t version;
+  char agent[256 + 1];
+  int32_t height;
+  int relay;
+  int64_t last_send;
+  int64_t last_recv;
+  int64_t last_ping;
+  int64_t last_pong;
+  int64_t min_ping;
+  int ban_score;
+  btc_traffic_t traffic;
+} btc_peerinfo_t;
+
+/*
+ * Pool
+ */
+
 BTC_EXTERN btc_pool_t *
 btc_pool_create(const btc_network_t *network,
                 struct btc_loop_s *loop,
@@ -58,6 +93,12 @@ btc_pool_set_bantime(btc_pool_t *pool, int64_t ban_time);
 BTC_EXTERN void
 btc_pool_set_onlynet(btc_pool_t *pool, enum btc_ipnet only_net);
 
+BTC_EXTERN void
+btc_pool_set_threads(btc_pool_t *pool, int threads);
+
+BTC_EXTERN void
+btc_pool_set_maxupload(btc_pool_t *pool, uint64_t max_upload);
+
 BTC_EXTERN int
 btc_pool_open(btc_pool_t *pool, const char *prefix, unsigned int flags);
 
@@ -72,12 +113,30 @@ btc_pool_announce_block(btc_pool_t *pool,
 BTC_EXTERN void
 btc_pool_announce_tx(btc_pool_t *pool, const btc_mpentry_t *entry);
 
+BTC_EXTERN const btc_traffic_t *
+btc_pool_traffic(const btc_pool_t *pool);
+
+BTC_EXTERN uint64_t
+btc_pool_maxupload(const btc_pool_t *pool);
+
+BTC_EXTERN size_t
+btc_pool_size(const btc_pool_t *pool);
+
+BTC_EXTERN size_t
+btc_pool_peerinfo(const btc_pool_t *pool, btc_peerinfo_t *items, size_t max);
+
 BTC_EXTERN void
 btc_pool_handle_badorphan(btc_pool_t *pool,
                           const char *msg,
                           const btc_verify_error_t *err,
                           unsigned int id);
 
+BTC_EXTERN void
+btc_pool_handle_reject(btc_pool_t *pool,
+                       const char *msg,
+                       const btc_verify_error_t *err,
+                       unsigned int id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,9 +32,21 @@ btc_rpc_set_port(btc_rpc_t *rpc, int port);
 BTC_EXTERN void
 btc_rpc_set_bind(btc_rpc_t *rpc, const btc_netaddr_t *addr);
 
+BTC_EXTERN void
+btc_rpc_set_path(btc_rpc_t *rpc, const char *path);
+
 BTC_EXTERN void
 btc_rpc_set_credentials(btc_rpc_t *rpc, const char *user, const char *pass);
 
+BTC_EXTERN void
+btc_rpc_set_threads(btc_rpc_t *rpc, int threads);
+
+BTC_EXTERN void
+btc_rpc_set_max_connections(btc_rpc_t *rpc, int max);
+
+BTC_EXTERN void
+btc_rpc_set_timeout(btc_rpc_t *rpc, int timeout);
+
 BTC_EXTERN int
 btc_rpc_open(btc_rpc_t *rpc, unsigned int flags);
 
@@ -62,6 +62,7 @@ enum btc_node_flags {
   /*
    * RPC
    */
+  BTC_RPC_REST = 1 << 16,
   BTC_RPC_DEFAULT_FLAGS = 0
 };
 
@@ -71,6 +72,7 @@ enum btc_node_flags {
 
 struct btc_network_s;
 struct btc_loop_s;
+struct btc_cmpct_s;
 
 typedef struct btc_deployment_state_s {
   unsigned int flags;
@@ -82,6 +84,7 @@ typedef struct btc_deployment_state_s {
 
 typedef struct btc_chaindb_s btc_chaindb_t;
 typedef struct btc_chain_s btc_chain_t;
+typedef struct btc_snapshot_s btc_snapshot_t;
 
 typedef struct btc_pool_s btc_pool_t;
 
@@ -93,6 +96,10 @@ struct btc_wallet_s;
 
 typedef struct btc_rpc_s btc_rpc_t;
 
+typedef struct btc_notifier_s btc_notifier_t;
+
+typedef struct btc_stratum_s btc_stratum_t;
+
 typedef struct btc_node_s {
   const struct btc_network_s *network;
   struct btc_loop_s *loop;
@@ -104,6 +111,9 @@ typedef struct btc_node_s {
   btc_pool_t *pool;
   struct btc_wallet_s *wallet;
   btc_rpc_t *rpc;
+  btc_notifier_t *notifier;
+  btc_stratum_t *stratum;
+  struct btc_timer_s *timer;
 } btc_node_t;
 
 #ifdef __cplusplus
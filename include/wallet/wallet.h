@@ -185,6 +185,12 @@ btc_wallet_send(btc_wallet_t *wallet,
                 const btc_selopt_t *options,
                 btc_tx_t *tx);
 
+int
+btc_wallet_bump(btc_tx_t **result,
+                btc_wallet_t *wallet,
+                const uint8_t *hash,
+                int64_t rate);
+
 int
 btc_wallet_add_tx(btc_wallet_t *wallet, const btc_tx_t *tx);
 
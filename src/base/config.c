@@ -460,6 +460,7 @@ conf_init(btc_conf_t *conf) {
   conf->network_active = 1;
   conf->disable_wallet = 0;
   conf->cache_size = 128;
+  conf->mempool_size = 100;
   conf->checkpoints = 1;
   conf->prune = 0;
   conf->workers = 0;
@@ -473,6 +474,8 @@ conf_init(btc_conf_t *conf) {
   conf->max_connections = 0;
   conf->max_inbound = 128;
   conf->max_outbound = 8;
+  conf->net_threads = 0;
+  conf->max_upload = 0;
   conf->ban_time = 24 * 60 * 60;
   conf->discover = 1;
   conf->upnp = 0;
@@ -484,11 +487,22 @@ conf_init(btc_conf_t *conf) {
   conf->only_net = BTC_IPNET_NONE;
   conf->rpc_port = 0;
   btc_vector_init(&conf->rpc_bind);
+  btc_str_assign(conf->rpc_path, "");
   btc_str_assign(conf->rpc_connect, "127.0.0.1");
   btc_str_assign(conf->rpc_user, "bitcoinrpc");
   btc_str_assign(conf->rpc_pass, "");
+  conf->rpc_threads = 4;
+  conf->rpc_max_connections = 128;
+  conf->rpc_timeout = 30;
+  conf->rest = 0;
+  btc_str_assign(conf->notify, "");
+  conf->notify_port = 0;
+  conf->stratum_port = 0;
+  conf->stratum_difficulty = 1;
   conf->version = 0;
   conf->help = 0;
+  conf->stdin_batch = 0;
+  conf->batch_size = 100;
   conf->method = NULL;
   conf->params[0] = NULL;
   conf->length = 0;
@@ -586,6 +600,9 @@ conf_read_file(btc_conf_t *conf, const char *file) {
     if (btc_match_range(&conf->cache_size, opt, "dbcache=", 8, 2048))
       continue;
 
+    if (btc_match_range(&conf->mempool_size, opt, "maxmempool=", 5, 16384))
+      continue;
+
     if (btc_match_bool(&conf->checkpoints, opt, "checkpoints="))
       continue;
 
@@ -633,6 +650,12 @@ conf_read_file(btc_conf_t *conf, const char *file) {
     if (btc_match_uint(&conf->max_outbound, opt, "maxoutbound="))
       continue;
 
+    if (btc_match_range(&conf->net_threads, opt, "netthreads=", 0, 64))
+      continue;
+
+    if (btc_match_uint(&conf->max_upload, opt, "maxuploadtarget="))
+      continue;
+
     if (btc_match_uint(&conf->ban_time, opt, "bantime="))
       continue;
 
@@ -668,6 +691,9 @@ conf_read_file(btc_conf_t *conf, const char *file) {
     if (btc_match_port(&conf->rpc_port, opt, "rpcport="))
       continue;
 
+    if (btc_match_path(conf->rpc_path, opt, "rpcbind=unix:"))
+      continue;
+
     if (btc_match_netaddr(&addr, opt, "rpcbind=")) {
       btc_vector_push(&conf->rpc_bind, btc_netaddr_clone(&addr));
       continue;
@@ -682,6 +708,36 @@ conf_read_file(btc_conf_t *conf, const char *file) {
     if (btc_match_str(conf->rpc_pass, opt, "rpcpassword="))
       continue;
 
+    if (btc_match_range(&conf->rpc_threads, opt, "rpcthreads=", 0, 64))
+      continue;
+
+    if (btc_match_range(&conf->rpc_max_connections, opt,
+                        "rpcmaxconnections=", 0, 65535)) {
+      continue;
+    }
+
+    if (btc_match_range(&conf->rpc_timeout, opt,
+                        "rpcservertimeout=", 0, 86400)) {
+      continue;
+    }
+
+    if (btc_match_bool(&conf->rest, opt, "rest="))
+      continue;
+
+    if (btc_match_path(conf->notify, opt, "notify="))
+      continue;
+
+    if (btc_match_port(&conf->notify_port, opt, "notifyport="))
+      continue;
+
+    if (btc_match_port(&conf->stratum_port, opt, "stratumport="))
+      continue;
+
+    if (btc_match_range(&conf->stratum_difficulty, opt,
+                        "stratumdifficulty=", 1, 1 << 30)) {
+      continue;
+    }
+
     fclose(stream);
 
     return btc_die("Invalid option: `%s`", opt);
@@ -730,6 +786,9 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     if (btc_match_range(&conf->cache_size, arg, "-dbcache=", 8, 2048))
       continue;
 
+    if (btc_match_range(&conf->mempool_size, arg, "-maxmempool=", 5, 16384))
+      continue;
+
     if (btc_match_argbool(&conf->checkpoints, arg, "-checkpoints="))
       continue;
 
@@ -777,6 +836,12 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     if (btc_match_uint(&conf->max_outbound, arg, "-maxoutbound="))
       continue;
 
+    if (btc_match_range(&conf->net_threads, arg, "-netthreads=", 0, 64))
+      continue;
+
+    if (btc_match_uint(&conf->max_upload, arg, "-maxuploadtarget="))
+      continue;
+
     if (btc_match_uint(&conf->ban_time, arg, "-bantime="))
       continue;
 
@@ -812,6 +877,9 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     if (btc_match_port(&conf->rpc_port, arg, "-rpcport="))
       continue;
 
+    if (btc_match_path(conf->rpc_path, arg, "-rpcbind=unix:"))
+      continue;
+
     if (btc_match_netaddr(&addr, arg, "-rpcbind=")) {
       btc_vector_push(&conf->rpc_bind, btc_netaddr_clone(&addr));
       continue;
@@ -826,6 +894,36 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     if (btc_match_str(conf->rpc_pass, arg, "-rpcpassword="))
       continue;
 
+    if (btc_match_range(&conf->rpc_threads, arg, "-rpcthreads=", 0, 64))
+      continue;
+
+    if (btc_match_range(&conf->rpc_max_connections, arg,
+                        "-rpcmaxconnections=", 0, 65535)) {
+      continue;
+    }
+
+    if (btc_match_range(&conf->rpc_timeout, arg,
+                        "-rpcservertimeout=", 0, 86400)) {
+      continue;
+    }
+
+    if (btc_match_argbool(&conf->rest, arg, "-rest="))
+      continue;
+
+    if (btc_match_path(conf->notify, arg, "-notify="))
+      continue;
+
+    if (btc_match_port(&conf->notify_port, arg, "-notifyport="))
+      continue;
+
+    if (btc_match_port(&conf->stratum_port, arg, "-stratumport="))
+      continue;
+
+    if (btc_match_range(&conf->stratum_difficulty, arg,
+                        "-stratumdifficulty=", 1, 1 << 30)) {
+      continue;
+    }
+
     if (strcmp(arg, "-testnet") == 0) {
       conf->network = btc_testnet;
       continue;
@@ -842,6 +940,12 @@ conf_parse_args(btc_conf_t *conf, int argc, char **argv, int allow_params) {
     }
 
     if (allow_params) {
+      if (btc_match_argbool(&conf->stdin_batch, arg, "-stdin-batch="))
+        continue;
+
+      if (btc_match_range(&conf->batch_size, arg, "-batchsize=", 1, 10000))
+        continue;
+
       if (arg[0] == '-' && arg[1] >= 'a' && arg[1] <= 'z')
         return btc_die("Invalid option: `%s`", arg);
 
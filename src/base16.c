@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <mako/encoding.h>
+#include "bio.h"
 #include "internal.h"
 
 /*
@@ -54,12 +55,78 @@ static const signed char base16_table[256] = {
   -1, -1, -1, -1, -1, -1, -1, -1
 };
 
+/*
+ * Base16 (SWAR)
+ */
+
+/* Eight characters or four bytes are processed per 64 bit
+ * word. Every lane stays below 0x100 so no carries cross
+ * lanes, and the results are endian-independent.
+ */
+
+#define B16_ONES UINT64_C(0x0101010101010101)
+#define B16_HIGH UINT64_C(0x8080808080808080)
+
+static void
+base16_encode4(char *zp, const uint8_t *xp) {
+  uint64_t x = btc_read32le(xp);
+  uint64_t ge10;
+
+  /* Spread the bytes into 16 bit lanes, then split the nibbles. */
+  x = (x | (x << 16)) & UINT64_C(0x0000ffff0000ffff);
+  x = (x | (x << 8)) & UINT64_C(0x00ff00ff00ff00ff);
+  x = ((x >> 4) & UINT64_C(0x000f000f000f000f))
+    | ((x & UINT64_C(0x000f000f000f000f)) << 8);
+
+  ge10 = ((x + B16_ONES * 6) >> 4) & B16_ONES;
+
+  x += B16_ONES * '0' + ge10 * ('a' - '0' - 10);
+
+  btc_write64le((uint8_t *)zp, x);
+}
+
+static int
+base16_decode8(uint8_t *zp, const char *xp) {
+  uint64_t w = btc_read64le((const uint8_t *)xp);
+  uint64_t l = w | (B16_ONES * 0x20);
+  uint64_t digit, alpha;
+
+  if (w & B16_HIGH)
+    return 0;
+
+  /* The high bit of `x + (0x80 - c)` is set when `x >= c`. */
+  digit = (w + B16_ONES * (0x80 - '0')) & ~(w + B16_ONES * (0x80 - '9' - 1));
+  alpha = (l + B16_ONES * (0x80 - 'a')) & ~(l + B16_ONES * (0x80 - 'f' - 1));
+
+  if (((digit | alpha) & B16_HIGH) != B16_HIGH)
+    return 0;
+
+  /* Letters have bit 6 set: 'a' & 15 = 1, plus 9. */
+  w = (w & (B16_ONES * 15)) + ((w >> 6) & B16_ONES) * 9;
+
+  /* Join nibble pairs, then pack the four bytes down. */
+  w = ((w << 4) | (w >> 8)) & UINT64_C(0x00ff00ff00ff00ff);
+  w = (w | (w >> 8)) & UINT64_C(0x0000ffff0000ffff);
+  w = (w | (w >> 16));
+
+  btc_write32le(zp, (uint32_t)w);
+
+  return 1;
+}
+
 /*
  * Base16
  */
 
 void
 btc_base16_encode(char *zp, const uint8_t *xp, size_t xn) {
+  while (xn >= 4) {
+    base16_encode4(zp, xp);
+    zp += 8;
+    xp += 4;
+    xn -= 4;
+  }
+
   while (xn--) {
     int ch = *xp++;
 
@@ -79,6 +146,13 @@ btc_base16_decode(uint8_t *zp, const char *xp, size_t xn) {
 
   xn >>= 1;
 
+  /* Bad input drops to the byte loop, which reports it. */
+  while (xn >= 4 && base16_decode8(zp, xp)) {
+    zp += 4;
+    xp += 8;
+    xn -= 4;
+  }
+
   while (xn--) {
     int hi = base16_table[*xp++ & 0xff];
     int lo = base16_table[*xp++ & 0xff];
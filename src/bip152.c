@@ -230,6 +230,67 @@ btc_cmpct_fill_mempool(btc_cmpct_t *blk, const btc_hashmap_t *map, int witness)
   return 0;
 }
 
+int
+btc_cmpct_fill_hashes(btc_cmpct_t *blk,
+                      const uint8_t *hashes,
+                      btc_tx_t *const *txs,
+                      size_t length) {
+  size_t total = blk->ptx.length + blk->ids.length;
+  uint64_t ids[256];
+  size_t i, j, n;
+  int index;
+
+  if (blk->count == total)
+    return 1;
+
+  CHECK(blk->avail.length == total);
+
+  /* Hashes are laid out contiguously so the
+     short IDs can be computed in batches. */
+  for (i = 0; i < length; i += n) {
+    n = length - i;
+
+    if (n > lengthof(ids))
+      n = lengthof(ids);
+
+    btc_siphash_batch(ids, hashes + i * 32, n, blk->sipkey);
+
+    for (j = 0; j < n; j++) {
+      btc_tx_t *tx = txs[i + j];
+      btc_tx_t *old;
+
+      index = btc_longtab_get(&blk->id_map, ids[j] & UINT64_C(0xffffffffffff));
+
+      if (index == -1)
+        continue;
+
+      CHECK((size_t)index < blk->avail.length);
+
+      old = blk->avail.items[index];
+
+      if (old != NULL) {
+        /* Seen in a previous pass. */
+        if (btc_hash_equal(old->hash, tx->hash))
+          continue;
+
+        /* Siphash collision, just request it. */
+        btc_tx_destroy(old);
+        blk->avail.items[index] = NULL;
+        blk->count -= 1;
+        continue;
+      }
+
+      blk->avail.items[index] = btc_tx_ref(tx);
+      blk->count += 1;
+
+      if (blk->count == total)
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
 int
 btc_cmpct_fill_missing(btc_cmpct_t *blk, const btc_blocktxn_t *msg) {
   size_t total = blk->ptx.length + blk->ids.length;
@@ -15,6 +15,12 @@
 
 #include "../internal.h"
 
+/*
+ * Constants
+ */
+
+#define BTC_CLIENT_MAX_PIPELINE 16
+
 /*
  * Client
  */
@@ -24,6 +30,12 @@ struct btc_client_s {
   uint32_t id;
   char user[256];
   char pass[256];
+  struct {
+    uint32_t id;
+    size_t length;
+  } batches[BTC_CLIENT_MAX_PIPELINE];
+  size_t start;
+  size_t inflight;
 };
 
 static void
@@ -32,6 +44,8 @@ btc_client_init(btc_client_t *client) {
   client->id = 0;
   client->user[0] = '\0';
   client->pass[0] = '\0';
+  client->start = 0;
+  client->inflight = 0;
 }
 
 static void
@@ -63,6 +77,8 @@ btc_client_open(btc_client_t *client,
 void
 btc_client_close(btc_client_t *client) {
   http_client_close(client->http);
+  client->start = 0;
+  client->inflight = 0;
 }
 
 void
@@ -82,44 +98,29 @@ btc_client_auth(btc_client_t *client, const char *user, const char *pass) {
   }
 }
 
-json_value *
-btc_client_call(btc_client_t *client, const char *method, json_value *params) {
-  json_value *id, *error, *code, *message, *result;
-  json_value *obj = json_object_new(3);
-  uint32_t num = client->id++;
-  http_options_t options;
-  http_msg_t *msg;
-  char *body;
-
-  if (params == NULL)
-    params = json_array_new(0);
-
-  json_object_push(obj, "method", json_string_new(method));
-  json_object_push(obj, "params", params);
-  json_object_push(obj, "id", json_integer_new(num));
-
-  body = json_encode(obj);
-
-  json_builder_free(obj);
-
-  http_options_init(&options);
-
-  options.method = HTTP_METHOD_POST;
-  options.path = "/";
-  options.headers = NULL;
-  options.agent = "mako";
-  options.accept = "application/json";
-  options.type = "application/json";
-  options.body = body;
+static void
+btc_client_options(btc_client_t *client,
+                   http_options_t *options,
+                   const char *body) {
+  http_options_init(options);
+
+  options->method = HTTP_METHOD_POST;
+  options->path = "/";
+  options->headers = NULL;
+  options->agent = "mako";
+  options->accept = "application/json";
+  options->type = "application/json";
+  options->body = body;
 
   if (*client->pass) {
-    options.user = client->user;
-    options.pass = client->pass;
+    options->user = client->user;
+    options->pass = client->pass;
   }
+}
 
-  msg = http_client_request(client->http, &options);
-
-  btc_free(body);
+static json_value *
+btc_client_response(btc_client_t *client, http_msg_t *msg) {
+  json_value *obj;
 
   if (msg == NULL) {
     fprintf(stderr, "Error: %s\n", http_client_strerror(client->http));
@@ -141,7 +142,17 @@ btc_client_call(btc_client_t *client, const char *method, json_value *params) {
 
   http_msg_destroy(msg);
 
-  if (obj == NULL || obj->type != json_object)
+  if (obj == NULL)
+    fprintf(stderr, "Could not parse JSON.\n");
+
+  return obj;
+}
+
+json_value *
+btc_client_result(json_value *obj, const char *method) {
+  json_value *error, *code, *message, *result;
+
+  if (obj->type != json_object)
     goto fail;
 
   error = json_object_get(obj, "error");
@@ -160,7 +171,8 @@ btc_client_call(btc_client_t *client, const char *method, json_value *params) {
     if (message == NULL || message->type != json_string)
       goto fail;
 
-    if (strcmp(method, "help") == 0 && code->u.integer == -1) {
+    if (method != NULL && strcmp(method, "help") == 0
+                       && code->u.integer == -1) {
       fprintf(stderr, "Usage: %s\n", message->u.string.ptr);
     } else {
       fprintf(stderr, "RPC Error: %s (code=%d).\n",
@@ -168,30 +180,174 @@ btc_client_call(btc_client_t *client, const char *method, json_value *params) {
                       (int)code->u.integer);
     }
 
-    json_builder_free(obj);
-
     return NULL;
   }
 
-  id = json_object_get(obj, "id");
+  result = json_object_pluck(obj, "result");
 
-  if (id == NULL || id->type != json_integer)
-    goto fail;
+  if (result == NULL)
+    result = json_null_new();
 
-  if (id->u.integer != (json_int_t)num)
-    goto fail;
+  return result;
+fail:
+  fprintf(stderr, "Could not parse JSON.\n");
+  return NULL;
+}
 
-  result = json_object_pluck(obj, "result");
+json_value *
+btc_client_call(btc_client_t *client, const char *method, json_value *params) {
+  json_value *obj = json_object_new(3);
+  uint32_t num = client->id++;
+  json_value *id, *result;
+  http_options_t options;
+  http_msg_t *msg;
+  char *body;
+
+  if (params == NULL)
+    params = json_array_new(0);
+
+  json_object_push(obj, "method", json_string_new(method));
+  json_object_push(obj, "params", params);
+  json_object_push(obj, "id", json_integer_new(num));
+
+  body = json_encode(obj);
 
   json_builder_free(obj);
 
-  if (result == NULL)
-    result = json_null_new();
+  btc_client_options(client, &options, body);
+
+  msg = http_client_request(client->http, &options);
+
+  btc_free(body);
+
+  obj = btc_client_response(client, msg);
+
+  if (obj == NULL)
+    return NULL;
+
+  result = btc_client_result(obj, method);
+
+  if (result != NULL) {
+    id = json_object_get(obj, "id");
+
+    if (id == NULL || id->type != json_integer
+                   || id->u.integer != (json_int_t)num) {
+      fprintf(stderr, "Could not parse JSON.\n");
+      json_builder_free(result);
+      result = NULL;
+    }
+  }
+
+  json_builder_free(obj);
 
   return result;
+}
+
+int
+btc_client_send(btc_client_t *client, json_value *calls) {
+  size_t length = calls->u.array.length;
+  http_options_t options;
+  size_t i, slot;
+  char *body;
+  int ret;
+
+  if (client->inflight == BTC_CLIENT_MAX_PIPELINE || length == 0) {
+    json_builder_free(calls);
+    return 0;
+  }
+
+  slot = (client->start + client->inflight) % BTC_CLIENT_MAX_PIPELINE;
+
+  client->batches[slot].id = client->id;
+  client->batches[slot].length = length;
+
+  for (i = 0; i < length; i++) {
+    json_value *call = calls->u.array.values[i];
+
+    json_object_push(call, "id", json_integer_new(client->id++));
+  }
+
+  body = json_encode(calls);
+
+  json_builder_free(calls);
+
+  btc_client_options(client, &options, body);
+
+  ret = http_client_send(client->http, &options);
+
+  btc_free(body);
+
+  if (!ret) {
+    fprintf(stderr, "Error: %s\n", http_client_strerror(client->http));
+    return 0;
+  }
+
+  client->inflight++;
+
+  return 1;
+}
+
+json_value *
+btc_client_recv(btc_client_t *client) {
+  json_value **items = NULL;
+  json_value *obj, *ret;
+  size_t i, length;
+  uint32_t base;
+
+  if (client->inflight == 0)
+    return NULL;
+
+  base = client->batches[client->start].id;
+  length = client->batches[client->start].length;
+
+  client->start = (client->start + 1) % BTC_CLIENT_MAX_PIPELINE;
+  client->inflight--;
+
+  obj = btc_client_response(client, http_client_recv(client->http));
+
+  if (obj == NULL)
+    return NULL;
+
+  if (obj->type != json_array || obj->u.array.length != length)
+    goto fail;
+
+  items = btc_malloc(length * sizeof(json_value *));
+
+  for (i = 0; i < length; i++)
+    items[i] = NULL;
+
+  /* Servers may answer a batch in any order. */
+  for (i = 0; i < length; i++) {
+    json_value *item = obj->u.array.values[i];
+    json_value *id = json_object_get(item, "id");
+    json_int_t index;
+
+    if (id == NULL || id->type != json_integer)
+      goto fail;
+
+    index = id->u.integer - (json_int_t)base;
+
+    if (index < 0 || index >= (json_int_t)length || items[index] != NULL)
+      goto fail;
+
+    items[index] = item;
+  }
+
+  ret = json_array_new(length);
+
+  for (i = 0; i < length; i++)
+    json_array_push(ret, items[i]);
+
+  obj->u.array.length = 0;
+
+  json_builder_free(obj);
+  btc_free(items);
+
+  return ret;
 fail:
   fprintf(stderr, "Could not parse JSON.\n");
-  if (obj != NULL)
-    json_builder_free(obj);
+  json_builder_free(obj);
+  if (items != NULL)
+    btc_free(items);
   return NULL;
 }
@@ -29,12 +29,22 @@ static const json_serialize_opts json_options = {
   2
 };
 
+static const json_serialize_opts json_packed = {
+  json_serialize_mode_packed,
+  0,
+  0
+};
+
+/* Batches kept in flight by -stdin-batch. */
+#define BATCH_PIPELINE 4
+
 /*
  * Arguments
  */
 
 static const char *rpc_args[] = {
   "-?",
+  "-batchsize=",
   "-chain=",
   "-conf=",
   "-datadir=",
@@ -42,6 +52,7 @@ static const char *rpc_args[] = {
   "-rpcpassword=",
   "-rpcport=",
   "-rpcuser=",
+  "-stdin-batch",
   "-testnet",
   "-version"
 };
@@ -131,10 +142,12 @@ static const struct {
   { "savemempool", { json_none } },
   { "send", { json_array, json_object } },
   { "sendfrom", { json_string, json_string, json_amount,
-                               json_integer, json_boolean } },
-  { "sendmany", { json_string, json_object, json_integer, json_boolean } },
+                  json_integer, json_boolean, json_boolean } },
+  { "sendmany", { json_string, json_object, json_integer,
+                  json_boolean, json_boolean } },
   { "sendrawtransaction", { json_string } },
-  { "sendtoaddress", { json_string, json_amount, json_integer, json_boolean } },
+  { "sendtoaddress", { json_string, json_amount, json_integer,
+                       json_boolean, json_boolean } },
   { "setban", { json_string, json_string, json_integer, json_boolean } },
   { "setgenerate", { json_boolean, json_integer } },
   { "setloglevel", { json_string } },
@@ -180,67 +193,29 @@ find_schema(const char *method) {
 }
 
 /*
- * Config
- */
-
-static btc_conf_t *
-get_config(int argc, char **argv) {
-  char prefix[BTC_PATH_MAX];
-
-  if (!btc_sys_datadir(prefix, sizeof(prefix), "mako")) {
-    fprintf(stderr, "Could not find suitable datadir.\n");
-    return NULL;
-  }
-
-  return btc_conf_create(argc, argv, prefix, 1);
-}
-
-/*
- * Main
+ * Params
  */
 
-static int
-btc_main(const btc_conf_t *conf) {
-  btc_client_t *client = NULL;
-  json_value *params = NULL;
-  const json_type *schema;
-  json_value *result;
-  int ret = 0;
+static json_value *
+parse_params(const char *method, const char *const *args, size_t length) {
+  const json_type *schema = find_schema(method);
+  json_value *params;
   size_t i;
 
-  if (conf->help) {
-    puts("Usage: mako [options] <command> [params]");
-    return 1;
-  }
-
-  if (conf->version) {
-    puts("0.0.0");
-    return 1;
-  }
-
-  if (conf->method == NULL) {
-    fprintf(stderr, "Must specify a command.\n");
-    return 0;
-  }
-
-  schema = find_schema(conf->method);
-
   if (schema == NULL) {
-    fprintf(stderr, "RPC method '%s' not found.\n", conf->method);
-    return 0;
+    fprintf(stderr, "RPC method '%s' not found.\n", method);
+    return NULL;
   }
 
-  btc_net_startup();
+  params = json_array_new(length);
 
-  params = json_array_new(conf->length);
-
-  for (i = 0; i < conf->length; i++) {
-    const char *param = conf->params[i];
+  for (i = 0; i < length; i++) {
+    const char *param = args[i];
     json_type type = schema[i];
     json_value *obj;
 
     if (type == json_none) {
-      fprintf(stderr, "Too many arguments for %s.\n", conf->method);
+      fprintf(stderr, "Too many arguments for %s.\n", method);
       goto fail;
     }
 
@@ -299,6 +274,257 @@ btc_main(const btc_conf_t *conf) {
     goto fail;
   }
 
+  return params;
+fail:
+  json_builder_free(params);
+  return NULL;
+}
+
+/*
+ * Config
+ */
+
+static btc_conf_t *
+get_config(int argc, char **argv) {
+  char prefix[BTC_PATH_MAX];
+
+  if (!btc_sys_datadir(prefix, sizeof(prefix), "mako")) {
+    fprintf(stderr, "Could not find suitable datadir.\n");
+    return NULL;
+  }
+
+  return btc_conf_create(argc, argv, prefix, 1);
+}
+
+/*
+ * Batch
+ */
+
+static int
+read_line(char **line, size_t *size, FILE *stream) {
+  size_t len = 0;
+
+  if (*size == 0) {
+    *size = 1024;
+    *line = btc_malloc(*size);
+  }
+
+  while (fgets(*line + len, *size - len, stream) != NULL) {
+    len += strlen(*line + len);
+
+    if ((*line)[len - 1] == '\n' || len + 1 < *size)
+      return 1;
+
+    *size *= 2;
+    *line = btc_realloc(*line, *size);
+  }
+
+  return len > 0;
+}
+
+static json_value *
+parse_command(char *line, int *blank) {
+  const char *args[9];
+  json_value *call, *params;
+  size_t length = 0;
+  char *tok = line;
+
+  *blank = 0;
+
+  /* One command per line, arguments separated by whitespace. */
+  for (;;) {
+    while (*tok != '\0' && *tok <= ' ')
+      tok++;
+
+    if (*tok == '\0' || (length == 0 && *tok == '#'))
+      break;
+
+    if (length == lengthof(args)) {
+      fprintf(stderr, "Too many parameters.\n");
+      return NULL;
+    }
+
+    args[length++] = tok;
+
+    while (*tok != '\0' && *tok > ' ')
+      tok++;
+
+    if (*tok != '\0')
+      *tok++ = '\0';
+  }
+
+  *blank = (length == 0);
+
+  if (length == 0)
+    return NULL;
+
+  params = parse_params(args[0], args + 1, length - 1);
+
+  if (params == NULL)
+    return NULL;
+
+  call = json_object_new(3);
+
+  json_object_push(call, "method", json_string_new(args[0]));
+  json_object_push(call, "params", params);
+
+  return call;
+}
+
+static void
+print_result(json_value *result, const json_serialize_opts opts) {
+  if (result->type == json_string)
+    puts(result->u.string.ptr);
+  else
+    json_print_ex(result, puts, opts);
+}
+
+static int
+btc_batch(btc_client_t *client, size_t size) {
+  /* Line numbers of every command still awaiting a response. */
+  size_t slots = BATCH_PIPELINE * size;
+  unsigned long *lines = btc_malloc(slots * sizeof(unsigned long));
+  unsigned long lineno = 0;
+  size_t head = 0;
+  size_t tail = 0;
+  size_t inflight = 0;
+  char *line = NULL;
+  size_t alloc = 0;
+  int done = 0;
+  int ret = 1;
+
+  for (;;) {
+    while (!done && inflight < BATCH_PIPELINE) {
+      json_value *calls = json_array_new(size);
+      json_value *call;
+      int blank;
+
+      while (calls->u.array.length < size) {
+        if (!read_line(&line, &alloc, stdin)) {
+          done = 1;
+          break;
+        }
+
+        lineno++;
+
+        call = parse_command(line, &blank);
+
+        if (call == NULL) {
+          if (blank)
+            continue;
+
+          fprintf(stderr, "Invalid command (line=%lu).\n", lineno);
+
+          done = 1;
+          ret = 0;
+
+          break;
+        }
+
+        json_array_push(calls, call);
+
+        lines[tail] = lineno;
+        tail = (tail + 1) % slots;
+      }
+
+      if (calls->u.array.length == 0) {
+        json_builder_free(calls);
+        break;
+      }
+
+      if (!btc_client_send(client, calls)) {
+        done = 1;
+        ret = 0;
+        break;
+      }
+
+      inflight++;
+    }
+
+    if (inflight == 0)
+      break;
+
+    {
+      json_value *items = btc_client_recv(client);
+      unsigned int i;
+
+      inflight--;
+
+      if (items == NULL) {
+        ret = 0;
+        break;
+      }
+
+      /* One output line per command, even for failures. */
+      for (i = 0; i < items->u.array.length; i++) {
+        json_value *item = items->u.array.values[i];
+        json_value *result = btc_client_result(item, NULL);
+
+        if (result != NULL) {
+          print_result(result, json_packed);
+          json_builder_free(result);
+        } else {
+          fprintf(stderr, "Command failed (line=%lu).\n", lines[head]);
+          puts("");
+          ret = 0;
+        }
+
+        head = (head + 1) % slots;
+      }
+
+      json_builder_free(items);
+    }
+  }
+
+  if (line != NULL)
+    btc_free(line);
+
+  btc_free(lines);
+
+  return ret;
+}
+
+/*
+ * Main
+ */
+
+static int
+btc_main(const btc_conf_t *conf) {
+  btc_client_t *client = NULL;
+  json_value *params = NULL;
+  json_value *result;
+  int ret = 0;
+
+  if (conf->help) {
+    puts("Usage: mako [options] <command> [params]");
+    puts("       mako [options] -stdin-batch < commands");
+    return 1;
+  }
+
+  if (conf->version) {
+    puts("0.0.0");
+    return 1;
+  }
+
+  if (conf->stdin_batch) {
+    if (conf->method != NULL) {
+      fprintf(stderr, "Cannot specify a command with -stdin-batch.\n");
+      return 0;
+    }
+  } else {
+    if (conf->method == NULL) {
+      fprintf(stderr, "Must specify a command.\n");
+      return 0;
+    }
+
+    params = parse_params(conf->method, conf->params, conf->length);
+
+    if (params == NULL)
+      return 0;
+  }
+
+  btc_net_startup();
+
   client = btc_client_create();
 
   btc_client_auth(client, conf->rpc_user, conf->rpc_pass);
@@ -309,6 +535,12 @@ btc_main(const btc_conf_t *conf) {
     goto fail;
   }
 
+  if (conf->stdin_batch) {
+    ret = btc_batch(client, conf->batch_size);
+    btc_client_close(client);
+    goto fail;
+  }
+
   result = btc_client_call(client, conf->method, params);
   params = NULL;
 
@@ -317,10 +549,7 @@ btc_main(const btc_conf_t *conf) {
   if (result == NULL)
     goto fail;
 
-  if (result->type == json_string)
-    puts(result->u.string.ptr);
-  else
-    json_print_ex(result, puts, json_options);
+  print_result(result, json_options);
 
   json_builder_free(result);
 
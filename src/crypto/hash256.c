@@ -10,7 +10,9 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <mako/crypto/hash.h>
+#include <mako/util.h>
 #include "../bio.h"
+#include "sha256.h"
 
 /*
  * Hash256
@@ -47,3 +49,95 @@ btc_checksum(const void *data, size_t size) {
   btc_hash256(hash, data, size);
   return btc_read32le(hash);
 }
+
+int
+btc_hash256_scan(uint8_t *hash,
+                 uint8_t *raw,
+                 const uint8_t *target,
+                 uint32_t limit) {
+  /* Double-SHA256 over an 80 byte header for successive
+     nonces. The first block never changes, so each lane
+     starts from its midstate and only the tail and the
+     second hash are compressed per nonce. */
+  uint32_t S[8][BTC_SHA256_LANES];
+  uint32_t W[16][BTC_SHA256_LANES];
+  uint32_t nonce = btc_read32le(raw + 76);
+  uint32_t top = btc_read32le(target + 28);
+  uint32_t tail[3];
+  uint64_t left;
+  btc_sha256_t ctx;
+  btc_sha256_t iv;
+  int i, j, n;
+
+  btc_sha256_init(&iv);
+  btc_sha256_init(&ctx);
+  btc_sha256_update(&ctx, raw, 64);
+
+  for (i = 0; i < 3; i++)
+    tail[i] = btc_read32be(raw + 64 + i * 4);
+
+  /* Stop at the limit or when the nonce wraps. */
+  left = ((uint64_t)1 << 32) - nonce;
+
+  if (limit != 0 && limit < left)
+    left = limit;
+
+  while (left > 0) {
+    n = left < BTC_SHA256_LANES ? (int)left : BTC_SHA256_LANES;
+
+    for (j = 0; j < BTC_SHA256_LANES; j++) {
+      for (i = 0; i < 8; i++)
+        S[i][j] = ctx.state[i];
+
+      W[0][j] = tail[0];
+      W[1][j] = tail[1];
+      W[2][j] = tail[2];
+      W[3][j] = btc_bswap32((uint32_t)(nonce + j));
+      W[4][j] = 0x80000000;
+
+      for (i = 5; i < 15; i++)
+        W[i][j] = 0;
+
+      W[15][j] = 80 * 8;
+    }
+
+    btc_sha256_lanes(S, W);
+
+    for (j = 0; j < BTC_SHA256_LANES; j++) {
+      for (i = 0; i < 8; i++) {
+        W[i][j] = S[i][j];
+        S[i][j] = iv.state[i];
+      }
+
+      W[8][j] = 0x80000000;
+
+      for (i = 9; i < 15; i++)
+        W[i][j] = 0;
+
+      W[15][j] = 32 * 8;
+    }
+
+    btc_sha256_lanes(S, W);
+
+    for (j = 0; j < n; j++) {
+      /* The last word holds the most significant bytes. */
+      if (btc_bswap32(S[7][j]) > top)
+        continue;
+
+      for (i = 0; i < 8; i++)
+        btc_write32be(hash + i * 4, S[i][j]);
+
+      if (btc_hash_compare(hash, target) <= 0) {
+        btc_write32le(raw + 76, nonce + j);
+        return 1;
+      }
+    }
+
+    nonce += n;
+    left -= n;
+  }
+
+  btc_write32le(raw + 76, nonce);
+
+  return 0;
+}
@@ -16,6 +16,30 @@
 #include <string.h>
 #include <mako/crypto/hash.h>
 #include "../bio.h"
+#include "sha256.h"
+
+/*
+ * Constants
+ */
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
 
 /*
  * SHA256
@@ -93,83 +117,83 @@ sha256_transform(btc_sha256_t *ctx, const uint8_t *chunk) {
  *   d = d + h
  *   h = h + Sigma0(a) + Maj(a, b, c)
  */
-#define R(a, b, c, d, e, f, g, h, i, k) do { \
-  if (i < 16) /* Optimized out. */           \
-    w = btc_read32be(chunk + i * 4);         \
-  else                                       \
-    w = WORD(i);                             \
-                                             \
-  W[i & 15] = w;                             \
-                                             \
-  h += Sigma1(e) + Ch(e, f, g) + k + w;      \
-  d += h;                                    \
-  h += Sigma0(a) + Maj(a, b, c);             \
+#define R(a, b, c, d, e, f, g, h, i) do {          \
+  if (i < 16) /* Optimized out. */                 \
+    w = btc_read32be(chunk + i * 4);               \
+  else                                             \
+    w = WORD(i);                                   \
+                                                   \
+  W[i & 15] = w;                                   \
+                                                   \
+  h += Sigma1(e) + Ch(e, f, g) + sha256_k[i] + w;  \
+  d += h;                                          \
+  h += Sigma0(a) + Maj(a, b, c);                   \
 } while (0)
 
-  R(A, B, C, D, E, F, G, H,  0, 0x428a2f98);
-  R(H, A, B, C, D, E, F, G,  1, 0x71374491);
-  R(G, H, A, B, C, D, E, F,  2, 0xb5c0fbcf);
-  R(F, G, H, A, B, C, D, E,  3, 0xe9b5dba5);
-  R(E, F, G, H, A, B, C, D,  4, 0x3956c25b);
-  R(D, E, F, G, H, A, B, C,  5, 0x59f111f1);
-  R(C, D, E, F, G, H, A, B,  6, 0x923f82a4);
-  R(B, C, D, E, F, G, H, A,  7, 0xab1c5ed5);
-  R(A, B, C, D, E, F, G, H,  8, 0xd807aa98);
-  R(H, A, B, C, D, E, F, G,  9, 0x12835b01);
-  R(G, H, A, B, C, D, E, F, 10, 0x243185be);
-  R(F, G, H, A, B, C, D, E, 11, 0x550c7dc3);
-  R(E, F, G, H, A, B, C, D, 12, 0x72be5d74);
-  R(D, E, F, G, H, A, B, C, 13, 0x80deb1fe);
-  R(C, D, E, F, G, H, A, B, 14, 0x9bdc06a7);
-  R(B, C, D, E, F, G, H, A, 15, 0xc19bf174);
-  R(A, B, C, D, E, F, G, H, 16, 0xe49b69c1);
-  R(H, A, B, C, D, E, F, G, 17, 0xefbe4786);
-  R(G, H, A, B, C, D, E, F, 18, 0x0fc19dc6);
-  R(F, G, H, A, B, C, D, E, 19, 0x240ca1cc);
-  R(E, F, G, H, A, B, C, D, 20, 0x2de92c6f);
-  R(D, E, F, G, H, A, B, C, 21, 0x4a7484aa);
-  R(C, D, E, F, G, H, A, B, 22, 0x5cb0a9dc);
-  R(B, C, D, E, F, G, H, A, 23, 0x76f988da);
-  R(A, B, C, D, E, F, G, H, 24, 0x983e5152);
-  R(H, A, B, C, D, E, F, G, 25, 0xa831c66d);
-  R(G, H, A, B, C, D, E, F, 26, 0xb00327c8);
-  R(F, G, H, A, B, C, D, E, 27, 0xbf597fc7);
-  R(E, F, G, H, A, B, C, D, 28, 0xc6e00bf3);
-  R(D, E, F, G, H, A, B, C, 29, 0xd5a79147);
-  R(C, D, E, F, G, H, A, B, 30, 0x06ca6351);
-  R(B, C, D, E, F, G, H, A, 31, 0x14292967);
-  R(A, B, C, D, E, F, G, H, 32, 0x27b70a85);
-  R(H, A, B, C, D, E, F, G, 33, 0x2e1b2138);
-  R(G, H, A, B, C, D, E, F, 34, 0x4d2c6dfc);
-  R(F, G, H, A, B, C, D, E, 35, 0x53380d13);
-  R(E, F, G, H, A, B, C, D, 36, 0x650a7354);
-  R(D, E, F, G, H, A, B, C, 37, 0x766a0abb);
-  R(C, D, E, F, G, H, A, B, 38, 0x81c2c92e);
-  R(B, C, D, E, F, G, H, A, 39, 0x92722c85);
-  R(A, B, C, D, E, F, G, H, 40, 0xa2bfe8a1);
-  R(H, A, B, C, D, E, F, G, 41, 0xa81a664b);
-  R(G, H, A, B, C, D, E, F, 42, 0xc24b8b70);
-  R(F, G, H, A, B, C, D, E, 43, 0xc76c51a3);
-  R(E, F, G, H, A, B, C, D, 44, 0xd192e819);
-  R(D, E, F, G, H, A, B, C, 45, 0xd6990624);
-  R(C, D, E, F, G, H, A, B, 46, 0xf40e3585);
-  R(B, C, D, E, F, G, H, A, 47, 0x106aa070);
-  R(A, B, C, D, E, F, G, H, 48, 0x19a4c116);
-  R(H, A, B, C, D, E, F, G, 49, 0x1e376c08);
-  R(G, H, A, B, C, D, E, F, 50, 0x2748774c);
-  R(F, G, H, A, B, C, D, E, 51, 0x34b0bcb5);
-  R(E, F, G, H, A, B, C, D, 52, 0x391c0cb3);
-  R(D, E, F, G, H, A, B, C, 53, 0x4ed8aa4a);
-  R(C, D, E, F, G, H, A, B, 54, 0x5b9cca4f);
-  R(B, C, D, E, F, G, H, A, 55, 0x682e6ff3);
-  R(A, B, C, D, E, F, G, H, 56, 0x748f82ee);
-  R(H, A, B, C, D, E, F, G, 57, 0x78a5636f);
-  R(G, H, A, B, C, D, E, F, 58, 0x84c87814);
-  R(F, G, H, A, B, C, D, E, 59, 0x8cc70208);
-  R(E, F, G, H, A, B, C, D, 60, 0x90befffa);
-  R(D, E, F, G, H, A, B, C, 61, 0xa4506ceb);
-  R(C, D, E, F, G, H, A, B, 62, 0xbef9a3f7);
-  R(B, C, D, E, F, G, H, A, 63, 0xc67178f2);
+  R(A, B, C, D, E, F, G, H,  0);
+  R(H, A, B, C, D, E, F, G,  1);
+  R(G, H, A, B, C, D, E, F,  2);
+  R(F, G, H, A, B, C, D, E,  3);
+  R(E, F, G, H, A, B, C, D,  4);
+  R(D, E, F, G, H, A, B, C,  5);
+  R(C, D, E, F, G, H, A, B,  6);
+  R(B, C, D, E, F, G, H, A,  7);
+  R(A, B, C, D, E, F, G, H,  8);
+  R(H, A, B, C, D, E, F, G,  9);
+  R(G, H, A, B, C, D, E, F, 10);
+  R(F, G, H, A, B, C, D, E, 11);
+  R(E, F, G, H, A, B, C, D, 12);
+  R(D, E, F, G, H, A, B, C, 13);
+  R(C, D, E, F, G, H, A, B, 14);
+  R(B, C, D, E, F, G, H, A, 15);
+  R(A, B, C, D, E, F, G, H, 16);
+  R(H, A, B, C, D, E, F, G, 17);
+  R(G, H, A, B, C, D, E, F, 18);
+  R(F, G, H, A, B, C, D, E, 19);
+  R(E, F, G, H, A, B, C, D, 20);
+  R(D, E, F, G, H, A, B, C, 21);
+  R(C, D, E, F, G, H, A, B, 22);
+  R(B, C, D, E, F, G, H, A, 23);
+  R(A, B, C, D, E, F, G, H, 24);
+  R(H, A, B, C, D, E, F, G, 25);
+  R(G, H, A, B, C, D, E, F, 26);
+  R(F, G, H, A, B, C, D, E, 27);
+  R(E, F, G, H, A, B, C, D, 28);
+  R(D, E, F, G, H, A, B, C, 29);
+  R(C, D, E, F, G, H, A, B, 30);
+  R(B, C, D, E, F, G, H, A, 31);
+  R(A, B, C, D, E, F, G, H, 32);
+  R(H, A, B, C, D, E, F, G, 33);
+  R(G, H, A, B, C, D, E, F, 34);
+  R(F, G, H, A, B, C, D, E, 35);
+  R(E, F, G, H, A, B, C, D, 36);
+  R(D, E, F, G, H, A, B, C, 37);
+  R(C, D, E, F, G, H, A, B, 38);
+  R(B, C, D, E, F, G, H, A, 39);
+  R(A, B, C, D, E, F, G, H, 40);
+  R(H, A, B, C, D, E, F, G, 41);
+  R(G, H, A, B, C, D, E, F, 42);
+  R(F, G, H, A, B, C, D, E, 43);
+  R(E, F, G, H, A, B, C, D, 44);
+  R(D, E, F, G, H, A, B, C, 45);
+  R(C, D, E, F, G, H, A, B, 46);
+  R(B, C, D, E, F, G, H, A, 47);
+  R(A, B, C, D, E, F, G, H, 48);
+  R(H, A, B, C, D, E, F, G, 49);
+  R(G, H, A, B, C, D, E, F, 50);
+  R(F, G, H, A, B, C, D, E, 51);
+  R(E, F, G, H, A, B, C, D, 52);
+  R(D, E, F, G, H, A, B, C, 53);
+  R(C, D, E, F, G, H, A, B, 54);
+  R(B, C, D, E, F, G, H, A, 55);
+  R(A, B, C, D, E, F, G, H, 56);
+  R(H, A, B, C, D, E, F, G, 57);
+  R(G, H, A, B, C, D, E, F, 58);
+  R(F, G, H, A, B, C, D, E, 59);
+  R(E, F, G, H, A, B, C, D, 60);
+  R(D, E, F, G, H, A, B, C, 61);
+  R(C, D, E, F, G, H, A, B, 62);
+  R(B, C, D, E, F, G, H, A, 63);
 
 #undef Ch
 #undef Maj
@@ -254,3 +278,87 @@ btc_sha256(uint8_t *out, const void *data, size_t size) {
   btc_sha256_update(&ctx, data, size);
   btc_sha256_final(&ctx, out);
 }
+
+/*
+ * SHA256 (Lanes)
+ */
+
+void
+btc_sha256_lanes(uint32_t S[8][BTC_SHA256_LANES],
+                 uint32_t W[16][BTC_SHA256_LANES]) {
+  /* Compresses one block per lane. The state and
+     schedule are lane-major, so every step below is
+     a loop over independent lanes. At the default
+     x86-64 baseline, gcc -O3 vectorizes these with
+     16 byte SSE2 registers; 32 byte AVX2 code needs
+     -mavx2 (or -march=native). NEON is used on arm64. */
+  uint32_t A[BTC_SHA256_LANES], B[BTC_SHA256_LANES];
+  uint32_t C[BTC_SHA256_LANES], D[BTC_SHA256_LANES];
+  uint32_t E[BTC_SHA256_LANES], F[BTC_SHA256_LANES];
+  uint32_t G[BTC_SHA256_LANES], H[BTC_SHA256_LANES];
+  uint32_t t1, t2;
+  int i, j;
+
+#define Ch(x, y, z) ((x & (y ^ z)) ^ z)
+#define Maj(x, y, z) ((x & (y | z)) | (y & z))
+#define Sigma0(x) (ROTR32(x,  2) ^ ROTR32(x, 13) ^ ROTR32(x, 22))
+#define Sigma1(x) (ROTR32(x,  6) ^ ROTR32(x, 11) ^ ROTR32(x, 25))
+#define sigma0(x) (ROTR32(x,  7) ^ ROTR32(x, 18) ^ (x >>  3))
+#define sigma1(x) (ROTR32(x, 17) ^ ROTR32(x, 19) ^ (x >> 10))
+
+  for (j = 0; j < BTC_SHA256_LANES; j++) {
+    A[j] = S[0][j];
+    B[j] = S[1][j];
+    C[j] = S[2][j];
+    D[j] = S[3][j];
+    E[j] = S[4][j];
+    F[j] = S[5][j];
+    G[j] = S[6][j];
+    H[j] = S[7][j];
+  }
+
+  for (i = 0; i < 64; i++) {
+    uint32_t *w = W[i & 15];
+
+    if (i >= 16) {
+      const uint32_t *w2 = W[(i - 2) & 15];
+      const uint32_t *w7 = W[(i - 7) & 15];
+      const uint32_t *w15 = W[(i - 15) & 15];
+
+      for (j = 0; j < BTC_SHA256_LANES; j++)
+        w[j] += sigma1(w2[j]) + w7[j] + sigma0(w15[j]);
+    }
+
+    for (j = 0; j < BTC_SHA256_LANES; j++) {
+      t1 = H[j] + Sigma1(E[j]) + Ch(E[j], F[j], G[j]) + sha256_k[i] + w[j];
+      t2 = Sigma0(A[j]) + Maj(A[j], B[j], C[j]);
+
+      H[j] = G[j];
+      G[j] = F[j];
+      F[j] = E[j];
+      E[j] = D[j] + t1;
+      D[j] = C[j];
+      C[j] = B[j];
+      B[j] = A[j];
+      A[j] = t1 + t2;
+    }
+  }
+
+#undef Ch
+#undef Maj
+#undef Sigma0
+#undef Sigma1
+#undef sigma0
+#undef sigma1
+
+  for (j = 0; j < BTC_SHA256_LANES; j++) {
+    S[0][j] += A[j];
+    S[1][j] += B[j];
+    S[2][j] += C[j];
+    S[3][j] += D[j];
+    S[4][j] += E[j];
+    S[5][j] += F[j];
+    S[6][j] += G[j];
+    S[7][j] += H[j];
+  }
+}
@@ -0,0 +1,32 @@
+/*!
+ * sha256.h - sha256 lanes for mako
+ * Copyright (c) 2020, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#ifndef BTC_SHA256_H
+#define BTC_SHA256_H
+
+#include <stdint.h>
+
+/*
+ * Alias
+ */
+
+#define btc_sha256_lanes btc__sha256_lanes
+
+/*
+ * Constants
+ */
+
+#define BTC_SHA256_LANES 16
+
+/*
+ * SHA256 (Lanes)
+ */
+
+void
+btc_sha256_lanes(uint32_t S[8][BTC_SHA256_LANES],
+                 uint32_t W[16][BTC_SHA256_LANES]);
+
+#endif /* BTC_SHA256_H */
@@ -135,3 +135,99 @@ btc_siphash_mod(const uint8_t *data,
   return axbhi + (axbmid >> 32) + (bxamid >> 32) + (c >> 32);
 #endif
 }
+
+/*
+ * Siphash (Batch)
+ */
+
+/* Four interleaved states. Keeping each word in its own
+   array lets the compiler run the lanes in parallel. */
+typedef struct sip4_s {
+  uint64_t v0[4];
+  uint64_t v1[4];
+  uint64_t v2[4];
+  uint64_t v3[4];
+} sip4_t;
+
+static void
+sip4_round(sip4_t *s) {
+  int j;
+
+  for (j = 0; j < 4; j++) {
+    s->v0[j] += s->v1[j]; s->v1[j] = ROTL64(s->v1[j], 13); s->v1[j] ^= s->v0[j];
+    s->v0[j] = ROTL64(s->v0[j], 32);
+    s->v2[j] += s->v3[j]; s->v3[j] = ROTL64(s->v3[j], 16); s->v3[j] ^= s->v2[j];
+    s->v0[j] += s->v3[j]; s->v3[j] = ROTL64(s->v3[j], 21); s->v3[j] ^= s->v0[j];
+    s->v2[j] += s->v1[j]; s->v1[j] = ROTL64(s->v1[j], 17); s->v1[j] ^= s->v2[j];
+    s->v2[j] = ROTL64(s->v2[j], 32);
+  }
+}
+
+void
+btc_siphash_batch(uint64_t *out,
+                  const uint8_t *data,
+                  size_t count,
+                  const uint8_t *key) {
+  /* Hash `count` consecutive 32 byte messages. */
+  uint64_t k0 = btc_read64le(key + 0);
+  uint64_t k1 = btc_read64le(key + 8);
+  uint64_t i0 = k0 ^ UINT64_C(0x736f6d6570736575);
+  uint64_t i1 = k1 ^ UINT64_C(0x646f72616e646f6d);
+  uint64_t i2 = k0 ^ UINT64_C(0x6c7967656e657261);
+  uint64_t i3 = k1 ^ UINT64_C(0x7465646279746573);
+  uint64_t f0 = (uint64_t)32 << 56;
+  uint64_t w[4];
+  sip4_t s;
+  int i, j;
+
+  while (count >= 4) {
+    for (j = 0; j < 4; j++) {
+      s.v0[j] = i0;
+      s.v1[j] = i1;
+      s.v2[j] = i2;
+      s.v3[j] = i3;
+    }
+
+    for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+        w[j] = btc_read64le(data + j * 32 + i * 8);
+        s.v3[j] ^= w[j];
+      }
+
+      sip4_round(&s);
+      sip4_round(&s);
+
+      for (j = 0; j < 4; j++)
+        s.v0[j] ^= w[j];
+    }
+
+    for (j = 0; j < 4; j++)
+      s.v3[j] ^= f0;
+
+    sip4_round(&s);
+    sip4_round(&s);
+
+    for (j = 0; j < 4; j++) {
+      s.v0[j] ^= f0;
+      s.v2[j] ^= 0xff;
+    }
+
+    sip4_round(&s);
+    sip4_round(&s);
+    sip4_round(&s);
+    sip4_round(&s);
+
+    for (j = 0; j < 4; j++)
+      out[j] = s.v0[j] ^ s.v1[j] ^ s.v2[j] ^ s.v3[j];
+
+    out += 4;
+    data += 4 * 32;
+    count -= 4;
+  }
+
+  while (count > 0) {
+    *out++ = btc_siphash_sum(data, 32, key);
+    data += 32;
+    count -= 1;
+  }
+}
@@ -10,6 +10,7 @@
 #include <mako/crypto/hash.h>
 #include <mako/header.h>
 #include <mako/util.h>
+#include "bio.h"
 #include "impl.h"
 #include "internal.h"
 
@@ -125,37 +126,18 @@ btc_header_verify(const btc_header_t *hdr) {
 
 int
 btc_header_mine(btc_header_t *hdr, uint32_t limit) {
-  btc_hash256_t pre, ctx;
-  uint32_t attempt = 0;
   uint8_t target[32];
   uint8_t hash[32];
+  uint8_t raw[80];
+  int ret;
 
   CHECK(btc_compact_export(target, hdr->bits));
 
-  memset(&pre, 0, sizeof(pre));
+  btc_header_write(raw, hdr);
 
-  btc_hash256_init(&pre);
+  ret = btc_hash256_scan(hash, raw, target, limit);
 
-  btc_uint32_update(&pre, hdr->version);
-  btc_raw_update(&pre, hdr->prev_block, 32);
-  btc_raw_update(&pre, hdr->merkle_root, 32);
-  btc_time_update(&pre, hdr->time);
-  btc_uint32_update(&pre, hdr->bits);
+  hdr->nonce = btc_read32le(raw + 76);
 
-  do {
-    ctx = pre;
-
-    btc_uint32_update(&ctx, hdr->nonce);
-    btc_hash256_final(&ctx, hash);
-
-    if (btc_hash_compare(hash, target) <= 0)
-      return 1;
-
-    hdr->nonce++;
-
-    if (++attempt == limit)
-      return 0;
-  } while (hdr->nonce != 0);
-
-  return 0;
+  return ret;
 }
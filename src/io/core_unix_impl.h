@@ -303,6 +303,34 @@ btc_fs_read(btc_fd_t fd, void *dst, size_t len) {
   return cnt;
 }
 
+int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos) {
+  unsigned char *buf = dst;
+  int64_t cnt = 0;
+
+  while (len > 0) {
+    size_t max = BTC_MIN(len, 1 << 30);
+    int nread;
+
+    do {
+      nread = pread(fd, buf, max, pos);
+    } while (nread < 0 && errno == EINTR);
+
+    if (nread < 0)
+      return -1;
+
+    if (nread == 0)
+      break;
+
+    buf += nread;
+    len -= nread;
+    pos += nread;
+    cnt += nread;
+  }
+
+  return cnt;
+}
+
 int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len) {
   const unsigned char *buf = src;
@@ -651,6 +651,40 @@ btc_fs_read(btc_fd_t fd, void *dst, size_t len) {
   return cnt;
 }
 
+int64_t
+btc_fs_pread(btc_fd_t fd, void *dst, size_t len, int64_t pos) {
+  unsigned char *buf = dst;
+  int64_t cnt = 0;
+
+  while (len > 0) {
+    DWORD max = BTC_MIN(len, 1 << 30);
+    OVERLAPPED ol;
+    DWORD nread;
+
+    memset(&ol, 0, sizeof(ol));
+
+    ol.Offset = (DWORD)(pos & 0xffffffff);
+    ol.OffsetHigh = (DWORD)(pos >> 32);
+
+    if (!ReadFile(fd, buf, max, &nread, &ol)) {
+      if (GetLastError() == ERROR_HANDLE_EOF)
+        break;
+
+      return -1;
+    }
+
+    if (nread == 0)
+      break;
+
+    buf += nread;
+    len -= nread;
+    pos += nread;
+    cnt += nread;
+  }
+
+  return cnt;
+}
+
 int64_t
 btc_fs_write(btc_fd_t fd, const void *src, size_t len) {
   const unsigned char *buf = src;
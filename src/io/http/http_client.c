@@ -26,10 +26,14 @@ struct http_client {
   char hostname[1024];
   int port;
   btc_sockaddr_t addr;
+  int local;
   int connected;
   struct http_parser parser;
   struct http_parser_settings settings;
   http_msg_t *msg;
+  http_msg_t *head;
+  http_msg_t *tail;
+  size_t pending;
   int last_was_value;
   size_t total_buffered;
   int done;
@@ -82,6 +86,7 @@ http_msg_init(http_msg_t *msg) {
   msg->status = HTTP_STATUS_NOT_FOUND;
   http_head_init(&msg->headers);
   http_string_init(&msg->body);
+  msg->next = NULL;
 }
 
 void
@@ -110,6 +115,20 @@ http_msg_destroy(http_msg_t *msg) {
 static void
 http_client_init(http_client_t *client);
 
+static void
+http_client_drain(http_client_t *client) {
+  http_msg_t *msg, *next;
+
+  for (msg = client->head; msg != NULL; msg = next) {
+    next = msg->next;
+    http_msg_destroy(msg);
+  }
+
+  client->head = NULL;
+  client->tail = NULL;
+  client->pending = 0;
+}
+
 static void
 http_client_clear(http_client_t *client) {
   btc_loop_close(client->loop);
@@ -117,6 +136,8 @@ http_client_clear(http_client_t *client) {
 
   if (client->msg != NULL)
     http_msg_destroy(client->msg);
+
+  http_client_drain(client);
 }
 
 http_client_t *
@@ -221,8 +242,13 @@ http_resolve(btc_sockaddr_t *addr, const char *hostname, int port, int family) {
 }
 
 static int
-http_client_connect(http_client_t *client, const btc_sockaddr_t *addr) {
-  btc_socket_t *socket = btc_loop_connect(client->loop, addr);
+http_client_connect(http_client_t *client) {
+  btc_socket_t *socket;
+
+  if (client->local)
+    socket = btc_loop_connect_unix(client->loop, client->hostname);
+  else
+    socket = btc_loop_connect(client->loop, &client->addr);
 
   if (socket == NULL)
     return 0;
@@ -231,6 +257,10 @@ http_client_connect(http_client_t *client, const btc_sockaddr_t *addr) {
 
   client->parser.data = client;
 
+  /* Pipelined requests shouldn't wait on delayed acks. */
+  if (!client->local)
+    btc_socket_set_nodelay(socket, 1);
+
   btc_socket_set_data(socket, client);
   btc_socket_on_connect(socket, on_connect);
   btc_socket_on_close(socket, on_close);
@@ -247,32 +277,50 @@ http_client_open(http_client_t *client,
                  const char *hostname,
                  int port,
                  int family) {
-  size_t len = strlen(hostname);
   btc_sockaddr_t addr;
+  int local = 0;
+  size_t len;
 
-  if (len + 1 > sizeof(client->hostname))
-    return 0;
+  /* `unix:/path/to/socket` names a local socket. */
+  if (strncmp(hostname, "unix:", 5) == 0) {
+    hostname += 5;
+    local = 1;
+  }
 
-  if (port <= 0 || port > 0xffff)
-    return 0;
+  len = strlen(hostname);
 
-  if (!http_resolve(&addr, hostname, port, family))
+  if (len == 0 || len + 1 > sizeof(client->hostname))
     return 0;
 
-  if (!http_client_connect(client, &addr))
-    return 0;
+  btc_sockaddr_init(&addr);
+
+  if (!local) {
+    if (port <= 0 || port > 0xffff)
+      return 0;
+
+    if (!http_resolve(&addr, hostname, port, family))
+      return 0;
+  }
 
   memcpy(client->hostname, hostname, len + 1);
 
   client->port = port;
   client->addr = addr;
+  client->local = local;
+
+  if (!http_client_connect(client)) {
+    client->hostname[0] = '\0';
+    client->port = 0;
+    client->local = 0;
+    return 0;
+  }
 
   return 1;
 }
 
 static int
 http_client_reopen(http_client_t *client) {
-  return http_client_connect(client, &client->addr);
+  return http_client_connect(client);
 }
 
 void
@@ -285,9 +333,12 @@ http_client_close(http_client_t *client) {
 
   btc_sockaddr_init(&client->addr);
 
+  client->local = 0;
   client->connected = 0;
 
   btc_loop_close(client->loop);
+
+  http_client_drain(client);
 }
 
 static void
@@ -409,8 +460,16 @@ on_body(struct http_parser *parser, const char *at, size_t length) {
 static int
 on_message_complete(struct http_parser *parser) {
   http_client_t *client = parser->data;
+  http_msg_t *msg = client->msg;
 
-  client->done = 1;
+  /* Pipelined responses queue up in order. */
+  if (client->tail != NULL)
+    client->tail->next = msg;
+  else
+    client->head = msg;
+
+  client->tail = msg;
+  client->msg = NULL;
 
   return 0;
 }
@@ -422,6 +481,7 @@ http_client_init(http_client_t *client) {
   client->hostname[0] = '\0';
   client->port = 0;
   btc_sockaddr_init(&client->addr);
+  client->local = 0;
   client->connected = 0;
 
   http_parser_init(&client->parser, HTTP_RESPONSE);
@@ -441,6 +501,9 @@ http_client_init(http_client_t *client) {
   client->settings.on_chunk_complete = NULL;
 
   client->msg = NULL;
+  client->head = NULL;
+  client->tail = NULL;
+  client->pending = 0;
   client->last_was_value = 0;
   client->total_buffered = 0;
   client->done = 0;
@@ -489,7 +552,9 @@ http_client_size_head(http_client_t *client,
 
   size += 12 + strlen(method) + strlen(opt->path); /* %s %s HTTP/1.1 */
 
-  if (client->port == 80)
+  if (client->local)
+    size += 17; /* Host: localhost */
+  else if (client->port == 80)
     size += 8 + strlen(client->hostname); /* Host: %s */
   else
     size += 11 + strlen(client->hostname) + 11; /* Host: [%s]:%d */
@@ -537,7 +602,9 @@ http_client_write_head(http_client_t *client, const http_options_t *opt) {
 
   zp += sprintf(zp, "%s %s HTTP/1.1\r\n", method, opt->path);
 
-  if (client->port == 80)
+  if (client->local)
+    zp += sprintf(zp, "Host: localhost\r\n");
+  else if (client->port == 80)
     zp += sprintf(zp, "Host: %s\r\n", client->hostname);
   else if (strchr(client->hostname, ':') != NULL)
     zp += sprintf(zp, "Host: [%s]:%d\r\n", client->hostname, client->port);
@@ -591,47 +658,78 @@ http_client_write_head(http_client_t *client, const http_options_t *opt) {
   return http_client_write(client, head, zp - head);
 }
 
-http_msg_t *
-http_client_request(http_client_t *client, const http_options_t *options) {
-  http_msg_t *msg = NULL;
-  int64_t start;
-
+int
+http_client_send(http_client_t *client, const http_options_t *options) {
   if (client->socket == NULL) {
+    /* Anything still owed by the old connection is lost. */
+    http_client_reset(client);
+    http_client_drain(client);
+
     if (!http_client_reopen(client))
-      return NULL;
+      return 0;
   }
 
   if (!http_client_write_head(client, options))
-    return NULL;
+    return 0;
 
   if (options->body != NULL) {
     if (!http_client_put(client, options->body, strlen(options->body)))
-      return NULL;
+      return 0;
   }
 
-  http_client_reset(client);
+  client->pending++;
+
+  return 1;
+}
+
+http_msg_t *
+http_client_recv(http_client_t *client) {
+  http_msg_t *msg;
+  int64_t start;
+
+  if (client->pending == 0)
+    return NULL;
 
   start = btc_time_msec();
 
-  while (!client->done) {
+  while (client->head == NULL && !client->done) {
     if (btc_time_msec() > start + 10 * 1000) {
       btc_socket_timeout(client->socket);
       btc_loop_cleanup(client->loop);
-      goto fail;
+      break;
     }
 
     btc_loop_poll(client->loop, 1000);
   }
 
-  msg = client->msg;
+  msg = client->head;
 
-  client->msg = NULL;
+  if (msg == NULL) {
+    http_client_reset(client);
+    http_client_drain(client);
+    return NULL;
+  }
+
+  client->head = msg->next;
+
+  if (client->head == NULL)
+    client->tail = NULL;
+
+  client->pending--;
+
+  msg->next = NULL;
 
-fail:
-  http_client_reset(client);
   return msg;
 }
 
+http_msg_t *
+http_client_request(http_client_t *client, const http_options_t *options) {
+  if (!http_client_send(client, options))
+    return NULL;
+
+  return http_client_recv(client);
+}
+
 http_msg_t *
 http_get(const char *hostname, int port, const char *path, int family) {
   http_client_t *client = http_client_create();
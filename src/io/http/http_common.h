@@ -18,6 +18,10 @@
 #define HTTP_MAX_BUFFER (20 << 20)
 #define HTTP_MAX_FIELD_SIZE (1 << 10)
 #define HTTP_MAX_HEADERS 100
+#define HTTP_MAX_QUEUED 16
+#define HTTP_MAX_POOLED 64
+#define HTTP_MAX_RETAIN (64 << 10)
+#define HTTP_CHUNKED ((unsigned long)-1)
 
 /*
  * Helpers
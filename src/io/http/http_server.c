@@ -24,11 +24,18 @@
 typedef struct http_conn_s {
   http_server_t *server;
   btc_socket_t *socket;
+  int64_t last;
   struct http_parser parser;
   struct http_parser_settings settings;
   http_req_t *req;
   int last_was_value;
   size_t total_buffered;
+  http_res_t *busy;
+  http_req_t *head;
+  http_req_t *tail;
+  int queued;
+  struct http_conn_s *prev;
+  struct http_conn_s *next;
 } http_conn_t;
 
 /*
@@ -38,11 +45,14 @@ typedef struct http_conn_s {
 static void
 http_req_init(http_req_t *req) {
   req->method = 0;
+  req->major = 1;
+  req->minor = 1;
   http_string_init(&req->path);
   http_head_init(&req->headers);
   http_string_init(&req->user);
   http_string_init(&req->pass);
   http_string_init(&req->body);
+  req->next = NULL;
 }
 
 static void
@@ -54,17 +64,61 @@ http_req_clear(http_req_t *req) {
   http_string_clear(&req->body);
 }
 
+static void
+http_string_recycle(http_string_t *str) {
+  /* Don't let one large body pin memory forever. */
+  if (str->alloc > HTTP_MAX_RETAIN) {
+    http_string_clear(str);
+    http_string_init(str);
+  } else {
+    http_string_reset(str);
+  }
+}
+
+static void
+http_req_reset(http_req_t *req) {
+  req->method = 0;
+  req->major = 1;
+  req->minor = 1;
+  http_string_reset(&req->path);
+  http_head_clear(&req->headers);
+  http_string_reset(&req->user);
+  http_string_reset(&req->pass);
+  http_string_recycle(&req->body);
+  req->next = NULL;
+}
+
 static http_req_t *
-http_req_create(void) {
-  http_req_t *req = http_malloc(sizeof(http_req_t));
+http_req_create(http_server_t *server) {
+  http_req_t *req = server->reqs;
+
+  if (req != NULL) {
+    server->reqs = req->next;
+    server->nreqs--;
+    req->next = NULL;
+    return req;
+  }
+
+  req = http_malloc(sizeof(http_req_t));
+
   http_req_init(req);
+
   return req;
 }
 
 static void
-http_req_destroy(http_req_t *req) {
-  http_req_clear(req);
-  free(req);
+http_req_destroy(http_server_t *server, http_req_t *req) {
+  if (server->nreqs >= HTTP_MAX_POOLED) {
+    http_req_clear(req);
+    free(req);
+    return;
+  }
+
+  http_req_reset(req);
+
+  req->next = server->reqs;
+  server->reqs = req;
+  server->nreqs++;
 }
 
 const http_string_t *
@@ -87,32 +141,84 @@ http_req_header(const http_req_t *req, const char *name) {
  */
 
 static void
-http_res_init(http_res_t *res, btc_socket_t *socket) {
-  res->socket = socket;
+http_res_init(http_res_t *res, http_server_t *server) {
+  res->socket = NULL;
   http_head_init(&res->headers);
+  res->server = server;
+  res->conn = NULL;
+  res->deferred = 0;
+  res->chunked = 1;
+  res->status = 0;
+  res->type = NULL;
+  http_string_init(&res->body);
+  res->next = NULL;
 }
 
 static void
 http_res_clear(http_res_t *res) {
   http_head_clear(&res->headers);
+  http_string_clear(&res->body);
+}
+
+static void
+http_res_reset(http_res_t *res) {
+  res->socket = NULL;
+  http_head_clear(&res->headers);
+  res->conn = NULL;
+  res->deferred = 0;
+  res->chunked = 1;
+  res->status = 0;
+  res->type = NULL;
+  http_string_recycle(&res->body);
+  res->next = NULL;
 }
 
 static http_res_t *
-http_res_create(btc_socket_t *socket) {
-  http_res_t *res = http_malloc(sizeof(http_res_t));
-  http_res_init(res, socket);
+http_res_create(http_server_t *server, btc_socket_t *socket) {
+  http_res_t *res = server->ress;
+
+  if (res != NULL) {
+    server->ress = res->next;
+    server->nress--;
+    res->next = NULL;
+  } else {
+    res = http_malloc(sizeof(http_res_t));
+    http_res_init(res, server);
+  }
+
+  res->socket = socket;
+
   return res;
 }
 
 static void
 http_res_destroy(http_res_t *res) {
-  http_res_clear(res);
-  free(res);
+  http_server_t *server = res->server;
+
+  if (server->nress >= HTTP_MAX_POOLED) {
+    http_res_clear(res);
+    free(res);
+    return;
+  }
+
+  http_res_reset(res);
+
+  res->next = server->ress;
+  server->ress = res;
+  server->nress++;
 }
 
 static int
 http_res_write(http_res_t *res, void *data, size_t size) {
-  int rc = btc_socket_write(res->socket, data, size);
+  int rc;
+
+  /* The connection went away while we were deferred. */
+  if (res->socket == NULL) {
+    free(data);
+    return 0;
+  }
+
+  rc = btc_socket_write(res->socket, data, size);
 
   if (rc == -1) {
     btc_socket_close(res->socket);
@@ -149,9 +255,7 @@ http_res_header(http_res_t *res, const char *field, const char *value) {
 }
 
 static int
-http_gmt_date(char *buf, size_t size) {
-  /* Required by the HTTP standard. */
-  time_t ts = time(NULL);
+http_gmt_date(char *buf, size_t size, time_t ts) {
   struct tm *gmt;
 #if defined(BTC_PTHREAD) && !defined(_WIN32)
   struct tm tmp;
@@ -173,6 +277,21 @@ http_gmt_date(char *buf, size_t size) {
   return strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", gmt) != 0;
 }
 
+static const char *
+http_server_date(http_server_t *server) {
+  /* Required by the HTTP standard, but only changes once a second. */
+  time_t ts = time(NULL);
+
+  if ((int64_t)ts != server->now) {
+    if (!http_gmt_date(server->date, sizeof(server->date), ts))
+      server->date[0] = '\0';
+
+    server->now = (int64_t)ts;
+  }
+
+  return server->date;
+}
+
 static size_t
 http_res_size_head(http_res_t *res, const char *desc, const char *type) {
   size_t size = 0;
@@ -202,18 +321,23 @@ http_res_write_head(http_res_t *res,
                     const char *type,
                     unsigned long length) {
   const char *desc = http_status_str(status);
+  const char *date = http_server_date(res->server);
   char *head = http_malloc(http_res_size_head(res, desc, type));
   char *zp = head;
-  char date[64];
   size_t i;
 
   zp += sprintf(zp, "HTTP/1.1 %u %s\r\n", status, desc);
 
-  if (http_gmt_date(date, sizeof(date)))
+  if (*date != '\0')
     zp += sprintf(zp, "Date: %s\r\n", date);
 
   zp += sprintf(zp, "Content-Type: %s\r\n", type);
-  zp += sprintf(zp, "Content-Length: %lu\r\n", length);
+
+  if (length == HTTP_CHUNKED)
+    zp += sprintf(zp, "Transfer-Encoding: chunked\r\n");
+  else
+    zp += sprintf(zp, "Content-Length: %lu\r\n", length);
+
   zp += sprintf(zp, "Connection: keep-alive\r\n");
 
   for (i = 0; i < res->headers.length; i++) {
@@ -249,6 +373,53 @@ http_res_send_data(http_res_t *res,
   http_res_write(res, body, length);
 }
 
+void
+http_res_begin(http_res_t *res, unsigned int status, const char *type) {
+  res->status = status;
+  res->type = type;
+
+  if (res->chunked)
+    http_res_write_head(res, status, type, HTTP_CHUNKED);
+}
+
+void
+http_res_chunk(http_res_t *res, void *data, size_t length) {
+  char size[32];
+
+  if (length == 0) {
+    free(data);
+    return;
+  }
+
+  /* HTTP/1.0 clients get the body in one piece. */
+  if (!res->chunked) {
+    http_string_append(&res->body, data, length);
+    free(data);
+    return;
+  }
+
+  http_res_put(res, size, sprintf(size, "%lx\r\n", (unsigned long)length));
+  http_res_write(res, data, length);
+  http_res_put(res, "\r\n", 2);
+}
+
+void
+http_res_end(http_res_t *res) {
+  size_t length = res->body.length;
+
+  if (res->chunked) {
+    http_res_put(res, "0\r\n\r\n", 5);
+    return;
+  }
+
+  http_res_write_head(res, res->status, res->type, length);
+
+  if (length > 0) {
+    http_res_write(res, res->body.data, length);
+    http_string_init(&res->body);
+  }
+}
+
 void
 http_res_error(http_res_t *res, unsigned int status) {
   char body[33];
@@ -271,6 +442,30 @@ http_res_unauthorized(http_res_t *res, const char *realm) {
   http_res_error(res, 401);
 }
 
+static void
+http_conn_resume(http_conn_t *conn);
+
+void
+http_res_defer(http_res_t *res) {
+  res->deferred = 1;
+}
+
+void
+http_res_finish(http_res_t *res) {
+  http_conn_t *conn = res->conn;
+
+  if (!res->deferred)
+    abort(); /* LCOV_EXCL_LINE */
+
+  http_res_destroy(res);
+
+  if (conn != NULL) {
+    conn->last = btc_time_msec();
+    conn->busy = NULL;
+    http_conn_resume(conn);
+  }
+}
+
 /*
  * Basic Auth
  */
@@ -341,8 +536,22 @@ http_conn_init(http_conn_t *conn, http_server_t *server);
 
 static void
 http_conn_clear(http_conn_t *conn) {
+  http_server_t *server = conn->server;
+  http_req_t *req, *next;
+
   if (conn->req != NULL)
-    http_req_destroy(conn->req);
+    http_req_destroy(server, conn->req);
+
+  for (req = conn->head; req != NULL; req = next) {
+    next = req->next;
+    http_req_destroy(server, req);
+  }
+
+  /* Whoever holds the deferred response finishes it later. */
+  if (conn->busy != NULL) {
+    conn->busy->socket = NULL;
+    conn->busy->conn = NULL;
+  }
 }
 
 static http_conn_t *
@@ -361,7 +570,7 @@ http_conn_destroy(http_conn_t *conn) {
 static int
 http_conn_abort(http_conn_t *conn) {
   if (conn->req != NULL)
-    http_req_destroy(conn->req);
+    http_req_destroy(conn->server, conn->req);
 
   btc_socket_close(conn->socket);
 
@@ -375,6 +584,20 @@ http_conn_abort(http_conn_t *conn) {
 static void
 on_close(btc_socket_t *socket) {
   http_conn_t *conn = btc_socket_get_data(socket);
+  http_server_t *server = conn->server;
+
+  if (conn->prev != NULL)
+    conn->prev->next = conn->next;
+  else
+    server->head = conn->next;
+
+  if (conn->next != NULL)
+    conn->next->prev = conn->prev;
+  else
+    server->tail = conn->prev;
+
+  server->connections--;
+
   http_conn_destroy(conn);
 }
 
@@ -386,8 +609,11 @@ on_error(btc_socket_t *socket) {
 static int
 on_data(btc_socket_t *socket, const void *data, size_t size) {
   http_conn_t *conn = btc_socket_get_data(socket);
+  size_t nparsed;
 
-  size_t nparsed = http_parser_execute(&conn->parser,
+  conn->last = btc_time_msec();
+
+  nparsed = http_parser_execute(&conn->parser,
                                        &conn->settings,
                                        data,
                                        size);
@@ -403,9 +629,9 @@ on_message_begin(struct http_parser *parser) {
   http_conn_t *conn = parser->data;
 
   if (conn->req != NULL)
-    http_req_destroy(conn->req);
+    http_req_destroy(conn->server, conn->req);
 
-  conn->req = http_req_create();
+  conn->req = http_req_create(conn->server);
   conn->last_was_value = 0;
   conn->total_buffered = 0;
 
@@ -492,6 +718,8 @@ on_headers_complete(struct http_parser *parser) {
   size_t i;
 
   req->method = parser->method;
+  req->major = parser->http_major;
+  req->minor = parser->http_minor;
 
   for (i = 0; i < req->headers.length; i++) {
     http_header_t *hdr = req->headers.items[i];
@@ -519,22 +747,73 @@ on_body(struct http_parser *parser, const char *at, size_t length) {
   return 0;
 }
 
+static void
+http_conn_dispatch(http_conn_t *conn, http_req_t *req) {
+  http_server_t *server = conn->server;
+  http_res_t *res = http_res_create(server, conn->socket);
+
+  res->conn = conn;
+  res->chunked = (req->major > 1 || (req->major == 1 && req->minor > 0));
+
+  if (!server->on_request(server, req, res))
+    btc_socket_close(conn->socket);
+
+  http_req_destroy(server, req);
+
+  if (res->deferred)
+    conn->busy = res;
+  else
+    http_res_destroy(res);
+}
+
+static void
+http_conn_resume(http_conn_t *conn) {
+  http_req_t *req;
+
+  /* Answer queued requests in order until one defers again. */
+  while (conn->busy == NULL && conn->head != NULL) {
+    req = conn->head;
+
+    conn->head = req->next;
+
+    if (conn->head == NULL)
+      conn->tail = NULL;
+
+    conn->queued--;
+
+    req->next = NULL;
+
+    http_conn_dispatch(conn, req);
+  }
+}
+
 static int
 on_message_complete(struct http_parser *parser) {
   http_conn_t *conn = parser->data;
-  http_server_t *server = conn->server;
   http_req_t *req = conn->req;
-  http_res_t *res = http_res_create(conn->socket);
 
   conn->req = NULL;
   conn->last_was_value = 0;
   conn->total_buffered = 0;
 
-  if (!server->on_request(server, req, res))
+  if (conn->busy == NULL) {
+    http_conn_dispatch(conn, req);
+    return 0;
+  }
+
+  if (conn->queued >= HTTP_MAX_QUEUED) {
+    http_req_destroy(conn->server, req);
     btc_socket_close(conn->socket);
+    return 0;
+  }
 
-  http_req_destroy(req);
-  http_res_destroy(res);
+  if (conn->tail != NULL)
+    conn->tail->next = req;
+  else
+    conn->head = req;
+
+  conn->tail = req;
+  conn->queued++;
 
   return 0;
 }
@@ -543,6 +822,7 @@ static void
 http_conn_init(http_conn_t *conn, http_server_t *server) {
   conn->server = server;
   conn->socket = NULL;
+  conn->last = btc_time_msec();
 
   http_parser_init(&conn->parser, HTTP_REQUEST);
   http_parser_settings_init(&conn->settings);
@@ -563,11 +843,28 @@ http_conn_init(http_conn_t *conn, http_server_t *server) {
   conn->req = NULL;
   conn->last_was_value = 0;
   conn->total_buffered = 0;
+  conn->busy = NULL;
+  conn->head = NULL;
+  conn->tail = NULL;
+  conn->queued = 0;
+  conn->prev = NULL;
+  conn->next = NULL;
 }
 
 static void
 http_conn_accept(http_conn_t *conn, btc_socket_t *socket) {
+  http_server_t *server = conn->server;
+
   conn->socket = socket;
+  conn->prev = server->tail;
+
+  if (server->tail != NULL)
+    server->tail->next = conn;
+  else
+    server->head = conn;
+
+  server->tail = conn;
+  server->connections++;
 
   btc_socket_set_data(socket, conn);
   btc_socket_on_close(socket, on_close);
@@ -590,11 +887,38 @@ default_request_cb(http_server_t *server, http_req_t *req, http_res_t *res) {
 static void
 on_socket(btc_socket_t *parent, btc_socket_t *child) {
   http_server_t *server = btc_socket_get_data(parent);
-  http_conn_t *conn = http_conn_create(server);
+  http_conn_t *conn;
+
+  if (server->max_connections > 0
+      && server->connections >= server->max_connections) {
+    btc_socket_close(child);
+    return;
+  }
+
+  conn = http_conn_create(server);
 
   http_conn_accept(conn, child);
 }
 
+static void
+on_sweep(void *arg) {
+  http_server_t *server = arg;
+  int64_t now = btc_time_msec();
+  http_conn_t *conn;
+
+  /* Sockets are closed on the next tick; the list stays intact. */
+  for (conn = server->head; conn != NULL; conn = conn->next) {
+    if (conn->busy != NULL || conn->head != NULL)
+      continue;
+
+    if (btc_socket_buffered(conn->socket) > 0)
+      continue;
+
+    if (now - conn->last >= server->timeout)
+      btc_socket_timeout(conn->socket);
+  }
+}
+
 http_server_t *
 http_server_create(btc_loop_t *loop) {
   http_server_t *server = http_malloc(sizeof(http_server_t));
@@ -603,8 +927,21 @@ http_server_create(btc_loop_t *loop) {
   server->tcp = btc_server_create(loop);
   server->on_request = default_request_cb;
   server->data = NULL;
+  server->timer = btc_timer_create(loop, on_sweep, server);
+  server->head = NULL;
+  server->tail = NULL;
+  server->connections = 0;
+  server->max_connections = 0;
+  server->timeout = 0;
+  server->reqs = NULL;
+  server->ress = NULL;
+  server->nreqs = 0;
+  server->nress = 0;
+  server->now = -1;
+  server->date[0] = '\0';
 
   btc_server_set_data(server->tcp, server);
+  btc_server_set_nodelay(server->tcp, 1);
   btc_server_on_socket(server->tcp, on_socket);
 
   return server;
@@ -612,6 +949,24 @@ http_server_create(btc_loop_t *loop) {
 
 void
 http_server_destroy(http_server_t *server) {
+  http_req_t *req;
+  http_res_t *res;
+
+  while (server->reqs != NULL) {
+    req = server->reqs;
+    server->reqs = req->next;
+    http_req_clear(req);
+    free(req);
+  }
+
+  while (server->ress != NULL) {
+    res = server->ress;
+    server->ress = res->next;
+    http_res_clear(res);
+    free(res);
+  }
+
+  btc_timer_destroy(server->timer);
   btc_server_destroy(server->tcp);
   free(server);
 }
@@ -621,22 +976,64 @@ http_server_strerror(http_server_t *server) {
   return btc_server_strerror(server->tcp);
 }
 
+void
+http_server_set_max_connections(http_server_t *server, size_t max) {
+  server->max_connections = max;
+}
+
+void
+http_server_set_timeout(http_server_t *server, int64_t timeout) {
+  server->timeout = timeout;
+}
+
+static void
+http_server_start(http_server_t *server) {
+  if (server->timeout > 0 && !btc_timer_active(server->timer))
+    btc_timer_start(server->timer, 1000, 1000);
+}
+
 int
 http_server_listen(http_server_t *server, const btc_sockaddr_t *addr) {
-  return btc_server_listen(server->tcp, addr);
+  if (!btc_server_listen(server->tcp, addr))
+    return 0;
+
+  http_server_start(server);
+
+  return 1;
 }
 
 int
 http_server_listen_local(http_server_t *server, int port) {
-  return btc_server_listen_local(server->tcp, port);
+  if (!btc_server_listen_local(server->tcp, port))
+    return 0;
+
+  http_server_start(server);
+
+  return 1;
 }
 
 int
 http_server_listen_external(http_server_t *server, int port) {
-  return btc_server_listen_external(server->tcp, port);
+  if (!btc_server_listen_external(server->tcp, port))
+    return 0;
+
+  http_server_start(server);
+
+  return 1;
+}
+
+int
+http_server_listen_unix(http_server_t *server, const char *path) {
+  if (!btc_server_listen_unix(server->tcp, path))
+    return 0;
+
+  http_server_start(server);
+
+  return 1;
 }
 
 void
 http_server_close(http_server_t *server) {
+  btc_timer_stop(server->timer);
   btc_server_close(server->tcp);
 }
@@ -30,6 +30,9 @@
 #    include <sys/select.h>
 #  endif
 #  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#  include <sys/un.h>
 #  include <netinet/in.h>
 #  include <netinet/tcp.h>
 #  include <arpa/inet.h>
@@ -46,6 +49,22 @@
 
 #define BTC_MIN(x, y) ((x) < (y) ? (x) : (y))
 
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#  define BTC_IOV_MAX IOV_MAX
+#else
+#  define BTC_IOV_MAX 1024
+#endif
+
+#define BTC_IOBUF_SMALL 512
+#define BTC_MAX_FREE_CHUNKS 1024
+#define BTC_MAX_FREE_IOBUFS 1024
+
+#define BTC_URING_ENTRIES 256
+#define BTC_URING_CQ_ENTRIES 4096
+#define BTC_URING_BUFS 64 /* power of two */
+#define BTC_URING_BUFSIZE (16 << 10)
+#define BTC_URING_IOV 64
+
 /*
  * Compat
  */
@@ -120,6 +139,7 @@ typedef int btc_sockopt_t;
 
 #if defined(BTC_USE_EPOLL)
 #  include <sys/epoll.h>
+#  include <sys/eventfd.h>
 #elif defined(BTC_USE_POLL)
 #  include <poll.h>
 #else
@@ -132,6 +152,17 @@ typedef int btc_sockopt_t;
 #  error "more than one backend selected"
 #endif
 
+#if defined(BTC_USE_URING) && !defined(BTC_USE_EPOLL)
+#  error "io_uring requires the epoll backend"
+#endif
+
+#ifdef BTC_USE_URING
+#  include <poll.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <linux/io_uring.h>
+#endif
+
 /*
  * Macros
  */
@@ -236,6 +267,23 @@ enum btc_socket_state {
   BTC_SOCKET_BOUND
 };
 
+#ifdef BTC_USE_URING
+/* Operation tags, stored in the low bits of the user data. */
+enum btc_uring_op {
+  BTC_URING_RECV = 1,
+  BTC_URING_ACCEPT = 2,
+  BTC_URING_POLLIN = 3,
+  BTC_URING_POLLOUT = 4,
+  BTC_URING_SEND = 5,
+  BTC_URING_CANCEL = 6,
+  BTC_URING_WAKE = 7
+};
+
+#define BTC_URING_MASK 7
+#define BTC_URING_BIT(op) (1 << (op))
+#define BTC_URING_DATA(ptr, op) ((uint64_t)(uintptr_t)(ptr) | (op))
+#endif
+
 /*
  * Types
  */
@@ -243,6 +291,7 @@ enum btc_socket_state {
 typedef struct chunk_s {
   struct sockaddr *addr;
   void *ptr;
+  btc_iobuf_t *buf;
   unsigned char *raw;
   size_t len;
   struct chunk_s *next;
@@ -254,6 +303,7 @@ struct btc_socket_s {
   struct sockaddr *addr;
   btc_sockfd_t fd;
   int state;
+  int polling;
 #ifdef BTC_USE_POLL
   size_t index;
 #endif
@@ -263,6 +313,14 @@ struct btc_socket_s {
   int draining;
 #ifndef BTC_USE_POLL
   btc_link_t link;
+#endif
+#ifdef BTC_USE_URING
+  btc_link_t pending;
+  struct msghdr msg;
+  struct iovec iov[BTC_URING_IOV];
+  int inflight;
+  int hangup;
+  int zombie;
 #endif
   btc_link_t deferred;
   btc_link_t closed;
@@ -278,25 +336,64 @@ struct btc_socket_s {
   void *data;
 };
 
+#ifdef BTC_USE_URING
+typedef struct btc_uring_s {
+  int fd;
+  unsigned char *ring;
+  size_t ring_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned sq_local;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  struct io_uring_buf_ring *br;
+  size_t br_size;
+  unsigned short br_tail;
+  unsigned char *bufs;
+  btc_list_t pending;
+  size_t zombies;
+  int waking;
+  int oneshot;
+} btc_uring_t;
+#endif
+
 typedef struct btc_tick_s {
   btc_loop_tick_cb *handler;
   void *data;
   btc_link_t link;
 } btc_tick_t;
 
+struct btc_timer_s {
+  struct btc_loop_s *loop;
+  btc_timer_cb *handler;
+  void *data;
+  int64_t deadline;
+  int64_t repeat;
+  size_t index;
+};
+
 struct btc_loop_s {
 #if defined(BTC_USE_EPOLL)
   int fd;
   struct epoll_event *events;
   int max;
   btc_list_t sockets;
+#ifdef BTC_USE_URING
+  btc_uring_t *ring;
+#endif
 #elif defined(BTC_USE_POLL)
   struct pollfd *pfds;
   btc_socket_t **sockets;
   size_t alloc;
   size_t length;
 #else /* !BTC_USE_POLL */
-  fd_set fds;
+  fd_set fds, wset;
   fd_set rfds, wfds;
 #ifdef _WIN32
   fd_set efds;
@@ -312,6 +409,17 @@ struct btc_loop_s {
   btc_list_t deferred;
   btc_list_t closed;
   btc_list_t ticks;
+  btc_timer_t **timers;
+  size_t timers_alloc;
+  size_t timers_length;
+  chunk_t *chunks;
+  size_t chunks_free;
+  btc_iobuf_t *iobufs;
+  size_t iobufs_free;
+  btc_mutex_t iobuf_lock;
+#ifndef _WIN32
+  int wake[2];
+#endif
   int error;
   int running;
 };
@@ -338,7 +446,6 @@ safe_malloc(size_t size) {
   return ptr;
 }
 
-#ifndef BTC_USE_SELECT
 static void *
 safe__realloc(void *ptr, size_t new_size, size_t old_size) {
   ptr = realloc(ptr, new_size);
@@ -355,7 +462,6 @@ safe__realloc(void *ptr, size_t new_size, size_t old_size) {
 #define safe_realloc(ptr, new_size, old_size, type)     \
   (type *)safe__realloc(ptr, (new_size) * sizeof(type), \
                              (old_size) * sizeof(type))
-#endif
 
 /*
  * Sockaddr Helpers
@@ -369,6 +475,10 @@ sa_domain(const struct sockaddr *addr) {
 #ifdef BTC_HAVE_RFC3493
     case AF_INET6:
       return PF_INET6;
+#endif
+#ifndef _WIN32
+    case AF_UNIX:
+      return PF_UNIX;
 #endif
     default:
       return PF_UNSPEC;
@@ -383,6 +493,10 @@ sa_addrlen(const struct sockaddr *addr) {
 #ifdef BTC_HAVE_RFC3493
     case AF_INET6:
       return sizeof(struct sockaddr_in6);
+#endif
+#ifndef _WIN32
+    case AF_UNIX:
+      return sizeof(struct sockaddr_un);
 #endif
     default:
       return 0;
@@ -612,6 +726,354 @@ safe_epoll_create(void) {
 }
 #endif
 
+/*
+ * io_uring Helper
+ */
+
+#ifdef BTC_USE_URING
+static int
+uring_enter(btc_uring_t *ring, unsigned wait, int timeout) {
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned flags = 0;
+  unsigned submit;
+  long ret;
+
+  __atomic_store_n(ring->sq_tail, ring->sq_local, __ATOMIC_RELEASE);
+
+  submit = ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  if (submit == 0 && wait == 0)
+    return 0;
+
+  memset(&arg, 0, sizeof(arg));
+
+  if (wait) {
+    flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+    if (timeout >= 0) {
+      ts.tv_sec = timeout / 1000;
+      ts.tv_nsec = (long long)(timeout % 1000) * 1000000;
+
+      arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+  }
+
+  ret = syscall(__NR_io_uring_enter, ring->fd, submit, wait,
+                flags, wait ? &arg : NULL, sizeof(arg));
+
+  if (ret < 0) {
+    if (errno != EINTR && errno != ETIME
+        && errno != EAGAIN && errno != EBUSY) {
+      abort(); /* LCOV_EXCL_LINE */
+    }
+
+    return -1;
+  }
+
+  return (int)ret;
+}
+
+static struct io_uring_sqe *
+uring_sqe(btc_uring_t *ring) {
+  struct io_uring_sqe *sqe;
+
+  for (;;) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    if (ring->sq_local - head < ring->sq_entries)
+      break;
+
+    uring_enter(ring, 0, 0);
+  }
+
+  sqe = &ring->sqes[ring->sq_local & ring->sq_mask];
+
+  memset(sqe, 0, sizeof(*sqe));
+
+  ring->sq_local++;
+
+  return sqe;
+}
+
+static void
+uring_provide(btc_uring_t *ring, unsigned bid) {
+  unsigned mask = BTC_URING_BUFS - 1;
+  struct io_uring_buf *buf = &ring->br->bufs[ring->br_tail & mask];
+
+  buf->addr = (uint64_t)(uintptr_t)&ring->bufs[bid * BTC_URING_BUFSIZE];
+  buf->len = BTC_URING_BUFSIZE;
+  buf->bid = bid;
+
+  ring->br_tail++;
+
+  __atomic_store_n(&ring->br->tail, ring->br_tail, __ATOMIC_RELEASE);
+}
+
+static void
+uring_destroy(btc_uring_t *ring) {
+  if (ring->sqes != NULL)
+    munmap(ring->sqes, ring->sqes_size);
+
+  if (ring->ring != NULL)
+    munmap(ring->ring, ring->ring_size);
+
+  if (ring->br != NULL)
+    munmap(ring->br, ring->br_size);
+
+  if (ring->bufs != NULL)
+    free(ring->bufs);
+
+  close(ring->fd);
+  free(ring);
+}
+
+static btc_uring_t *
+uring_create(void) {
+  unsigned required = IORING_FEAT_SINGLE_MMAP
+                    | IORING_FEAT_NODROP
+                    | IORING_FEAT_FAST_POLL
+                    | IORING_FEAT_EXT_ARG;
+  struct io_uring_params p;
+  struct io_uring_buf_reg reg;
+  btc_uring_t *ring;
+  unsigned *array;
+  void *ptr;
+  unsigned i;
+  int fd;
+
+  memset(&p, 0, sizeof(p));
+
+  p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  p.cq_entries = BTC_URING_CQ_ENTRIES;
+
+#ifdef IORING_SETUP_COOP_TASKRUN
+  p.flags |= IORING_SETUP_COOP_TASKRUN;
+#endif
+
+  fd = syscall(__NR_io_uring_setup, BTC_URING_ENTRIES, &p);
+
+#ifdef IORING_SETUP_COOP_TASKRUN
+  if (fd == -1 && errno == EINVAL) {
+    memset(&p, 0, sizeof(p));
+
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    p.cq_entries = BTC_URING_CQ_ENTRIES;
+
+    fd = syscall(__NR_io_uring_setup, BTC_URING_ENTRIES, &p);
+  }
+#endif
+
+  /* Disabled by sysctl, seccomp or an old kernel. */
+  if (fd == -1)
+    return NULL;
+
+  if ((p.features & required) != required) {
+    close(fd);
+    return NULL;
+  }
+
+  ring = (btc_uring_t *)safe_malloc(sizeof(btc_uring_t));
+
+  memset(ring, 0, sizeof(*ring));
+
+  ring->fd = fd;
+
+  ring->ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+
+  if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe)
+      > ring->ring_size) {
+    ring->ring_size = p.cq_off.cqes
+                    + p.cq_entries * sizeof(struct io_uring_cqe);
+  }
+
+  ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, IORING_OFF_SQ_RING);
+
+  if (ptr == MAP_FAILED)
+    goto fail;
+
+  ring->ring = (unsigned char *)ptr;
+
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, IORING_OFF_SQES);
+
+  if (ptr == MAP_FAILED)
+    goto fail;
+
+  ring->sqes = (struct io_uring_sqe *)ptr;
+
+  ring->sq_head = (unsigned *)(void *)(ring->ring + p.sq_off.head);
+  ring->sq_tail = (unsigned *)(void *)(ring->ring + p.sq_off.tail);
+  ring->sq_mask = *(unsigned *)(void *)(ring->ring + p.sq_off.ring_mask);
+  ring->sq_entries = p.sq_entries;
+  ring->sq_local = *ring->sq_tail;
+
+  ring->cq_head = (unsigned *)(void *)(ring->ring + p.cq_off.head);
+  ring->cq_tail = (unsigned *)(void *)(ring->ring + p.cq_off.tail);
+  ring->cq_mask = *(unsigned *)(void *)(ring->ring + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(void *)(ring->ring + p.cq_off.cqes);
+
+  /* Submission slots map one-to-one onto the sqe array. */
+  array = (unsigned *)(void *)(ring->ring + p.sq_off.array);
+
+  for (i = 0; i < p.sq_entries; i++)
+    array[i] = i;
+
+  /* Receive buffers are handed to the kernel through a buffer ring. */
+  ring->br_size = BTC_URING_BUFS * sizeof(struct io_uring_buf);
+
+  ptr = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (ptr == MAP_FAILED)
+    goto fail;
+
+  ring->br = (struct io_uring_buf_ring *)ptr;
+  ring->bufs = (unsigned char *)safe_malloc(BTC_URING_BUFS * BTC_URING_BUFSIZE);
+
+  memset(&reg, 0, sizeof(reg));
+
+  reg.ring_addr = (uint64_t)(uintptr_t)ring->br;
+  reg.ring_entries = BTC_URING_BUFS;
+  reg.bgid = 0;
+
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING,
+              &reg, 1) != 0) {
+    goto fail;
+  }
+
+  for (i = 0; i < BTC_URING_BUFS; i++)
+    uring_provide(ring, i);
+
+  btc_list_init(&ring->pending);
+
+  return ring;
+fail:
+  uring_destroy(ring);
+  return NULL;
+}
+#endif
+
+/*
+ * Chunk
+ */
+
+static chunk_t *
+chunk_alloc(btc_loop_t *loop) {
+  chunk_t *chunk = loop->chunks;
+
+  if (chunk != NULL) {
+    loop->chunks = chunk->next;
+    loop->chunks_free--;
+  } else {
+    chunk = (chunk_t *)safe_malloc(sizeof(chunk_t));
+  }
+
+  chunk->addr = NULL;
+  chunk->ptr = NULL;
+  chunk->buf = NULL;
+  chunk->raw = NULL;
+  chunk->len = 0;
+  chunk->next = NULL;
+
+  return chunk;
+}
+
+static void
+chunk_free(btc_loop_t *loop, chunk_t *chunk) {
+  if (chunk->addr != NULL)
+    free(chunk->addr);
+
+  if (chunk->buf != NULL)
+    btc_iobuf_destroy(chunk->buf);
+  else if (chunk->ptr != NULL)
+    free(chunk->ptr);
+
+  if (loop->chunks_free < BTC_MAX_FREE_CHUNKS) {
+    chunk->next = loop->chunks;
+    loop->chunks = chunk;
+    loop->chunks_free++;
+  } else {
+    free(chunk);
+  }
+}
+
+/*
+ * I/O Buffer
+ */
+
+btc_iobuf_t *
+btc_iobuf_create(btc_loop_t *loop, size_t length) {
+  size_t alloc = length <= BTC_IOBUF_SMALL ? BTC_IOBUF_SMALL : length;
+  btc_iobuf_t *buf = NULL;
+
+  btc_mutex_lock(&loop->iobuf_lock);
+
+  if (alloc == BTC_IOBUF_SMALL && loop->iobufs != NULL) {
+    buf = loop->iobufs;
+    loop->iobufs = buf->next;
+    loop->iobufs_free--;
+  }
+
+  btc_mutex_unlock(&loop->iobuf_lock);
+
+  if (buf == NULL) {
+    buf = (btc_iobuf_t *)safe_malloc(sizeof(btc_iobuf_t) + alloc);
+    buf->data = (unsigned char *)(buf + 1);
+    buf->alloc = alloc;
+  }
+
+  buf->loop = loop;
+  buf->length = length;
+  buf->refs = 1;
+  buf->next = NULL;
+
+  return buf;
+}
+
+btc_iobuf_t *
+btc_iobuf_ref(btc_iobuf_t *buf) {
+  /* Buffers may be shared with sockets on other threads' loops. */
+  btc_mutex_lock(&buf->loop->iobuf_lock);
+
+  CHECK(buf->refs > 0);
+
+  buf->refs++;
+
+  btc_mutex_unlock(&buf->loop->iobuf_lock);
+
+  return buf;
+}
+
+void
+btc_iobuf_destroy(btc_iobuf_t *buf) {
+  btc_loop_t *loop = buf->loop;
+
+  btc_mutex_lock(&loop->iobuf_lock);
+
+  CHECK(buf->refs > 0);
+
+  if (--buf->refs > 0) {
+    btc_mutex_unlock(&loop->iobuf_lock);
+    return;
+  }
+
+  if (buf->alloc == BTC_IOBUF_SMALL && loop->iobufs_free < BTC_MAX_FREE_IOBUFS) {
+    buf->next = loop->iobufs;
+    loop->iobufs = buf;
+    loop->iobufs_free++;
+    buf = NULL;
+  }
+
+  btc_mutex_unlock(&loop->iobuf_lock);
+
+  if (buf != NULL)
+    free(buf);
+}
+
 /*
  * Default Callbacks
  */
@@ -675,8 +1137,12 @@ btc_socket_create(btc_loop_t *loop) {
   socket->addr = (struct sockaddr *)&socket->storage;
   socket->fd = BTC_INVALID_SOCKET;
   socket->state = BTC_SOCKET_DISCONNECTED;
+  socket->polling = -1;
 #ifndef BTC_USE_POLL
   socket->link.value = socket;
+#endif
+#ifdef BTC_USE_URING
+  socket->pending.value = socket;
 #endif
   socket->deferred.value = socket;
   socket->closed.value = socket;
@@ -697,14 +1163,18 @@ static void
 btc_socket_destroy(btc_socket_t *socket) {
   chunk_t *chunk, *next;
 
+#ifdef BTC_USE_URING
+  /* Freed once the kernel is done with us. */
+  if (socket->inflight != 0) {
+    socket->zombie = 1;
+    socket->loop->ring->zombies++;
+    return;
+  }
+#endif
+
   for (chunk = socket->head; chunk != NULL; chunk = next) {
     next = chunk->next;
-
-    if (chunk->addr != NULL)
-      free(chunk->addr);
-
-    free(chunk->ptr);
-    free(chunk);
+    chunk_free(socket->loop, chunk);
   }
 
   free(socket);
@@ -793,14 +1263,36 @@ btc_socket_setaddr(btc_socket_t *socket, const btc_sockaddr_t *addr) {
 }
 
 static int
-btc_socket_listen(btc_socket_t *server, const btc_sockaddr_t *addr) {
+btc_socket_setpath(btc_socket_t *socket, const char *path) {
+#ifdef _WIN32
+  (void)path;
+  socket->loop->error = BTC_EAFNOSUPPORT;
+  return 0;
+#else
+  struct sockaddr_un *un = (struct sockaddr_un *)socket->addr;
+  size_t len = strlen(path);
+
+  if (sizeof(*un) > sizeof(socket->storage) || len >= sizeof(un->sun_path)) {
+    socket->loop->error = BTC_EINVAL;
+    return 0;
+  }
+
+  memset(un, 0, sizeof(*un));
+
+  un->sun_family = AF_UNIX;
+
+  memcpy(un->sun_path, path, len + 1);
+
+  return 1;
+#endif
+}
+
+static int
+btc_socket_listen_addr(btc_socket_t *server) {
   btc_socklen_t addrlen;
   btc_sockfd_t fd;
   int backlog;
 
-  if (!btc_socket_setaddr(server, addr))
-    return 0;
-
   fd = safe_listener(sa_domain(server->addr), SOCK_STREAM, 0);
 
   if (fd == BTC_INVALID_SOCKET) {
@@ -839,6 +1331,32 @@ btc_socket_listen(btc_socket_t *server, const btc_sockaddr_t *addr) {
   return 1;
 }
 
+static int
+btc_socket_listen(btc_socket_t *server, const btc_sockaddr_t *addr) {
+  if (!btc_socket_setaddr(server, addr))
+    return 0;
+
+  return btc_socket_listen_addr(server);
+}
+
+static int
+btc_socket_listen_unix(btc_socket_t *server, const char *path) {
+#ifndef _WIN32
+  struct stat st;
+#endif
+
+  if (!btc_socket_setpath(server, path))
+    return 0;
+
+#ifndef _WIN32
+  /* Left behind by an unclean shutdown. */
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+#endif
+
+  return btc_socket_listen_addr(server);
+}
+
 static int
 btc_socket_accept(btc_socket_t *socket, btc_socket_t *server) {
   btc_socklen_t addrlen = sizeof(socket->storage);
@@ -866,13 +1384,10 @@ btc_socket_accept(btc_socket_t *socket, btc_socket_t *server) {
 }
 
 static int
-btc_socket_connect(btc_socket_t *socket, const btc_sockaddr_t *addr) {
+btc_socket_connect_addr(btc_socket_t *socket) {
   btc_socklen_t addrlen;
   btc_sockfd_t fd;
 
-  if (!btc_socket_setaddr(socket, addr))
-    return 0;
-
   fd = safe_socket(sa_domain(socket->addr), SOCK_STREAM, 0);
 
   if (fd == BTC_INVALID_SOCKET) {
@@ -910,6 +1425,22 @@ btc_socket_connect(btc_socket_t *socket, const btc_sockaddr_t *addr) {
   return 1;
 }
 
+static int
+btc_socket_connect(btc_socket_t *socket, const btc_sockaddr_t *addr) {
+  if (!btc_socket_setaddr(socket, addr))
+    return 0;
+
+  return btc_socket_connect_addr(socket);
+}
+
+static int
+btc_socket_connect_unix(btc_socket_t *socket, const char *path) {
+  if (!btc_socket_setpath(socket, path))
+    return 0;
+
+  return btc_socket_connect_addr(socket);
+}
+
 static int
 btc_socket_bind(btc_socket_t *socket, const btc_sockaddr_t *addr) {
   btc_socklen_t addrlen;
@@ -983,51 +1514,111 @@ btc_socket_talk(btc_socket_t *socket, int family) {
   return 1;
 }
 
+static void
+btc_loop_rearm(btc_loop_t *loop, btc_socket_t *socket);
+
+#ifndef _WIN32
 static int
-btc_socket_flush_write(btc_socket_t *socket) {
-  chunk_t *chunk, *next;
-  size_t max;
-  int len;
+btc_socket_writev(btc_socket_t *socket) {
+  struct iovec iov[BTC_IOV_MAX];
+  size_t total = 0;
+  struct msghdr msg;
+  chunk_t *chunk;
+  int count = 0;
+  ssize_t len;
 
-  for (chunk = socket->head; chunk != NULL; chunk = next) {
-    next = chunk->next;
+  for (chunk = socket->head; chunk != NULL; chunk = chunk->next) {
+    if (count == BTC_IOV_MAX || total >= (1 << 30))
+      break;
 
-    while (chunk->len > 0) {
-      max = BTC_MIN(chunk->len, 1 << 30);
-      len = send(socket->fd, (void *)chunk->raw, max, BTC_NOSIGNAL);
+    iov[count].iov_base = (void *)chunk->raw;
+    iov[count].iov_len = BTC_MIN(chunk->len, 1 << 30);
 
-      if (len == BTC_SOCKET_ERROR) {
-        int error = btc_errno;
+    total += iov[count].iov_len;
+    count += 1;
+  }
 
-        if (error == BTC_EINTR)
-          continue;
+  memset(&msg, 0, sizeof(msg));
 
-        if (error == BTC_EAGAIN)
-          break;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
 
-        if (error == BTC_EWOULDBLOCK)
-          break;
+  do {
+    len = sendmsg(socket->fd, &msg, BTC_NOSIGNAL);
+  } while (len == -1 && errno == EINTR);
 
-        socket->loop->error = error;
+  return (int)len;
+}
+#endif
 
-        return -1;
-      }
+static void
+btc_socket_consume(btc_socket_t *socket, size_t len) {
+  chunk_t *chunk;
+
+  socket->total -= len;
 
+  while (len > 0) {
+    chunk = socket->head;
+
+    if (len < chunk->len) {
       chunk->raw += len;
       chunk->len -= len;
-
-      socket->total -= len;
+      break;
     }
 
-    if (chunk->len != 0) {
-      socket->draining = 1;
-      return 0;
+    len -= chunk->len;
+
+    socket->head = chunk->next;
+
+    chunk_free(socket->loop, chunk);
+  }
+}
+
+static int
+btc_socket_flush_write(btc_socket_t *socket) {
+  btc_loop_t *loop = socket->loop;
+#ifdef _WIN32
+  chunk_t *chunk;
+#endif
+  int ret;
+
+  while (socket->head != NULL) {
+#ifdef BTC_USE_URING
+    /* Sends are batched into the next submission. */
+    if (loop->ring != NULL)
+      break;
+#endif
+
+#ifdef _WIN32
+    chunk = socket->head;
+    ret = send(socket->fd, (void *)chunk->raw,
+               BTC_MIN(chunk->len, 1 << 30), BTC_NOSIGNAL);
+#else
+    /* Gather as many chunks as possible into one syscall. */
+    ret = btc_socket_writev(socket);
+#endif
+
+    if (ret == BTC_SOCKET_ERROR) {
+      int error = btc_errno;
+
+      if (error == BTC_EINTR)
+        continue;
+
+      if (error == BTC_EAGAIN || error == BTC_EWOULDBLOCK)
+        break;
+
+      loop->error = error;
+
+      return -1;
     }
 
-    free(chunk->ptr);
-    free(chunk);
+    btc_socket_consume(socket, ret);
+  }
 
-    socket->head = next;
+  if (socket->head != NULL) {
+    socket->draining = 1;
+    btc_loop_rearm(loop, socket);
+    return 0;
   }
 
   CHECK(socket->total == 0);
@@ -1036,6 +1627,8 @@ btc_socket_flush_write(btc_socket_t *socket) {
   socket->tail = NULL;
   socket->total = 0;
 
+  btc_loop_rearm(loop, socket);
+
   if (socket->draining) {
     socket->draining = 0;
     socket->on_drain(socket);
@@ -1044,9 +1637,27 @@ btc_socket_flush_write(btc_socket_t *socket) {
   return 1;
 }
 
+static int
+btc_socket_queue(btc_socket_t *socket, chunk_t *chunk) {
+  if (socket->head == NULL)
+    socket->head = chunk;
+
+  if (socket->tail != NULL)
+    socket->tail->next = chunk;
+
+  socket->tail = chunk;
+  socket->total += chunk->len;
+
+  if (socket->state == BTC_SOCKET_CONNECTING) {
+    socket->draining = 1;
+    return 0;
+  }
+
+  return btc_socket_flush_write(socket);
+}
+
 int
 btc_socket_write(btc_socket_t *socket, void *data, size_t len) {
-  unsigned char *raw = (unsigned char *)data;
   chunk_t *chunk;
 
   if (socket->state != BTC_SOCKET_CONNECTING
@@ -1066,29 +1677,33 @@ btc_socket_write(btc_socket_t *socket, void *data, size_t len) {
     return !socket->draining;
   }
 
-  chunk = (chunk_t *)safe_malloc(sizeof(chunk_t));
-
-  chunk->addr = NULL;
-  chunk->ptr = raw;
-  chunk->raw = raw;
+  chunk = chunk_alloc(socket->loop);
+  chunk->ptr = data;
+  chunk->raw = (unsigned char *)data;
   chunk->len = len;
-  chunk->next = NULL;
-
-  if (socket->head == NULL)
-    socket->head = chunk;
 
-  if (socket->tail != NULL)
-    socket->tail->next = chunk;
+  return btc_socket_queue(socket, chunk);
+}
 
-  socket->tail = chunk;
-  socket->total += len;
+int
+btc_socket_write_buf(btc_socket_t *socket, btc_iobuf_t *buf) {
+  chunk_t *chunk;
 
-  if (socket->state == BTC_SOCKET_CONNECTING) {
-    socket->draining = 1;
-    return 0;
+  if (socket->state != BTC_SOCKET_CONNECTING
+      && socket->state != BTC_SOCKET_CONNECTED) {
+    socket->loop->error = BTC_EPIPE;
+    return -1;
   }
 
-  return btc_socket_flush_write(socket);
+  if (buf->length == 0)
+    return !socket->draining;
+
+  chunk = chunk_alloc(socket->loop);
+  chunk->buf = btc_iobuf_ref(buf);
+  chunk->raw = buf->data;
+  chunk->len = buf->length;
+
+  return btc_socket_queue(socket, chunk);
 }
 
 static int
@@ -1118,26 +1733,20 @@ btc_socket_flush_send(btc_socket_t *socket) {
         if (error == BTC_EINTR)
           continue;
 
-        if (error == BTC_EAGAIN)
-          return 0;
-
-        if (error == BTC_EWOULDBLOCK)
-          return 0;
-
-        if (error == BTC_ENOBUFS)
+        if (error == BTC_EAGAIN || error == BTC_EWOULDBLOCK
+                                || error == BTC_ENOBUFS) {
+          btc_loop_rearm(socket->loop, socket);
           return 0;
+        }
       }
 
       break;
     }
 
     socket->total -= chunk->len;
-
-    free(chunk->addr);
-    free(chunk->ptr);
-    free(chunk);
-
     socket->head = next;
+
+    chunk_free(socket->loop, chunk);
   }
 
   CHECK(socket->total == 0);
@@ -1146,6 +1755,8 @@ btc_socket_flush_send(btc_socket_t *socket) {
   socket->tail = NULL;
   socket->total = 0;
 
+  btc_loop_rearm(socket->loop, socket);
+
   return 1;
 }
 
@@ -1179,13 +1790,12 @@ btc_socket_send(btc_socket_t *socket,
     return -1;
   }
 
-  chunk = (chunk_t *)safe_malloc(sizeof(chunk_t));
+  chunk = chunk_alloc(socket->loop);
 
   chunk->addr = (struct sockaddr *)safe_malloc(sizeof(struct sockaddr_storage));
   chunk->ptr = raw;
   chunk->raw = raw;
   chunk->len = len;
-  chunk->next = NULL;
 
   btc_sockaddr_get(chunk->addr, addr);
 
@@ -1212,19 +1822,24 @@ btc_socket_close(btc_socket_t *socket) {
   if (socket->state == BTC_SOCKET_DISCONNECTED)
     return;
 
+#ifdef BTC_USE_URING
+  /* An in-flight send still points into our chunks. */
+  if (socket->inflight & BTC_URING_BIT(BTC_URING_SEND))
+    goto done;
+#endif
+
   for (chunk = socket->head; chunk != NULL; chunk = next) {
     next = chunk->next;
-
-    if (chunk->addr != NULL)
-      free(chunk->addr);
-
-    free(chunk->ptr);
-    free(chunk);
+    chunk_free(loop, chunk);
   }
 
-  socket->state = BTC_SOCKET_DISCONNECTED;
   socket->head = NULL;
   socket->tail = NULL;
+
+#ifdef BTC_USE_URING
+done:
+#endif
+  socket->state = BTC_SOCKET_DISCONNECTED;
   socket->total = 0;
   socket->draining = 0;
 
@@ -1275,6 +1890,60 @@ btc_loop_grow(btc_loop_t *loop, size_t n) {
 #endif
 }
 
+#ifndef _WIN32
+static void
+btc_loop_open_wakeup(btc_loop_t *loop) {
+#if defined(BTC_USE_EPOLL)
+  struct epoll_event ev;
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  CHECK(fd != -1);
+
+  loop->wake[0] = fd;
+  loop->wake[1] = fd;
+
+  memset(&ev, 0, sizeof(ev));
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+
+  CHECK(epoll_ctl(loop->fd, EPOLL_CTL_ADD, fd, &ev) == 0);
+#else
+  CHECK(pipe(loop->wake) == 0);
+
+  CHECK(set_nonblocking(loop->wake[0]) == 0);
+  CHECK(set_nonblocking(loop->wake[1]) == 0);
+
+  set_cloexec(loop->wake[0]);
+  set_cloexec(loop->wake[1]);
+
+#if defined(BTC_USE_POLL)
+  /* The wakeup descriptor always occupies slot zero. */
+  loop->pfds[0].fd = loop->wake[0];
+  loop->pfds[0].events = POLLIN;
+  loop->pfds[0].revents = 0;
+  loop->sockets[0] = NULL;
+  loop->length = 1;
+#else
+  CHECK(loop->wake[0] < FD_SETSIZE);
+
+  FD_SET(loop->wake[0], &loop->fds);
+
+  if (loop->wake[0] + 1 > loop->nfds)
+    loop->nfds = loop->wake[0] + 1;
+#endif
+#endif
+}
+
+static void
+btc_loop_drain_wakeup(btc_loop_t *loop) {
+  unsigned char buf[64];
+
+  while (read(loop->wake[0], buf, sizeof(buf)) > 0)
+    ;
+}
+#endif /* !_WIN32 */
+
 btc_loop_t *
 btc_loop_create(void) {
   btc_loop_t *loop = (btc_loop_t *)safe_malloc(sizeof(btc_loop_t));
@@ -1282,6 +1951,11 @@ btc_loop_create(void) {
   memset(loop, 0, sizeof(*loop));
 
 #if defined(BTC_USE_EPOLL)
+#ifdef BTC_USE_URING
+  /* Falls back to epoll if the kernel won't give us a ring. */
+  loop->ring = uring_create();
+#endif
+
   loop->fd = safe_epoll_create();
 
   CHECK(loop->fd != -1);
@@ -1289,19 +1963,45 @@ btc_loop_create(void) {
   /* nothing */
 #else
   FD_ZERO(&loop->fds);
+  FD_ZERO(&loop->wset);
 #endif
 
   btc_loop_grow(loop, 64);
 
+#ifndef _WIN32
+  btc_loop_open_wakeup(loop);
+#endif
+
+  btc_mutex_init(&loop->iobuf_lock);
+
   return loop;
 }
 
+#ifdef BTC_USE_URING
+static void
+uring_drain(btc_loop_t *loop);
+#endif
+
 void
 btc_loop_destroy(btc_loop_t *loop) {
   btc_link_t *it, *next;
 
   CHECK(loop->running == 0);
 
+#ifdef BTC_USE_URING
+  if (loop->ring != NULL) {
+    uring_drain(loop);
+    uring_destroy(loop->ring);
+  }
+#endif
+
+#ifndef _WIN32
+  close(loop->wake[0]);
+
+  if (loop->wake[1] != loop->wake[0])
+    close(loop->wake[1]);
+#endif
+
 #if defined(BTC_USE_EPOLL)
   CHECK(loop->fd != -1);
   close(loop->fd);
@@ -1316,6 +2016,23 @@ btc_loop_destroy(btc_loop_t *loop) {
     free(it->value);
   }
 
+  if (loop->timers != NULL)
+    free(loop->timers);
+
+  while (loop->chunks != NULL) {
+    chunk_t *chunk = loop->chunks;
+    loop->chunks = chunk->next;
+    free(chunk);
+  }
+
+  while (loop->iobufs != NULL) {
+    btc_iobuf_t *buf = loop->iobufs;
+    loop->iobufs = buf->next;
+    free(buf);
+  }
+
+  btc_mutex_destroy(&loop->iobuf_lock);
+
   free(loop);
 }
 
@@ -1347,45 +2064,422 @@ btc_loop_off_tick(btc_loop_t *loop, btc_loop_tick_cb *handler, void *data) {
   }
 }
 
+void
+btc_loop_wakeup(btc_loop_t *loop) {
+#ifdef _WIN32
+  (void)loop;
+#else
+  static const unsigned char one[8] = {1, 0, 0, 0, 0, 0, 0, 0};
+  int fd = loop->wake[1];
+
+  /* Async-signal-safe. A full pipe is already a pending wakeup. */
+  while (write(fd, one, sizeof(one)) == -1 && errno == EINTR)
+    ;
+#endif
+}
+
+/*
+ * Timer Heap
+ */
+
+static int
+timer_before(const btc_timer_t *x, const btc_timer_t *y) {
+  return x->deadline < y->deadline;
+}
+
+static void
+timer_swap(btc_loop_t *loop, size_t i, size_t j) {
+  btc_timer_t *x = loop->timers[i];
+  btc_timer_t *y = loop->timers[j];
+
+  loop->timers[i] = y;
+  loop->timers[j] = x;
+
+  y->index = i;
+  x->index = j;
+}
+
+static void
+timer_up(btc_loop_t *loop, size_t i) {
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+
+    if (!timer_before(loop->timers[i], loop->timers[parent]))
+      break;
+
+    timer_swap(loop, i, parent);
+
+    i = parent;
+  }
+}
+
+static void
+timer_down(btc_loop_t *loop, size_t i) {
+  size_t length = loop->timers_length;
+
+  for (;;) {
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    size_t min = i;
+
+    if (left < length && timer_before(loop->timers[left], loop->timers[min]))
+      min = left;
+
+    if (right < length && timer_before(loop->timers[right], loop->timers[min]))
+      min = right;
+
+    if (min == i)
+      break;
+
+    timer_swap(loop, i, min);
+
+    i = min;
+  }
+}
+
+static void
+timer_insert(btc_loop_t *loop, btc_timer_t *timer) {
+  if (loop->timers_length == loop->timers_alloc) {
+    size_t alloc = loop->timers_alloc < 8 ? 8 : loop->timers_alloc * 2;
+
+    loop->timers = safe_realloc(loop->timers, alloc,
+                                loop->timers_alloc,
+                                btc_timer_t *);
+
+    loop->timers_alloc = alloc;
+  }
+
+  timer->index = loop->timers_length;
+
+  loop->timers[loop->timers_length++] = timer;
+
+  timer_up(loop, timer->index);
+}
+
+static void
+timer_remove(btc_loop_t *loop, btc_timer_t *timer) {
+  size_t i = timer->index;
+  size_t last = loop->timers_length - 1;
+
+  CHECK(i <= last && loop->timers[i] == timer);
+
+  if (i != last) {
+    timer_swap(loop, i, last);
+
+    loop->timers_length--;
+
+    timer_down(loop, i);
+    timer_up(loop, i);
+  } else {
+    loop->timers_length--;
+  }
+
+  timer->index = (size_t)-1;
+}
+
+/*
+ * Timer
+ */
+
+btc_timer_t *
+btc_timer_create(btc_loop_t *loop, btc_timer_cb *handler, void *data) {
+  btc_timer_t *timer = (btc_timer_t *)safe_malloc(sizeof(btc_timer_t));
+
+  timer->loop = loop;
+  timer->handler = handler;
+  timer->data = data;
+  timer->deadline = 0;
+  timer->repeat = 0;
+  timer->index = (size_t)-1;
+
+  return timer;
+}
+
+void
+btc_timer_destroy(btc_timer_t *timer) {
+  btc_timer_stop(timer);
+  free(timer);
+}
+
+void
+btc_timer_start(btc_timer_t *timer, int64_t timeout, int64_t repeat) {
+  btc_loop_t *loop = timer->loop;
+
+  btc_timer_stop(timer);
+
+  if (timeout < 0)
+    timeout = 0;
+
+  if (repeat < 0)
+    repeat = 0;
+
+  timer->deadline = btc_time_msec() + timeout;
+  timer->repeat = repeat;
+
+  timer_insert(loop, timer);
+}
+
+void
+btc_timer_stop(btc_timer_t *timer) {
+  if (timer->index != (size_t)-1)
+    timer_remove(timer->loop, timer);
+}
+
+int
+btc_timer_active(const btc_timer_t *timer) {
+  return timer->index != (size_t)-1;
+}
+
+static int
+btc_loop_timeout(btc_loop_t *loop, int timeout) {
+  int64_t delta;
+
+  if (loop->deferred.length > 0 || loop->closed.length > 0)
+    return 0;
+
+  if (loop->timers_length == 0)
+    return timeout;
+
+  delta = loop->timers[0]->deadline - btc_time_msec();
+
+  if (delta < 0)
+    delta = 0;
+
+  if (timeout < 0 || delta < timeout)
+    timeout = delta > INT_MAX ? INT_MAX : (int)delta;
+
+  return timeout;
+}
+
 const char *
 btc_loop_strerror(btc_loop_t *loop) {
 #ifdef _WIN32
   DWORD version = GetVersion();
   DWORD result = 0;
 
-  /* Winsock error messages only available on Windows 2000 and up. */
-  /* See: https://tangentsoft.net/wskfaq/articles/history.html */
-  if (version < 0x80000000 && (version & 0xff) >= 5) {
-    WCHAR tmp[512];
+  /* Winsock error messages only available on Windows 2000 and up. */
+  /* See: https://tangentsoft.net/wskfaq/articles/history.html */
+  if (version < 0x80000000 && (version & 0xff) >= 5) {
+    WCHAR tmp[512];
+
+    result = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM |
+                            FORMAT_MESSAGE_IGNORE_INSERTS,
+                            NULL,
+                            loop->error,
+                            LANG_USER_DEFAULT,
+                            tmp,
+                            sizeof(tmp) / sizeof(tmp[0]),
+                            NULL);
+
+    if (result) {
+      result = WideCharToMultiByte(CP_UTF8,
+                                   0,
+                                   tmp,
+                                   -1,
+                                   loop->errmsg,
+                                   sizeof(loop->errmsg),
+                                   NULL,
+                                   NULL);
+    }
+  }
+
+  if (!result)
+    sprintf(loop->errmsg, "WSA Error: %d", loop->error);
+
+  return loop->errmsg;
+#else
+  return strerror(loop->error);
+#endif
+}
+
+#ifdef BTC_USE_URING
+static void
+uring_submit(btc_loop_t *loop, btc_socket_t *socket, int op, int fd) {
+  struct io_uring_sqe *sqe = uring_sqe(loop->ring);
+
+  sqe->fd = fd;
+  sqe->user_data = BTC_URING_DATA(socket, op);
+
+  switch (op) {
+    case BTC_URING_RECV: {
+      sqe->opcode = IORING_OP_RECV;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = 0;
+
+      if (!loop->ring->oneshot)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+
+      break;
+    }
+
+    case BTC_URING_ACCEPT: {
+      sqe->opcode = IORING_OP_ACCEPT;
+      sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+      if (!loop->ring->oneshot)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+
+      break;
+    }
+
+    case BTC_URING_POLLIN:
+    case BTC_URING_WAKE: {
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->poll32_events = POLLIN;
+      sqe->len = IORING_POLL_ADD_MULTI;
+      break;
+    }
+
+    case BTC_URING_POLLOUT: {
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->poll32_events = POLLOUT;
+      break;
+    }
+
+    case BTC_URING_SEND: {
+      size_t total = 0;
+      chunk_t *chunk;
+      int count = 0;
+
+      /* Everything queued since the last pass goes out in one sendmsg. */
+      for (chunk = socket->head; chunk != NULL; chunk = chunk->next) {
+        if (count == BTC_URING_IOV || total >= (1 << 30))
+          break;
+
+        socket->iov[count].iov_base = (void *)chunk->raw;
+        socket->iov[count].iov_len = BTC_MIN(chunk->len, 1 << 30);
+
+        total += socket->iov[count].iov_len;
+        count += 1;
+      }
+
+      memset(&socket->msg, 0, sizeof(socket->msg));
+
+      socket->msg.msg_iov = socket->iov;
+      socket->msg.msg_iovlen = count;
+
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->addr = (uint64_t)(uintptr_t)&socket->msg;
+      sqe->len = 1;
+      sqe->msg_flags = BTC_NOSIGNAL;
+
+      break;
+    }
+  }
+
+  if (socket != NULL)
+    socket->inflight |= BTC_URING_BIT(op);
+}
+
+static void
+uring_arm(btc_loop_t *loop, btc_socket_t *socket) {
+  int idle = ~socket->inflight;
+
+  switch (socket->state) {
+    case BTC_SOCKET_LISTENING: {
+      if (idle & BTC_URING_BIT(BTC_URING_ACCEPT))
+        uring_submit(loop, socket, BTC_URING_ACCEPT, socket->fd);
+      break;
+    }
+
+    case BTC_SOCKET_CONNECTING: {
+      if (idle & BTC_URING_BIT(BTC_URING_POLLOUT))
+        uring_submit(loop, socket, BTC_URING_POLLOUT, socket->fd);
+      break;
+    }
+
+    case BTC_SOCKET_CONNECTED: {
+      if (!socket->hangup && (idle & BTC_URING_BIT(BTC_URING_RECV)))
+        uring_submit(loop, socket, BTC_URING_RECV, socket->fd);
+
+      if (socket->head != NULL && (idle & BTC_URING_BIT(BTC_URING_SEND)))
+        uring_submit(loop, socket, BTC_URING_SEND, socket->fd);
+
+      break;
+    }
+
+    case BTC_SOCKET_BOUND: {
+      if (idle & BTC_URING_BIT(BTC_URING_POLLIN))
+        uring_submit(loop, socket, BTC_URING_POLLIN, socket->fd);
+
+      if (socket->head != NULL && (idle & BTC_URING_BIT(BTC_URING_POLLOUT)))
+        uring_submit(loop, socket, BTC_URING_POLLOUT, socket->fd);
+
+      break;
+    }
+  }
+}
+
+static void
+uring_cancel(btc_loop_t *loop, btc_socket_t *socket) {
+  btc_uring_t *ring = loop->ring;
+  int op;
+
+  if (btc_list_has(&ring->pending, &socket->pending))
+    btc_list_remove(&ring->pending, &socket->pending);
+
+  for (op = BTC_URING_RECV; op <= BTC_URING_SEND; op++) {
+    struct io_uring_sqe *sqe;
+
+    if (!(socket->inflight & BTC_URING_BIT(op)))
+      continue;
+
+    sqe = uring_sqe(ring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = BTC_URING_DATA(socket, op);
+    sqe->user_data = BTC_URING_CANCEL;
+  }
+}
+#endif
+
+static void
+btc_loop_rearm(btc_loop_t *loop, btc_socket_t *socket) {
+  int want = (socket->state == BTC_SOCKET_CONNECTING || socket->head != NULL);
+
+#ifdef BTC_USE_URING
+  /* Submissions are deferred until the next poll. */
+  if (loop->ring != NULL) {
+    btc_list_t *pending = &loop->ring->pending;
+
+    if (socket->polling == -1 || socket->state == BTC_SOCKET_DISCONNECTED)
+      return;
+
+    if (!btc_list_has(pending, &socket->pending))
+      btc_list_push(pending, &socket->pending);
+
+    return;
+  }
+#endif
+
+  /* Only poll for writability when there is something to write. */
+  if (socket->polling == -1 || socket->polling == want)
+    return;
+
+  if (socket->state == BTC_SOCKET_DISCONNECTED)
+    return;
+
+  socket->polling = want;
 
-    result = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM |
-                            FORMAT_MESSAGE_IGNORE_INSERTS,
-                            NULL,
-                            loop->error,
-                            LANG_USER_DEFAULT,
-                            tmp,
-                            sizeof(tmp) / sizeof(tmp[0]),
-                            NULL);
+  {
+#if defined(BTC_USE_EPOLL)
+    struct epoll_event ev;
 
-    if (result) {
-      result = WideCharToMultiByte(CP_UTF8,
-                                   0,
-                                   tmp,
-                                   -1,
-                                   loop->errmsg,
-                                   sizeof(loop->errmsg),
-                                   NULL,
-                                   NULL);
-    }
-  }
+    memset(&ev, 0, sizeof(ev));
 
-  if (!result)
-    sprintf(loop->errmsg, "WSA Error: %d", loop->error);
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.ptr = socket;
 
-  return loop->errmsg;
+    CHECK(epoll_ctl(loop->fd, EPOLL_CTL_MOD, socket->fd, &ev) == 0);
+#elif defined(BTC_USE_POLL)
+    loop->pfds[socket->index].events = POLLIN | (want ? POLLOUT : 0);
 #else
-  return strerror(loop->error);
+    if (want)
+      FD_SET(socket->fd, &loop->wset);
+    else
+      FD_CLR(socket->fd, &loop->wset);
 #endif
+  }
 }
 
 static int
@@ -1393,9 +2487,20 @@ btc_loop_register(btc_loop_t *loop, btc_socket_t *socket) {
 #if defined(BTC_USE_EPOLL)
   struct epoll_event ev;
 
+#ifdef BTC_USE_URING
+  if (loop->ring != NULL) {
+    socket->polling = 0;
+    btc_list_push(&loop->sockets, &socket->link);
+    btc_list_push(&loop->ring->pending, &socket->pending);
+    return 1;
+  }
+#endif
+
+  socket->polling = (socket->state == BTC_SOCKET_CONNECTING);
+
   memset(&ev, 0, sizeof(ev));
 
-  ev.events = EPOLLIN | EPOLLOUT;
+  ev.events = EPOLLIN | (socket->polling ? EPOLLOUT : 0);
   ev.data.ptr = socket;
 
   if (epoll_ctl(loop->fd, EPOLL_CTL_ADD, socket->fd, &ev) != 0)
@@ -1410,9 +2515,11 @@ btc_loop_register(btc_loop_t *loop, btc_socket_t *socket) {
   if (loop->length == loop->alloc)
     btc_loop_grow(loop, (loop->length * 3) / 2);
 
+  socket->polling = (socket->state == BTC_SOCKET_CONNECTING);
+
   pfd = &loop->pfds[loop->length];
   pfd->fd = socket->fd;
-  pfd->events = POLLIN | POLLOUT;
+  pfd->events = POLLIN | (socket->polling ? POLLOUT : 0);
   pfd->revents = 0;
 
   socket->index = loop->length;
@@ -1437,8 +2544,13 @@ btc_loop_register(btc_loop_t *loop, btc_socket_t *socket) {
     loop->nfds = socket->fd + 1;
 #endif
 
+  socket->polling = (socket->state == BTC_SOCKET_CONNECTING);
+
   FD_SET(socket->fd, &loop->fds);
 
+  if (socket->polling)
+    FD_SET(socket->fd, &loop->wset);
+
   btc_list_push(&loop->sockets, &socket->link);
 
   return 1;
@@ -1450,6 +2562,14 @@ btc_loop_unregister(btc_loop_t *loop, btc_socket_t *socket) {
 #if defined(BTC_USE_EPOLL)
   struct epoll_event ev;
 
+#ifdef BTC_USE_URING
+  if (loop->ring != NULL) {
+    uring_cancel(loop, socket);
+    btc_list_remove(&loop->sockets, &socket->link);
+    return;
+  }
+#endif
+
   memset(&ev, 0, sizeof(ev));
 
   if (epoll_ctl(loop->fd, EPOLL_CTL_DEL, socket->fd, &ev) != 0) {
@@ -1470,6 +2590,7 @@ btc_loop_unregister(btc_loop_t *loop, btc_socket_t *socket) {
   loop->length--;
 #else
   FD_CLR(socket->fd, &loop->fds);
+  FD_CLR(socket->fd, &loop->wset);
 
   btc_list_remove(&loop->sockets, &socket->link);
 #endif
@@ -1493,6 +2614,24 @@ fail:
   return NULL;
 }
 
+btc_socket_t *
+btc_loop_listen_unix(btc_loop_t *loop, const char *path) {
+  btc_socket_t *socket = btc_socket_create(loop);
+
+  if (!btc_socket_listen_unix(socket, path))
+    goto fail;
+
+  if (!btc_loop_register(loop, socket)) {
+    btc_closesocket(socket->fd);
+    goto fail;
+  }
+
+  return socket;
+fail:
+  btc_socket_destroy(socket);
+  return NULL;
+}
+
 btc_socket_t *
 btc_loop_connect(btc_loop_t *loop, const btc_sockaddr_t *addr) {
   btc_socket_t *socket = btc_socket_create(loop);
@@ -1516,6 +2655,29 @@ fail:
   return NULL;
 }
 
+btc_socket_t *
+btc_loop_connect_unix(btc_loop_t *loop, const char *path) {
+  btc_socket_t *socket = btc_socket_create(loop);
+
+  if (!btc_socket_connect_unix(socket, path))
+    goto fail;
+
+  if (!btc_loop_register(loop, socket)) {
+    btc_closesocket(socket->fd);
+    goto fail;
+  }
+
+  if (socket->state == BTC_SOCKET_CONNECTED) {
+    btc_list_push(&loop->deferred, &socket->deferred);
+    socket->state = BTC_SOCKET_CONNECTING;
+  }
+
+  return socket;
+fail:
+  btc_socket_destroy(socket);
+  return NULL;
+}
+
 btc_socket_t *
 btc_loop_bind(btc_loop_t *loop, const btc_sockaddr_t *addr) {
   btc_socket_t *socket = btc_socket_create(loop);
@@ -1552,6 +2714,39 @@ fail:
   return NULL;
 }
 
+void
+btc_socket_detach(btc_socket_t *socket) {
+  btc_loop_t *loop = socket->loop;
+
+  CHECK(socket->state == BTC_SOCKET_CONNECTED);
+  CHECK(socket->head == NULL);
+  CHECK(!btc_list_has(&loop->deferred, &socket->deferred));
+#ifdef BTC_USE_URING
+  /* Must happen before the next poll arms the socket. */
+  CHECK(socket->inflight == 0);
+#endif
+
+  btc_loop_unregister(loop, socket);
+
+  socket->loop = NULL;
+  socket->polling = -1;
+}
+
+int
+btc_loop_attach(btc_loop_t *loop, btc_socket_t *socket) {
+  CHECK(socket->loop == NULL);
+
+  socket->loop = loop;
+
+  if (!btc_loop_register(loop, socket)) {
+    btc_closesocket(socket->fd);
+    btc_socket_destroy(socket);
+    return 0;
+  }
+
+  return 1;
+}
+
 static void
 handle_read(btc_loop_t *loop, btc_socket_t *socket) {
   switch (socket->state) {
@@ -1705,6 +2900,34 @@ handle_deferred(btc_loop_t *loop) {
   }
 }
 
+static void
+handle_timers(btc_loop_t *loop) {
+  int64_t now = btc_time_msec();
+  size_t count = loop->timers_length;
+
+  /* Bounded so a zero-timeout timer cannot starve the loop. */
+  while (count-- > 0 && loop->timers_length > 0) {
+    btc_timer_t *timer = loop->timers[0];
+
+    if (timer->deadline > now)
+      break;
+
+    timer_remove(loop, timer);
+
+    if (timer->repeat > 0) {
+      timer->deadline += timer->repeat;
+
+      if (timer->deadline <= now)
+        timer->deadline = now + timer->repeat;
+
+      timer_insert(loop, timer);
+    }
+
+    /* May stop, restart or destroy the timer. */
+    timer->handler(timer->data);
+  }
+}
+
 static void
 handle_ticks(btc_loop_t *loop) {
   btc_link_t *it;
@@ -1732,14 +2955,218 @@ handle_closed(btc_loop_t *loop) {
   btc_list_init(&loop->closed);
 }
 
+#ifdef BTC_USE_URING
+static void
+uring_accept(btc_loop_t *loop, btc_socket_t *server, int fd) {
+  btc_socket_t *child = btc_socket_create(loop);
+  btc_socklen_t addrlen = sizeof(child->storage);
+
+  if (getpeername(fd, child->addr, &addrlen) != 0) {
+    close(fd);
+    goto fail;
+  }
+
+  child->fd = fd;
+  child->state = BTC_SOCKET_CONNECTED;
+
+  if (!btc_loop_register(loop, child)) {
+    close(fd);
+    goto fail;
+  }
+
+  server->on_socket(server, child);
+
+  return;
+fail:
+  btc_socket_destroy(child);
+}
+
+static void
+uring_complete(btc_loop_t *loop, const struct io_uring_cqe *cqe) {
+  btc_uring_t *ring = loop->ring;
+  int op = cqe->user_data & BTC_URING_MASK;
+  uintptr_t ptr = (uintptr_t)(cqe->user_data & ~(uint64_t)BTC_URING_MASK);
+  btc_socket_t *socket = (btc_socket_t *)ptr;
+  unsigned char *buf = NULL;
+  unsigned bid = 0;
+  int res = cqe->res;
+
+  if (op == BTC_URING_CANCEL)
+    return;
+
+  if (op == BTC_URING_WAKE) {
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+      ring->waking = 0;
+
+    btc_loop_drain_wakeup(loop);
+
+    return;
+  }
+
+  if (!(cqe->flags & IORING_CQE_F_MORE))
+    socket->inflight &= ~BTC_URING_BIT(op);
+
+  if (cqe->flags & IORING_CQE_F_BUFFER) {
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    buf = &ring->bufs[bid * BTC_URING_BUFSIZE];
+  }
+
+  if (res == -ECANCELED || res == -EINTR || res == -EAGAIN)
+    goto done;
+
+  /* Closed and awaiting (or past) its destruction. */
+  if (socket->state == BTC_SOCKET_DISCONNECTED) {
+    if (op == BTC_URING_ACCEPT && res >= 0)
+      close(res);
+
+    goto done;
+  }
+
+  switch (op) {
+    case BTC_URING_ACCEPT: {
+      if (res == -EINVAL && !ring->oneshot)
+        ring->oneshot = 1;
+      else if (res >= 0)
+        uring_accept(loop, socket, res);
+      break;
+    }
+
+    case BTC_URING_RECV: {
+      if (res == -ENOBUFS)
+        break;
+
+      if (res == -EINVAL && !ring->oneshot) {
+        ring->oneshot = 1;
+        break;
+      }
+
+      if (res < 0) {
+        loop->error = -res;
+        socket->on_error(socket);
+        break;
+      }
+
+      if (res == 0) {
+        socket->hangup = 1;
+        socket->on_data(socket, loop->buffer, 0);
+        break;
+      }
+
+      socket->on_data(socket, buf, res);
+
+      break;
+    }
+
+    case BTC_URING_POLLIN: {
+      if (res > 0)
+        handle_read(loop, socket);
+      break;
+    }
+
+    case BTC_URING_POLLOUT: {
+      if (res > 0)
+        handle_write(loop, socket);
+      break;
+    }
+
+    case BTC_URING_SEND: {
+      if (res < 0) {
+        loop->error = -res;
+        socket->on_error(socket);
+        break;
+      }
+
+      btc_socket_consume(socket, res);
+
+      if (btc_socket_flush_write(socket) == -1)
+        socket->on_error(socket);
+
+      break;
+    }
+  }
+
+done:
+  if (buf != NULL)
+    uring_provide(ring, bid);
+
+  if (socket->zombie) {
+    if (socket->inflight == 0) {
+      socket->zombie = 0;
+      ring->zombies--;
+      btc_socket_destroy(socket);
+    }
+  } else if (socket->loop == loop) {
+    btc_loop_rearm(loop, socket);
+  }
+}
+
+static void
+uring_reap(btc_loop_t *loop) {
+  btc_uring_t *ring = loop->ring;
+  unsigned head = *ring->cq_head;
+  unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  struct io_uring_cqe cqe;
+
+  while (head != tail) {
+    cqe = ring->cqes[head & ring->cq_mask];
+
+    /* Release the slot before running callbacks. */
+    __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+
+    uring_complete(loop, &cqe);
+  }
+}
+
+static void
+uring_flush(btc_loop_t *loop) {
+  btc_uring_t *ring = loop->ring;
+
+  if (!ring->waking) {
+    uring_submit(loop, NULL, BTC_URING_WAKE, loop->wake[0]);
+    ring->waking = 1;
+  }
+
+  while (ring->pending.length > 0) {
+    btc_link_t *it = btc_list_shift(&ring->pending);
+
+    uring_arm(loop, it->value);
+  }
+}
+
+static void
+uring_poll(btc_loop_t *loop, int timeout) {
+  handle_deferred(loop);
+
+  uring_flush(loop);
+
+  timeout = btc_loop_timeout(loop, timeout);
+
+  /* One syscall submits the whole pass and waits for completions. */
+  uring_enter(loop->ring, timeout != 0, timeout);
+
+  uring_reap(loop);
+
+  handle_timers(loop);
+  handle_ticks(loop);
+  handle_closed(loop);
+}
+
+static void
+uring_drain(btc_loop_t *loop) {
+  while (loop->ring->zombies > 0) {
+    uring_flush(loop);
+    uring_enter(loop->ring, 1, 100);
+    uring_reap(loop);
+  }
+}
+#endif
+
 void
 btc_loop_start(btc_loop_t *loop) {
   loop->running = 1;
 
-  while (loop->running) {
-    btc_loop_poll(loop, 25);
-    btc_time_sleep(1);
-  }
+  while (loop->running)
+    btc_loop_poll(loop, -1);
 
   btc_loop_close(loop);
 }
@@ -1747,6 +3174,7 @@ btc_loop_start(btc_loop_t *loop) {
 void
 btc_loop_stop(btc_loop_t *loop) {
   loop->running = 0;
+  btc_loop_wakeup(loop);
 }
 
 void
@@ -1761,8 +3189,17 @@ btc_loop_poll(btc_loop_t *loop, int timeout) {
 #if defined(BTC_USE_EPOLL)
   int i, count;
 
+#ifdef BTC_USE_URING
+  if (loop->ring != NULL) {
+    uring_poll(loop, timeout);
+    return;
+  }
+#endif
+
   handle_deferred(loop);
 
+  timeout = btc_loop_timeout(loop, timeout);
+
 retry:
   count = epoll_wait(loop->fd, loop->events, loop->max, timeout);
 
@@ -1777,6 +3214,11 @@ retry:
     struct epoll_event *ev = &loop->events[i];
     btc_socket_t *socket = ev->data.ptr;
 
+    if (socket == NULL) {
+      btc_loop_drain_wakeup(loop);
+      continue;
+    }
+
     if (ev->events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
       handle_write(loop, socket);
 
@@ -1787,6 +3229,7 @@ retry:
   if (count == loop->max)
     btc_loop_grow(loop, (count * 3) / 2);
 
+  handle_timers(loop);
   handle_ticks(loop);
   handle_closed(loop);
 #elif defined(BTC_USE_POLL)
@@ -1794,6 +3237,8 @@ retry:
 
   handle_deferred(loop);
 
+  timeout = btc_loop_timeout(loop, timeout);
+
 retry:
   count = poll(loop->pfds, loop->length, timeout);
 
@@ -1812,6 +3257,15 @@ retry:
       btc_socket_t *socket = loop->sockets[i];
       struct pollfd *pfd = &loop->pfds[i];
 
+      if (socket == NULL) {
+        if (pfd->revents != 0)
+          btc_loop_drain_wakeup(loop);
+
+        pfd->revents = 0;
+
+        continue;
+      }
+
       if (pfd->revents & POLLNVAL) {
         btc_socket_close(socket);
         continue;
@@ -1827,6 +3281,7 @@ retry:
     }
   }
 
+  handle_timers(loop);
   handle_ticks(loop);
   handle_closed(loop);
 #else /* BTC_USE_SELECT */
@@ -1836,9 +3291,17 @@ retry:
 
   handle_deferred(loop);
 
+#ifdef _WIN32
+  /* No wakeup descriptor. Poll for cross-thread events. */
+  if (timeout < 0 || timeout > 25)
+    timeout = 25;
+#endif
+
+  timeout = btc_loop_timeout(loop, timeout);
+
 retry:
   memcpy(&loop->rfds, &loop->fds, sizeof(loop->fds));
-  memcpy(&loop->wfds, &loop->fds, sizeof(loop->fds));
+  memcpy(&loop->wfds, &loop->wset, sizeof(loop->wset));
 #ifdef _WIN32
   memcpy(&loop->efds, &loop->fds, sizeof(loop->fds));
 #endif
@@ -1877,6 +3340,13 @@ retry:
 #endif
   }
 
+#ifndef _WIN32
+  if (count > 0 && FD_ISSET(loop->wake[0], &loop->rfds)) {
+    btc_loop_drain_wakeup(loop);
+    count--;
+  }
+#endif
+
   if (count > 0) {
     btc_link_t *tail = loop->sockets.tail;
     btc_link_t *it;
@@ -1900,6 +3370,7 @@ retry:
     }
   }
 
+  handle_timers(loop);
   handle_ticks(loop);
   handle_closed(loop);
 #endif /* BTC_USE_SELECT */
@@ -1912,7 +3383,7 @@ btc_loop_close(btc_loop_t *loop) {
 
   handle_deferred(loop);
 
-  for (i = 0; i < loop->length; i++)
+  for (i = 1; i < loop->length; i++)
     btc_socket_close(loop->sockets[i]);
 
   handle_closed(loop);
@@ -1926,8 +3397,13 @@ btc_loop_close(btc_loop_t *loop) {
 
   handle_closed(loop);
 
+#ifdef BTC_USE_URING
+  if (loop->ring != NULL)
+    uring_drain(loop);
+#endif
+
 #if defined(BTC_USE_SELECT) && !defined(_WIN32)
-  loop->nfds = 0;
+  loop->nfds = loop->wake[0] + 1;
 #endif
 #endif /* !BTC_USE_POLL */
 }
@@ -1977,10 +3453,8 @@ btc_server_on_close(btc_socket_t *socket) {
   btc_list_remove(&server->sockets, &socket->listener);
 }
 
-int
-btc_server_listen(btc_server_t *server, const btc_sockaddr_t *addr) {
-  btc_socket_t *socket = btc_loop_listen(server->loop, addr);
-
+static int
+btc_server_attach(btc_server_t *server, btc_socket_t *socket) {
   if (socket == NULL)
     return 0;
 
@@ -2001,6 +3475,16 @@ btc_server_listen(btc_server_t *server, const btc_sockaddr_t *addr) {
   return 1;
 }
 
+int
+btc_server_listen(btc_server_t *server, const btc_sockaddr_t *addr) {
+  return btc_server_attach(server, btc_loop_listen(server->loop, addr));
+}
+
+int
+btc_server_listen_unix(btc_server_t *server, const char *path) {
+  return btc_server_attach(server, btc_loop_listen_unix(server->loop, path));
+}
+
 int
 btc_server_listen_local(btc_server_t *server, int port) {
   btc_sockaddr_t addr;
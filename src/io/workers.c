@@ -115,7 +115,7 @@ btc_workq_concat(btc_workq_t *z, btc_workq_t *x) {
     z->tail = x->tail;
   } else {
     z->tail->next = x->head;
-    z->tail = x->head;
+    z->tail = x->tail;
   }
 
   z->length += x->length;
@@ -213,33 +213,33 @@ json_stack_new(const btc_stack_t *stack) {
   return obj;
 }
 
-static json_value *
-json_script_type_new(const btc_script_t *script) {
+static const char *
+json_script_type(const btc_script_t *script) {
   if (btc_script_is_p2pk(script))
-    return json_string_new("pubkey");
+    return "pubkey";
 
   if (btc_script_is_p2pkh(script))
-    return json_string_new("pubkeyhash");
+    return "pubkeyhash";
 
   if (btc_script_is_p2sh(script))
-    return json_string_new("scripthash");
+    return "scripthash";
 
   if (btc_script_is_multisig(script))
-    return json_string_new("multisig");
+    return "multisig";
 
   if (btc_script_is_nulldata(script))
-    return json_string_new("nulldata");
+    return "nulldata";
 
   if (btc_script_is_p2wpkh(script))
-    return json_string_new("witness_v0_keyhash");
+    return "witness_v0_keyhash";
 
   if (btc_script_is_p2wsh(script))
-    return json_string_new("witness_v0_scripthash");
+    return "witness_v0_scripthash";
 
   if (btc_script_is_program(script))
-    return json_string_new("witness_unknown");
+    return "witness_unknown";
 
-  return json_string_new("nonstandard");
+  return "nonstandard";
 }
 
 static json_value *
@@ -280,7 +280,7 @@ json_script_new(const btc_script_t *script, const btc_network_t *network) {
   if (has_addr)
     json_object_push(obj, "address", json_address_new(&addr, network));
 
-  json_object_push(obj, "type", json_script_type_new(script));
+  json_object_push(obj, "type", json_string_new(json_script_type(script)));
 
   return obj;
 }
@@ -577,6 +577,264 @@ json_block_new_ex(const btc_block_t *block,
   return obj;
 }
 
+/*
+ * JSON Streams
+ */
+
+static void
+json_stack_write(json_writer *w, const btc_stack_t *stack) {
+  size_t i;
+
+  json_write_array(w);
+
+  for (i = 0; i < stack->length; i++) {
+    const btc_buffer_t *item = stack->items[i];
+
+    json_write_hex(w, item->data, item->length);
+  }
+
+  json_write_array_end(w);
+}
+
+static void
+json_script_asm_write(json_writer *w, const btc_script_t *script) {
+  char *str = btc_script_asm(script);
+
+  json_write_string(w, str);
+
+  btc_free(str);
+}
+
+static void
+json_scriptsig_write(json_writer *w, const btc_script_t *script) {
+  json_write_object(w);
+  json_write_key(w, "asm");
+  json_script_asm_write(w, script);
+  json_write_key(w, "hex");
+  json_write_hex(w, script->data, script->length);
+  json_write_object_end(w);
+}
+
+static void
+json_script_write(json_writer *w,
+                  const btc_script_t *script,
+                  const btc_network_t *network) {
+  btc_address_t addr;
+
+  json_write_object(w);
+  json_write_key(w, "asm");
+  json_script_asm_write(w, script);
+  json_write_key(w, "hex");
+  json_write_hex(w, script->data, script->length);
+
+  if (btc_address_set_script(&addr, script)) {
+    char str[BTC_ADDRESS_MAXLEN + 1];
+
+    btc_address_get_str(str, &addr, network);
+
+    json_write_key(w, "address");
+    json_write_string(w, str);
+  }
+
+  json_write_key(w, "type");
+  json_write_string(w, json_script_type(script));
+  json_write_object_end(w);
+}
+
+static void
+json_coin_write(json_writer *w,
+                const btc_coin_t *coin,
+                const btc_network_t *network) {
+  json_write_object(w);
+  json_write_key(w, "generated");
+  json_write_boolean(w, coin->coinbase);
+  json_write_key(w, "height");
+  json_write_integer(w, coin->height);
+  json_write_key(w, "value");
+  json_write_amount(w, coin->output.value);
+  json_write_key(w, "scriptPubKey");
+  json_script_write(w, &coin->output.script, network);
+  json_write_object_end(w);
+}
+
+static void
+json_input_write(json_writer *w,
+                 const btc_input_t *input,
+                 const btc_view_t *view,
+                 const btc_network_t *network) {
+  const btc_coin_t *coin = NULL;
+
+  if (view != NULL)
+    coin = btc_view_get(view, &input->prevout);
+
+  json_write_object(w);
+
+  if (btc_outpoint_is_null(&input->prevout)) {
+    json_write_key(w, "coinbase");
+    json_write_hex(w, input->script.data, input->script.length);
+  } else {
+    json_write_key(w, "txid");
+    json_write_hash(w, input->prevout.hash);
+    json_write_key(w, "vout");
+    json_write_integer(w, input->prevout.index);
+    json_write_key(w, "scriptSig");
+    json_scriptsig_write(w, &input->script);
+  }
+
+  if (input->witness.length > 0) {
+    json_write_key(w, "txinwitness");
+    json_stack_write(w, &input->witness);
+  }
+
+  if (coin != NULL) {
+    json_write_key(w, "prevout");
+    json_coin_write(w, coin, network);
+  }
+
+  json_write_key(w, "sequence");
+  json_write_integer(w, input->sequence);
+  json_write_object_end(w);
+}
+
+static void
+json_output_write(json_writer *w,
+                  const btc_output_t *output,
+                  size_t index,
+                  const btc_network_t *network) {
+  json_write_object(w);
+  json_write_key(w, "value");
+  json_write_amount(w, output->value);
+  json_write_key(w, "scriptPubKey");
+  json_script_write(w, &output->script, network);
+  json_write_key(w, "n");
+  json_write_integer(w, index);
+  json_write_object_end(w);
+}
+
+void
+json_tx_write(json_writer *w,
+              const btc_tx_t *tx,
+              const btc_view_t *view,
+              const btc_network_t *network) {
+  size_t base = btc_tx_base_size(tx);
+  size_t wit = btc_tx_witness_size(tx);
+  size_t size = base + wit;
+  size_t weight = (base * BTC_WITNESS_SCALE_FACTOR) + wit;
+  size_t vsize = weight;
+  size_t i;
+
+  vsize += (BTC_WITNESS_SCALE_FACTOR - 1);
+  vsize /= BTC_WITNESS_SCALE_FACTOR;
+
+  json_write_object(w);
+  json_write_key(w, "txid");
+  json_write_hash(w, tx->hash);
+  json_write_key(w, "hash");
+  json_write_hash(w, tx->whash);
+  json_write_key(w, "version");
+  json_write_integer(w, tx->version);
+  json_write_key(w, "size");
+  json_write_integer(w, size);
+  json_write_key(w, "vsize");
+  json_write_integer(w, vsize);
+  json_write_key(w, "weight");
+  json_write_integer(w, weight);
+  json_write_key(w, "locktime");
+  json_write_integer(w, tx->locktime);
+
+  if (view != NULL) {
+    int64_t fee = btc_tx_fee(tx, view);
+
+    if (fee != -1) {
+      json_write_key(w, "fee");
+      json_write_amount(w, fee);
+    }
+  }
+
+  json_write_key(w, "vin");
+  json_write_array(w);
+
+  for (i = 0; i < tx->inputs.length; i++)
+    json_input_write(w, tx->inputs.items[i], view, network);
+
+  json_write_array_end(w);
+
+  json_write_key(w, "vout");
+  json_write_array(w);
+
+  for (i = 0; i < tx->outputs.length; i++)
+    json_output_write(w, tx->outputs.items[i], i, network);
+
+  json_write_array_end(w);
+  json_write_object_end(w);
+}
+
+void
+json_block_write(json_writer *w,
+                 const btc_block_t *block,
+                 const btc_entry_t *entry,
+                 const btc_view_t *view,
+                 int confirmations,
+                 const uint8_t *next,
+                 int details,
+                 const btc_network_t *network) {
+  const btc_header_t *hdr = &entry->header;
+  size_t base = btc_block_base_size(block);
+  size_t wit = btc_block_witness_size(block);
+  size_t size = base + wit;
+  size_t weight = (base * BTC_WITNESS_SCALE_FACTOR) + wit;
+  size_t i;
+
+  json_write_object(w);
+  json_write_key(w, "hash");
+  json_write_hash(w, entry->hash);
+  json_write_key(w, "height");
+  json_write_integer(w, entry->height);
+  json_write_key(w, "version");
+  json_write_integer(w, hdr->version);
+  json_write_key(w, "previousblockhash");
+  json_write_hash(w, hdr->prev_block);
+  json_write_key(w, "merkleroot");
+  json_write_hash(w, hdr->merkle_root);
+  json_write_key(w, "time");
+  json_write_integer(w, hdr->time);
+  json_write_key(w, "bits");
+  json_write_integer(w, hdr->bits);
+  json_write_key(w, "nonce");
+  json_write_integer(w, hdr->nonce);
+  json_write_key(w, "chainwork");
+  json_write_hash(w, entry->chainwork);
+  json_write_key(w, "mediantime");
+  json_write_integer(w, btc_entry_median_time(entry));
+  json_write_key(w, "difficulty");
+  json_write_double(w, btc_difficulty(hdr->bits));
+  json_write_key(w, "confirmations");
+  json_write_integer(w, confirmations);
+  json_write_key(w, "nextblockhash");
+  json_write_hash(w, next);
+  json_write_key(w, "strippedsize");
+  json_write_integer(w, base);
+  json_write_key(w, "size");
+  json_write_integer(w, size);
+  json_write_key(w, "weight");
+  json_write_integer(w, weight);
+  json_write_key(w, "nTx");
+  json_write_integer(w, block->txs.length);
+  json_write_key(w, "tx");
+  json_write_array(w);
+
+  if (details) {
+    for (i = 0; i < block->txs.length; i++)
+      json_tx_write(w, block->txs.items[i], view, network);
+  } else {
+    for (i = 0; i < block->txs.length; i++)
+      json_write_hash(w, block->txs.items[i]->hash);
+  }
+
+  json_write_array_end(w);
+  json_write_object_end(w);
+}
+
 /*
  * Hexification
  */
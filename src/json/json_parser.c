@@ -209,6 +209,37 @@ static int new_value (json_state * state,
    return 1;
 }
 
+/* Length of the run of plain string bytes at `ptr`, eight at a time:
+ * a word is skipped whole unless it holds a quote, backslash or NUL.
+ */
+#define json_ones UINT64_C(0x0101010101010101)
+#define json_high UINT64_C(0x8080808080808080)
+#define json_has_zero(v) (((v) - json_ones) & ~(v) & json_high)
+
+static size_t scan_plain (const json_char * ptr, const json_char * end)
+{
+   const json_char * start = ptr;
+   uint64_t w;
+
+   while (end - ptr >= 8)
+   {
+      memcpy (&w, ptr, 8);
+
+      if (json_has_zero (w) | json_has_zero (w ^ (json_ones * '"'))
+                            | json_has_zero (w ^ (json_ones * '\\')))
+      {
+         break;
+      }
+
+      ptr += 8;
+   }
+
+   while (ptr < end && *ptr != '"' && *ptr != '\\' && *ptr != 0)
+      ++ ptr;
+
+   return ptr - start;
+}
+
 #define whitespace \
    case '\n': ++ state.cur_line;  state.cur_col = 0; /* FALLTHRU */ \
    case ' ': /* FALLTHRU */ case '\t': /* FALLTHRU */ case '\r'
@@ -445,7 +476,17 @@ json_value * json_parse_ex (json_settings * settings,
             }
             else
             {
-               string_add (b);
+               size_t run = scan_plain (state.ptr, end);
+
+               if (run > state.uint_max - string_length)
+                  goto e_overflow;
+
+               if (!state.first_pass)
+                  memcpy (string + string_length, state.ptr, run);
+
+               string_length += run;
+               state.ptr += run - 1;
+
                continue;
             }
          }
@@ -0,0 +1,467 @@
+/*!
+ * json_writer.c - streaming json writer for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mako/encoding.h>
+#include <mako/json.h>
+
+/*
+ * Constants
+ */
+
+#define JSON_CHUNK_MIN (1 << 10)
+#define JSON_CHUNK_MAX (64 << 10)
+
+/*
+ * Helpers
+ */
+
+static void *
+json_malloc(size_t size) {
+  void *ptr = malloc(size);
+
+  if (ptr == NULL)
+    abort(); /* LCOV_EXCL_LINE */
+
+  return ptr;
+}
+
+/*
+ * Chunk
+ */
+
+static json_chunk *
+json_chunk_create(size_t size) {
+  json_chunk *chunk = json_malloc(sizeof(json_chunk));
+
+  chunk->data = json_malloc(size);
+  chunk->length = 0;
+  chunk->size = size;
+  chunk->next = NULL;
+
+  return chunk;
+}
+
+static void
+json_chunk_destroy(json_chunk *chunk) {
+  free(chunk->data);
+  free(chunk);
+}
+
+/*
+ * Writer
+ */
+
+void
+json_writer_init(json_writer *w) {
+  w->head = NULL;
+  w->tail = NULL;
+  w->total = 0;
+  w->comma = 0;
+}
+
+void
+json_writer_clear(json_writer *w) {
+  json_chunk *chunk, *next;
+
+  for (chunk = w->head; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    json_chunk_destroy(chunk);
+  }
+
+  json_writer_init(w);
+}
+
+json_writer *
+json_writer_create(void) {
+  json_writer *w = json_malloc(sizeof(json_writer));
+  json_writer_init(w);
+  return w;
+}
+
+void
+json_writer_destroy(json_writer *w) {
+  json_writer_clear(w);
+  free(w);
+}
+
+static char *
+json_writer_reserve(json_writer *w, size_t size) {
+  json_chunk *chunk = w->tail;
+
+  if (chunk == NULL || chunk->size - chunk->length < size) {
+    /* Start small and double up to the maximum so
+       that short responses don't pin large buffers. */
+    size_t want = w->total;
+
+    if (want < JSON_CHUNK_MIN)
+      want = JSON_CHUNK_MIN;
+
+    if (want > JSON_CHUNK_MAX)
+      want = JSON_CHUNK_MAX;
+
+    chunk = json_chunk_create(size > want ? size : want);
+
+    if (w->tail == NULL)
+      w->head = chunk;
+    else
+      w->tail->next = chunk;
+
+    w->tail = chunk;
+  }
+
+  return chunk->data + chunk->length;
+}
+
+static void
+json_writer_advance(json_writer *w, size_t size) {
+  w->tail->length += size;
+  w->total += size;
+}
+
+static void
+json_writer_put(json_writer *w, int ch) {
+  char *zp = json_writer_reserve(w, 1);
+
+  *zp = ch;
+
+  json_writer_advance(w, 1);
+}
+
+static void
+json_writer_sep(json_writer *w) {
+  if (w->comma)
+    json_writer_put(w, ',');
+
+  w->comma = 1;
+}
+
+void
+json_writer_concat(json_writer *z, json_writer *x) {
+  /* Splices `x` in as a single value; no copying. */
+  if (x->head == NULL) {
+    json_write_null(z);
+    return;
+  }
+
+  json_writer_sep(z);
+
+  if (z->tail == NULL)
+    z->head = x->head;
+  else
+    z->tail->next = x->head;
+
+  z->tail = x->tail;
+  z->total += x->total;
+
+  json_writer_init(x);
+}
+
+int
+json_writer_shift(json_writer *w, char **data, size_t *length) {
+  json_chunk *chunk = w->head;
+
+  if (chunk == NULL)
+    return 0;
+
+  w->head = chunk->next;
+
+  if (w->head == NULL)
+    w->tail = NULL;
+
+  w->total -= chunk->length;
+
+  *data = chunk->data;
+  *length = chunk->length;
+
+  free(chunk);
+
+  return 1;
+}
+
+char *
+json_writer_encode(json_writer *w, size_t *length) {
+  char *zp = json_malloc(w->total + 1);
+  size_t zn = 0;
+  json_chunk *chunk;
+
+  for (chunk = w->head; chunk != NULL; chunk = chunk->next) {
+    memcpy(zp + zn, chunk->data, chunk->length);
+    zn += chunk->length;
+  }
+
+  zp[zn] = '\0';
+
+  if (length != NULL)
+    *length = zn;
+
+  json_writer_clear(w);
+
+  return zp;
+}
+
+/*
+ * Values
+ */
+
+void
+json_write_data(json_writer *w, const char *xp, size_t xn) {
+  char *zp = json_writer_reserve(w, xn);
+
+  memcpy(zp, xp, xn);
+
+  json_writer_advance(w, xn);
+}
+
+void
+json_write_object(json_writer *w) {
+  json_writer_sep(w);
+  json_writer_put(w, '{');
+  w->comma = 0;
+}
+
+void
+json_write_object_end(json_writer *w) {
+  json_writer_put(w, '}');
+  w->comma = 1;
+}
+
+void
+json_write_array(json_writer *w) {
+  json_writer_sep(w);
+  json_writer_put(w, '[');
+  w->comma = 0;
+}
+
+void
+json_write_array_end(json_writer *w) {
+  json_writer_put(w, ']');
+  w->comma = 1;
+}
+
+void
+json_write_key(json_writer *w, const char *key) {
+  json_write_string(w, key);
+  json_writer_put(w, ':');
+  w->comma = 0;
+}
+
+void
+json_write_string(json_writer *w, const char *str) {
+  json_write_string_length(w, str, strlen(str));
+}
+
+void
+json_write_string_length(json_writer *w, const char *str, size_t len) {
+  char *zp, *sp;
+  size_t i;
+
+  json_writer_sep(w);
+
+  zp = json_writer_reserve(w, len * 2 + 2);
+  sp = zp;
+
+  *zp++ = '"';
+
+  /* Same escaping as json-builder's serializer. */
+  for (i = 0; i < len; i++) {
+    int ch = str[i];
+
+    switch (ch) {
+      case '"': *zp++ = '\\'; *zp++ = '"'; break;
+      case '\\': *zp++ = '\\'; *zp++ = '\\'; break;
+      case '\b': *zp++ = '\\'; *zp++ = 'b'; break;
+      case '\f': *zp++ = '\\'; *zp++ = 'f'; break;
+      case '\n': *zp++ = '\\'; *zp++ = 'n'; break;
+      case '\r': *zp++ = '\\'; *zp++ = 'r'; break;
+      case '\t': *zp++ = '\\'; *zp++ = 't'; break;
+      default: *zp++ = ch; break;
+    }
+  }
+
+  *zp++ = '"';
+
+  json_writer_advance(w, zp - sp);
+}
+
+static size_t
+json_format_u64(char *zp, uint64_t x) {
+  char tmp[20];
+  size_t i = 0;
+  size_t j;
+
+  do {
+    tmp[i++] = '0' + (x % 10);
+    x /= 10;
+  } while (x != 0);
+
+  for (j = 0; j < i; j++)
+    zp[j] = tmp[i - j - 1];
+
+  return i;
+}
+
+void
+json_write_integer(json_writer *w, int64_t x) {
+  char *zp, *sp;
+
+  json_writer_sep(w);
+
+  zp = json_writer_reserve(w, 21);
+  sp = zp;
+
+  if (x < 0) {
+    *zp++ = '-';
+    zp += json_format_u64(zp, -(uint64_t)x);
+  } else {
+    zp += json_format_u64(zp, x);
+  }
+
+  json_writer_advance(w, zp - sp);
+}
+
+void
+json_write_amount(json_writer *w, int64_t x) {
+  uint64_t hi, lo;
+  char *zp, *sp;
+  int i;
+
+  json_writer_sep(w);
+
+  zp = json_writer_reserve(w, 30);
+  sp = zp;
+
+  if (x < 0) {
+    *zp++ = '-';
+    hi = -(uint64_t)x;
+  } else {
+    hi = x;
+  }
+
+  lo = hi % 100000000;
+  hi = hi / 100000000;
+
+  zp += json_format_u64(zp, hi);
+
+  if (lo != 0) {
+    *zp++ = '.';
+
+    for (i = 7; i >= 0; i--) {
+      zp[i] = '0' + (lo % 10);
+      lo /= 10;
+    }
+
+    zp += 8;
+
+    while (zp[-1] == '0')
+      zp--;
+  }
+
+  json_writer_advance(w, zp - sp);
+}
+
+void
+json_write_double(json_writer *w, double x) {
+  char tmp[512];
+  char *dot;
+  int len;
+
+  json_writer_sep(w);
+
+  len = sprintf(tmp, "%.g", x);
+
+  if ((dot = strchr(tmp, ',')) != NULL) {
+    *dot = '.';
+  } else if (!strchr(tmp, '.') && !strchr(tmp, 'e')) {
+    tmp[len++] = '.';
+    tmp[len++] = '0';
+  }
+
+  json_write_data(w, tmp, len);
+}
+
+void
+json_write_boolean(json_writer *w, int x) {
+  json_writer_sep(w);
+
+  if (x)
+    json_write_data(w, "true", 4);
+  else
+    json_write_data(w, "false", 5);
+}
+
+void
+json_write_null(json_writer *w) {
+  json_writer_sep(w);
+  json_write_data(w, "null", 4);
+}
+
+void
+json_write_hex(json_writer *w, const uint8_t *xp, size_t xn) {
+  char *zp;
+
+  json_writer_sep(w);
+
+  /* Room for the terminator written by the encoder. */
+  zp = json_writer_reserve(w, xn * 2 + 3);
+
+  *zp++ = '"';
+
+  btc_base16_encode(zp, xp, xn);
+
+  zp[xn * 2] = '"';
+
+  json_writer_advance(w, xn * 2 + 2);
+}
+
+void
+json_write_hash(json_writer *w, const uint8_t *hash) {
+  char *zp;
+
+  if (hash == NULL) {
+    json_write_null(w);
+    return;
+  }
+
+  json_writer_sep(w);
+
+  /* Room for the terminator written by the encoder. */
+  zp = json_writer_reserve(w, 64 + 3);
+
+  *zp++ = '"';
+
+  btc_base16le_encode(zp, hash, 32);
+
+  zp[64] = '"';
+
+  json_writer_advance(w, 64 + 2);
+}
+
+void
+json_write_value(json_writer *w, json_value *value) {
+  /* Note: json_measure includes the null terminator and
+     may overestimate (doubles), so advance by what was
+     actually written. */
+  size_t len;
+  char *zp;
+
+  if (value == NULL) {
+    json_write_null(w);
+    return;
+  }
+
+  json_writer_sep(w);
+
+  len = json_measure(value);
+  zp = json_writer_reserve(w, len);
+
+  json_serialize(zp, value);
+
+  json_writer_advance(w, strlen(zp));
+}
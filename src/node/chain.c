@@ -2067,6 +2067,29 @@ btc_chain_coin(btc_chain_t *chain, const uint8_t *hash, size_t index) {
   return btc_chaindb_coin(chain->db, hash, index);
 }
 
+const btc_snapshot_t *
+btc_chain_snapshot(btc_chain_t *chain) {
+  return btc_chaindb_snapshot(chain->db);
+}
+
+void
+btc_chain_release(btc_chain_t *chain, const btc_snapshot_t *snapshot) {
+  btc_chaindb_release(chain->db, snapshot);
+}
+
+btc_coin_t *
+btc_chain_coin_at(btc_chain_t *chain,
+                  const btc_snapshot_t *snapshot,
+                  const uint8_t *hash,
+                  size_t index) {
+  return btc_chaindb_coin_at(chain->db, snapshot, hash, index);
+}
+
+btc_coin_t *
+btc_chain_tx_coin(btc_chain_t *chain, const uint8_t *hash) {
+  return btc_chaindb_tx_coin(chain->db, hash);
+}
+
 int
 btc_chain_get_coins(btc_chain_t *chain,
                     btc_view_t *view,
@@ -2087,6 +2110,14 @@ btc_chain_get_raw_block(btc_chain_t *chain,
   return btc_chaindb_get_raw_block(chain->db, data, length, entry);
 }
 
+int
+btc_chain_get_block_data(btc_chain_t *chain,
+                         uint8_t **data,
+                         size_t *length,
+                         const btc_entry_t *entry) {
+  return btc_chaindb_get_block_data(chain->db, data, length, entry);
+}
+
 btc_view_t *
 btc_chain_get_undo(btc_chain_t *chain,
                    const btc_entry_t *entry,
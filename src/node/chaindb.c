@@ -37,6 +37,7 @@
  */
 
 #define MAX_FILE_SIZE (128 << 20)
+#define MAX_READ_FILES 8
 #define BLOCK_FILE 0
 #define UNDO_FILE 1
 
@@ -288,6 +289,15 @@ btc_chainfile_update(btc_chainfile_t *z, const btc_entry_t *entry) {
  * Chain Database
  */
 
+typedef struct btc_readfile_s {
+  int type;
+  int id;
+  btc_fd_t fd;
+  int refs;
+  int dead;
+  uint64_t used;
+} btc_readfile_t;
+
 struct btc_chaindb_s {
   const btc_network_t *network;
   char prefix[BTC_PATH_MAX - 31];
@@ -307,6 +317,9 @@ struct btc_chaindb_s {
   btc_chainfile_t block;
   btc_chainfile_t undo;
   uint8_t *slab;
+  btc_mutex_t read_lock;
+  btc_readfile_t reads[MAX_READ_FILES];
+  uint64_t read_tick;
 };
 
 static void
@@ -322,6 +335,8 @@ btc_chaindb_path(btc_chaindb_t *db, char *path, int type, int id) {
 
 static void
 btc_chaindb_init(btc_chaindb_t *db, const btc_network_t *network) {
+  int i;
+
   memset(db, 0, sizeof(*db));
 
   db->network = network;
@@ -333,10 +348,23 @@ btc_chaindb_init(btc_chaindb_t *db, const btc_network_t *network) {
   btc_vector_init(&db->heights);
 
   db->slab = (uint8_t *)btc_malloc(24 + BTC_MAX_RAW_BLOCK_SIZE);
+
+  btc_mutex_init(&db->read_lock);
+
+  for (i = 0; i < MAX_READ_FILES; i++)
+    db->reads[i].fd = BTC_INVALID_FD;
 }
 
 static void
 btc_chaindb_clear(btc_chaindb_t *db) {
+  int i;
+
+  for (i = 0; i < MAX_READ_FILES; i++) {
+    if (db->reads[i].fd != BTC_INVALID_FD)
+      btc_fs_close(db->reads[i].fd);
+  }
+
+  btc_mutex_destroy(&db->read_lock);
   btc_hashmap_clear(&db->hashes);
   btc_vector_clear(&db->heights);
   btc_free(db->slab);
@@ -678,9 +706,28 @@ btc_chaindb_close(btc_chaindb_t *db) {
   btc_chaindb_unload_database(db);
 }
 
+const btc_snapshot_t *
+btc_chaindb_snapshot(btc_chaindb_t *db) {
+  return (const btc_snapshot_t *)ldb_snapshot(db->lsm);
+}
+
+void
+btc_chaindb_release(btc_chaindb_t *db, const btc_snapshot_t *snapshot) {
+  ldb_release(db->lsm, (const ldb_snapshot_t *)snapshot);
+}
+
 btc_coin_t *
 btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
+  return btc_chaindb_coin_at(db, NULL, hash, index);
+}
+
+btc_coin_t *
+btc_chaindb_coin_at(btc_chaindb_t *db,
+                    const btc_snapshot_t *snapshot,
+                    const uint8_t *hash,
+                    size_t index) {
   uint8_t kbuf[COIN_KEYLEN];
+  ldb_readopt_t opt = *ldb_readopt_default;
   ldb_slice_t key, val;
   btc_coin_t *coin;
   int rc;
@@ -688,7 +735,10 @@ btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
   key.data = kbuf;
   key.size = coin_key(kbuf, hash, index);
 
-  rc = ldb_get(db->lsm, &key, &val, 0);
+  /* Safe to call off the main thread with a snapshot. */
+  opt.snapshot = (const ldb_snapshot_t *)snapshot;
+
+  rc = ldb_get(db->lsm, &key, &val, &opt);
 
   if (rc == LDB_NOTFOUND)
     return NULL;
@@ -707,6 +757,41 @@ btc_chaindb_coin(btc_chaindb_t *db, const uint8_t *hash, size_t index) {
   return coin;
 }
 
+btc_coin_t *
+btc_chaindb_tx_coin(btc_chaindb_t *db, const uint8_t *hash) {
+  uint8_t kbuf[COIN_KEYLEN];
+  btc_coin_t *coin = NULL;
+  ldb_slice_t key, val;
+  ldb_iter_t *it;
+
+  key.data = kbuf;
+  key.size = coin_key(kbuf, hash, 0);
+
+  /* Coin keys sort by txid, so the first key
+     at or after output zero is the lowest unspent
+     output of this transaction (if any). */
+  it = ldb_iterator(db->lsm, 0);
+
+  ldb_iter_seek(it, &key);
+
+  if (ldb_iter_valid(it)) {
+    key = ldb_iter_key(it);
+
+    if (key.size == COIN_KEYLEN && memcmp(key.data, kbuf, 33) == 0) {
+      val = ldb_iter_value(it);
+      coin = btc_coin_create();
+
+      CHECK(btc_coin_import(coin, val.data, val.size));
+    }
+  }
+
+  CHECK(ldb_iter_status(it) == LDB_OK);
+
+  ldb_iter_destroy(it);
+
+  return coin;
+}
+
 static btc_coin_t *
 read_coin(const btc_outpoint_t *prevout, void *arg) {
   return btc_chaindb_coin(arg, prevout->hash, prevout->index);
@@ -762,31 +847,138 @@ btc_chaindb_save_view(btc_chaindb_t *db,
   }
 }
 
+/* Block and undo reads come from worker threads as well as
+   the loop thread. Recently used files stay open and are
+   read with pread(2) so that a handle can be shared. */
+static btc_readfile_t *
+btc_chaindb_file_get(btc_chaindb_t *db, int type, int id) {
+  btc_readfile_t *slot = NULL;
+  char path[BTC_PATH_MAX];
+  int i;
+
+  btc_mutex_lock(&db->read_lock);
+
+  for (i = 0; i < MAX_READ_FILES; i++) {
+    btc_readfile_t *item = &db->reads[i];
+
+    if (item->fd == BTC_INVALID_FD || item->dead)
+      continue;
+
+    if (item->type == type && item->id == id) {
+      slot = item;
+      goto done;
+    }
+  }
+
+  for (i = 0; i < MAX_READ_FILES; i++) {
+    btc_readfile_t *item = &db->reads[i];
+
+    if (item->refs > 0)
+      continue;
+
+    if (slot == NULL || item->fd == BTC_INVALID_FD || item->used < slot->used)
+      slot = item;
+
+    if (item->fd == BTC_INVALID_FD)
+      break;
+  }
+
+  if (slot == NULL)
+    goto done;
+
+  if (slot->fd != BTC_INVALID_FD)
+    btc_fs_close(slot->fd);
+
+  btc_chaindb_path(db, path, type, id);
+
+  slot->type = type;
+  slot->id = id;
+  slot->fd = btc_fs_open(path);
+  slot->dead = 0;
+
+  if (slot->fd == BTC_INVALID_FD)
+    slot = NULL;
+
+done:
+  if (slot != NULL) {
+    slot->refs++;
+    slot->used = ++db->read_tick;
+  }
+
+  btc_mutex_unlock(&db->read_lock);
+
+  return slot;
+}
+
+static void
+btc_chaindb_file_put(btc_chaindb_t *db, btc_readfile_t *slot) {
+  btc_mutex_lock(&db->read_lock);
+
+  if (--slot->refs == 0 && slot->dead) {
+    btc_fs_close(slot->fd);
+    slot->fd = BTC_INVALID_FD;
+    slot->dead = 0;
+  }
+
+  btc_mutex_unlock(&db->read_lock);
+}
+
+static void
+btc_chaindb_file_evict(btc_chaindb_t *db, int type, int id) {
+  int i;
+
+  btc_mutex_lock(&db->read_lock);
+
+  for (i = 0; i < MAX_READ_FILES; i++) {
+    btc_readfile_t *item = &db->reads[i];
+
+    if (item->fd == BTC_INVALID_FD)
+      continue;
+
+    if (item->type != type || item->id != id)
+      continue;
+
+    if (item->refs > 0) {
+      item->dead = 1;
+    } else {
+      btc_fs_close(item->fd);
+      item->fd = BTC_INVALID_FD;
+    }
+  }
+
+  btc_mutex_unlock(&db->read_lock);
+}
+
 static int
 btc_chaindb_read(btc_chaindb_t *db,
                  uint8_t **raw,
                  size_t *len,
                  int type,
                  int id,
-                 int pos) {
-  char path[BTC_PATH_MAX];
+                 int pos,
+                 int framed) {
+  btc_readfile_t *slot = btc_chaindb_file_get(db, type, id);
+  size_t off = framed ? 24 : 0;
   uint8_t *data = NULL;
   uint8_t hdr[24];
   size_t size;
   int ret = 0;
   btc_fd_t fd;
 
-  btc_chaindb_path(db, path, type, id);
+  if (slot != NULL) {
+    fd = slot->fd;
+  } else {
+    char path[BTC_PATH_MAX];
 
-  fd = btc_fs_open(path);
+    btc_chaindb_path(db, path, type, id);
 
-  if (fd == BTC_INVALID_FD)
-    return 0;
+    fd = btc_fs_open(path);
 
-  if (btc_fs_seek(fd, pos) != pos)
-    goto fail;
+    if (fd == BTC_INVALID_FD)
+      return 0;
+  }
 
-  if (btc_fs_read(fd, hdr, 24) != 24)
+  if (btc_fs_pread(fd, hdr, 24, pos) != 24)
     goto fail;
 
   size = btc_read32le(hdr + 16);
@@ -794,19 +986,19 @@ btc_chaindb_read(btc_chaindb_t *db,
   if (size > (64 << 20))
     goto fail;
 
-  size += 24;
-  data = (uint8_t *)malloc(size);
+  data = (uint8_t *)malloc(off + size);
 
   if (data == NULL)
     goto fail;
 
-  memcpy(data, hdr, 24);
+  if (framed)
+    memcpy(data, hdr, 24);
 
-  if ((size_t)btc_fs_read(fd, data + 24, size - 24) != size - 24)
+  if ((size_t)btc_fs_pread(fd, data + off, size, pos + 24) != size)
     goto fail;
 
   *raw = data;
-  *len = size;
+  *len = off + size;
 
   data = NULL;
   ret = 1;
@@ -814,7 +1006,10 @@ fail:
   if (data != NULL)
     free(data);
 
-  btc_fs_close(fd);
+  if (slot != NULL)
+    btc_chaindb_file_put(db, slot);
+  else
+    btc_fs_close(fd);
 
   return ret;
 }
@@ -829,11 +1024,11 @@ btc_chaindb_read_block(btc_chaindb_t *db, const btc_entry_t *entry) {
     return NULL;
 
   if (!btc_chaindb_read(db, &buf, &len, BLOCK_FILE, entry->block_file,
-                                                    entry->block_pos)) {
+                                                    entry->block_pos, 0)) {
     return NULL;
   }
 
-  block = btc_block_decode(buf + 24, len - 24);
+  block = btc_block_decode(buf, len);
 
   free(buf);
 
@@ -850,11 +1045,11 @@ btc_chaindb_read_undo(btc_chaindb_t *db, const btc_entry_t *entry) {
     return btc_undo_create();
 
   if (!btc_chaindb_read(db, &buf, &len, UNDO_FILE, entry->undo_file,
-                                                   entry->undo_pos)) {
+                                                   entry->undo_pos, 0)) {
     return NULL;
   }
 
-  undo = btc_undo_decode(buf + 24, len - 24);
+  undo = btc_undo_decode(buf, len);
 
   free(buf);
 
@@ -1061,6 +1256,7 @@ btc_chaindb_prune_files(btc_chaindb_t *db,
     ldb_batch_del(batch, &key);
 
     btc_chaindb_path(db, path, file->type, file->id);
+    btc_chaindb_file_evict(db, file->type, file->id);
 
     btc_fs_unlink(path);
 
@@ -1428,8 +1624,19 @@ btc_chaindb_get_raw_block(btc_chaindb_t *db,
     return 0;
 
   return btc_chaindb_read(db, data, length, BLOCK_FILE, entry->block_file,
-                                                        entry->block_pos);
+                                                        entry->block_pos, 1);
+}
+
+int
+btc_chaindb_get_block_data(btc_chaindb_t *db,
+                           uint8_t **data,
+                           size_t *length,
+                           const btc_entry_t *entry) {
+  if (entry->block_pos == -1)
+    return 0;
 
+  return btc_chaindb_read(db, data, length, BLOCK_FILE, entry->block_file,
+                                                        entry->block_pos, 0);
 }
 
 btc_view_t *
@@ -13,9 +13,12 @@
 
 #include <node/chain.h>
 #include <base/logger.h>
+#include <node/mempool.h>
 #include <node/node.h>
 #include <node/pool.h>
+#include <node/notifier.h>
 #include <node/rpc.h>
+#include <node/stratum.h>
 
 #include <base/config.h>
 #include <mako/netaddr.h>
@@ -47,8 +50,13 @@ static const char *node_args[] = {
   "-loglevel=",
   "-maxconnections=",
   "-maxinbound=",
+  "-maxmempool=",
   "-maxoutbound=",
+  "-maxuploadtarget=",
   "-networkactive=",
+  "-netthreads=",
+  "-notify=",
+  "-notifyport=",
   "-onion=",
   "-onlynet=",
   "-par=",
@@ -57,11 +65,17 @@ static const char *node_args[] = {
   "-port=",
   "-proxy=",
   "-prune=",
+  "-rest=",
   "-rpcbind=",
   "-rpcconnect=",
+  "-rpcmaxconnections=",
   "-rpcpassword=",
   "-rpcport=",
+  "-rpcservertimeout=",
+  "-rpcthreads=",
   "-rpcuser=",
+  "-stratumdifficulty=",
+  "-stratumport=",
   "-testnet",
   "-upnp=",
   "-version"
@@ -102,6 +116,9 @@ set_config(btc_node_t *node, const btc_conf_t *conf) {
   btc_chain_set_threads(node->chain, conf->workers);
   btc_chain_set_cache(node->chain, (size_t)conf->cache_size << 20);
 
+  btc_mempool_set_threads(node->mempool, conf->workers);
+  btc_mempool_set_limit(node->mempool, (size_t)conf->mempool_size * 1000000);
+
   btc_pool_set_port(node->pool, conf->port);
 
   for (i = 0; i < conf->bind.length; i++)
@@ -118,13 +135,27 @@ set_config(btc_node_t *node, const btc_conf_t *conf) {
   btc_pool_set_maxoutbound(node->pool, conf->max_outbound);
   btc_pool_set_bantime(node->pool, conf->ban_time);
   btc_pool_set_onlynet(node->pool, conf->only_net);
+  btc_pool_set_threads(node->pool, conf->net_threads);
+  btc_pool_set_maxupload(node->pool, (uint64_t)conf->max_upload << 20);
 
   btc_rpc_set_port(node->rpc, conf->rpc_port);
 
   for (i = 0; i < conf->rpc_bind.length; i++)
     btc_rpc_set_bind(node->rpc, conf->rpc_bind.items[i]);
 
+  if (*conf->rpc_path != '\0')
+    btc_rpc_set_path(node->rpc, conf->rpc_path);
+
   btc_rpc_set_credentials(node->rpc, conf->rpc_user, conf->rpc_pass);
+  btc_rpc_set_threads(node->rpc, conf->rpc_threads);
+  btc_rpc_set_max_connections(node->rpc, conf->rpc_max_connections);
+  btc_rpc_set_timeout(node->rpc, conf->rpc_timeout);
+
+  btc_notifier_set_path(node->notifier, conf->notify);
+  btc_notifier_set_port(node->notifier, conf->notify_port);
+
+  btc_stratum_set_port(node->stratum, conf->stratum_port);
+  btc_stratum_set_difficulty(node->stratum, conf->stratum_difficulty);
 }
 
 static unsigned int
@@ -170,6 +201,9 @@ get_node_flags(const btc_conf_t *conf) {
   if (conf->bip157)
     flags |= BTC_POOL_BIP157;
 
+  if (conf->rest)
+    flags |= BTC_RPC_REST;
+
   return flags;
 }
 
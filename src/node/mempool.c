@@ -9,12 +9,14 @@
 #include <string.h>
 
 #include <io/core.h>
+#include <io/workers.h>
 
 #include <node/chain.h>
 #include <base/logger.h>
 #include <node/mempool.h>
 #include <base/timedata.h>
 
+#include <mako/bip152.h>
 #include <mako/block.h>
 #include <mako/bloom.h>
 #include <mako/coins.h>
@@ -24,6 +26,7 @@
 #include <mako/entry.h>
 #include <mako/header.h>
 #include <mako/heap.h>
+#include <mako/list.h>
 #include <mako/map.h>
 #include <mako/netmsg.h>
 #include <mako/network.h>
@@ -36,6 +39,66 @@
 #include "../impl.h"
 #include "../internal.h"
 
+/*
+ * Memory Usage
+ */
+
+/* Approximates the footprint of a heap allocation
+   (malloc header plus 16 byte alignment). */
+static size_t
+malloc_usage(size_t size) {
+  if (size == 0)
+    return 0;
+
+  if (sizeof(void *) == 8)
+    return ((size + 31) >> 4) << 4;
+
+  return ((size + 15) >> 3) << 3;
+}
+
+#define map_usage(map) (malloc_usage((map)->n_buckets * sizeof(*(map)->keys)) \
+                      + malloc_usage((map)->n_buckets * sizeof(*(map)->vals)) \
+                      + malloc_usage((((map)->n_buckets >> 4) + 1) * 4))
+
+static size_t
+stack_usage(const btc_stack_t *stack) {
+  size_t usage = malloc_usage(stack->alloc * sizeof(btc_buffer_t *));
+  size_t i;
+
+  for (i = 0; i < stack->length; i++) {
+    usage += malloc_usage(sizeof(btc_buffer_t));
+    usage += malloc_usage(stack->items[i]->alloc);
+  }
+
+  return usage;
+}
+
+static size_t
+tx_usage(const btc_tx_t *tx) {
+  size_t usage = malloc_usage(sizeof(btc_tx_t));
+  size_t i;
+
+  usage += malloc_usage(tx->inputs.alloc * sizeof(btc_input_t *));
+  usage += malloc_usage(tx->outputs.alloc * sizeof(btc_output_t *));
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+
+    usage += malloc_usage(sizeof(btc_input_t));
+    usage += malloc_usage(input->script.alloc);
+    usage += stack_usage(&input->witness);
+  }
+
+  for (i = 0; i < tx->outputs.length; i++) {
+    const btc_output_t *output = tx->outputs.items[i];
+
+    usage += malloc_usage(sizeof(btc_output_t));
+    usage += malloc_usage(output->script.alloc);
+  }
+
+  return usage;
+}
+
 /*
  * Orphan Transaction
  */
@@ -67,6 +130,11 @@ btc_orphan_copy(btc_orphan_t *z, const btc_orphan_t *x) {
   *z = *x;
 }
 
+static size_t
+btc_orphan_usage(const btc_orphan_t *orphan) {
+  return malloc_usage(sizeof(btc_orphan_t)) + tx_usage(orphan->tx);
+}
+
 /**
  * Mempool Entry
  */
@@ -88,6 +156,7 @@ btc_mpentry_init(btc_mpentry_t *entry) {
   entry->locks = 0;
   entry->desc_fee = 0;
   entry->desc_size = 0;
+  entry->_index = 0;
 }
 
 static void
@@ -113,6 +182,7 @@ btc_mpentry_copy(btc_mpentry_t *z, const btc_mpentry_t *x) {
   z->locks = x->locks;
   z->desc_fee = x->desc_fee;
   z->desc_size = x->desc_size;
+  z->_index = x->_index;
 }
 
 static void
@@ -156,6 +226,11 @@ btc_mpentry_set(btc_mpentry_t *entry,
   entry->desc_size = size;
 }
 
+static size_t
+btc_mpentry_usage(const btc_mpentry_t *entry) {
+  return malloc_usage(sizeof(btc_mpentry_t)) + tx_usage(entry->tx);
+}
+
 static size_t
 btc_mpentry_size(const btc_mpentry_t *x) {
   return btc_tx_size(x->tx) + 30;
@@ -208,6 +283,136 @@ btc_mpentry_read(btc_mpentry_t *z, const uint8_t **xp, size_t *xn) {
   return 1;
 }
 
+/*
+ * Pending Transaction
+ */
+
+typedef struct btc_mpjob_s {
+  btc_mpentry_t *entry;
+  btc_view_t *view;
+  const btc_entry_t *tip;
+  unsigned int id;
+  int result;
+  struct btc_mpjob_s *next;
+} btc_mpjob_t;
+
+typedef struct btc_mpqueue_s {
+  btc_mpjob_t *head;
+  btc_mpjob_t *tail;
+  size_t length;
+} btc_mpqueue_t;
+
+static btc_mpjob_t *
+btc_mpjob_create(btc_mpentry_t *entry,
+                 btc_view_t *view,
+                 const btc_entry_t *tip,
+                 unsigned int id) {
+  btc_mpjob_t *job = (btc_mpjob_t *)btc_malloc(sizeof(btc_mpjob_t));
+
+  job->entry = entry;
+  job->view = view;
+  job->tip = tip;
+  job->id = id;
+  job->result = -1;
+  job->next = NULL;
+
+  return job;
+}
+
+static void
+btc_mpjob_destroy(btc_mpjob_t *job) {
+  if (job->entry != NULL)
+    btc_mpentry_destroy(job->entry);
+
+  if (job->view != NULL)
+    btc_view_destroy(job->view);
+
+  btc_free(job);
+}
+
+static void
+btc_mpjob_work(void *arg) {
+  btc_mpjob_t *job = arg;
+  unsigned int flags = BTC_SCRIPT_STANDARD_VERIFY_FLAGS;
+
+  job->result = btc_tx_verify(job->entry->tx, job->view, flags);
+}
+
+/*
+ * Short ID Index
+ */
+
+typedef struct btc_mpindex_s {
+  uint8_t *hashes;
+  uint8_t *whashes;
+  btc_tx_t **txs;
+  size_t alloc;
+  size_t length;
+} btc_mpindex_t;
+
+static void
+btc_mpindex_init(btc_mpindex_t *z) {
+  z->hashes = NULL;
+  z->whashes = NULL;
+  z->txs = NULL;
+  z->alloc = 0;
+  z->length = 0;
+}
+
+static void
+btc_mpindex_clear(btc_mpindex_t *z) {
+  if (z->alloc > 0) {
+    btc_free(z->hashes);
+    btc_free(z->whashes);
+    btc_free(z->txs);
+  }
+
+  btc_mpindex_init(z);
+}
+
+static void
+btc_mpindex_set(btc_mpindex_t *z, size_t index, btc_tx_t *tx) {
+  memcpy(z->hashes + index * 32, tx->hash, 32);
+  memcpy(z->whashes + index * 32, tx->whash, 32);
+
+  z->txs[index] = tx;
+}
+
+static size_t
+btc_mpindex_push(btc_mpindex_t *z, btc_tx_t *tx) {
+  if (z->length == z->alloc) {
+    size_t alloc = z->alloc == 0 ? 64 : z->alloc * 2;
+
+    z->hashes = (uint8_t *)btc_realloc(z->hashes, alloc * 32);
+    z->whashes = (uint8_t *)btc_realloc(z->whashes, alloc * 32);
+    z->txs = (btc_tx_t **)btc_realloc(z->txs, alloc * sizeof(btc_tx_t *));
+    z->alloc = alloc;
+  }
+
+  btc_mpindex_set(z, z->length, tx);
+
+  return z->length++;
+}
+
+static btc_tx_t *
+btc_mpindex_remove(btc_mpindex_t *z, size_t index) {
+  /* Swap the last item into the hole. Returns
+     the moved transaction (if any) so the caller
+     can update its position. */
+  size_t last;
+
+  CHECK(index < z->length);
+
+  last = --z->length;
+
+  if (index == last)
+    return NULL;
+
+  btc_mpindex_set(z, index, z->txs[last]);
+
+  return z->txs[index];
+}
+
 /*
  * Mempool
  */
@@ -218,16 +423,31 @@ struct btc_mempool_s {
   const btc_timedata_t *timedata;
   btc_chain_t *chain;
   size_t size;
+  size_t usage;
+  size_t limit;
+  uint32_t sequence;
   btc_hashmap_t map;
   btc_hashmap_t waiting;
   btc_hashmap_t orphans;
   btc_outmap_t spents;
   btc_filter_t rejects;
+  btc_hashmap_t pending;
+  btc_mpqueue_t queue;
+  btc_vector_t disconnected;
+  btc_hashset_t confirmed;
+  btc_mpindex_t index;
+  btc_mpindex_t extra;
+  size_t extra_head;
+  int32_t reorg_height;
+  int64_t reorg_time;
+  btc_workers_t *workers;
+  int threads;
   btc_verify_error_t error;
   unsigned int flags;
   char file[BTC_PATH_MAX];
   btc_mempool_tx_cb *on_tx;
   btc_mempool_badorphan_cb *on_badorphan;
+  btc_mempool_reject_cb *on_reject;
   void *arg;
 };
 
@@ -246,19 +466,65 @@ btc_mempool_create(const btc_network_t *network, btc_chain_t *chain) {
   btc_hashmap_init(&mp->waiting); /* orphan prevout hashes */
   btc_hashmap_init(&mp->orphans);
   btc_outmap_init(&mp->spents); /* mempool entry's outpoints */
-
+  btc_hashmap_init(&mp->pending); /* awaiting script verification */
+  btc_queue_init(&mp->queue);
+  btc_vector_init(&mp->disconnected); /* blocks awaiting re-admission */
+  btc_hashset_init(&mp->confirmed); /* txs connected mid-reorg */
+  btc_mpindex_init(&mp->index); /* contiguous (w)txids for bip152 */
+  btc_mpindex_init(&mp->extra); /* evicted and orphaned txs for bip152 */
+
+  mp->limit = BTC_MEMPOOL_MAX_SIZE;
+  mp->reorg_height = -1;
+  mp->reorg_time = -1;
   mp->flags = BTC_MEMPOOL_DEFAULT_FLAGS;
   mp->file[0] = '\0';
 
   btc_filter_init(&mp->rejects);
   btc_filter_set(&mp->rejects, 120000, 0.000001);
 
+  btc_mempool_set_threads(mp, 0);
+
   return mp;
 }
 
+static void
+btc_mempool_reset_reorg(btc_mempool_t *mp) {
+  btc_mapiter_t it;
+  size_t i;
+
+  for (i = 0; i < mp->disconnected.length; i++)
+    btc_block_destroy(mp->disconnected.items[i]);
+
+  btc_map_each(&mp->confirmed, it)
+    btc_free(mp->confirmed.keys[it]);
+
+  btc_vector_reset(&mp->disconnected);
+  btc_hashset_reset(&mp->confirmed);
+
+  mp->reorg_height = -1;
+  mp->reorg_time = -1;
+}
+
+static void
+btc_mempool_drop_pending(btc_mempool_t *mp) {
+  btc_mpjob_t *job, *next;
+
+  for (job = mp->queue.head; job != NULL; job = next) {
+    next = job->next;
+    btc_mpjob_destroy(job);
+  }
+
+  btc_queue_reset(&mp->queue);
+  btc_hashmap_reset(&mp->pending);
+}
+
 void
 btc_mempool_destroy(btc_mempool_t *mp) {
   btc_mapiter_t it;
+  size_t i;
+
+  btc_mempool_drop_pending(mp);
+  btc_mempool_reset_reorg(mp);
 
   btc_map_each(&mp->map, it)
     btc_mpentry_destroy(mp->map.vals[it]);
@@ -271,10 +537,18 @@ btc_mempool_destroy(btc_mempool_t *mp) {
   btc_map_each(&mp->orphans, it)
     btc_orphan_destroy(mp->orphans.vals[it]);
 
+  for (i = 0; i < mp->extra.length; i++)
+    btc_tx_destroy(mp->extra.txs[i]);
+
   btc_hashmap_clear(&mp->map);
   btc_hashmap_clear(&mp->waiting);
   btc_hashmap_clear(&mp->orphans);
   btc_outmap_clear(&mp->spents);
+  btc_hashmap_clear(&mp->pending);
+  btc_vector_clear(&mp->disconnected);
+  btc_hashset_clear(&mp->confirmed);
+  btc_mpindex_clear(&mp->index);
+  btc_mpindex_clear(&mp->extra);
   btc_filter_clear(&mp->rejects);
 
   btc_free(mp);
@@ -290,6 +564,30 @@ btc_mempool_set_timedata(btc_mempool_t *mp, const btc_timedata_t *td) {
   mp->timedata = td;
 }
 
+void
+btc_mempool_set_threads(btc_mempool_t *mp, int threads) {
+  if (threads <= 0) {
+    int num = btc_sys_numcpu();
+
+    if (num < 1)
+      num = 1;
+
+    threads += num;
+  }
+
+  if (threads <= 1)
+    threads = 0;
+  else if (threads > 16)
+    threads = 16;
+
+  mp->threads = threads;
+}
+
+void
+btc_mempool_set_limit(btc_mempool_t *mp, size_t limit) {
+  mp->limit = limit;
+}
+
 void
 btc_mempool_on_tx(btc_mempool_t *mp, btc_mempool_tx_cb *handler) {
   mp->on_tx = handler;
@@ -301,6 +599,11 @@ btc_mempool_on_badorphan(btc_mempool_t *mp,
   mp->on_badorphan = handler;
 }
 
+void
+btc_mempool_on_reject(btc_mempool_t *mp, btc_mempool_reject_cb *handler) {
+  mp->on_reject = handler;
+}
+
 void
 btc_mempool_set_context(btc_mempool_t *mp, void *arg) {
   mp->arg = arg;
@@ -319,12 +622,25 @@ btc_mempool_open(btc_mempool_t *mp, const char *prefix, unsigned int flags) {
 
   btc_log_info(mp, "Opening mempool.");
 
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+  if (mp->threads > 0)
+    mp->workers = btc_workers_create(mp->threads, BTC_MEMPOOL_MAX_PENDING);
+#endif
+
   return 1;
 }
 
 void
 btc_mempool_close(btc_mempool_t *mp) {
   btc_log_info(mp, "Closing mempool.");
+
+  btc_mempool_drop_pending(mp);
+  btc_mempool_reset_reorg(mp);
+
+  if (mp->workers != NULL) {
+    btc_workers_destroy(mp->workers);
+    mp->workers = NULL;
+  }
 }
 
 static int
@@ -363,6 +679,24 @@ btc_mempool_throw(btc_mempool_t *mp,
  * Orphan Handling
  */
 
+static void
+btc_mempool_add_extra(btc_mempool_t *mp, btc_tx_t *tx) {
+  /* Ring buffer of recently evicted transactions. These
+     may still show up in a block (e.g. a competing block,
+     or a miner with a different policy). */
+  btc_mpindex_t *extra = &mp->extra;
+
+  if (extra->length < BTC_MEMPOOL_MAX_EXTRA) {
+    btc_mpindex_push(extra, btc_tx_ref(tx));
+    return;
+  }
+
+  btc_tx_destroy(extra->txs[mp->extra_head]);
+  btc_mpindex_set(extra, mp->extra_head, btc_tx_ref(tx));
+
+  mp->extra_head = (mp->extra_head + 1) % BTC_MEMPOOL_MAX_EXTRA;
+}
+
 static int
 btc_mempool_remove_orphan(btc_mempool_t *mp, const uint8_t *hash) {
   btc_orphan_t *orphan = btc_hashmap_get(&mp->orphans, hash);
@@ -391,6 +725,7 @@ btc_mempool_remove_orphan(btc_mempool_t *mp, const uint8_t *hash) {
   }
 
   btc_hashmap_del(&mp->orphans, hash);
+
   btc_orphan_destroy(orphan);
 
   return 1;
@@ -527,6 +862,8 @@ btc_mempool_add_orphan(btc_mempool_t *mp,
 
   CHECK(btc_hashmap_put(&mp->orphans, orphan->hash, orphan));
 
+  btc_mempool_add_extra(mp, orphan->tx);
+
   btc_log_debug(mp, "Added orphan %H to mempool.", tx->hash);
 }
 
@@ -610,9 +947,8 @@ btc_mempool_handle_orphans(btc_mempool_t *mp, const uint8_t *parent) {
  * UTXO Handling
  */
 
-btc_view_t *
-btc_mempool_view(btc_mempool_t *mp, const btc_tx_t *tx) {
-  btc_view_t *view = btc_view_create();
+static void
+btc_mempool_fill_view(btc_mempool_t *mp, btc_view_t *view, const btc_tx_t *tx) {
   size_t i;
 
   for (i = 0; i < tx->inputs.length; i++) {
@@ -627,12 +963,22 @@ btc_mempool_view(btc_mempool_t *mp, const btc_tx_t *tx) {
     if (prevout->index >= parent->tx->outputs.length)
       continue;
 
+    if (btc_view_has(view, prevout))
+      continue;
+
     coin = btc_tx_coin(parent->tx, prevout->index, -1);
 
     btc_view_put(view, prevout, coin);
   }
 
   btc_chain_get_coins(mp->chain, view, tx);
+}
+
+btc_view_t *
+btc_mempool_view(btc_mempool_t *mp, const btc_tx_t *tx) {
+  btc_view_t *view = btc_view_create();
+
+  btc_mempool_fill_view(mp, view, tx);
 
   return view;
 }
@@ -729,6 +1075,9 @@ btc_mempool_exists(btc_mempool_t *mp, const uint8_t *hash) {
   if (btc_hashmap_has(&mp->orphans, hash))
     return 1;
 
+  if (btc_hashmap_has(&mp->pending, hash))
+    return 1;
+
   return btc_hashmap_has(&mp->map, hash);
 }
 
@@ -754,6 +1103,8 @@ btc_mempool_track_entry(btc_mempool_t *mp, btc_mpentry_t *entry) {
   CHECK(!btc_tx_is_coinbase(tx));
   CHECK(btc_hashmap_put(&mp->map, entry->hash, entry));
 
+  entry->_index = btc_mpindex_push(&mp->index, entry->tx);
+
   for (i = 0; i < tx->inputs.length; i++) {
     const btc_input_t *input = tx->inputs.items[i];
 
@@ -761,6 +1112,8 @@ btc_mempool_track_entry(btc_mempool_t *mp, btc_mpentry_t *entry) {
   }
 
   mp->size += entry->size;
+  mp->usage += btc_mpentry_usage(entry);
+  mp->sequence++;
 }
 
 static void
@@ -783,11 +1136,22 @@ static void
 btc_mempool_untrack_entry(btc_mempool_t *mp,
                           const btc_mpentry_t *entry) {
   const btc_tx_t *tx = entry->tx;
+  btc_tx_t *moved;
   size_t i;
 
   CHECK(!btc_tx_is_coinbase(tx));
   CHECK(btc_hashmap_del(&mp->map, entry->hash));
 
+  moved = btc_mpindex_remove(&mp->index, entry->_index);
+
+  if (moved != NULL) {
+    btc_mpentry_t *last = btc_hashmap_get(&mp->map, moved->hash);
+
+    CHECK(last != NULL);
+
+    last->_index = entry->_index;
+  }
+
   for (i = 0; i < tx->inputs.length; i++) {
     const btc_input_t *input = tx->inputs.items[i];
 
@@ -795,6 +1159,8 @@ btc_mempool_untrack_entry(btc_mempool_t *mp,
   }
 
   mp->size -= entry->size;
+  mp->usage -= btc_mpentry_usage(entry);
+  mp->sequence++;
 }
 
 static void
@@ -819,6 +1185,7 @@ btc_mempool_remove_spenders(btc_mempool_t *mp,
       continue;
 
     btc_mempool_remove_spenders(mp, spender);
+    btc_mempool_add_extra(mp, spender->tx);
     btc_mempool_remove_entry(mp, spender);
   }
 }
@@ -827,6 +1194,7 @@ static void
 btc_mempool_evict_entry(btc_mempool_t *mp, btc_mpentry_t *entry) {
   btc_mempool_remove_spenders(mp, entry);
   btc_mempool_update_ancestors(mp, entry, remove_fee);
+  btc_mempool_add_extra(mp, entry->tx);
   btc_mempool_remove_entry(mp, entry);
 }
 
@@ -862,6 +1230,55 @@ btc_mempool_has_dependencies(btc_mempool_t *mp, const btc_tx_t *tx) {
   return 0;
 }
 
+static size_t
+btc_mempool_pool_usage(btc_mempool_t *mp) {
+  /* Entries are tracked as they come and go. Table
+     and index overhead is cheap enough to compute. */
+  size_t usage = mp->usage;
+
+  usage += map_usage(&mp->map);
+  usage += map_usage(&mp->spents);
+  usage += 2 * malloc_usage(mp->index.alloc * 32);
+  usage += malloc_usage(mp->index.alloc * sizeof(btc_tx_t *));
+
+  return usage;
+}
+
+static size_t
+btc_mempool_extra_usage(btc_mempool_t *mp) {
+  /* The extra ring usually shares its txs with an
+     orphan or a pool entry. Charge those only once. */
+  const btc_mpindex_t *extra = &mp->extra;
+  size_t usage = 0;
+  btc_mapiter_t it;
+  size_t i;
+
+  btc_map_each(&mp->orphans, it)
+    usage += btc_orphan_usage(mp->orphans.vals[it]);
+
+  for (i = 0; i < extra->length; i++) {
+    const btc_tx_t *tx = extra->txs[i];
+    const btc_orphan_t *orphan = btc_hashmap_get(&mp->orphans, tx->hash);
+    const btc_mpentry_t *entry = btc_hashmap_get(&mp->map, tx->hash);
+
+    if (orphan != NULL && orphan->tx == tx)
+      continue;
+
+    if (entry != NULL && entry->tx == tx)
+      continue;
+
+    usage += tx_usage(tx);
+  }
+
+  usage += map_usage(&mp->waiting);
+  usage += map_usage(&mp->orphans);
+  usage += map_usage(&mp->pending);
+  usage += 2 * malloc_usage(extra->alloc * 32);
+  usage += malloc_usage(extra->alloc * sizeof(btc_tx_t *));
+
+  return usage;
+}
+
 static int
 use_desc(const btc_mpentry_t *a) {
   int64_t x = a->delta_fee * a->desc_size;
@@ -904,13 +1321,17 @@ cmp_rate(const void *ap, const void *bp) {
 static int
 btc_mempool_limit_size(btc_mempool_t *mp, const uint8_t *added) {
   btc_vector_t queue;
+  size_t threshold;
   btc_mapiter_t it;
   int64_t now;
 
-  if (mp->size <= BTC_MEMPOOL_MAX_SIZE)
+  /* Orphans and recently evicted txs are bounded by
+     count and cannot be freed by evicting entries. */
+  if (btc_mempool_pool_usage(mp) <= mp->limit)
     return 0;
 
   now = btc_now();
+  threshold = mp->limit - mp->limit / 10;
 
   btc_vector_init(&queue);
 
@@ -932,7 +1353,7 @@ btc_mempool_limit_size(btc_mempool_t *mp, const uint8_t *added) {
     btc_heap_insert(&queue, entry, cmp_rate);
   }
 
-  while (queue.length > 0 && mp->size > BTC_MEMPOOL_THRESHOLD) {
+  while (queue.length > 0 && btc_mempool_pool_usage(mp) > threshold) {
     btc_mpentry_t *entry = btc_heap_shift(&queue, cmp_rate);
 
     btc_log_debug(mp, "Removing package %H from mempool (low fee).",
@@ -947,94 +1368,304 @@ btc_mempool_limit_size(btc_mempool_t *mp, const uint8_t *added) {
 }
 
 /*
- * TX Handling
+ * Replacement (BIP125)
  */
 
 static int
-btc_mempool_verify_inputs(btc_mempool_t *mp,
-                          const btc_mpentry_t *entry,
-                          const btc_view_t *view,
-                          unsigned int flags) {
-  const btc_tx_t *tx = entry->tx;
+btc_mempool_is_replaceable(btc_mempool_t *mp, const btc_mpentry_t *entry) {
+  btc_hashset_t set;
+  btc_mapiter_t it;
+  int ret = 0;
 
-  if (btc_tx_verify(tx, view, flags))
+  if (btc_tx_is_rbf(entry->tx))
     return 1;
 
-  if (flags & BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS) {
-    flags &= ~BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS;
+  /* Signaling is inherited from unconfirmed
+     ancestors (bounded by the ancestor limit). */
+  btc_hashset_init(&set);
 
-    if (btc_tx_verify(tx, view, flags)) {
-      return btc_mempool_throw(mp, tx,
-                               BTC_REJECT_INVALID,
-                               "non-mandatory-script-verify-flag",
-                               0,
-                               0);
+  traverse_ancestors(mp, entry, &set, entry, NULL);
+
+  btc_map_each(&set, it) {
+    const btc_mpentry_t *parent = btc_hashmap_get(&mp->map, set.keys[it]);
+
+    if (btc_tx_is_rbf(parent->tx)) {
+      ret = 1;
+      break;
     }
   }
 
-  return btc_mempool_throw(mp, tx,
-                           BTC_REJECT_INVALID,
-                           "mandatory-script-verify-flag-failed",
-                           100,
-                           0);
+  btc_hashset_clear(&set);
+
+  return ret;
 }
 
 static int
-btc_mempool_verify(btc_mempool_t *mp,
-                   const btc_mpentry_t *entry,
-                   const btc_view_t *view) {
-  unsigned int lock_flags = BTC_STANDARD_LOCKTIME_FLAGS;
-  const btc_deployment_state_t *state = btc_chain_state(mp->chain);
-  const btc_entry_t *tip = btc_chain_tip(mp->chain);
-  const btc_tx_t *tx = entry->tx;
-  unsigned int flags;
-  int64_t minfee;
+btc_mempool_get_conflicts(btc_mempool_t *mp,
+                          btc_vector_t *conflicts,
+                          btc_hashset_t *set,
+                          size_t *direct,
+                          const btc_tx_t *tx) {
+  btc_outpoint_t prevout;
+  size_t i, j;
 
-  /* Verify sequence locks. */
-  if (!btc_chain_verify_locks(mp->chain, tip, tx, view, lock_flags)) {
-    return btc_mempool_throw(mp, tx,
-                             BTC_REJECT_NONSTANDARD,
-                             "non-BIP68-final",
-                             0,
-                             0);
-  }
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    btc_mpentry_t *spent = btc_outmap_get(&mp->spents, &input->prevout);
 
-  /* Check input and witness standardness. */
-  if (mp->network->require_standard) {
-    if (!btc_tx_has_standard_inputs(tx, view)) {
-      return btc_mempool_throw(mp, tx,
-                               BTC_REJECT_NONSTANDARD,
-                               "bad-txns-nonstandard-inputs",
-                               0,
-                               0);
-    }
+    if (spent == NULL)
+      continue;
 
-    if (state->flags & BTC_SCRIPT_VERIFY_WITNESS) {
-      if (!btc_tx_has_standard_witness(tx, view)) {
-        return btc_mempool_throw(mp, tx,
-                                 BTC_REJECT_NONSTANDARD,
-                                 "bad-witness-nonstandard",
-                                 0,
-                                 1);
-      }
-    }
+    if (btc_hashset_put(set, spent->hash))
+      btc_vector_push(conflicts, spent);
   }
 
-  /* Annoying process known as sigops counting. */
-  if (entry->sigops > BTC_MAX_TX_SIGOPS_COST) {
-    return btc_mempool_throw(mp, tx,
-                             BTC_REJECT_NONSTANDARD,
-                             "bad-txns-too-many-sigops",
-                             0,
-                             0);
-  }
+  *direct = conflicts->length;
 
-  /* Make sure this guy gave a decent fee. */
-  minfee = btc_get_fee(mp->network->min_relay, entry->size);
+  /* Walk descendants breadth-first, bailing
+     out as soon as we exceed the limit. */
+  for (i = 0; i < conflicts->length; i++) {
+    const btc_mpentry_t *entry = conflicts->items[i];
 
-  if (entry->fee < minfee) {
-    return btc_mempool_throw(mp, tx,
-                             BTC_REJECT_INSUFFICIENTFEE,
+    if (set->size > BTC_MEMPOOL_MAX_REPLACEMENTS)
+      return 0;
+
+    for (j = 0; j < entry->tx->outputs.length; j++) {
+      btc_mpentry_t *spender;
+
+      btc_outpoint_set(&prevout, entry->hash, j);
+
+      spender = btc_outmap_get(&mp->spents, &prevout);
+
+      if (spender == NULL)
+        continue;
+
+      if (btc_hashset_put(set, spender->hash))
+        btc_vector_push(conflicts, spender);
+    }
+  }
+
+  return set->size <= BTC_MEMPOOL_MAX_REPLACEMENTS;
+}
+
+static int
+btc_mempool_check_replace(btc_mempool_t *mp, const btc_mpentry_t *entry) {
+  const btc_tx_t *tx = entry->tx;
+  btc_hashset_t set, parents;
+  btc_vector_t conflicts;
+  int64_t fee = 0;
+  size_t i, j, direct;
+  int ret = 0;
+
+  if (!btc_mempool_is_double_spend(mp, tx))
+    return 1;
+
+  btc_hashset_init(&set);
+  btc_hashset_init(&parents);
+  btc_vector_init(&conflicts);
+
+  if (!btc_mempool_get_conflicts(mp, &conflicts, &set, &direct, tx)) {
+    btc_mempool_throw(mp, tx,
+                      BTC_REJECT_NONSTANDARD,
+                      "too many potential replacements",
+                      0,
+                      0);
+    goto fail;
+  }
+
+  for (i = 0; i < direct; i++) {
+    const btc_mpentry_t *conflict = conflicts.items[i];
+
+    /* Rule #1: originals must signal replaceability. */
+    if (!btc_mempool_is_replaceable(mp, conflict)) {
+      btc_mempool_throw(mp, tx,
+                        BTC_REJECT_DUPLICATE,
+                        "bad-txns-inputs-spent",
+                        0,
+                        0);
+      goto fail;
+    }
+
+    /* Replacement must pay a higher fee rate
+       than everything it directly replaces. */
+    if (entry->fee * (int64_t)conflict->size
+        <= conflict->fee * (int64_t)entry->size) {
+      btc_mempool_throw(mp, tx,
+                        BTC_REJECT_INSUFFICIENTFEE,
+                        "insufficient fee",
+                        0,
+                        0);
+      goto fail;
+    }
+
+    for (j = 0; j < conflict->tx->inputs.length; j++) {
+      const btc_input_t *input = conflict->tx->inputs.items[j];
+
+      btc_hashset_put(&parents, input->prevout.hash);
+    }
+  }
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    const uint8_t *hash = input->prevout.hash;
+
+    if (btc_hashset_has(&set, hash)) {
+      btc_mempool_throw(mp, tx,
+                        BTC_REJECT_INVALID,
+                        "bad-txns-spends-conflicting-tx",
+                        10,
+                        0);
+      goto fail;
+    }
+
+    /* Rule #2: no new unconfirmed inputs. */
+    if (btc_hashmap_has(&mp->map, hash) && !btc_hashset_has(&parents, hash)) {
+      btc_mempool_throw(mp, tx,
+                        BTC_REJECT_NONSTANDARD,
+                        "replacement-adds-unconfirmed",
+                        0,
+                        0);
+      goto fail;
+    }
+  }
+
+  for (i = 0; i < conflicts.length; i++) {
+    const btc_mpentry_t *conflict = conflicts.items[i];
+
+    fee += conflict->fee;
+  }
+
+  /* Rule #3: pay at least the sum of the originals. Rule #4:
+     pay for our own bandwidth at the minimum relay rate. */
+  if (entry->fee < fee
+      || entry->fee - fee < btc_get_fee(mp->network->min_relay, entry->size)) {
+    btc_mempool_throw(mp, tx,
+                      BTC_REJECT_INSUFFICIENTFEE,
+                      "insufficient fee",
+                      0,
+                      0);
+    goto fail;
+  }
+
+  ret = 1;
+fail:
+  btc_hashset_clear(&set);
+  btc_hashset_clear(&parents);
+  btc_vector_clear(&conflicts);
+  return ret;
+}
+
+static void
+btc_mempool_replace(btc_mempool_t *mp, const btc_mpentry_t *entry) {
+  const btc_tx_t *tx = entry->tx;
+  size_t i;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    btc_mpentry_t *spent = btc_outmap_get(&mp->spents, &input->prevout);
+
+    if (spent == NULL)
+      continue;
+
+    btc_log_debug(mp, "Replacing %H with %H in mempool.",
+                      spent->hash, entry->hash);
+
+    btc_mempool_evict_entry(mp, spent);
+  }
+}
+
+/*
+ * TX Handling
+ */
+
+static int
+btc_mempool_verify_inputs(btc_mempool_t *mp,
+                          const btc_mpentry_t *entry,
+                          const btc_view_t *view,
+                          unsigned int flags,
+                          int result) {
+  const btc_tx_t *tx = entry->tx;
+
+  if (result < 0)
+    result = btc_tx_verify(tx, view, flags);
+
+  if (result)
+    return 1;
+
+  if (flags & BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS) {
+    flags &= ~BTC_SCRIPT_ONLY_STANDARD_VERIFY_FLAGS;
+
+    if (btc_tx_verify(tx, view, flags)) {
+      return btc_mempool_throw(mp, tx,
+                               BTC_REJECT_INVALID,
+                               "non-mandatory-script-verify-flag",
+                               0,
+                               0);
+    }
+  }
+
+  return btc_mempool_throw(mp, tx,
+                           BTC_REJECT_INVALID,
+                           "mandatory-script-verify-flag-failed",
+                           100,
+                           0);
+}
+
+static int
+btc_mempool_check(btc_mempool_t *mp,
+                  const btc_mpentry_t *entry,
+                  const btc_view_t *view) {
+  unsigned int lock_flags = BTC_STANDARD_LOCKTIME_FLAGS;
+  const btc_deployment_state_t *state = btc_chain_state(mp->chain);
+  const btc_entry_t *tip = btc_chain_tip(mp->chain);
+  const btc_tx_t *tx = entry->tx;
+  int64_t minfee;
+
+  /* Verify sequence locks. */
+  if (!btc_chain_verify_locks(mp->chain, tip, tx, view, lock_flags)) {
+    return btc_mempool_throw(mp, tx,
+                             BTC_REJECT_NONSTANDARD,
+                             "non-BIP68-final",
+                             0,
+                             0);
+  }
+
+  /* Check input and witness standardness. */
+  if (mp->network->require_standard) {
+    if (!btc_tx_has_standard_inputs(tx, view)) {
+      return btc_mempool_throw(mp, tx,
+                               BTC_REJECT_NONSTANDARD,
+                               "bad-txns-nonstandard-inputs",
+                               0,
+                               0);
+    }
+
+    if (state->flags & BTC_SCRIPT_VERIFY_WITNESS) {
+      if (!btc_tx_has_standard_witness(tx, view)) {
+        return btc_mempool_throw(mp, tx,
+                                 BTC_REJECT_NONSTANDARD,
+                                 "bad-witness-nonstandard",
+                                 0,
+                                 1);
+      }
+    }
+  }
+
+  /* Annoying process known as sigops counting. */
+  if (entry->sigops > BTC_MAX_TX_SIGOPS_COST) {
+    return btc_mempool_throw(mp, tx,
+                             BTC_REJECT_NONSTANDARD,
+                             "bad-txns-too-many-sigops",
+                             0,
+                             0);
+  }
+
+  /* Make sure this guy gave a decent fee. */
+  minfee = btc_get_fee(mp->network->min_relay, entry->size);
+
+  if (entry->fee < minfee) {
+    return btc_mempool_throw(mp, tx,
+                             BTC_REJECT_INSUFFICIENTFEE,
                              "insufficient fee",
                              0,
                              0);
@@ -1058,10 +1689,19 @@ btc_mempool_verify(btc_mempool_t *mp,
                              0);
   }
 
-  /* Script verification. */
-  flags = BTC_SCRIPT_STANDARD_VERIFY_FLAGS;
+  return 1;
+}
+
+static int
+btc_mempool_verify_scripts(btc_mempool_t *mp,
+                           const btc_mpentry_t *entry,
+                           const btc_view_t *view,
+                           int result) {
+  unsigned int flags = BTC_SCRIPT_STANDARD_VERIFY_FLAGS;
+  const btc_tx_t *tx = entry->tx;
 
-  if (!btc_mempool_verify_inputs(mp, entry, view, flags)) {
+  /* A non-negative result was computed ahead of time by a worker. */
+  if (!btc_mempool_verify_inputs(mp, entry, view, flags, result)) {
     if (btc_tx_has_witness(tx))
       return 0;
 
@@ -1096,7 +1736,11 @@ btc_mempool_verify(btc_mempool_t *mp,
 }
 
 static int
-btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
+btc_mempool_prepare(btc_mempool_t *mp,
+                    btc_mpentry_t **result,
+                    btc_view_t **output,
+                    const btc_tx_t *tx,
+                    unsigned int id) {
   const btc_deployment_state_t *state = btc_chain_state(mp->chain);
   unsigned int lock_flags = BTC_STANDARD_LOCKTIME_FLAGS;
   const btc_entry_t *tip = btc_chain_tip(mp->chain);
@@ -1188,25 +1832,6 @@ btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
                              0);
   }
 
-  /* Quick and dirty test to verify we're
-     not double-spending an output in the
-     mempool. */
-  if (btc_mempool_is_double_spend(mp, tx)) {
-    if (btc_tx_is_rbf(tx)) {
-      return btc_mempool_fail(mp, tx,
-                              BTC_REJECT_DUPLICATE,
-                              "replace-by-fee",
-                              0,
-                              0);
-    }
-
-    return btc_mempool_throw(mp, tx,
-                             BTC_REJECT_DUPLICATE,
-                             "bad-txns-inputs-spent",
-                             0,
-                             0);
-  }
-
   /* Get coin viewpoint as it pertains to the mempool. */
   view = btc_mempool_view(mp, tx);
 
@@ -1221,6 +1846,9 @@ btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
     btc_mempool_add_orphan(mp, tx, view, id);
     btc_view_destroy(view);
 
+    *result = NULL;
+    *output = NULL;
+
     return 1;
   }
 
@@ -1241,13 +1869,34 @@ btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
 
   btc_mpentry_set(entry, tx, view, height, fee);
 
-  /* Contextual verification. */
-  if (!btc_mempool_verify(mp, entry, view)) {
+  /* Contextual verification (sans scripts). */
+  if (!btc_mempool_check(mp, entry, view)) {
+    btc_view_destroy(view);
+    btc_mpentry_destroy(entry);
+    return 0;
+  }
+
+  /* Double spends must be valid replacements. */
+  if (!btc_mempool_check_replace(mp, entry)) {
     btc_view_destroy(view);
     btc_mpentry_destroy(entry);
     return 0;
   }
 
+  *result = entry;
+  *output = view;
+
+  return 1;
+}
+
+static int
+btc_mempool_commit(btc_mempool_t *mp,
+                   const btc_tx_t *tx,
+                   btc_mpentry_t *entry,
+                   btc_view_t *view) {
+  /* Evict anything we're replacing. */
+  btc_mempool_replace(mp, entry);
+
   /* Add and index the entry. */
   btc_mempool_add_entry(mp, entry, view);
   btc_view_destroy(view);
@@ -1264,25 +1913,221 @@ btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
   return 1;
 }
 
+static int
+btc_mempool_insert(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
+  btc_mpentry_t *entry;
+  btc_view_t *view;
+
+  if (!btc_mempool_prepare(mp, &entry, &view, tx, id))
+    return 0;
+
+  /* Stored as an orphan. */
+  if (entry == NULL)
+    return 1;
+
+  /* Script verification. */
+  if (!btc_mempool_verify_scripts(mp, entry, view, -1)) {
+    btc_view_destroy(view);
+    btc_mpentry_destroy(entry);
+    return 0;
+  }
+
+  return btc_mempool_commit(mp, tx, entry, view);
+}
+
+static void
+btc_mempool_reject(btc_mempool_t *mp, const btc_tx_t *tx) {
+  const btc_verify_error_t *err = &mp->error;
+
+  if (strstr(err->reason, "script-verify-flag") != NULL) {
+    if (!btc_tx_has_witness(tx) && !err->malleated)
+      btc_filter_add(&mp->rejects, tx->hash, 32);
+  } else {
+    if (!err->malleated)
+      btc_filter_add(&mp->rejects, tx->hash, 32);
+  }
+}
+
 int
 btc_mempool_add(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
   if (!btc_mempool_insert(mp, tx, id)) {
-    const btc_verify_error_t *err = &mp->error;
+    btc_mempool_reject(mp, tx);
+    return 0;
+  }
 
-    if (strstr(err->reason, "script-verify-flag") != NULL) {
-      if (!btc_tx_has_witness(tx) && !err->malleated)
-        btc_filter_add(&mp->rejects, tx->hash, 32);
-    } else {
-      if (!err->malleated)
-        btc_filter_add(&mp->rejects, tx->hash, 32);
-    }
+  return 1;
+}
+
+/*
+ * Pipeline
+ */
+
+static int
+btc_mempool_is_stale(btc_mempool_t *mp, const btc_mpjob_t *job) {
+  const btc_tx_t *tx = job->entry->tx;
+  size_t i;
+
+  if (job->tip != btc_chain_tip(mp->chain))
+    return 1;
+
+  /* Mempool parents may have been evicted in the meantime. */
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    const btc_coin_t *coin = btc_view_get(job->view, &input->prevout);
+
+    CHECK(coin != NULL);
+
+    if (coin->height != -1)
+      continue;
+
+    if (!btc_hashmap_has(&mp->map, input->prevout.hash))
+      return 1;
+  }
+
+  return 0;
+}
+
+static int
+btc_mempool_finish(btc_mempool_t *mp, btc_mpjob_t *job, const btc_tx_t *tx) {
+  btc_mpentry_t *entry = job->entry;
+  btc_view_t *view = job->view;
+
+  /* The chain or our parents changed underneath us.
+     Fall back to a full (serial) verification. */
+  if (btc_mempool_is_stale(mp, job))
+    return btc_mempool_insert(mp, tx, job->id);
+
+  /* We may have accepted the same tx synchronously. */
+  if (btc_mempool_exists(mp, tx->hash)) {
+    return btc_mempool_throw(mp, tx,
+                             BTC_REJECT_ALREADYKNOWN,
+                             "txn-already-in-mempool",
+                             0,
+                             0);
+  }
+
+  /* An earlier transaction in the batch may have
+     claimed one of our outputs. */
+  if (!btc_mempool_check_replace(mp, entry))
+    return 0;
+
+  /* Ancestors may have been added in the interim. */
+  if (btc_mempool_count_ancestors(mp, entry) + 1 > BTC_MEMPOOL_MAX_ANCESTORS) {
+    return btc_mempool_throw(mp, tx,
+                             BTC_REJECT_NONSTANDARD,
+                             "too-long-mempool-chain",
+                             0,
+                             0);
+  }
+
+  if (!btc_mempool_verify_scripts(mp, entry, view, job->result))
+    return 0;
+
+  job->entry = NULL;
+  job->view = NULL;
+
+  return btc_mempool_commit(mp, tx, entry, view);
+}
+
+int
+btc_mempool_enqueue(btc_mempool_t *mp, const btc_tx_t *tx, unsigned int id) {
+  const btc_entry_t *tip = btc_chain_tip(mp->chain);
+  btc_mpentry_t *entry;
+  btc_view_t *view;
+  btc_mpjob_t *job;
 
+  if (!btc_mempool_prepare(mp, &entry, &view, tx, id)) {
+    btc_mempool_reject(mp, tx);
     return 0;
   }
 
+  /* Stored as an orphan. */
+  if (entry == NULL)
+    return 1;
+
+  job = btc_mpjob_create(entry, view, tip, id);
+
+  btc_queue_push(&mp->queue, job);
+
+  CHECK(btc_hashmap_put(&mp->pending, entry->hash, job));
+
+  if (mp->queue.length >= BTC_MEMPOOL_MAX_PENDING)
+    btc_mempool_flush(mp);
+
   return 1;
 }
 
+void
+btc_mempool_flush(btc_mempool_t *mp) {
+  btc_mpjob_t *job, *next;
+  btc_workq_t batch;
+  size_t total = 0;
+  size_t length;
+
+  if (mp->queue.length == 0)
+    return;
+
+  /* Script verification (parallel). */
+  if (mp->workers != NULL) {
+    btc_workq_init(&batch);
+
+    for (job = mp->queue.head; job != NULL; job = job->next)
+      btc_workq_push(&batch, btc_mpjob_work, job);
+
+    btc_workers_batch(mp->workers, &batch);
+    btc_workers_wait(mp->workers);
+  } else {
+    for (job = mp->queue.head; job != NULL; job = job->next)
+      btc_mpjob_work(job);
+  }
+
+  /* Detach the queue. Resolved orphans may enqueue more. */
+  job = mp->queue.head;
+  length = mp->queue.length;
+
+  btc_queue_reset(&mp->queue);
+
+  /* Insertion (serial). */
+  for (; job != NULL; job = next) {
+    btc_tx_t *tx = btc_tx_ref(job->entry->tx);
+
+    next = job->next;
+
+    CHECK(btc_hashmap_del(&mp->pending, tx->hash) != NULL);
+
+    if (btc_mempool_finish(mp, job, tx)) {
+      total += 1;
+    } else {
+      btc_mempool_reject(mp, tx);
+
+      if (mp->on_reject != NULL)
+        mp->on_reject(&mp->error, job->id, mp->arg);
+    }
+
+    btc_mpjob_destroy(job);
+    btc_tx_destroy(tx);
+  }
+
+  btc_log_debug(mp, "Flushed %zu/%zu pending txs (txs=%zu).",
+                    total, length, (size_t)mp->map.size);
+}
+
+static void
+btc_mempool_readmit(btc_mempool_t *mp);
+
+void
+btc_mempool_tick(void *ptr) {
+  btc_mempool_t *mp = ptr;
+
+  /* A reorg was aborted before it could complete. */
+  if (mp->disconnected.length > 0) {
+    btc_mempool_readmit(mp);
+    btc_mempool_reset_reorg(mp);
+  }
+
+  btc_mempool_flush(mp);
+}
+
 /*
  * Block Handling
  */
@@ -1294,6 +2139,16 @@ btc_mempool_add_block(btc_mempool_t *mp,
   int total = 0;
   size_t i;
 
+  /* Remember what the new chain confirmed. */
+  if (mp->disconnected.length > 0) {
+    for (i = 1; i < block->txs.length; i++) {
+      const btc_tx_t *tx = block->txs.items[i];
+
+      if (!btc_hashset_has(&mp->confirmed, tx->hash))
+        btc_hashset_put(&mp->confirmed, btc_hash_clone(tx->hash));
+    }
+  }
+
   if (mp->map.size == 0)
     return;
 
@@ -1331,84 +2186,288 @@ void
 btc_mempool_remove_block(btc_mempool_t *mp,
                          const btc_entry_t *entry,
                          const btc_block_t *block) {
-  int total = 0;
-  size_t i;
+  if (mp->map.size == 0 && mp->disconnected.length == 0)
+    return;
 
-  if (mp->map.size == 0)
+  /* Blocks are disconnected tip-first. Keep the
+     state of the old tip around for handle_reorg. */
+  if (mp->disconnected.length == 0) {
+    mp->reorg_height = entry->height;
+    mp->reorg_time = btc_entry_median_time(entry);
+  }
+
+  /* Defer re-admission until the reorg is complete. */
+  btc_vector_push(&mp->disconnected, btc_block_refconst(block));
+}
+
+static void
+btc_mempool_readmit(btc_mempool_t *mp) {
+  btc_mpqueue_t queue = mp->queue;
+  btc_hashmap_t index;
+  btc_vector_t items;
+  size_t *depth, *start;
+  size_t i, j, max = 0;
+  size_t total;
+
+  btc_hashmap_init(&index);
+  btc_vector_init(&items);
+
+  /* Walk the disconnected blocks in chain order. This
+     yields a topological ordering of their transactions. */
+  for (i = mp->disconnected.length - 1; i != (size_t)-1; i--) {
+    const btc_block_t *block = mp->disconnected.items[i];
+
+    for (j = 1; j < block->txs.length; j++) {
+      const btc_tx_t *tx = block->txs.items[j];
+
+      if (btc_hashset_has(&mp->confirmed, tx->hash))
+        continue;
+
+      if (btc_hashmap_has(&mp->map, tx->hash))
+        continue;
+
+      if (btc_hashmap_has(&index, tx->hash))
+        continue;
+
+      btc_hashmap_put(&index, tx->hash, NULL);
+      btc_vector_push(&items, tx);
+    }
+  }
+
+  total = items.length;
+
+  if (total == 0) {
+    btc_hashmap_clear(&index);
+    btc_vector_clear(&items);
     return;
+  }
 
-  for (i = 1; i < block->txs.length; i++) {
-    const btc_tx_t *tx = block->txs.items[i];
+  /* Compute the depth of each tx within the set. Siblings at
+     the same depth are independent and can be verified together. */
+  depth = (size_t *)btc_malloc(total * sizeof(size_t));
+  start = (size_t *)btc_malloc((total + 1) * sizeof(size_t));
 
-    if (btc_hashmap_has(&mp->map, tx->hash))
-      continue;
+  btc_hashmap_reset(&index);
+
+  for (i = 0; i < total; i++) {
+    const btc_tx_t *tx = items.items[i];
+
+    btc_hashmap_put(&index, tx->hash, (void *)&depth[i]);
+
+    depth[i] = 0;
+
+    for (j = 0; j < tx->inputs.length; j++) {
+      const btc_input_t *input = tx->inputs.items[j];
+      const size_t *parent = btc_hashmap_get(&index, input->prevout.hash);
+
+      if (parent != NULL && parent != &depth[i] && *parent + 1 > depth[i])
+        depth[i] = *parent + 1;
+    }
 
-    total += btc_mempool_insert(mp, tx, -1);
+    if (depth[i] > max)
+      max = depth[i];
   }
 
+  /* Stale pending txs go to the back of the line. */
+  btc_queue_reset(&mp->queue);
+
+  /* Counting sort by depth. */
+  memset(start, 0, (total + 1) * sizeof(size_t));
+
+  for (i = 0; i < total; i++)
+    start[depth[i] + 1]++;
+
+  for (i = 1; i <= max; i++)
+    start[i] += start[i - 1];
+
+  {
+    const btc_tx_t **sorted = btc_malloc(total * sizeof(btc_tx_t *));
+    size_t level = 0;
+
+    for (i = 0; i < total; i++)
+      sorted[start[depth[i]]++] = items.items[i];
+
+    /* start[n] now points at the end of level n. */
+    for (i = 0; i < total; i++) {
+      if (i == start[level]) {
+        btc_mempool_flush(mp);
+        level++;
+      }
+
+      btc_mempool_enqueue(mp, sorted[i], -1);
+    }
+
+    btc_mempool_flush(mp);
+    btc_free(sorted);
+  }
+
+  if (queue.head != NULL)
+    mp->queue = queue;
+
   btc_filter_reset(&mp->rejects);
 
-  if (total > 0) {
-    btc_log_debug(mp, "Added %d txs back into the mempool for block %d.",
-                      total, entry->height);
+  for (i = 0, j = 0; i < total; i++) {
+    const btc_tx_t *tx = items.items[i];
+
+    if (btc_hashmap_has(&mp->map, tx->hash))
+      j++;
   }
+
+  btc_log_debug(mp, "Added %zu/%zu txs back into the mempool (depth=%zu).",
+                    j, total, max + 1);
+
+  btc_hashmap_clear(&index);
+  btc_vector_clear(&items);
+  btc_free(depth);
+  btc_free(start);
 }
 
-void
-btc_mempool_handle_reorg(btc_mempool_t *mp) {
+static int
+btc_mempool_is_changed(const btc_hashset_t *changed, const btc_tx_t *tx) {
+  size_t i;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+
+    if (btc_hashset_has(changed, input->prevout.hash))
+      return 1;
+  }
+
+  return 0;
+}
+
+static int
+btc_mempool_recheck(btc_mempool_t *mp,
+                    const btc_mpentry_t *entry,
+                    const btc_view_t *view) {
   unsigned int flags = BTC_STANDARD_LOCKTIME_FLAGS;
   const btc_entry_t *tip = btc_chain_tip(mp->chain);
   int64_t mtp = btc_entry_median_time(tip);
   int32_t height = tip->height + 1;
+  const btc_tx_t *tx = entry->tx;
+  size_t i;
+
+  if (!btc_tx_is_final(tx, height, mtp))
+    return 0;
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *input = tx->inputs.items[i];
+    const btc_coin_t *coin = btc_view_get(view, &input->prevout);
+
+    /* Spends the output of a disconnected coinbase. */
+    if (coin == NULL)
+      return 0;
+
+    if (!coin->coinbase)
+      continue;
+
+    if (height < coin->height + BTC_COINBASE_MATURITY)
+      return 0;
+  }
+
+  if (entry->locks) {
+    if (!btc_chain_verify_locks(mp->chain, tip, tx, view, flags))
+      return 0;
+  }
+
+  return 1;
+}
+
+void
+btc_mempool_handle_reorg(btc_mempool_t *mp) {
+  const btc_entry_t *tip = btc_chain_tip(mp->chain);
+  int64_t mtp = btc_entry_median_time(tip);
+  btc_hashset_t changed;
+  btc_vector_t recheck;
   btc_mapiter_t it;
+  btc_view_t *view;
+  int regressed;
+  size_t i, j;
+
+  /* A lower tip may invalidate any timelock. Otherwise,
+     only entries spending reorged outputs are affected. */
+  regressed = tip->height < mp->reorg_height || mtp < mp->reorg_time;
+
+  btc_hashset_init(&changed);
+  btc_vector_init(&recheck);
+
+  for (i = 0; i < mp->disconnected.length; i++) {
+    const btc_block_t *block = mp->disconnected.items[i];
+
+    for (j = 0; j < block->txs.length; j++) {
+      const btc_tx_t *tx = block->txs.items[j];
+
+      btc_hashset_put(&changed, tx->hash);
+    }
+  }
+
+  btc_map_each(&mp->confirmed, it)
+    btc_hashset_put(&changed, mp->confirmed.keys[it]);
+
+  /* Put disconnected transactions back first so
+     that their descendants can find their inputs. */
+  btc_mempool_readmit(mp);
 
   btc_map_each(&mp->map, it) {
     btc_mpentry_t *entry = mp->map.vals[it];
-    btc_tx_t *tx = entry->tx;
-    btc_view_t *view;
 
-    if (!btc_tx_is_final(tx, height, mtp)) {
-      btc_mempool_evict_entry(mp, entry);
+    /* Freshly re-admitted. */
+    if (btc_hashset_has(&changed, entry->hash))
       continue;
-    }
 
-    if (!entry->coinbase && !entry->locks)
+    if (btc_mempool_is_changed(&changed, entry->tx)) {
+      btc_vector_push(&recheck, btc_hash_clone(entry->hash));
       continue;
+    }
 
-    view = btc_mempool_view(mp, tx);
+    if (!regressed)
+      continue;
 
-    if (!btc_chain_verify_locks(mp->chain, tip, tx, view, flags)) {
-      btc_mempool_evict_entry(mp, entry);
-      btc_view_destroy(view);
+    if (entry->coinbase || entry->locks) {
+      btc_vector_push(&recheck, btc_hash_clone(entry->hash));
       continue;
     }
 
-    if (entry->coinbase) {
-      int invalid = 0;
-      size_t i;
+    /* Finality is all that's left to check. */
+    if (!btc_tx_is_final(entry->tx, tip->height + 1, mtp))
+      btc_vector_push(&recheck, btc_hash_clone(entry->hash));
+  }
+
+  /* Fetch all coins in one pass. */
+  view = btc_view_create();
 
-      for (i = 0; i < tx->inputs.length; i++) {
-        const btc_input_t *input = tx->inputs.items[i];
-        const btc_coin_t *coin = btc_view_get(view, &input->prevout);
+  for (i = 0; i < recheck.length; i++) {
+    const btc_mpentry_t *entry = btc_hashmap_get(&mp->map, recheck.items[i]);
 
-        if (coin == NULL || !coin->coinbase)
-          continue;
+    CHECK(entry != NULL);
 
-        if (height < coin->height + BTC_COINBASE_MATURITY) {
-          invalid = 1;
-          break;
-        }
-      }
+    btc_mempool_fill_view(mp, view, entry->tx);
+  }
 
-      if (invalid) {
-        btc_mempool_evict_entry(mp, entry);
-        btc_view_destroy(view);
-        continue;
-      }
-    }
+  for (i = 0; i < recheck.length; i++) {
+    btc_mpentry_t *entry = btc_hashmap_get(&mp->map, recheck.items[i]);
 
-    btc_view_destroy(view);
+    /* Already evicted as a descendant. */
+    if (entry == NULL)
+      continue;
+
+    if (btc_mempool_recheck(mp, entry, view))
+      continue;
+
+    btc_log_debug(mp, "Removing %H from mempool (invalidated by reorg).",
+                      entry->hash);
+
+    btc_mempool_evict_entry(mp, entry);
   }
+
+  for (i = 0; i < recheck.length; i++)
+    btc_free(recheck.items[i]);
+
+  btc_view_destroy(view);
+  btc_vector_clear(&recheck);
+  btc_hashset_clear(&changed);
+
+  btc_mempool_reset_reorg(mp);
 }
 
 /*
@@ -1425,6 +2484,26 @@ btc_mempool_size(btc_mempool_t *mp) {
   return mp->map.size;
 }
 
+size_t
+btc_mempool_bytes(btc_mempool_t *mp) {
+  return mp->size;
+}
+
+uint32_t
+btc_mempool_sequence(btc_mempool_t *mp) {
+  return mp->sequence;
+}
+
+size_t
+btc_mempool_usage(btc_mempool_t *mp) {
+  return btc_mempool_pool_usage(mp) + btc_mempool_extra_usage(mp);
+}
+
+size_t
+btc_mempool_limit(btc_mempool_t *mp) {
+  return mp->limit;
+}
+
 int
 btc_mempool_has(btc_mempool_t *mp, const uint8_t *hash) {
   return btc_hashmap_has(&mp->map, hash);
@@ -1452,6 +2531,20 @@ btc_mempool_coin(btc_mempool_t *mp, const uint8_t *hash, size_t index) {
   return coin;
 }
 
+int
+btc_mempool_is_spent(btc_mempool_t *mp, const uint8_t *hash, size_t index) {
+  btc_outpoint_t spend;
+
+  btc_outpoint_set(&spend, hash, index);
+
+  return btc_outmap_has(&mp->spents, &spend);
+}
+
+int
+btc_mempool_has_pending(btc_mempool_t *mp, const uint8_t *hash) {
+  return btc_hashmap_has(&mp->pending, hash);
+}
+
 int
 btc_mempool_has_orphan(btc_mempool_t *mp, const uint8_t *hash) {
   return btc_hashmap_has(&mp->orphans, hash);
@@ -1476,6 +2569,9 @@ btc_mempool_missing(btc_mempool_t *mp, const btc_tx_t *tx) {
     if (btc_hashmap_has(&mp->orphans, input->prevout.hash))
       continue;
 
+    if (btc_hashmap_has(&mp->pending, input->prevout.hash))
+      continue;
+
     btc_vector_push(missing, input->prevout.hash);
   }
 
@@ -1486,3 +2582,17 @@ const btc_hashmap_t *
 btc_mempool_map(const btc_mempool_t *mp) {
   return &mp->map;
 }
+
+int
+btc_mempool_fill_compact(btc_mempool_t *mp, btc_cmpct_t *blk, int witness) {
+  const btc_mpindex_t *index = &mp->index;
+  const btc_mpindex_t *extra = &mp->extra;
+
+  if (btc_cmpct_fill_hashes(blk, witness ? index->whashes : index->hashes,
+                                 index->txs, index->length)) {
+    return 1;
+  }
+
+  return btc_cmpct_fill_hashes(blk, witness ? extra->whashes : extra->hashes,
+                                    extra->txs, extra->length);
+}
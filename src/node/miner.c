@@ -50,6 +50,9 @@
 static const uint8_t zero_nonce[32] = {0};
 static const uint8_t default_flags[] = "mined by mako";
 
+#define MINER_CACHE_TIME 5
+#define MINER_MAX_TEMPLATES 8
+
 /*
  * Types
  */
@@ -70,7 +73,7 @@ typedef struct btc_cputhread_s {
 typedef struct btc_cpuminer_s {
   btc_miner_t *miner;
   int mining;
-  int64_t last_check;
+  btc_timer_t *timer;
   btc_mutex_t lock;
   btc_cond_t master;
   btc_cond_t worker;
@@ -94,6 +97,9 @@ struct btc_miner_s {
   unsigned int flags;
   btc_buffer_t cbflags;
   btc_vector_t addrs;
+  btc_vector_t tmpls;
+  uint32_t sequence;
+  int64_t updated;
   btc_cpuminer_t cpu;
 };
 
@@ -548,6 +554,49 @@ btc_tmpl_submitwork(const btc_tmpl_t *bt,
   return block;
 }
 
+btc_block_t *
+btc_tmpl_rebuild(const btc_tmpl_t *bt,
+                 const btc_header_t *hdr,
+                 btc_tx_t *cb) {
+  /* The merkle steps stand in for every hash but the
+     coinbase, so a matching root (and commitment) means
+     the remaining transactions are exactly ours. */
+  const uint8_t *commitment;
+  btc_block_t *block;
+  uint8_t root[32];
+  size_t i;
+
+  if (!btc_hash_equal(hdr->prev_block, bt->prev_block))
+    return NULL;
+
+  btc_tmpl_compute(root, bt, cb->hash);
+
+  if (!btc_hash_equal(hdr->merkle_root, root))
+    return NULL;
+
+  block = btc_block_create();
+
+  btc_header_copy(&block->header, hdr);
+  btc_txvec_push(&block->txs, btc_tx_ref(cb));
+
+  for (i = 0; i < bt->txs.length; i++) {
+    const btc_blockentry_t *item = bt->txs.items[i];
+
+    btc_txvec_push(&block->txs, btc_tx_ref(item->tx));
+  }
+
+  if (btc_tmpl_witness(bt)) {
+    commitment = btc_block_get_commitment_hash(block);
+
+    if (commitment == NULL || !btc_hash_equal(commitment, bt->commitment)) {
+      btc_block_destroy(block);
+      return NULL;
+    }
+  }
+
+  return block;
+}
+
 btc_block_t *
 btc_tmpl_mine(const btc_tmpl_t *bt) {
   /* Simple mining function for testing.
@@ -629,6 +678,9 @@ fail:
  * CPU Miner
  */
 
+static void
+on_tick(void *arg);
+
 static void
 btc_cpuminer_init(btc_cpuminer_t *cpu, btc_miner_t *miner, int length) {
   btc_cputhread_t *thread;
@@ -639,7 +691,7 @@ btc_cpuminer_init(btc_cpuminer_t *cpu, btc_miner_t *miner, int length) {
 
   cpu->miner = miner;
   cpu->mining = 0;
-  cpu->last_check = 0;
+  cpu->timer = btc_timer_create(miner->loop, on_tick, cpu);
 
   btc_mutex_init(&cpu->lock);
   btc_cond_init(&cpu->master);
@@ -665,6 +717,7 @@ btc_cpuminer_init(btc_cpuminer_t *cpu, btc_miner_t *miner, int length) {
 
 static void
 btc_cpuminer_clear(btc_cpuminer_t *cpu) {
+  btc_timer_destroy(cpu->timer);
   btc_mutex_destroy(&cpu->lock);
   btc_cond_destroy(&cpu->master);
   btc_cond_destroy(&cpu->worker);
@@ -725,9 +778,6 @@ btc_cpuminer_stop_job(btc_cpuminer_t *cpu) {
   }
 }
 
-static void
-on_tick(void *arg);
-
 static void
 mining_thread(void *arg);
 
@@ -750,7 +800,7 @@ btc_cpuminer_start(btc_cpuminer_t *cpu, int active) {
 
   cpu->mining = 1;
 
-  btc_loop_on_tick(miner->loop, on_tick, cpu);
+  btc_timer_start(cpu->timer, 250, 250);
 
   for (i = 0; i < active; i++) {
     btc_thread_create(&thread, mining_thread, &cpu->threads[i]);
@@ -789,7 +839,7 @@ btc_cpuminer_stop(btc_cpuminer_t *cpu) {
 
   cpu->mining = 0;
 
-  btc_loop_off_tick(miner->loop, on_tick, cpu);
+  btc_timer_stop(cpu->timer);
 
   btc_log_info(miner, "Miner stopped.");
 }
@@ -826,11 +876,6 @@ on_tick(void *arg) {
 
   CHECK(cpu->mining == 1);
 
-  if (now < cpu->last_check + 250)
-    return;
-
-  cpu->last_check = now;
-
   btc_mutex_lock(&cpu->lock);
 
   /* Get tip for below checks. */
@@ -1001,6 +1046,7 @@ btc_miner_create(const btc_network_t *network,
 
   btc_buffer_init(&miner->cbflags);
   btc_vector_init(&miner->addrs);
+  btc_vector_init(&miner->tmpls);
   btc_cpuminer_init(&miner->cpu, miner, btc_sys_numcpu());
 
   btc_buffer_set(&miner->cbflags, default_flags, sizeof(default_flags) - 1);
@@ -1015,7 +1061,11 @@ btc_miner_destroy(btc_miner_t *miner) {
   for (i = 0; i < miner->addrs.length; i++)
     btc_address_destroy(miner->addrs.items[i]);
 
+  for (i = 0; i < miner->tmpls.length; i++)
+    btc_tmpl_destroy(miner->tmpls.items[i]);
+
   btc_vector_clear(&miner->addrs);
+  btc_vector_clear(&miner->tmpls);
   btc_buffer_clear(&miner->cbflags);
   btc_cpuminer_clear(&miner->cpu);
 
@@ -1232,6 +1282,80 @@ btc_miner_template(btc_miner_t *miner) {
   return bt;
 }
 
+static void
+btc_miner_flush(btc_miner_t *miner) {
+  size_t i;
+
+  for (i = 0; i < miner->tmpls.length; i++)
+    btc_tmpl_destroy(miner->tmpls.items[i]);
+
+  btc_vector_reset(&miner->tmpls);
+}
+
+const btc_tmpl_t *
+btc_miner_get_template(btc_miner_t *miner) {
+  const btc_entry_t *tip = btc_chain_tip(miner->chain);
+  btc_vector_t *tmpls = &miner->tmpls;
+  uint32_t sequence = 0;
+  int64_t now = btc_now();
+  btc_tmpl_t *bt = NULL;
+
+  if (miner->mempool != NULL)
+    sequence = btc_mempool_sequence(miner->mempool);
+
+  if (tmpls->length > 0) {
+    bt = btc_vector_top(tmpls);
+
+    /* Mempool churn alone only invalidates the cache every
+       few seconds; a new tip invalidates it immediately. */
+    if (!btc_hash_equal(bt->prev_block, tip->hash)) {
+      btc_miner_flush(miner);
+      bt = NULL;
+    } else if (sequence != miner->sequence) {
+      if (now >= miner->updated + MINER_CACHE_TIME)
+        bt = NULL;
+    }
+  }
+
+  if (bt == NULL) {
+    if (tmpls->length == MINER_MAX_TEMPLATES) {
+      btc_tmpl_destroy(tmpls->items[0]);
+
+      memmove(tmpls->items, tmpls->items + 1,
+              (tmpls->length - 1) * sizeof(void *));
+
+      tmpls->length--;
+    }
+
+    bt = btc_miner_template(miner);
+
+    btc_vector_push(tmpls, bt);
+
+    miner->sequence = sequence;
+    miner->updated = now;
+  }
+
+  btc_miner_update_time(miner, bt);
+
+  return bt;
+}
+
+btc_block_t *
+btc_miner_rebuild(btc_miner_t *miner, const btc_header_t *hdr, btc_tx_t *cb) {
+  const btc_vector_t *tmpls = &miner->tmpls;
+  btc_block_t *block;
+  size_t i;
+
+  for (i = tmpls->length - 1; i != (size_t)-1; i--) {
+    block = btc_tmpl_rebuild(tmpls->items[i], hdr, cb);
+
+    if (block != NULL)
+      return block;
+  }
+
+  return NULL;
+}
+
 int
 btc_miner_getgenerate(btc_miner_t *miner) {
   return miner->cpu.mining;
@@ -18,8 +18,10 @@
 #include <node/mempool.h>
 #include <node/miner.h>
 #include <node/node.h>
+#include <node/notifier.h>
 #include <node/pool.h>
 #include <node/rpc.h>
+#include <node/stratum.h>
 #include <base/timedata.h>
 
 #include <wallet/client.h>
@@ -73,6 +75,9 @@ on_tx(const btc_mpentry_t *entry, const btc_view_t *view, void *arg);
 static void
 on_bad_tx_orphan(const btc_verify_error_t *err, unsigned int id, void *arg);
 
+static void
+on_bad_tx(const btc_verify_error_t *err, unsigned int id, void *arg);
+
 /*
  * Wallet Client Calls
  */
@@ -154,11 +159,17 @@ btc_node_create(const btc_network_t *network) {
   }
 
   node->rpc = btc_rpc_create(node);
+  node->notifier = btc_notifier_create(node->loop);
+  node->stratum = btc_stratum_create(network, node->loop,
+                                     node->chain, node->miner);
+  node->timer = btc_timer_create(node->loop, btc_wallet_tick, node->wallet);
 
   btc_chain_set_logger(node->chain, node->logger);
   btc_mempool_set_logger(node->mempool, node->logger);
   btc_miner_set_logger(node->miner, node->logger);
   btc_pool_set_logger(node->pool, node->logger);
+  btc_notifier_set_logger(node->notifier, node->logger);
+  btc_stratum_set_logger(node->stratum, node->logger);
 
   btc_chain_set_timedata(node->chain, node->timedata);
   btc_mempool_set_timedata(node->mempool, node->timedata);
@@ -175,12 +186,16 @@ btc_node_create(const btc_network_t *network) {
   btc_mempool_set_context(node->mempool, node);
   btc_mempool_on_tx(node->mempool, on_tx);
   btc_mempool_on_badorphan(node->mempool, on_bad_tx_orphan);
+  btc_mempool_on_reject(node->mempool, on_bad_tx);
 
   return node;
 }
 
 void
 btc_node_destroy(btc_node_t *node) {
+  btc_timer_destroy(node->timer);
+  btc_stratum_destroy(node->stratum);
+  btc_notifier_destroy(node->notifier);
   btc_rpc_destroy(node->rpc);
   btc_wallet_destroy(node->wallet);
   btc_pool_destroy(node->pool);
@@ -247,6 +262,16 @@ btc_node_open(btc_node_t *node, const char *prefix, unsigned int flags) {
     goto fail6;
   }
 
+  if (!btc_notifier_open(node->notifier, prefix)) {
+    btc_log_error(node, "Failed to open notifier.");
+    goto fail7;
+  }
+
+  if (!btc_stratum_open(node->stratum)) {
+    btc_log_error(node, "Failed to open stratum server.");
+    goto fail8;
+  }
+
   {
     btc_address_t addr;
 
@@ -255,9 +280,14 @@ btc_node_open(btc_node_t *node, const char *prefix, unsigned int flags) {
     btc_miner_add_address(node->miner, &addr);
   }
 
-  btc_loop_on_tick(node->loop, btc_wallet_tick, node->wallet);
+  btc_loop_on_tick(node->loop, btc_mempool_tick, node->mempool);
+  btc_timer_start(node->timer, 1000, 1000);
 
   return 1;
+fail8:
+  btc_notifier_close(node->notifier);
+fail7:
+  btc_rpc_close(node->rpc);
 fail6:
   btc_wallet_close(node->wallet);
 fail5:
@@ -278,8 +308,11 @@ void
 btc_node_close(btc_node_t *node) {
   btc_log_info(node, "Closing node.");
 
-  btc_loop_off_tick(node->loop, btc_wallet_tick, node->wallet);
+  btc_timer_stop(node->timer);
+  btc_loop_off_tick(node->loop, btc_mempool_tick, node->mempool);
 
+  btc_stratum_close(node->stratum);
+  btc_notifier_close(node->notifier);
   btc_rpc_close(node->rpc);
   btc_wallet_close(node->wallet);
   btc_pool_close(node->pool);
@@ -314,6 +347,7 @@ on_connect(const btc_entry_t *entry,
 
   btc_mempool_add_block(node->mempool, entry, block);
   btc_wallet_add_block(node->wallet, entry, block);
+  btc_notifier_connect(node->notifier, entry, block);
 }
 
 static void
@@ -327,16 +361,15 @@ on_disconnect(const btc_entry_t *entry,
 
   btc_mempool_remove_block(node->mempool, entry, block);
   btc_wallet_remove_block(node->wallet, entry);
+  btc_notifier_disconnect(node->notifier, entry);
 }
 
 static void
 on_reorganize(const btc_entry_t *old, const btc_entry_t *new_, void *arg) {
   btc_node_t *node = (btc_node_t *)arg;
 
-  (void)old;
-  (void)new_;
-
   btc_mempool_handle_reorg(node->mempool);
+  btc_notifier_reorganize(node->notifier, old, new_);
 }
 
 static void
@@ -362,6 +395,7 @@ on_tx(const btc_mpentry_t *entry, const btc_view_t *view, void *arg) {
 
   btc_pool_announce_tx(node->pool, entry);
   btc_wallet_add_tx(node->wallet, entry->tx);
+  btc_notifier_tx(node->notifier, entry->tx);
 }
 
 static void
@@ -370,3 +404,10 @@ on_bad_tx_orphan(const btc_verify_error_t *err, unsigned int id, void *arg) {
 
   btc_pool_handle_badorphan(node->pool, "tx", err, id);
 }
+
+static void
+on_bad_tx(const btc_verify_error_t *err, unsigned int id, void *arg) {
+  btc_node_t *node = (btc_node_t *)arg;
+
+  btc_pool_handle_reject(node->pool, "tx", err, id);
+}
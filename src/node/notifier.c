@@ -0,0 +1,374 @@
+/*!
+ * notifier.c - block and tx notifications for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/notifier.h>
+
+#include <mako/block.h>
+#include <mako/entry.h>
+#include <mako/list.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include "../impl.h"
+#include "../internal.h"
+
+/*
+ * Constants
+ */
+
+#define NOTIFY_HEADER_SIZE 9
+#define NOTIFY_MAX_BUFFER (64 << 20)
+
+/*
+ * Types
+ */
+
+typedef struct btc_subscriber_s {
+  struct btc_notifier_s *notifier;
+  btc_socket_t *socket;
+  unsigned int topics;
+  struct btc_subscriber_s *prev;
+  struct btc_subscriber_s *next;
+} btc_subscriber_t;
+
+typedef struct btc_sublist_s {
+  btc_subscriber_t *head;
+  btc_subscriber_t *tail;
+  size_t length;
+} btc_sublist_t;
+
+struct btc_notifier_s {
+  btc_loop_t *loop;
+  btc_logger_t *logger;
+  btc_server_t *server;
+  char path[BTC_PATH_MAX];
+  char file[BTC_PATH_MAX];
+  int port;
+  btc_sublist_t subs;
+  uint32_t sequence[5];
+};
+
+BTC_DEFINE_LOGGER(btc_log, btc_notifier_t, "notifier")
+
+/*
+ * Subscriber
+ */
+
+static void
+on_close(btc_socket_t *socket) {
+  btc_subscriber_t *sub = btc_socket_get_data(socket);
+  btc_notifier_t *notifier = sub->notifier;
+
+  btc_list_remove(&notifier->subs, sub, btc_subscriber_t);
+
+  btc_free(sub);
+}
+
+static void
+on_error(btc_socket_t *socket) {
+  btc_socket_close(socket);
+}
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  btc_subscriber_t *sub = btc_socket_get_data(socket);
+  const uint8_t *raw = data;
+
+  if (size > 0)
+    sub->topics = raw[size - 1] & BTC_NOTIFY_ALL;
+
+  return 1;
+}
+
+static void
+on_socket(btc_socket_t *parent, btc_socket_t *child) {
+  btc_notifier_t *notifier = btc_socket_get_data(parent);
+  btc_subscriber_t *sub = btc_malloc(sizeof(btc_subscriber_t));
+
+  sub->notifier = notifier;
+  sub->socket = child;
+  sub->topics = 0;
+  sub->prev = NULL;
+  sub->next = NULL;
+
+  btc_list_push(&notifier->subs, sub, btc_subscriber_t);
+
+  btc_socket_set_data(child, sub);
+  btc_socket_on_close(child, on_close);
+  btc_socket_on_error(child, on_error);
+  btc_socket_on_data(child, on_data);
+}
+
+/*
+ * Notifier
+ */
+
+btc_notifier_t *
+btc_notifier_create(btc_loop_t *loop) {
+  btc_notifier_t *notifier = btc_malloc(sizeof(btc_notifier_t));
+
+  memset(notifier, 0, sizeof(*notifier));
+
+  notifier->loop = loop;
+  notifier->logger = NULL;
+  notifier->server = btc_server_create(loop);
+  notifier->port = 0;
+
+  btc_list_init(&notifier->subs);
+
+  btc_server_set_data(notifier->server, notifier);
+  btc_server_on_socket(notifier->server, on_socket);
+
+  return notifier;
+}
+
+void
+btc_notifier_destroy(btc_notifier_t *notifier) {
+  btc_server_destroy(notifier->server);
+  btc_free(notifier);
+}
+
+void
+btc_notifier_set_logger(btc_notifier_t *notifier, btc_logger_t *logger) {
+  notifier->logger = logger;
+}
+
+void
+btc_notifier_set_path(btc_notifier_t *notifier, const char *path) {
+  CHECK(btc_strcpy(notifier->path, sizeof(notifier->path), path));
+}
+
+void
+btc_notifier_set_port(btc_notifier_t *notifier, int port) {
+  CHECK(port >= 0 && port <= 0xffff);
+  notifier->port = port;
+}
+
+int
+btc_notifier_open(btc_notifier_t *notifier, const char *prefix) {
+  if (*notifier->path == '\0' && notifier->port == 0)
+    return 1;
+
+  btc_log_info(notifier, "Opening notifier.");
+
+  if (*notifier->path != '\0') {
+    char *file = notifier->file;
+    size_t size = sizeof(notifier->file);
+
+    /* Relative paths live in the data directory. */
+    if (notifier->path[0] == '/')
+      CHECK(btc_strcpy(file, size, notifier->path));
+    else if (!btc_path_join(file, size, prefix, notifier->path))
+      goto fail;
+
+    if (!btc_server_listen_unix(notifier->server, file)) {
+      const char *msg = btc_server_strerror(notifier->server);
+
+      btc_log_error(notifier, "Could not listen on %s: %s.", file, msg);
+
+      goto fail;
+    }
+
+    btc_log_info(notifier, "Listening on %s.", file);
+  }
+
+  if (notifier->port != 0) {
+    int port = notifier->port;
+
+    if (!btc_server_listen_local(notifier->server, port)) {
+      const char *msg = btc_server_strerror(notifier->server);
+
+      btc_log_error(notifier, "Could not listen on port %d: %s.", port, msg);
+
+      goto fail;
+    }
+
+    btc_log_info(notifier, "Listening on port %d.", port);
+  }
+
+  return 1;
+fail:
+  btc_notifier_close(notifier);
+  return 0;
+}
+
+void
+btc_notifier_close(btc_notifier_t *notifier) {
+  btc_subscriber_t *sub;
+
+  btc_server_close(notifier->server);
+
+  for (sub = notifier->subs.head; sub != NULL; sub = sub->next)
+    btc_socket_close(sub->socket);
+
+  if (*notifier->file != '\0') {
+    btc_fs_unlink(notifier->file);
+    *notifier->file = '\0';
+  }
+}
+
+static int
+btc_notifier_wants(btc_notifier_t *notifier, unsigned int topics) {
+  btc_subscriber_t *sub;
+
+  for (sub = notifier->subs.head; sub != NULL; sub = sub->next) {
+    if (sub->topics & topics)
+      return 1;
+  }
+
+  return 0;
+}
+
+static int
+btc_topic_index(unsigned int topic) {
+  int index = 0;
+
+  while (!(topic & 1)) {
+    topic >>= 1;
+    index++;
+  }
+
+  return index;
+}
+
+static btc_iobuf_t *
+btc_notifier_frame(btc_notifier_t *notifier,
+                   unsigned int topic,
+                   size_t length) {
+  btc_iobuf_t *buf = btc_iobuf_create(notifier->loop,
+                                      NOTIFY_HEADER_SIZE + length);
+  uint32_t sequence = notifier->sequence[btc_topic_index(topic)]++;
+  uint8_t *zp = buf->data;
+
+  zp = btc_uint8_write(zp, topic);
+  zp = btc_uint32_write(zp, sequence);
+  zp = btc_uint32_write(zp, length);
+
+  return buf;
+}
+
+static void
+btc_notifier_publish(btc_notifier_t *notifier,
+                     unsigned int topic,
+                     btc_iobuf_t *buf) {
+  btc_subscriber_t *sub, *next;
+
+  for (sub = notifier->subs.head; sub != NULL; sub = next) {
+    btc_socket_t *socket = sub->socket;
+
+    next = sub->next;
+
+    if (!(sub->topics & topic))
+      continue;
+
+    /* Never let a stalled reader hold memory hostage. */
+    if (btc_socket_buffered(socket) > NOTIFY_MAX_BUFFER) {
+      btc_log_debug(notifier, "Dropping slow subscriber.");
+      btc_socket_close(socket);
+      continue;
+    }
+
+    btc_socket_write_buf(socket, buf);
+  }
+
+  btc_iobuf_destroy(buf);
+}
+
+static void
+btc_notifier_hash(btc_notifier_t *notifier,
+                  unsigned int topic,
+                  const uint8_t *hash) {
+  btc_iobuf_t *buf = btc_notifier_frame(notifier, topic, 32);
+
+  memcpy(buf->data + NOTIFY_HEADER_SIZE, hash, 32);
+
+  btc_notifier_publish(notifier, topic, buf);
+}
+
+static void
+btc_notifier_sequence(btc_notifier_t *notifier,
+                      const uint8_t *hash,
+                      int label) {
+  btc_iobuf_t *buf = btc_notifier_frame(notifier, BTC_NOTIFY_SEQUENCE, 33);
+
+  memcpy(buf->data + NOTIFY_HEADER_SIZE, hash, 32);
+
+  buf->data[NOTIFY_HEADER_SIZE + 32] = label;
+
+  btc_notifier_publish(notifier, BTC_NOTIFY_SEQUENCE, buf);
+}
+
+void
+btc_notifier_connect(btc_notifier_t *notifier,
+                     const btc_entry_t *entry,
+                     const btc_block_t *block) {
+  if (notifier->subs.length == 0)
+    return;
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_HASHBLOCK))
+    btc_notifier_hash(notifier, BTC_NOTIFY_HASHBLOCK, entry->hash);
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_RAWBLOCK)) {
+    size_t size = btc_block_size(block);
+    btc_iobuf_t *buf = btc_notifier_frame(notifier, BTC_NOTIFY_RAWBLOCK, size);
+
+    btc_block_write(buf->data + NOTIFY_HEADER_SIZE, block);
+    btc_notifier_publish(notifier, BTC_NOTIFY_RAWBLOCK, buf);
+  }
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_SEQUENCE))
+    btc_notifier_sequence(notifier, entry->hash, 'C');
+}
+
+void
+btc_notifier_disconnect(btc_notifier_t *notifier, const btc_entry_t *entry) {
+  if (notifier->subs.length == 0)
+    return;
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_SEQUENCE))
+    btc_notifier_sequence(notifier, entry->hash, 'D');
+}
+
+void
+btc_notifier_reorganize(btc_notifier_t *notifier,
+                        const btc_entry_t *old,
+                        const btc_entry_t *new_) {
+  (void)old;
+
+  if (notifier->subs.length == 0)
+    return;
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_SEQUENCE))
+    btc_notifier_sequence(notifier, new_->hash, 'R');
+}
+
+void
+btc_notifier_tx(btc_notifier_t *notifier, const btc_tx_t *tx) {
+  if (notifier->subs.length == 0)
+    return;
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_HASHTX))
+    btc_notifier_hash(notifier, BTC_NOTIFY_HASHTX, tx->hash);
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_RAWTX)) {
+    size_t size = btc_tx_size(tx);
+    btc_iobuf_t *buf = btc_notifier_frame(notifier, BTC_NOTIFY_RAWTX, size);
+
+    btc_tx_write(buf->data + NOTIFY_HEADER_SIZE, tx);
+    btc_notifier_publish(notifier, BTC_NOTIFY_RAWTX, buf);
+  }
+
+  if (btc_notifier_wants(notifier, BTC_NOTIFY_SEQUENCE))
+    btc_notifier_sequence(notifier, tx->hash, 'A');
+}
@@ -4,6 +4,7 @@
  * https://github.com/chjj/mako
  */
 
+#include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -56,6 +57,25 @@ enum btc_peer_state {
   BTC_PEER_DEAD
 };
 
+enum btc_frame_type {
+  BTC_FRAME_BLOCK,
+  BTC_FRAME_WITNESS_BLOCK,
+  BTC_FRAME_CMPCT,
+  BTC_FRAME_WITNESS_CMPCT,
+  BTC_FRAME_HEADERS,
+  BTC_FRAME_MAX
+};
+
+#define BTC_POOL_RECENT 8
+#define BTC_POOL_HISTORICAL 1008
+#define BTC_POOL_UPLOAD_BURST (8 << 20)
+#define BTC_POOL_TX_DELAY 2000
+#define BTC_POOL_TX_TIMEOUT 10000
+#define BTC_POOL_TX_INFLIGHT 100
+#define BTC_POOL_INV_INBOUND 5000
+#define BTC_POOL_INV_OUTBOUND 2000
+#define BTC_POOL_TXLOG_MAX 50000
+
 /*
  * Types
  */
@@ -65,27 +85,134 @@ typedef void btc_parser_on_error_cb(void *arg);
 
 typedef struct btc_parser_s {
   uint32_t magic;
-  uint8_t *pending;
-  size_t alloc;
-  size_t total;
-  size_t waiting;
   int closed;
   /* Header */
+  uint8_t header[24];
+  size_t header_len;
   char cmd[12];
   int has_header;
   uint32_t checksum;
+  /* Body */
+  uint8_t *body;
+  size_t alloc;
+  size_t total;
+  size_t waiting;
+  btc_hash256_t hash;
   /* Callback */
   btc_parser_on_msg_cb *on_msg;
   btc_parser_on_error_cb *on_error;
   void *arg;
 } btc_parser_t;
 
+enum btc_netev_type {
+  /* Core -> I/O thread. */
+  BTC_NETOP_CONNECT,
+  BTC_NETOP_ATTACH,
+  BTC_NETOP_WRITE,
+  BTC_NETOP_CLOSE,
+  BTC_NETOP_RELEASE,
+  BTC_NETOP_STOP,
+  /* I/O thread -> core. */
+  BTC_NETEV_CONNECT,
+  BTC_NETEV_MSG,
+  BTC_NETEV_DRAIN,
+  BTC_NETEV_ERROR,
+  BTC_NETEV_HANGUP,
+  BTC_NETEV_PARSE,
+  BTC_NETEV_CLOSE
+};
+
+typedef struct btc_netev_s {
+  enum btc_netev_type type;
+  struct btc_conn_s *conn;
+  btc_msg_t msg;
+  uint8_t *raw;
+  void *data;
+  size_t length;
+  btc_iobuf_t *buf;
+  btc_sockaddr_t addr;
+  btc_socket_t *socket;
+  uint64_t written;
+  char error[128];
+  struct btc_netev_s *next;
+} btc_netev_t;
+
+typedef struct btc_netq_s {
+  btc_mutex_t lock;
+  btc_netev_t *head;
+  btc_netev_t *tail;
+} btc_netq_t;
+
+typedef struct btc_netthread_s {
+  btc_pool_t *pool;
+  btc_loop_t *loop;
+  btc_thread_t thread;
+  btc_netq_t ops;
+  size_t peers;
+  int stopped;
+} btc_netthread_t;
+
+typedef struct btc_conn_s {
+  /* Owned by the I/O thread once posted. */
+  btc_netthread_t *thread;
+  struct btc_peer_s *peer;
+  btc_socket_t *socket;
+  btc_parser_t parser;
+  uint64_t written;
+  uint64_t reported;
+} btc_conn_t;
+
 typedef struct btc_sendqueue_s {
   btc_invitem_t *head;
   btc_invitem_t *tail;
   size_t length;
 } btc_sendqueue_t;
 
+typedef struct btc_txlog_s {
+  uint8_t *items;
+  uint64_t start;
+  size_t length;
+  size_t alloc;
+} btc_txlog_t;
+
+typedef struct btc_txinv_s {
+  const btc_mpentry_t *entry;
+  int64_t rate;
+  int depth;
+  size_t index;
+} btc_txinv_t;
+
+typedef struct btc_txann_s {
+  struct btc_txreq_s *req;
+  struct btc_peer_s *peer;
+  int64_t time;
+  int failed;
+  struct btc_txann_s *prev;
+  struct btc_txann_s *next;
+  struct btc_txann_s *peer_prev;
+  struct btc_txann_s *peer_next;
+} btc_txann_t;
+
+typedef struct btc_txreq_s {
+  uint8_t hash[32];
+  btc_txann_t *head;
+  btc_txann_t *tail;
+  size_t length;
+  size_t live;
+  btc_txann_t *active;
+  int64_t time;
+  int64_t timeout;
+  struct btc_txqueue_s *queue;
+  struct btc_txreq_s *prev;
+  struct btc_txreq_s *next;
+} btc_txreq_t;
+
+typedef struct btc_txqueue_s {
+  btc_txreq_t *head;
+  btc_txreq_t *tail;
+  size_t length;
+} btc_txqueue_t;
+
 typedef struct btc_peer_s {
   btc_pool_t *pool;
   const btc_network_t *network;
@@ -93,6 +220,9 @@ typedef struct btc_peer_s {
   btc_loop_t *loop;
   btc_socket_t *socket;
   btc_parser_t parser;
+  btc_conn_t *conn;
+  uint64_t queued;
+  uint64_t flushed;
   btc_sendqueue_t sending;
   enum btc_peer_state state;
   unsigned int id;
@@ -104,6 +234,7 @@ typedef struct btc_peer_s {
   int64_t time;
   int64_t last_send;
   int64_t last_recv;
+  btc_traffic_t traffic;
   int ban_score;
   btc_inv_t inv_queue;
   uint32_t version;
@@ -131,12 +262,18 @@ typedef struct btc_peer_s {
   int64_t gh_time;
   int64_t ping_timer;
   int64_t inv_timer;
+  uint64_t tx_seq;
   int64_t stall_timer;
   btc_filter_t addr_filter;
   btc_filter_t inv_filter;
   btc_bloom_t *spv_filter;
   btc_hashtab_t block_map;
-  btc_hashtab_t tx_map;
+  btc_txann_t *tx_head;
+  btc_hashmap_t tx_map;
+  btc_filter_t tx_filter;
+  size_t tx_count;
+  size_t tx_inflight;
+  btc_zinv_t tx_wanted;
   btc_hashmap_t compact_map;
   struct btc_peer_s *prev;
   struct btc_peer_s *next;
@@ -146,6 +283,11 @@ typedef struct btc_nonces_s {
   btc_longset_t set;
 } btc_nonces_t;
 
+typedef struct btc_recent_s {
+  uint8_t hash[32];
+  btc_iobuf_t *frames[BTC_FRAME_MAX];
+} btc_recent_t;
+
 typedef struct btc_peers_s {
   btc_netmap_t map;
   btc_intmap_t ids;
@@ -158,8 +300,10 @@ typedef struct btc_peers_s {
 } btc_peers_t;
 
 typedef struct btc_hdrnode_s {
-  uint8_t hash[32];
-  int32_t height;
+  btc_entry_t entry;
+  btc_block_t *block;
+  unsigned int flags;
+  unsigned int id;
   struct btc_hdrnode_s *next;
 } btc_hdrnode_t;
 
@@ -184,14 +328,31 @@ struct btc_pool_s {
   btc_peers_t peers;
   btc_nonces_t nonces;
   btc_hashset_t block_map;
-  btc_hashset_t tx_map;
+  btc_hashmap_t tx_map;
+  btc_txqueue_t tx_delayed;
+  btc_txqueue_t tx_pending;
+  btc_txqueue_t tx_inflight;
+  btc_txlog_t tx_log;
+  int64_t inv_timer;
   btc_hashset_t compact_map;
   int block_mode;
   int checkpoints;
   const btc_checkpoint_t *header_tip;
   btc_hdrnode_t *header_head;
   btc_hdrnode_t *header_tail;
-  btc_hdrnode_t *header_next;
+  btc_hashmap_t header_map;
+  size_t header_bytes;
+  int headers_done;
+  btc_timer_t *timer;
+  btc_netthread_t *threads;
+  int thread_count;
+  btc_netq_t events;
+  btc_recent_t recent[BTC_POOL_RECENT];
+  size_t recent_index;
+  btc_traffic_t traffic;
+  uint64_t max_upload;
+  int64_t upload_tokens;
+  int64_t upload_time;
   int64_t refill_timer;
   int64_t flush_timer;
   unsigned int id;
@@ -241,6 +402,128 @@ btc_nonces_remove(btc_nonces_t *list, uint64_t nonce) {
   return btc_longset_del(&list->set, nonce) != 0;
 }
 
+/*
+ * Recent Blocks
+ */
+
+static void
+btc_recent_init(btc_recent_t *slot) {
+  memset(slot, 0, sizeof(*slot));
+}
+
+static void
+btc_recent_clear(btc_recent_t *slot) {
+  int i;
+
+  for (i = 0; i < BTC_FRAME_MAX; i++) {
+    if (slot->frames[i] != NULL)
+      btc_iobuf_destroy(slot->frames[i]);
+  }
+
+  btc_recent_init(slot);
+}
+
+/*
+ * Traffic
+ */
+
+static enum btc_msgtype
+btc_traffic_type(enum btc_msgtype type) {
+  /* Internal types are accounted under their wire command. */
+  switch (type) {
+    case BTC_MSG_BLOCKTXN_BASE:
+      return BTC_MSG_BLOCKTXN;
+    case BTC_MSG_BLOCK_BASE:
+      return BTC_MSG_BLOCK;
+    case BTC_MSG_CMPCTBLOCK_BASE:
+      return BTC_MSG_CMPCTBLOCK;
+    case BTC_MSG_GETDATA_FULL:
+      return BTC_MSG_GETDATA;
+    case BTC_MSG_INV_FULL:
+      return BTC_MSG_INV;
+    case BTC_MSG_NOTFOUND_FULL:
+      return BTC_MSG_NOTFOUND;
+    case BTC_MSG_TX_BASE:
+      return BTC_MSG_TX;
+    default:
+      return type;
+  }
+}
+
+static void
+btc_traffic_send(btc_traffic_t *traffic, enum btc_msgtype type, size_t size) {
+  traffic->bytes_sent += size;
+  traffic->sent[btc_traffic_type(type)] += size;
+}
+
+static void
+btc_traffic_recv(btc_traffic_t *traffic, enum btc_msgtype type, size_t size) {
+  traffic->bytes_recv += size;
+  traffic->recv[btc_traffic_type(type)] += size;
+}
+
+/*
+ * Tx Log
+ */
+
+static void
+btc_txlog_init(btc_txlog_t *log) {
+  log->items = NULL;
+  log->start = 0;
+  log->length = 0;
+  log->alloc = 0;
+}
+
+static void
+btc_txlog_clear(btc_txlog_t *log) {
+  if (log->items != NULL)
+    btc_free(log->items);
+
+  btc_txlog_init(log);
+}
+
+static uint64_t
+btc_txlog_end(const btc_txlog_t *log) {
+  return log->start + log->length;
+}
+
+static const uint8_t *
+btc_txlog_get(const btc_txlog_t *log, uint64_t seq) {
+  return log->items + (size_t)(seq - log->start) * 32;
+}
+
+static void
+btc_txlog_push(btc_txlog_t *log, const uint8_t *hash) {
+  if (log->length == log->alloc) {
+    log->alloc = log->alloc == 0 ? 64 : log->alloc * 2;
+    log->items = btc_realloc(log->items, log->alloc * 32);
+  }
+
+  memcpy(log->items + log->length * 32, hash, 32);
+
+  log->length++;
+}
+
+static void
+btc_txlog_trim(btc_txlog_t *log, uint64_t seq) {
+  size_t count = seq - log->start;
+
+  if (count == 0)
+    return;
+
+  memmove(log->items, log->items + count * 32, (log->length - count) * 32);
+
+  log->start = seq;
+  log->length -= count;
+}
+
+static int64_t
+btc_poisson(int64_t now, int64_t mean) {
+  /* Exponentially distributed delay with the given mean. */
+  double u = ((double)btc_random() + 1.0) / 4294967296.0;
+  return now + (int64_t)(-log(u) * (double)mean + 0.5);
+}
+
 /*
  * Parser
  */
@@ -248,14 +531,15 @@ btc_nonces_remove(btc_nonces_t *list, uint64_t nonce) {
 static void
 btc_parser_init(btc_parser_t *parser, uint32_t magic) {
   parser->magic = magic;
-  parser->pending = NULL;
-  parser->alloc = 0;
-  parser->total = 0;
-  parser->waiting = 24;
   parser->closed = 0;
+  parser->header_len = 0;
   parser->cmd[0] = '\0';
   parser->has_header = 0;
   parser->checksum = 0;
+  parser->body = NULL;
+  parser->alloc = 0;
+  parser->total = 0;
+  parser->waiting = 0;
   parser->on_msg = NULL;
   parser->on_error = NULL;
   parser->arg = NULL;
@@ -264,76 +548,82 @@ btc_parser_init(btc_parser_t *parser, uint32_t magic) {
 static void
 btc_parser_clear(btc_parser_t *parser) {
   if (parser->alloc > 0)
-    btc_free(parser->pending);
-
-  parser->pending = NULL;
-}
+    btc_free(parser->body);
 
-static uint8_t *
-btc_parser_append(btc_parser_t *parser, const uint8_t *data, size_t length) {
-  if (parser->closed)
-    return parser->pending;
-
-  if (parser->total + length > parser->alloc) {
-    parser->pending = btc_realloc(parser->pending, parser->total + length);
-    parser->alloc = parser->total + length;
-  }
-
-  if (length > 0)
-    memcpy(parser->pending + parser->total, data, length);
-
-  parser->total += length;
-
-  return parser->pending;
+  parser->body = NULL;
+  parser->alloc = 0;
 }
 
 static int
-btc_parser_parse_header(btc_parser_t *parser, const uint8_t **xp, size_t *xn) {
+btc_parser_parse_header(btc_parser_t *parser) {
+  const uint8_t *xp = parser->header;
+  size_t xn = sizeof(parser->header);
   uint32_t magic, size;
 
-  if (!btc_uint32_read(&magic, xp, xn))
+  if (!btc_uint32_read(&magic, &xp, &xn))
     return 0;
 
   if (magic != parser->magic)
     return 0;
 
-  if (!btc_nullstr_read(parser->cmd, sizeof(parser->cmd), xp, xn))
+  if (!btc_nullstr_read(parser->cmd, sizeof(parser->cmd), &xp, &xn))
     return 0;
 
-  if (!btc_uint32_read(&size, xp, xn))
+  if (!btc_uint32_read(&size, &xp, &xn))
     return 0;
 
   if (size > BTC_NET_MAX_MESSAGE)
     return 0;
 
-  if (!btc_uint32_read(&parser->checksum, xp, xn))
+  if (!btc_uint32_read(&parser->checksum, &xp, &xn))
     return 0;
 
+  /* Only trust the advertised size as far as the
+     first chunk; the rest is allocated as it arrives. */
+  if (size > parser->alloc && parser->alloc < BTC_NET_PARSER_INITIAL) {
+    btc_parser_clear(parser);
+
+    parser->alloc = BTC_MIN(size, BTC_NET_PARSER_INITIAL);
+    parser->body = (uint8_t *)btc_malloc(parser->alloc);
+  }
+
+  parser->total = 0;
   parser->waiting = size;
   parser->has_header = 1;
 
+  btc_hash256_init(&parser->hash);
+
   return 1;
 }
 
-static int
-btc_parser_parse(btc_parser_t *parser, const uint8_t *data, size_t length) {
-  btc_msg_t msg;
+static void
+btc_parser_grow(btc_parser_t *parser, size_t size) {
+  size_t alloc = parser->alloc;
 
-  CHECK(length <= BTC_NET_MAX_MESSAGE);
+  while (alloc < size)
+    alloc *= 2;
 
-  if (!parser->has_header)
-    return btc_parser_parse_header(parser, &data, &length);
+  if (alloc > parser->waiting)
+    alloc = parser->waiting;
 
-  parser->waiting = 24;
-  parser->has_header = 0;
+  parser->body = (uint8_t *)btc_realloc(parser->body, alloc);
+  parser->alloc = alloc;
+}
+
+static int
+btc_parser_parse_body(btc_parser_t *parser) {
+  uint8_t hash[32];
+  btc_msg_t msg;
+
+  btc_hash256_final(&parser->hash, hash);
 
-  if (btc_checksum(data, length) != parser->checksum)
+  if (btc_read32le(hash) != parser->checksum)
     return 0;
 
   btc_msg_set_cmd(&msg, parser->cmd);
   btc_msg_alloc(&msg);
 
-  if (!btc_msg_import(&msg, data, length)) {
+  if (!btc_msg_import(&msg, parser->body, parser->total)) {
     btc_msg_clear(&msg);
     return 0;
   }
@@ -347,31 +637,169 @@ btc_parser_parse(btc_parser_t *parser, const uint8_t *data, size_t length) {
 
 static int
 btc_parser_feed(btc_parser_t *parser, const uint8_t *data, size_t length) {
-  uint8_t *ptr = btc_parser_append(parser, data, length);
-  size_t len = parser->total;
   int parsed = 0;
+  size_t size;
+
+  while (!parser->closed) {
+    if (!parser->has_header) {
+      if (length == 0)
+        break;
+
+      size = sizeof(parser->header) - parser->header_len;
+
+      if (size > length)
+        size = length;
+
+      memcpy(parser->header + parser->header_len, data, size);
+
+      parser->header_len += size;
+
+      data += size;
+      length -= size;
+
+      if (parser->header_len < sizeof(parser->header))
+        break;
+
+      parser->header_len = 0;
+
+      if (!btc_parser_parse_header(parser))
+        parser->on_error(parser->arg);
 
-  while (!parser->closed && len >= parser->waiting) {
-    size_t size = parser->waiting;
+      continue;
+    }
+
+    size = parser->waiting - parser->total;
+
+    if (size > length)
+      size = length;
+
+    if (size > 0) {
+      if (parser->total + size > parser->alloc)
+        btc_parser_grow(parser, parser->total + size);
+
+      memcpy(parser->body + parser->total, data, size);
+
+      btc_hash256_update(&parser->hash, data, size);
 
-    if (parser->has_header)
-      parsed = 1;
+      parser->total += size;
 
-    if (!btc_parser_parse(parser, ptr, size)) {
+      data += size;
+      length -= size;
+    }
+
+    if (parser->total < parser->waiting)
+      break;
+
+    parser->has_header = 0;
+    parsed = 1;
+
+    if (!btc_parser_parse_body(parser)) {
       if (!parser->closed)
         parser->on_error(parser->arg);
     }
 
-    ptr += size;
-    len -= size;
+    /* Don't let one large message pin memory for the peer's lifetime. */
+    if (parser->alloc > BTC_NET_PARSER_RETAIN)
+      btc_parser_clear(parser);
   }
 
-  if (len > 0 && ptr != parser->pending)
-    memmove(parser->pending, ptr, len);
+  return parsed;
+}
+
+static uint8_t *
+btc_parser_detach(btc_parser_t *parser) {
+  uint8_t *body = parser->body;
 
-  parser->total = len;
+  parser->body = NULL;
+  parser->alloc = 0;
 
-  return parsed;
+  return body;
+}
+
+/*
+ * Network Queue
+ */
+
+static btc_netev_t *
+btc_netev_create(enum btc_netev_type type, btc_conn_t *conn) {
+  btc_netev_t *ev = btc_malloc(sizeof(btc_netev_t));
+
+  memset(ev, 0, sizeof(*ev));
+
+  btc_msg_init(&ev->msg);
+
+  ev->type = type;
+  ev->conn = conn;
+
+  return ev;
+}
+
+static void
+btc_netev_destroy(btc_netev_t *ev) {
+  btc_msg_clear(&ev->msg);
+
+  if (ev->raw != NULL)
+    btc_free(ev->raw);
+
+  if (ev->data != NULL)
+    btc_free(ev->data);
+
+  if (ev->buf != NULL)
+    btc_iobuf_destroy(ev->buf);
+
+  btc_free(ev);
+}
+
+static void
+btc_netq_init(btc_netq_t *queue) {
+  btc_mutex_init(&queue->lock);
+
+  queue->head = NULL;
+  queue->tail = NULL;
+}
+
+static void
+btc_netq_clear(btc_netq_t *queue) {
+  CHECK(queue->head == NULL);
+
+  btc_mutex_destroy(&queue->lock);
+}
+
+static int
+btc_netq_push(btc_netq_t *queue, btc_netev_t *ev) {
+  int empty;
+
+  btc_mutex_lock(&queue->lock);
+
+  empty = (queue->head == NULL);
+
+  if (empty)
+    queue->head = ev;
+  else
+    queue->tail->next = ev;
+
+  queue->tail = ev;
+
+  btc_mutex_unlock(&queue->lock);
+
+  /* Only the first producer needs to wake the consumer. */
+  return empty;
+}
+
+static btc_netev_t *
+btc_netq_take(btc_netq_t *queue) {
+  btc_netev_t *head;
+
+  btc_mutex_lock(&queue->lock);
+
+  head = queue->head;
+
+  queue->head = NULL;
+  queue->tail = NULL;
+
+  btc_mutex_unlock(&queue->lock);
+
+  return head;
 }
 
 /*
@@ -403,7 +831,7 @@ static void
 btc_peer_on_drain(btc_peer_t *peer);
 
 static void
-btc_peer_on_msg(btc_peer_t *peer, btc_msg_t *msg);
+btc_peer_on_msg(btc_peer_t *peer, btc_msg_t *msg, size_t size);
 
 static void
 btc_peer_on_parse_error(btc_peer_t *peer);
@@ -457,7 +885,8 @@ on_drain(btc_socket_t *socket) {
 
 static void
 on_msg(btc_msg_t *msg, void *arg) {
-  btc_peer_on_msg((btc_peer_t *)arg, msg);
+  btc_peer_t *peer = (btc_peer_t *)arg;
+  btc_peer_on_msg(peer, msg, 24 + peer->parser.total);
 }
 
 static void
@@ -465,6 +894,309 @@ on_parse_error(void *arg) {
   btc_peer_on_parse_error((btc_peer_t *)arg);
 }
 
+/*
+ * Connection (I/O Thread)
+ */
+
+static void
+btc_conn_emit(btc_conn_t *conn, btc_netev_t *ev) {
+  btc_pool_t *pool = conn->thread->pool;
+
+  if (btc_netq_push(&pool->events, ev))
+    btc_loop_wakeup(pool->loop);
+}
+
+static void
+btc_conn_fail(btc_conn_t *conn, enum btc_netev_type type, const char *msg) {
+  btc_netev_t *ev = btc_netev_create(type, conn);
+
+  if (msg != NULL) {
+    strncpy(ev->error, msg, sizeof(ev->error) - 1);
+    ev->error[sizeof(ev->error) - 1] = '\0';
+  }
+
+  btc_conn_emit(conn, ev);
+
+  if (conn->socket != NULL) {
+    conn->parser.closed = 1;
+    btc_socket_close(conn->socket);
+  }
+}
+
+static void
+btc_conn_drained(btc_conn_t *conn) {
+  btc_netev_t *ev = btc_netev_create(BTC_NETEV_DRAIN, conn);
+
+  ev->written = conn->written;
+
+  conn->reported = conn->written;
+
+  btc_conn_emit(conn, ev);
+}
+
+static void
+on_conn_connect(btc_socket_t *socket) {
+  btc_conn_t *conn = (btc_conn_t *)btc_socket_get_data(socket);
+
+  btc_socket_set_nodelay(socket, 1);
+
+  btc_conn_emit(conn, btc_netev_create(BTC_NETEV_CONNECT, conn));
+}
+
+static void
+on_conn_close(btc_socket_t *socket) {
+  btc_conn_t *conn = (btc_conn_t *)btc_socket_get_data(socket);
+
+  conn->socket = NULL;
+  conn->parser.closed = 1;
+
+  /* Always the last event the core sees for this connection. */
+  btc_conn_emit(conn, btc_netev_create(BTC_NETEV_CLOSE, conn));
+}
+
+static void
+on_conn_error(btc_socket_t *socket) {
+  btc_conn_fail((btc_conn_t *)btc_socket_get_data(socket),
+                BTC_NETEV_ERROR,
+                btc_socket_strerror(socket));
+}
+
+static int
+on_conn_data(btc_socket_t *socket, const void *data, size_t size) {
+  btc_conn_t *conn = (btc_conn_t *)btc_socket_get_data(socket);
+
+  if (conn->parser.closed)
+    return 0;
+
+  if (size == 0) {
+    btc_conn_fail(conn, BTC_NETEV_HANGUP, NULL);
+    return 0;
+  }
+
+  return !btc_parser_feed(&conn->parser, (const uint8_t *)data, size);
+}
+
+static void
+on_conn_drain(btc_socket_t *socket) {
+  btc_conn_drained((btc_conn_t *)btc_socket_get_data(socket));
+}
+
+static void
+on_conn_msg(btc_msg_t *msg, void *arg) {
+  btc_conn_t *conn = (btc_conn_t *)arg;
+  btc_netev_t *ev = btc_netev_create(BTC_NETEV_MSG, conn);
+
+  /* The decoded body may point into the receive
+     buffer, so the buffer travels with it. */
+  ev->msg = *msg;
+  ev->length = 24 + conn->parser.total;
+  ev->raw = btc_parser_detach(&conn->parser);
+
+  msg->body = NULL;
+
+  btc_conn_emit(conn, ev);
+}
+
+static void
+on_conn_parse_error(void *arg) {
+  btc_conn_t *conn = (btc_conn_t *)arg;
+
+  btc_conn_emit(conn, btc_netev_create(BTC_NETEV_PARSE, conn));
+}
+
+static btc_conn_t *
+btc_conn_create(btc_netthread_t *thread, struct btc_peer_s *peer) {
+  btc_conn_t *conn = btc_malloc(sizeof(btc_conn_t));
+
+  conn->thread = thread;
+  conn->peer = peer;
+  conn->socket = NULL;
+  conn->written = 0;
+  conn->reported = 0;
+
+  btc_parser_init(&conn->parser, thread->pool->network->magic);
+
+  conn->parser.on_msg = on_conn_msg;
+  conn->parser.on_error = on_conn_parse_error;
+  conn->parser.arg = conn;
+
+  return conn;
+}
+
+static void
+btc_conn_destroy(btc_conn_t *conn) {
+  CHECK(conn->socket == NULL);
+
+  btc_parser_clear(&conn->parser);
+
+  btc_free(conn);
+}
+
+static void
+btc_conn_bind(btc_conn_t *conn, btc_socket_t *socket) {
+  conn->socket = socket;
+
+  btc_socket_set_data(socket, conn);
+  btc_socket_on_connect(socket, on_conn_connect);
+  btc_socket_on_close(socket, on_conn_close);
+  btc_socket_on_error(socket, on_conn_error);
+  btc_socket_on_data(socket, on_conn_data);
+  btc_socket_on_drain(socket, on_conn_drain);
+}
+
+static void
+btc_conn_write(btc_conn_t *conn, btc_netev_t *op) {
+  size_t length = op->length;
+  int rc;
+
+  if (conn->socket == NULL)
+    return;
+
+  if (op->buf != NULL) {
+    rc = btc_socket_write_buf(conn->socket, op->buf);
+  } else {
+    rc = btc_socket_write(conn->socket, op->data, length);
+    op->data = NULL;
+  }
+
+  if (rc == -1) {
+    btc_conn_fail(conn, BTC_NETEV_ERROR, btc_socket_strerror(conn->socket));
+    return;
+  }
+
+  conn->written += length;
+
+  /* Writes that complete immediately never trigger a drain,
+     so report progress now and then to keep the core's view
+     of our send buffer honest. */
+  if (btc_socket_buffered(conn->socket) == 0) {
+    if (conn->written - conn->reported >= (1 << 20))
+      btc_conn_drained(conn);
+  }
+}
+
+static void
+btc_conn_handle(btc_netthread_t *thread, btc_netev_t *op) {
+  btc_conn_t *conn = op->conn;
+
+  switch (op->type) {
+    case BTC_NETOP_CONNECT: {
+      btc_socket_t *socket = btc_loop_connect(thread->loop, &op->addr);
+
+      if (socket == NULL) {
+        btc_conn_fail(conn, BTC_NETEV_ERROR, btc_loop_strerror(thread->loop));
+        btc_conn_emit(conn, btc_netev_create(BTC_NETEV_CLOSE, conn));
+        break;
+      }
+
+      btc_conn_bind(conn, socket);
+
+      break;
+    }
+
+    case BTC_NETOP_ATTACH: {
+      if (!btc_loop_attach(thread->loop, op->socket)) {
+        btc_conn_emit(conn, btc_netev_create(BTC_NETEV_CLOSE, conn));
+        break;
+      }
+
+      btc_conn_bind(conn, op->socket);
+
+      break;
+    }
+
+    case BTC_NETOP_WRITE: {
+      btc_conn_write(conn, op);
+      break;
+    }
+
+    case BTC_NETOP_CLOSE: {
+      if (conn->socket != NULL) {
+        conn->parser.closed = 1;
+        btc_socket_close(conn->socket);
+      }
+      break;
+    }
+
+    case BTC_NETOP_RELEASE: {
+      btc_conn_destroy(conn);
+      break;
+    }
+
+    case BTC_NETOP_STOP: {
+      thread->stopped = 1;
+      break;
+    }
+
+    default: {
+      abort(); /* LCOV_EXCL_LINE */
+      break;
+    }
+  }
+}
+
+/*
+ * Network Thread
+ */
+
+static int
+btc_netthread_run(btc_netthread_t *thread) {
+  btc_netev_t *op = btc_netq_take(&thread->ops);
+  btc_netev_t *next;
+  int ran = 0;
+
+  for (; op != NULL; op = next) {
+    next = op->next;
+
+    btc_conn_handle(thread, op);
+    btc_netev_destroy(op);
+
+    ran = 1;
+  }
+
+  return ran;
+}
+
+static void
+on_ops(void *arg) {
+  btc_netthread_run((btc_netthread_t *)arg);
+}
+
+static void
+btc_netthread_main(void *arg) {
+  btc_netthread_t *thread = (btc_netthread_t *)arg;
+
+  while (!thread->stopped)
+    btc_loop_poll(thread->loop, -1);
+
+  btc_loop_close(thread->loop);
+}
+
+static void
+btc_netthread_init(btc_netthread_t *thread, btc_pool_t *pool) {
+  thread->pool = pool;
+  thread->loop = btc_loop_create();
+  thread->peers = 0;
+  thread->stopped = 0;
+
+  btc_netq_init(&thread->ops);
+
+  btc_loop_on_tick(thread->loop, on_ops, thread);
+}
+
+static void
+btc_netthread_clear(btc_netthread_t *thread) {
+  btc_loop_off_tick(thread->loop, on_ops, thread);
+  btc_loop_destroy(thread->loop);
+  btc_netq_clear(&thread->ops);
+}
+
+static void
+btc_netthread_post(btc_netthread_t *thread, btc_netev_t *op) {
+  if (btc_netq_push(&thread->ops, op))
+    btc_loop_wakeup(thread->loop);
+}
+
 /*
  * Peer
  */
@@ -498,6 +1230,8 @@ btc_peer_create(btc_pool_t *pool) {
   peer->gb_time = -1;
   peer->gh_time = -1;
 
+  peer->tx_seq = btc_txlog_end(&pool->tx_log);
+
   btc_parser_init(&peer->parser, peer->network->magic);
 
   peer->parser.on_msg = on_msg;
@@ -513,7 +1247,19 @@ btc_peer_create(btc_pool_t *pool) {
   btc_filter_set(&peer->inv_filter, 50000, 0.000001);
 
   btc_hashtab_init(&peer->block_map);
-  btc_hashtab_init(&peer->tx_map);
+
+  peer->tx_head = NULL;
+
+  btc_hashmap_init(&peer->tx_map);
+
+  btc_filter_init(&peer->tx_filter);
+  btc_filter_set(&peer->tx_filter, 10000, 0.000001);
+
+  peer->tx_count = 0;
+  peer->tx_inflight = 0;
+
+  btc_zinv_init(&peer->tx_wanted);
+
   btc_hashmap_init(&peer->compact_map);
 
   return peer;
@@ -522,10 +1268,22 @@ btc_peer_create(btc_pool_t *pool) {
 static void
 btc_peer_clear_data(btc_peer_t *peer);
 
+static void
+btc_peer_post(btc_peer_t *peer, btc_netev_t *op) {
+  btc_netthread_post(peer->conn->thread, op);
+}
+
 static void
 btc_peer_destroy(btc_peer_t *peer) {
   btc_mapiter_t it;
 
+  /* The I/O thread frees the connection once it
+     has worked through everything we sent it. */
+  if (peer->conn != NULL) {
+    peer->conn->thread->peers--;
+    btc_peer_post(peer, btc_netev_create(BTC_NETOP_RELEASE, peer->conn));
+  }
+
   btc_parser_clear(&peer->parser);
 
   btc_peer_clear_data(peer);
@@ -534,10 +1292,6 @@ btc_peer_destroy(btc_peer_t *peer) {
   btc_map_each(&peer->block_map, it)
     btc_free(peer->block_map.keys[it]);
 
-  /* Free TXIDs. */
-  btc_map_each(&peer->tx_map, it)
-    btc_free(peer->tx_map.keys[it]);
-
   /* Free compact blocks. */
   btc_map_each(&peer->compact_map, it)
     btc_cmpct_destroy(peer->compact_map.vals[it]);
@@ -546,28 +1300,44 @@ btc_peer_destroy(btc_peer_t *peer) {
 
   btc_filter_clear(&peer->addr_filter);
   btc_filter_clear(&peer->inv_filter);
+  btc_filter_clear(&peer->tx_filter);
 
   if (peer->spv_filter != NULL)
     btc_bloom_destroy(peer->spv_filter);
 
   btc_hashtab_clear(&peer->block_map);
-  btc_hashtab_clear(&peer->tx_map);
+  btc_hashmap_clear(&peer->tx_map);
+  btc_zinv_clear(&peer->tx_wanted);
   btc_hashmap_clear(&peer->compact_map);
 
   btc_free(peer);
 }
 
+static btc_conn_t *
+btc_pool_assign(btc_pool_t *pool, btc_peer_t *peer);
+
 static int
 btc_peer_open(btc_peer_t *peer, const btc_netaddr_t *addr) {
-  btc_socket_t *socket;
+  btc_socket_t *socket = NULL;
   btc_sockaddr_t sa;
 
   btc_netaddr_get_sockaddr(&sa, addr);
 
-  socket = btc_loop_connect(peer->loop, &sa);
+  if (peer->pool->threads != NULL) {
+    btc_netev_t *op;
 
-  if (socket == NULL)
-    return 0;
+    peer->conn = btc_pool_assign(peer->pool, peer);
+
+    op = btc_netev_create(BTC_NETOP_CONNECT, peer->conn);
+    op->addr = sa;
+
+    btc_peer_post(peer, op);
+  } else {
+    socket = btc_loop_connect(peer->loop, &sa);
+
+    if (socket == NULL)
+      return 0;
+  }
 
   peer->state = BTC_PEER_CONNECTING;
   peer->socket = socket;
@@ -576,12 +1346,14 @@ btc_peer_open(btc_peer_t *peer, const btc_netaddr_t *addr) {
   peer->time = btc_time_msec();
   peer->nonce = btc_nonces_alloc(&peer->pool->nonces);
 
-  btc_socket_set_data(socket, peer);
-  btc_socket_on_connect(socket, on_connect);
-  btc_socket_on_close(socket, on_close);
-  btc_socket_on_error(socket, on_error);
-  btc_socket_on_data(socket, on_data);
-  btc_socket_on_drain(socket, on_drain);
+  if (socket != NULL) {
+    btc_socket_set_data(socket, peer);
+    btc_socket_on_connect(socket, on_connect);
+    btc_socket_on_close(socket, on_close);
+    btc_socket_on_error(socket, on_error);
+    btc_socket_on_data(socket, on_data);
+    btc_socket_on_drain(socket, on_drain);
+  }
 
   return 1;
 }
@@ -594,7 +1366,6 @@ btc_peer_accept(btc_peer_t *peer, btc_socket_t *socket) {
 
   /* We're shy. Wait for an introduction. */
   peer->state = BTC_PEER_WAIT_VERSION;
-  peer->socket = socket;
 
   btc_netaddr_set_sockaddr(&peer->addr, &sa);
 
@@ -602,11 +1373,27 @@ btc_peer_accept(btc_peer_t *peer, btc_socket_t *socket) {
   peer->time = btc_time_msec();
   peer->nonce = btc_nonces_alloc(&peer->pool->nonces);
 
-  btc_socket_set_data(socket, peer);
-  btc_socket_on_close(socket, on_close);
-  btc_socket_on_error(socket, on_error);
-  btc_socket_on_data(socket, on_data);
-  btc_socket_on_drain(socket, on_drain);
+  if (peer->pool->threads != NULL) {
+    btc_netev_t *op;
+
+    /* Hand the socket over to an I/O thread. */
+    btc_socket_detach(socket);
+
+    peer->conn = btc_pool_assign(peer->pool, peer);
+
+    op = btc_netev_create(BTC_NETOP_ATTACH, peer->conn);
+    op->socket = socket;
+
+    btc_peer_post(peer, op);
+  } else {
+    peer->socket = socket;
+
+    btc_socket_set_data(socket, peer);
+    btc_socket_on_close(socket, on_close);
+    btc_socket_on_error(socket, on_error);
+    btc_socket_on_data(socket, on_data);
+    btc_socket_on_drain(socket, on_drain);
+  }
 
   btc_peer_info(peer, "Accepted connection from %N.", &peer->addr);
 
@@ -615,7 +1402,13 @@ btc_peer_accept(btc_peer_t *peer, btc_socket_t *socket) {
 
 static void
 btc_peer_close(btc_peer_t *peer) {
-  btc_socket_close(peer->socket);
+  if (peer->conn != NULL) {
+    if (peer->state != BTC_PEER_DEAD)
+      btc_peer_post(peer, btc_netev_create(BTC_NETOP_CLOSE, peer->conn));
+  } else {
+    btc_socket_close(peer->socket);
+  }
+
   peer->state = BTC_PEER_DEAD;
   peer->parser.closed = 1;
 }
@@ -637,9 +1430,7 @@ btc_peer_increase_ban(btc_peer_t *peer, int score) {
 }
 
 static int
-btc_peer_write(btc_peer_t *peer, uint8_t *data, size_t length) {
-  int rc = btc_socket_write(peer->socket, data, length);
-
+btc_peer_written(btc_peer_t *peer, int rc) {
   if (rc == -1) {
     const char *msg = btc_socket_strerror(peer->socket);
 
@@ -654,19 +1445,86 @@ btc_peer_write(btc_peer_t *peer, uint8_t *data, size_t length) {
   return rc;
 }
 
+static void
+btc_peer_count_send(btc_peer_t *peer, enum btc_msgtype type, size_t size) {
+  btc_pool_t *pool = peer->pool;
+
+  btc_traffic_send(&peer->traffic, type, size);
+  btc_traffic_send(&pool->traffic, type, size);
+
+  /* Everything we send is drawn from the upload budget. */
+  if (pool->max_upload != 0)
+    pool->upload_tokens -= size;
+}
+
 static int
-btc_peer_send(btc_peer_t *peer, const btc_msg_t *msg) {
+btc_peer_queue(btc_peer_t *peer, uint8_t *data, btc_iobuf_t *buf, size_t length) {
+  btc_netev_t *op;
+
+  if (peer->state == BTC_PEER_DEAD) {
+    if (data != NULL)
+      btc_free(data);
+
+    return 0;
+  }
+
+  op = btc_netev_create(BTC_NETOP_WRITE, peer->conn);
+  op->data = data;
+  op->buf = buf != NULL ? btc_iobuf_ref(buf) : NULL;
+  op->length = length;
+
+  btc_peer_post(peer, op);
+
+  peer->queued += length;
+  peer->last_send = btc_time_msec();
+
+  return 1;
+}
+
+static int
+btc_peer_write(btc_peer_t *peer,
+               enum btc_msgtype type,
+               uint8_t *data,
+               size_t length) {
+  btc_peer_count_send(peer, type, length);
+
+  if (peer->conn != NULL)
+    return btc_peer_queue(peer, data, NULL, length);
+
+  return btc_peer_written(peer, btc_socket_write(peer->socket, data, length));
+}
+
+static int
+btc_peer_write_buf(btc_peer_t *peer, enum btc_msgtype type, btc_iobuf_t *buf) {
+  btc_peer_count_send(peer, type, buf->length);
+
+  if (peer->conn != NULL)
+    return btc_peer_queue(peer, NULL, buf, buf->length);
+
+  return btc_peer_written(peer, btc_socket_write_buf(peer->socket, buf));
+}
+
+static size_t
+btc_peer_buffered(btc_peer_t *peer) {
+  /* Bytes queued for the I/O thread that it hasn't reported flushed. */
+  if (peer->conn != NULL)
+    return peer->queued - peer->flushed;
+
+  return btc_socket_buffered(peer->socket);
+}
+
+static btc_iobuf_t *
+btc_pool_frame(btc_pool_t *pool, const btc_msg_t *msg) {
   size_t bodylen = btc_msg_size(msg);
-  size_t length = 24 + bodylen;
-  uint8_t *data = (uint8_t *)btc_malloc(length);
-  uint8_t *body = data + 24;
-  uint8_t *zp = data;
+  btc_iobuf_t *buf = btc_iobuf_create(pool->loop, 24 + bodylen);
+  uint8_t *body = buf->data + 24;
+  uint8_t *zp = buf->data;
 
   /* Payload. */
   btc_msg_export(body, msg);
 
   /* Magic value. */
-  zp = btc_uint32_write(zp, peer->network->magic);
+  zp = btc_uint32_write(zp, pool->network->magic);
 
   /* Command. */
   zp = btc_nullstr_write(zp, msg->cmd, 12);
@@ -674,10 +1532,20 @@ btc_peer_send(btc_peer_t *peer, const btc_msg_t *msg) {
   /* Payload length. */
   zp = btc_uint32_write(zp, bodylen);
 
-  /* Checksum. */
-  btc_uint32_write(zp, btc_checksum(body, bodylen));
+  /* Checksum. */
+  btc_uint32_write(zp, btc_checksum(body, bodylen));
+
+  return buf;
+}
+
+static int
+btc_peer_send(btc_peer_t *peer, const btc_msg_t *msg) {
+  btc_iobuf_t *buf = btc_pool_frame(peer->pool, msg);
+  int rc = btc_peer_write_buf(peer, msg->type, buf);
+
+  btc_iobuf_destroy(buf);
 
-  return btc_peer_write(peer, data, length);
+  return rc;
 }
 
 static int
@@ -976,20 +1844,6 @@ btc_peer_send_headers(btc_peer_t *peer, const btc_headers_t *msg) {
   return btc_peer_sendmsg(peer, BTC_MSG_HEADERS, msg);
 }
 
-static int
-btc_peer_send_headers_1(btc_peer_t *peer, const btc_header_t *hdr) {
-  btc_header_t *items[1];
-  btc_headers_t msg;
-
-  items[0] = (btc_header_t *)hdr;
-
-  msg.items = items;
-  msg.alloc = 0;
-  msg.length = 1;
-
-  return btc_peer_sendmsg(peer, BTC_MSG_HEADERS, &msg);
-}
-
 static int
 btc_peer_send_reject(btc_peer_t *peer, const btc_reject_t *msg) {
   btc_peer_debug(peer, "Rejecting %s %H (%N): code=%s reason=%s.",
@@ -1197,10 +2051,154 @@ btc_peer_flush_inv(btc_peer_t *peer) {
   return rc;
 }
 
+static btc_iobuf_t *
+btc_pool_frame_cmpct(btc_pool_t *pool, const btc_block_t *block, int witness) {
+  btc_cmpct_t body;
+  btc_iobuf_t *buf;
+  btc_msg_t msg;
+
+  btc_cmpct_init(&body);
+  btc_cmpct_set_block(&body, block, witness);
+
+  btc_msg_set_type(&msg, witness ? BTC_MSG_CMPCTBLOCK
+                                 : BTC_MSG_CMPCTBLOCK_BASE);
+
+  msg.body = &body;
+
+  buf = btc_pool_frame(pool, &msg);
+
+  btc_cmpct_clear(&body);
+
+  return buf;
+}
+
+static btc_iobuf_t *
+btc_pool_frame_headers(btc_pool_t *pool, const btc_header_t *hdr) {
+  btc_header_t *items[1];
+  btc_headers_t body;
+  btc_msg_t msg;
+
+  items[0] = (btc_header_t *)hdr;
+
+  body.items = items;
+  body.alloc = 0;
+  body.length = 1;
+
+  btc_msg_set_type(&msg, BTC_MSG_HEADERS);
+
+  msg.body = &body;
+
+  return btc_pool_frame(pool, &msg);
+}
+
+static btc_recent_t *
+btc_pool_recent(btc_pool_t *pool, const uint8_t *hash) {
+  size_t i;
+
+  for (i = 0; i < BTC_POOL_RECENT; i++) {
+    btc_recent_t *slot = &pool->recent[i];
+
+    if (btc_hash_equal(slot->hash, hash))
+      return slot;
+  }
+
+  return NULL;
+}
+
+static btc_recent_t *
+btc_pool_remember(btc_pool_t *pool, const uint8_t *hash) {
+  btc_recent_t *slot = btc_pool_recent(pool, hash);
+
+  if (slot != NULL)
+    return slot;
+
+  /* Evict the oldest. Queued writes keep their own references. */
+  slot = &pool->recent[pool->recent_index];
+
+  btc_recent_clear(slot);
+  btc_hash_copy(slot->hash, hash);
+
+  pool->recent_index = (pool->recent_index + 1) % BTC_POOL_RECENT;
+
+  return slot;
+}
+
+static btc_iobuf_t *
+btc_pool_recent_frame(btc_pool_t *pool,
+                      const btc_entry_t *entry,
+                      enum btc_frame_type type) {
+  btc_recent_t *slot = btc_pool_recent(pool, entry->hash);
+  btc_block_t *block;
+  btc_msg_t msg;
+
+  if (slot == NULL)
+    return NULL;
+
+  if (slot->frames[type] != NULL)
+    return slot->frames[type];
+
+  if (type == BTC_FRAME_WITNESS_BLOCK) {
+    btc_iobuf_t *buf;
+    size_t length;
+    uint8_t *data;
+
+    /* Already framed on disk. */
+    if (!btc_chain_get_raw_block(pool->chain, &data, &length, entry))
+      return NULL;
+
+    buf = btc_iobuf_create(pool->loop, length);
+
+    memcpy(buf->data, data, length);
+
+    free(data);
+
+    slot->frames[type] = buf;
+
+    return buf;
+  }
+
+  block = btc_chain_get_block(pool->chain, entry);
+
+  if (block == NULL)
+    return NULL;
+
+  switch (type) {
+    case BTC_FRAME_BLOCK: {
+      btc_msg_set_type(&msg, BTC_MSG_BLOCK_BASE);
+
+      msg.body = block;
+
+      slot->frames[type] = btc_pool_frame(pool, &msg);
+
+      break;
+    }
+
+    case BTC_FRAME_CMPCT:
+    case BTC_FRAME_WITNESS_CMPCT: {
+      int witness = (type == BTC_FRAME_WITNESS_CMPCT);
+
+      slot->frames[type] = btc_pool_frame_cmpct(pool, block, witness);
+
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+
+  btc_block_destroy(block);
+
+  return slot->frames[type];
+}
+
 static int
 btc_peer_announce_block(btc_peer_t *peer,
                         const btc_block_t *block,
-                        const uint8_t *hash) {
+                        const uint8_t *hash,
+                        btc_recent_t *slot) {
+  btc_iobuf_t **frames = slot->frames;
+
   /* Don't send if they already have it. */
   if (btc_filter_has(&peer->inv_filter, hash, 32))
     return 0;
@@ -1208,15 +2206,29 @@ btc_peer_announce_block(btc_peer_t *peer,
   /* Send them the block immediately if
      they're using compact block mode 1. */
   if (peer->compact_mode == 1) {
+    int witness = (peer->compact_witness != 0);
+    int type = witness ? BTC_FRAME_WITNESS_CMPCT : BTC_FRAME_CMPCT;
+
+    /* Serialized once and shared by every peer. */
+    if (frames[type] == NULL)
+      frames[type] = btc_pool_frame_cmpct(peer->pool, block, witness);
+
     btc_filter_add(&peer->inv_filter, hash, 32);
-    btc_peer_send_cmpctblock(peer, block);
+    btc_peer_write_buf(peer, BTC_MSG_CMPCTBLOCK, frames[type]);
+
     return 1;
   }
 
   /* Send header for peers that request it. */
   if (peer->prefer_headers) {
+    if (frames[BTC_FRAME_HEADERS] == NULL) {
+      frames[BTC_FRAME_HEADERS] = btc_pool_frame_headers(peer->pool,
+                                                         &block->header);
+    }
+
     btc_filter_add(&peer->inv_filter, hash, 32);
-    btc_peer_send_headers_1(peer, &block->header);
+    btc_peer_write_buf(peer, BTC_MSG_HEADERS, frames[BTC_FRAME_HEADERS]);
+
     return 1;
   }
 
@@ -1227,35 +2239,114 @@ btc_peer_announce_block(btc_peer_t *peer,
 }
 
 static int
-btc_peer_announce_tx(btc_peer_t *peer, const btc_mpentry_t *entry) {
-  /* Do not send txs to spv clients that have relay unset. */
-  if (!peer->relay)
-    return 0;
+btc_txinv_compare(const void *x, const void *y) {
+  const btc_txinv_t *a = (const btc_txinv_t *)x;
+  const btc_txinv_t *b = (const btc_txinv_t *)y;
 
-  /* Don't send if they already have it. */
-  if (btc_filter_has(&peer->inv_filter, entry->hash, 32))
-    return 0;
+  /* Parents first, then highest feerate. */
+  if (a->depth != b->depth)
+    return a->depth < b->depth ? -1 : 1;
 
-  /* Check the peer's bloom filter. */
-  if (peer->spv_filter != NULL) {
-    if (!btc_tx_matches(entry->tx, peer->spv_filter))
-      return 0;
+  if (a->rate != b->rate)
+    return a->rate > b->rate ? -1 : 1;
+
+  return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+static int
+btc_peer_announce_txs(btc_peer_t *peer) {
+  btc_pool_t *pool = peer->pool;
+  const btc_txlog_t *log = &pool->tx_log;
+  uint64_t end = btc_txlog_end(log);
+  btc_txinv_t *items;
+  btc_hashmap_t map;
+  size_t i, j, count;
+  btc_zinv_t inv;
+  uint64_t seq;
+  int rc = 1;
+
+  if (peer->tx_seq < log->start)
+    peer->tx_seq = log->start;
+
+  /* Do not send txs to spv clients that have relay unset. */
+  if (!peer->relay || peer->tx_seq == end) {
+    peer->tx_seq = end;
+    return 1;
   }
 
-  /* Check the fee filter. */
-  if (peer->fee_rate != -1) {
-    int64_t rate = btc_get_rate(entry->fee, entry->size);
+  items = btc_malloc((end - peer->tx_seq) * sizeof(btc_txinv_t));
+  count = 0;
 
-    if (rate < peer->fee_rate)
-      return 0;
+  btc_hashmap_init(&map);
+
+  /* The log is in acceptance order, so parents precede children. */
+  for (seq = peer->tx_seq; seq < end; seq++) {
+    const uint8_t *hash = btc_txlog_get(log, seq);
+    const btc_mpentry_t *entry = btc_mempool_get(pool->mempool, hash);
+    btc_txinv_t *item;
+    int64_t rate;
+
+    /* Mined, evicted or announced twice. */
+    if (entry == NULL || btc_hashmap_has(&map, entry->hash))
+      continue;
+
+    /* Don't send if they already have it. */
+    if (btc_filter_has(&peer->inv_filter, entry->hash, 32))
+      continue;
+
+    rate = btc_get_rate(entry->fee, entry->size);
+
+    /* Check the fee filter. */
+    if (peer->fee_rate != -1 && rate < peer->fee_rate)
+      continue;
+
+    /* Check the peer's bloom filter. */
+    if (peer->spv_filter != NULL) {
+      if (!btc_tx_matches(entry->tx, peer->spv_filter))
+        continue;
+    }
+
+    item = &items[count];
+    item->entry = entry;
+    item->rate = rate;
+    item->depth = 0;
+    item->index = count;
+
+    for (j = 0; j < entry->tx->inputs.length; j++) {
+      const btc_input_t *input = entry->tx->inputs.items[j];
+      const btc_txinv_t *parent = btc_hashmap_get(&map, input->prevout.hash);
+
+      if (parent != NULL && parent->depth >= item->depth)
+        item->depth = parent->depth + 1;
+    }
+
+    btc_hashmap_put(&map, entry->hash, item);
+
+    count++;
   }
 
-  btc_inv_push_item(&peer->inv_queue, BTC_INV_TX, entry->hash);
+  btc_hashmap_clear(&map);
 
-  if (peer->inv_queue.length >= 500)
-    btc_peer_flush_inv(peer);
+  peer->tx_seq = end;
 
-  return 1;
+  qsort(items, count, sizeof(btc_txinv_t), btc_txinv_compare);
+
+  btc_zinv_init(&inv);
+
+  for (i = 0; i < count; i++) {
+    btc_zinv_push(&inv, BTC_INV_TX, items[i].entry->hash);
+
+    if (inv.length == BTC_NET_MAX_INV || i == count - 1) {
+      rc = btc_peer_send_inv(peer, &inv);
+
+      btc_zinv_reset(&inv);
+    }
+  }
+
+  btc_zinv_clear(&inv);
+  btc_free(items);
+
+  return rc;
 }
 
 static void
@@ -1562,14 +2653,70 @@ btc_peer_on_drain(btc_peer_t *peer) {
   btc_peer_flush_data(peer);
 }
 
+static void
+btc_peer_on_event(btc_peer_t *peer, btc_netev_t *ev) {
+  switch (ev->type) {
+    case BTC_NETEV_CONNECT: {
+      if (peer->state != BTC_PEER_DEAD)
+        btc_peer_on_connect(peer);
+      break;
+    }
+
+    case BTC_NETEV_MSG: {
+      if (peer->state == BTC_PEER_DEAD)
+        break;
+
+      peer->last_recv = btc_time_msec();
+
+      btc_peer_on_msg(peer, &ev->msg, ev->length);
+
+      break;
+    }
+
+    case BTC_NETEV_DRAIN: {
+      peer->flushed = ev->written;
+      btc_peer_on_drain(peer);
+      break;
+    }
+
+    case BTC_NETEV_ERROR: {
+      btc_peer_on_error(peer, ev->error);
+      break;
+    }
+
+    case BTC_NETEV_HANGUP: {
+      btc_peer_on_data(peer, NULL, 0);
+      break;
+    }
+
+    case BTC_NETEV_PARSE: {
+      btc_peer_on_parse_error(peer);
+      break;
+    }
+
+    case BTC_NETEV_CLOSE: {
+      btc_peer_on_close(peer);
+      break;
+    }
+
+    default: {
+      abort(); /* LCOV_EXCL_LINE */
+      break;
+    }
+  }
+}
+
 static void
 btc_pool_on_msg(btc_pool_t *pool, btc_peer_t *peer, btc_msg_t *msg);
 
 static void
-btc_peer_on_msg(btc_peer_t *peer, btc_msg_t *msg) {
+btc_peer_on_msg(btc_peer_t *peer, btc_msg_t *msg, size_t size) {
   if (peer->state == BTC_PEER_DEAD)
     return;
 
+  btc_traffic_recv(&peer->traffic, msg->type, size);
+  btc_traffic_recv(&peer->pool->traffic, msg->type, size);
+
   switch (msg->type) {
     case BTC_MSG_VERSION:
       btc_peer_on_version(peer, (const btc_version_t *)msg->body);
@@ -1617,12 +2764,70 @@ btc_peer_on_parse_error(btc_peer_t *peer) {
   btc_peer_increase_ban(peer, 10);
 }
 
+static int
+btc_pool_historical(btc_pool_t *pool, uint32_t type, const uint8_t *hash) {
+  const btc_entry_t *entry;
+
+  switch (type & ~BTC_INV_WITNESS_FLAG) {
+    case BTC_INV_BLOCK:
+    case BTC_INV_FILTERED_BLOCK:
+      break;
+    default:
+      return 0;
+  }
+
+  entry = btc_chain_by_hash(pool->chain, hash);
+
+  if (entry == NULL)
+    return 0;
+
+  return entry->height < btc_chain_height(pool->chain) - BTC_POOL_HISTORICAL;
+}
+
+static int
+btc_pool_upload_limited(btc_pool_t *pool) {
+  uint64_t target = pool->max_upload;
+  int64_t now, elapsed, burst;
+  uint64_t credit;
+
+  if (target == 0)
+    return 0;
+
+  now = btc_time_msec();
+  elapsed = now - pool->upload_time;
+
+  if (elapsed > 0) {
+    if (elapsed > 86400000)
+      elapsed = 86400000;
+
+    /* Refill at target/day (split to avoid overflow). */
+    credit = (target / 86400000) * elapsed
+           + (target % 86400000) * elapsed / 86400000;
+
+    if (credit > 0) {
+      pool->upload_tokens += (int64_t)credit;
+      pool->upload_time = now;
+    }
+  }
+
+  burst = (int64_t)(target / 144);
+
+  if (burst < BTC_POOL_UPLOAD_BURST)
+    burst = BTC_POOL_UPLOAD_BURST;
+
+  if (pool->upload_tokens > burst)
+    pool->upload_tokens = burst;
+
+  return pool->upload_tokens <= 0;
+}
+
 static int
 btc_peer_flush_data(btc_peer_t *peer) {
   btc_pool_t *pool = peer->pool;
   btc_chain_t *chain = pool->chain;
   btc_mempool_t *mempool = pool->mempool;
   btc_invitem_t *item, *next;
+  btc_sendqueue_t deferred;
   int blk_count = 0;
   int tx_count = 0;
   int cmpct_count = 0;
@@ -1641,9 +2846,13 @@ btc_peer_flush_data(btc_peer_t *peer) {
 
   btc_inv_init(&nf);
 
+  deferred.head = NULL;
+  deferred.tail = NULL;
+  deferred.length = 0;
+
   for (item = peer->sending.head; item != NULL; item = next) {
     next = item->next;
-    size = btc_socket_buffered(peer->socket) + nf.length * 36;
+    size = btc_peer_buffered(peer) + nf.length * 36;
     type = item->type;
 
     if (size >= (10 << 20) || peer->state == BTC_PEER_DEAD) {
@@ -1665,16 +2874,51 @@ btc_peer_flush_data(btc_peer_t *peer) {
         type = peer->compact_witness ? BTC_INV_WITNESS_BLOCK : BTC_INV_BLOCK;
     }
 
+    /* Old blocks wait for the upload budget to
+       refill while the rest of the queue is served. */
+    if (btc_pool_historical(pool, type, item->hash)
+        && btc_pool_upload_limited(pool)) {
+      peer->sending.head = next;
+      peer->sending.length--;
+
+      if (peer->sending.head == NULL)
+        peer->sending.tail = NULL;
+
+      if (deferred.tail != NULL)
+        deferred.tail->next = item;
+      else
+        deferred.head = item;
+
+      item->next = NULL;
+
+      deferred.tail = item;
+      deferred.length++;
+
+      ret = 0;
+
+      continue;
+    }
+
     switch (type) {
       case BTC_INV_BLOCK: {
         const btc_entry_t *entry = btc_chain_by_hash(chain, item->hash);
         btc_block_t *block;
+        btc_iobuf_t *buf;
 
         if (entry == NULL) {
           btc_inv_push(&nf, item);
           break;
         }
 
+        buf = btc_pool_recent_frame(pool, entry, BTC_FRAME_BLOCK);
+
+        if (buf != NULL) {
+          btc_peer_write_buf(peer, BTC_MSG_BLOCK, buf);
+          btc_invitem_destroy(item);
+          blk_count += 1;
+          break;
+        }
+
         block = btc_chain_get_block(chain, entry);
 
         if (block == NULL) {
@@ -1694,6 +2938,7 @@ btc_peer_flush_data(btc_peer_t *peer) {
 
       case BTC_INV_WITNESS_BLOCK: {
         const btc_entry_t *entry = btc_chain_by_hash(chain, item->hash);
+        btc_iobuf_t *buf;
         size_t length;
         uint8_t *data;
 
@@ -1702,12 +2947,21 @@ btc_peer_flush_data(btc_peer_t *peer) {
           break;
         }
 
+        buf = btc_pool_recent_frame(pool, entry, BTC_FRAME_WITNESS_BLOCK);
+
+        if (buf != NULL) {
+          btc_peer_write_buf(peer, BTC_MSG_BLOCK, buf);
+          btc_invitem_destroy(item);
+          blk_count += 1;
+          break;
+        }
+
         if (!btc_chain_get_raw_block(chain, &data, &length, entry)) {
           btc_inv_push(&nf, item);
           break;
         }
 
-        btc_peer_write(peer, data, length);
+        btc_peer_write(peer, BTC_MSG_BLOCK, data, length);
 
         btc_invitem_destroy(item);
 
@@ -1719,12 +2973,25 @@ btc_peer_flush_data(btc_peer_t *peer) {
       case BTC_INV_CMPCT_BLOCK: {
         const btc_entry_t *entry = btc_chain_by_hash(chain, item->hash);
         btc_block_t *block;
+        btc_iobuf_t *buf;
 
         if (entry == NULL) {
           btc_inv_push(&nf, item);
           break;
         }
 
+        buf = btc_pool_recent_frame(pool, entry, peer->compact_witness
+                                               ? BTC_FRAME_WITNESS_CMPCT
+                                               : BTC_FRAME_CMPCT);
+
+        if (buf != NULL) {
+          btc_peer_write_buf(peer, BTC_MSG_CMPCTBLOCK, buf);
+          btc_invitem_destroy(item);
+          blk_count += 1;
+          cmpct_count += 1;
+          break;
+        }
+
         block = btc_chain_get_block(chain, entry);
 
         if (block == NULL) {
@@ -1823,6 +3090,17 @@ btc_peer_flush_data(btc_peer_t *peer) {
       peer->sending.tail = NULL;
   }
 
+  /* Put deferred blocks back at the front, in order. */
+  if (deferred.length > 0) {
+    deferred.tail->next = peer->sending.head;
+
+    if (peer->sending.tail == NULL)
+      peer->sending.tail = deferred.tail;
+
+    peer->sending.head = deferred.head;
+    peer->sending.length += deferred.length;
+  }
+
   if (nf.length > 0)
     btc_peer_send_notfound(peer, &nf);
 
@@ -1868,15 +3146,71 @@ btc_peer_clear_data(btc_peer_t *peer) {
     btc_invitem_destroy(item);
   }
 
-  peer->sending.head = NULL;
-  peer->sending.tail = NULL;
-  peer->sending.length = 0;
+  peer->sending.head = NULL;
+  peer->sending.tail = NULL;
+  peer->sending.length = 0;
+}
+
+static int32_t
+btc_pool_window(btc_pool_t *pool) {
+  const btc_network_t *network = pool->network;
+  const btc_entry_t *tail = &pool->header_tail->entry;
+  int32_t height = pool->header_head->entry.height;
+  int32_t limit = height + BTC_NET_BLOCK_WINDOW;
+
+  /* Buffered too much; fetch only what connects next. */
+  if (pool->header_bytes >= BTC_NET_MAX_BLOCK_BUFFER)
+    limit = height + 1;
+
+  /* Past the last checkpoint, the header chain
+     must first prove the minimum chainwork. */
+  if (btc_hash_compare(tail->chainwork, network->pow.chainwork) < 0)
+    limit = BTC_MIN(limit, BTC_MAX(height, network->last_checkpoint));
+
+  return limit;
+}
+
+static int
+btc_peer_is_stalling(btc_peer_t *peer, int64_t now) {
+  btc_pool_t *pool = peer->pool;
+  const btc_hdrnode_t *node;
+  int32_t limit;
+
+  if (!pool->checkpoints || peer->block_map.size == 0)
+    return 0;
+
+  node = pool->header_head->next;
+
+  /* Are we holding up the download window? */
+  if (node == NULL || !btc_hashtab_has(&peer->block_map, node->entry.hash))
+    return 0;
+
+  if (now <= btc_hashtab_get(&peer->block_map, node->entry.hash) + 10000)
+    return 0;
+
+  limit = btc_pool_window(pool);
+
+  /* Only if there is nothing left for other peers to do. */
+  for (; node != NULL && node->entry.height <= limit; node = node->next) {
+    const uint8_t *hash = node->entry.hash;
+
+    if (node->block == NULL && !btc_hashset_has(&pool->block_map, hash))
+      return 0;
+  }
+
+  return 1;
 }
 
 static void
 btc_peer_maybe_timeout(btc_peer_t *peer, int64_t now) {
   btc_chain_t *chain = peer->pool->chain;
 
+  if (btc_peer_is_stalling(peer, now)) {
+    btc_peer_error(peer, "Peer is stalling (window) (%N).", &peer->addr);
+    btc_peer_close(peer);
+    return;
+  }
+
   if (!btc_chain_synced(chain)) {
     if (peer->gb_time != -1 && now > peer->gb_time + 30000) {
       btc_peer_error(peer, "Peer is stalling (inv) (%N).", &peer->addr);
@@ -1899,7 +3233,7 @@ btc_peer_maybe_timeout(btc_peer_t *peer, int64_t now) {
     }
   }
 
-  if (btc_chain_synced(chain) || !peer->syncing) {
+  if (btc_chain_synced(chain) || !peer->syncing || peer->pool->checkpoints) {
     btc_mapiter_t it;
 
     btc_map_each(&peer->block_map, it) {
@@ -1912,16 +3246,6 @@ btc_peer_maybe_timeout(btc_peer_t *peer, int64_t now) {
       }
     }
 
-    btc_map_each(&peer->tx_map, it) {
-      int64_t ts = peer->tx_map.vals[it];
-
-      if (now > ts + 120000) {
-        btc_peer_error(peer, "Peer is stalling (tx) (%N).", &peer->addr);
-        btc_peer_close(peer);
-        return;
-      }
-    }
-
     btc_map_each(&peer->compact_map, it) {
       btc_cmpct_t *block = peer->compact_map.vals[it];
 
@@ -1981,9 +3305,17 @@ btc_peer_on_tick(btc_peer_t *peer, int64_t now) {
     peer->ping_timer = now;
   }
 
-  if (now >= peer->inv_timer + 5000) {
+  /* Trickle on a Poisson schedule. Inbound peers share
+     one timer so that extra connections learn nothing. */
+  if (peer->outbound) {
+    if (now >= peer->inv_timer) {
+      btc_peer_flush_inv(peer);
+      btc_peer_announce_txs(peer);
+      peer->inv_timer = btc_poisson(now, BTC_POOL_INV_OUTBOUND);
+    }
+  } else if (now >= peer->pool->inv_timer) {
     btc_peer_flush_inv(peer);
-    peer->inv_timer = now;
+    btc_peer_announce_txs(peer);
   }
 
   if (now >= peer->stall_timer + 5000) {
@@ -1993,7 +3325,7 @@ btc_peer_on_tick(btc_peer_t *peer, int64_t now) {
 
   btc_peer_flush_data(peer);
 
-  if (btc_socket_buffered(peer->socket) > (30 << 20)) {
+  if (btc_peer_buffered(peer) > (30 << 20)) {
     btc_peer_error(peer, "Peer stalled (drain) (%N).", &peer->addr);
     btc_peer_close(peer);
     return;
@@ -2083,12 +3415,14 @@ btc_peers_close(btc_peers_t *list) {
  */
 
 static btc_hdrnode_t *
-btc_hdrnode_create(const uint8_t *hash, int32_t height) {
+btc_hdrnode_create(const btc_header_t *hdr, const btc_entry_t *prev) {
   btc_hdrnode_t *node = btc_malloc(sizeof(btc_hdrnode_t));
 
-  btc_hash_copy(node->hash, hash);
+  btc_entry_set_header(&node->entry, hdr, prev);
 
-  node->height = height;
+  node->block = NULL;
+  node->flags = 0;
+  node->id = 0;
   node->next = NULL;
 
   return node;
@@ -2096,6 +3430,9 @@ btc_hdrnode_create(const uint8_t *hash, int32_t height) {
 
 static void
 btc_hdrnode_destroy(btc_hdrnode_t *node) {
+  if (node->block != NULL)
+    btc_block_destroy(node->block);
+
   btc_free(node);
 }
 
@@ -2109,6 +3446,7 @@ btc_pool_create(const btc_network_t *network,
                 btc_chain_t *chain,
                 btc_mempool_t *mempool) {
   btc_pool_t *pool = btc_malloc(sizeof(btc_pool_t));
+  size_t i;
 
   memset(pool, 0, sizeof(*pool));
 
@@ -2132,14 +3470,33 @@ btc_pool_create(const btc_network_t *network,
   btc_peers_init(&pool->peers);
   btc_nonces_init(&pool->nonces);
   btc_hashset_init(&pool->block_map);
-  btc_hashset_init(&pool->tx_map);
+  btc_hashmap_init(&pool->tx_map);
+  btc_list_init(&pool->tx_delayed);
+  btc_list_init(&pool->tx_pending);
+  btc_list_init(&pool->tx_inflight);
+  btc_txlog_init(&pool->tx_log);
+  pool->inv_timer = 0;
   btc_hashset_init(&pool->compact_map);
   pool->block_mode = 0;
   pool->checkpoints = 0;
   pool->header_tip = NULL;
   pool->header_head = NULL;
   pool->header_tail = NULL;
-  pool->header_next = NULL;
+  btc_hashmap_init(&pool->header_map);
+  pool->header_bytes = 0;
+  pool->headers_done = 0;
+  pool->timer = btc_timer_create(loop, on_tick, pool);
+  pool->threads = NULL;
+  pool->thread_count = 0;
+  btc_netq_init(&pool->events);
+
+  for (i = 0; i < BTC_POOL_RECENT; i++)
+    btc_recent_init(&pool->recent[i]);
+
+  pool->recent_index = 0;
+  pool->max_upload = 0;
+  pool->upload_tokens = 0;
+  pool->upload_time = 0;
   pool->refill_timer = 0;
   pool->flush_timer = 0;
   pool->id = 0;
@@ -2166,11 +3523,15 @@ btc_pool_destroy(btc_pool_t *pool) {
   btc_vector_clear(&pool->bind);
   btc_vector_clear(&pool->connect);
   btc_server_destroy(pool->server);
+  btc_timer_destroy(pool->timer);
+  btc_netq_clear(&pool->events);
   btc_peers_clear(&pool->peers);
   btc_nonces_clear(&pool->nonces);
   btc_hashset_clear(&pool->block_map);
-  btc_hashset_clear(&pool->tx_map);
+  btc_hashmap_clear(&pool->tx_map);
+  btc_txlog_clear(&pool->tx_log);
   btc_hashset_clear(&pool->compact_map);
+  btc_hashmap_clear(&pool->header_map);
   btc_free(pool);
 }
 
@@ -2239,6 +3600,26 @@ btc_pool_set_onlynet(btc_pool_t *pool, enum btc_ipnet only_net) {
   pool->only_net = only_net;
 }
 
+void
+btc_pool_set_threads(btc_pool_t *pool, int threads) {
+  CHECK(pool->threads == NULL);
+
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+  pool->thread_count = threads < 0 ? 0 : threads;
+#else
+  (void)threads;
+  pool->thread_count = 0;
+#endif
+}
+
+void
+btc_pool_set_maxupload(btc_pool_t *pool, uint64_t max_upload) {
+  /* Start with a full bucket (clamped on first use). */
+  pool->max_upload = max_upload;
+  pool->upload_tokens = (int64_t)max_upload;
+  pool->upload_time = btc_time_msec();
+}
+
 static int
 btc_pool_listen(btc_pool_t *pool) {
   size_t i;
@@ -2348,9 +3729,7 @@ btc_pool_next_tip(btc_pool_t *pool, int32_t height) {
       return chk;
   }
 
-  btc_abort(); /* LCOV_EXCL_LINE */
-
-  return NULL; /* LCOV_EXCL_LINE */
+  return NULL;
 }
 
 static void
@@ -2362,11 +3741,24 @@ btc_pool_clear_chain(btc_pool_t *pool) {
     btc_hdrnode_destroy(node);
   }
 
+  btc_hashmap_reset(&pool->header_map);
+
+  pool->header_bytes = 0;
   pool->checkpoints = 0;
   pool->header_tip = NULL;
   pool->header_head = NULL;
   pool->header_tail = NULL;
-  pool->header_next = NULL;
+  pool->headers_done = 0;
+}
+
+static void
+btc_pool_clear_recent(btc_pool_t *pool) {
+  size_t i;
+
+  for (i = 0; i < BTC_POOL_RECENT; i++)
+    btc_recent_clear(&pool->recent[i]);
+
+  pool->recent_index = 0;
 }
 
 static void
@@ -2377,22 +3769,117 @@ btc_pool_reset_chain(btc_pool_t *pool) {
   if (!(pool->flags & BTC_POOL_CHECKPOINTS))
     return;
 
-  if (network->checkpoints.length == 0)
-    return;
-
   btc_pool_clear_chain(pool);
 
   tip = btc_chain_tip(pool->chain);
 
-  if (tip->height < network->last_checkpoint) {
+  if (tip->height < network->last_checkpoint || !btc_chain_synced(pool->chain)) {
     pool->checkpoints = 1;
     pool->header_tip = btc_pool_next_tip(pool, tip->height);
-    pool->header_head = btc_hdrnode_create(tip->hash, tip->height);
+    pool->header_head = btc_hdrnode_create(&tip->header, tip->prev);
     pool->header_tail = pool->header_head;
 
     btc_pool_info(pool, "Initialized header chain to height %d (checkpoint=%H).",
-                        tip->height, pool->header_tip->hash);
+                        tip->height, pool->header_tip != NULL
+                                   ? pool->header_tip->hash
+                                   : btc_hash_zero);
+  }
+}
+
+static int
+btc_pool_run_events(btc_pool_t *pool) {
+  btc_netev_t *ev = btc_netq_take(&pool->events);
+  btc_netev_t *next;
+  int ran = 0;
+
+  for (; ev != NULL; ev = next) {
+    next = ev->next;
+
+    btc_peer_on_event(ev->conn->peer, ev);
+    btc_netev_destroy(ev);
+
+    ran = 1;
+  }
+
+  return ran;
+}
+
+static void
+on_events(void *arg) {
+  btc_pool_run_events((btc_pool_t *)arg);
+}
+
+static btc_conn_t *
+btc_pool_assign(btc_pool_t *pool, btc_peer_t *peer) {
+  btc_netthread_t *best = &pool->threads[0];
+  int i;
+
+  for (i = 1; i < pool->thread_count; i++) {
+    if (pool->threads[i].peers < best->peers)
+      best = &pool->threads[i];
+  }
+
+  best->peers++;
+
+  return btc_conn_create(best, peer);
+}
+
+static void
+btc_pool_start_threads(btc_pool_t *pool) {
+  int i;
+
+  if (pool->thread_count == 0)
+    return;
+
+  pool->threads = btc_malloc(pool->thread_count * sizeof(btc_netthread_t));
+
+  for (i = 0; i < pool->thread_count; i++) {
+    btc_netthread_t *thread = &pool->threads[i];
+
+    btc_netthread_init(thread, pool);
+    btc_thread_create(&thread->thread, btc_netthread_main, thread);
   }
+
+  btc_loop_on_tick(pool->loop, on_events, pool);
+
+  btc_pool_info(pool, "Started %d network threads.", pool->thread_count);
+}
+
+static void
+btc_pool_stop_threads(btc_pool_t *pool) {
+  int i, busy;
+
+  if (pool->threads == NULL)
+    return;
+
+  for (i = 0; i < pool->thread_count; i++)
+    btc_netthread_post(&pool->threads[i], btc_netev_create(BTC_NETOP_STOP, NULL));
+
+  for (i = 0; i < pool->thread_count; i++)
+    btc_thread_join(&pool->threads[i].thread);
+
+  /* The threads are gone: finish the close/release
+     handshake for every connection right here. */
+  do {
+    busy = btc_pool_run_events(pool);
+
+    for (i = 0; i < pool->thread_count; i++) {
+      btc_netthread_t *thread = &pool->threads[i];
+
+      busy |= btc_netthread_run(thread);
+
+      btc_loop_close(thread->loop);
+    }
+  } while (busy);
+
+  btc_loop_off_tick(pool->loop, on_events, pool);
+
+  for (i = 0; i < pool->thread_count; i++)
+    btc_netthread_clear(&pool->threads[i]);
+
+  btc_free(pool->threads);
+
+  pool->threads = NULL;
 }
 
 int
@@ -2415,8 +3902,11 @@ btc_pool_open(btc_pool_t *pool, const char *prefix, unsigned int flags) {
   if (!btc_addrman_open(pool->addrman, file, flags))
     return 0;
 
+  btc_pool_start_threads(pool);
+
   if (pool->flags & BTC_POOL_LISTEN) {
     if (!btc_pool_listen(pool)) {
+      btc_pool_stop_threads(pool);
       btc_addrman_close(pool->addrman);
       return 0;
     }
@@ -2431,7 +3921,7 @@ btc_pool_open(btc_pool_t *pool, const char *prefix, unsigned int flags) {
 
   btc_pool_reset_chain(pool);
 
-  btc_loop_on_tick(pool->loop, on_tick, pool);
+  btc_timer_start(pool->timer, 0, 1000);
 
   return 1;
 }
@@ -2440,11 +3930,13 @@ void
 btc_pool_close(btc_pool_t *pool) {
   btc_pool_info(pool, "Closing pool.");
 
-  btc_loop_off_tick(pool->loop, on_tick, pool);
+  btc_timer_stop(pool->timer);
 
   btc_server_close(pool->server);
   btc_peers_close(&pool->peers);
+  btc_pool_stop_threads(pool);
   btc_pool_clear_chain(pool);
+  btc_pool_clear_recent(pool);
   btc_addrman_close(pool->addrman);
 }
 
@@ -2606,7 +4098,10 @@ btc_pool_send_locator(btc_pool_t *pool,
   peer->block_time = btc_time_msec();
 
   if (pool->checkpoints) {
-    btc_peer_send_getheaders(peer, locator, pool->header_tip->hash);
+    const btc_checkpoint_t *tip = pool->header_tip;
+
+    btc_peer_send_getheaders(peer, locator, tip != NULL ? tip->hash : NULL);
+
     return 1;
   }
 
@@ -2715,10 +4210,40 @@ btc_pool_fill_outbound(btc_pool_t *pool) {
   return 1;
 }
 
+static int
+btc_pool_resolve_headers(btc_pool_t *pool, btc_peer_t *peer);
+
+static void
+btc_pool_fill_window(btc_pool_t *pool);
+
+static void
+btc_pool_schedule_txs(btc_pool_t *pool, int64_t now);
+
+static void
+btc_pool_trim_txlog(btc_pool_t *pool) {
+  btc_txlog_t *log = &pool->tx_log;
+  uint64_t end = btc_txlog_end(log);
+  uint64_t seq = end;
+  btc_peer_t *peer;
+
+  for (peer = pool->peers.head; peer != NULL; peer = peer->next) {
+    if (peer->tx_seq < seq)
+      seq = peer->tx_seq;
+  }
+
+  /* Peers that fall this far behind skip ahead. */
+  if (end - seq > BTC_POOL_TXLOG_MAX)
+    seq = end - BTC_POOL_TXLOG_MAX;
+
+  if (seq > log->start)
+    btc_txlog_trim(log, seq);
+}
+
 static void
 btc_pool_on_tick(btc_pool_t *pool, int64_t now) {
   if (now >= pool->refill_timer + 3000) {
     btc_pool_fill_outbound(pool);
+    btc_pool_fill_window(pool);
     pool->refill_timer = now;
   }
 
@@ -2726,6 +4251,13 @@ btc_pool_on_tick(btc_pool_t *pool, int64_t now) {
     btc_addrman_flush(pool->addrman);
     pool->flush_timer = now;
   }
+
+  if (now >= pool->inv_timer) {
+    btc_pool_trim_txlog(pool);
+    pool->inv_timer = btc_poisson(now, BTC_POOL_INV_INBOUND);
+  }
+
+  btc_pool_schedule_txs(pool, now);
 }
 
 static void
@@ -2754,88 +4286,345 @@ btc_pool_on_socket(btc_pool_t *pool, btc_socket_t *socket) {
 
   peer = btc_peer_create(pool);
 
-  if (!btc_peer_accept(peer, socket)) {
-    const char *msg = btc_loop_strerror(pool->loop);
+  if (!btc_peer_accept(peer, socket)) {
+    const char *msg = btc_loop_strerror(pool->loop);
+
+    btc_pool_debug(pool, "Connection failed: %s (%S).", msg, &sa);
+    btc_peer_destroy(peer);
+
+    return;
+  }
+
+  btc_peers_add(&pool->peers, peer);
+}
+
+static void
+btc_pool_on_connect(btc_pool_t *pool, btc_peer_t *peer) {
+  btc_pool_info(pool, "Connected to %N.", &peer->addr);
+
+  if (peer->outbound)
+    btc_addrman_mark_success(pool->addrman, &peer->addr);
+}
+
+static void
+btc_pool_on_complete(btc_pool_t *pool, btc_peer_t *peer) {
+  const btc_netaddr_t *addr;
+
+  if (peer->outbound) {
+    /* Advertise our address. */
+    if ((pool->flags & BTC_POOL_LISTEN) && btc_chain_synced(pool->chain)) {
+      addr = btc_addrman_get_local(pool->addrman, &peer->addr, pool->services);
+
+      if (addr != NULL)
+        btc_peer_send_addr_1(peer, addr);
+    }
+
+    /* Find some more peers. */
+    btc_peer_send_getaddr(peer);
+    peer->getting_addr = 1;
+  }
+
+  /* We want compact blocks! */
+  if (pool->flags & BTC_POOL_BIP152)
+    btc_peer_send_sendcmpct(peer, pool->block_mode);
+
+  if (peer->outbound) {
+    /* Start syncing the chain. */
+    btc_pool_send_sync(pool, peer);
+
+    /* Help with the block download. */
+    btc_pool_resolve_headers(pool, peer);
+
+    /* Mark success. */
+    btc_addrman_mark_ack(pool->addrman, &peer->addr, peer->services);
+
+    /* If we don't have an ack'd loader yet, consider it dead. */
+    if (!peer->loader && pool->peers.load != NULL) {
+      if (pool->peers.load->state != BTC_PEER_CONNECTED) {
+        pool->peers.load->loader = 0;
+        pool->peers.load = NULL;
+      }
+    }
+
+    /* If we do not have a loader, use this peer. */
+    if (pool->peers.load == NULL)
+      btc_pool_set_loader(pool, peer);
+  }
+}
+
+static void
+btc_pool_resync(btc_pool_t *pool, int force) {
+  btc_vector_t locator;
+  btc_peer_t *peer;
+
+  btc_vector_init(&locator);
+  btc_chain_get_locator(pool->chain, &locator, NULL);
+
+  for (peer = pool->peers.head; peer != NULL; peer = peer->next) {
+    if (!peer->outbound)
+      continue;
+
+    if (!force && peer->syncing)
+      continue;
+
+    btc_pool_send_locator(pool, peer, &locator);
+  }
+
+  btc_vector_clear(&locator);
+}
+
+static int
+btc_peer_tx_better(const btc_peer_t *x, const btc_peer_t *y) {
+  if (x->outbound != y->outbound)
+    return x->outbound;
+
+  if (x->min_ping == -1)
+    return 0;
+
+  if (y->min_ping == -1)
+    return 1;
+
+  return x->min_ping < y->min_ping;
+}
+
+static btc_txann_t *
+btc_txreq_select(const btc_txreq_t *req, int64_t now) {
+  btc_txann_t *best = NULL;
+  btc_txann_t *ann;
+
+  for (ann = req->head; ann != NULL; ann = ann->next) {
+    const btc_peer_t *peer = ann->peer;
+
+    if (ann->failed || now < ann->time)
+      continue;
+
+    if (peer->state != BTC_PEER_CONNECTED)
+      continue;
+
+    if (peer->tx_inflight >= BTC_POOL_TX_INFLIGHT)
+      continue;
+
+    if (best == NULL || btc_peer_tx_better(peer, best->peer))
+      best = ann;
+  }
+
+  return best;
+}
+
+static btc_txreq_t *
+btc_pool_get_txreq(btc_pool_t *pool, const uint8_t *hash, int64_t time) {
+  btc_txreq_t *req = btc_hashmap_get(&pool->tx_map, hash);
+
+  if (req == NULL) {
+    req = btc_malloc(sizeof(btc_txreq_t));
+
+    btc_hash_copy(req->hash, hash);
+    btc_list_init(req);
+
+    req->live = 0;
+    req->active = NULL;
+    req->time = time;
+    req->timeout = 0;
+    req->queue = NULL;
+    req->prev = NULL;
+    req->next = NULL;
+
+    CHECK(btc_hashmap_put(&pool->tx_map, req->hash, req));
+  }
+
+  return req;
+}
+
+static void
+btc_txreq_move(btc_txreq_t *req, btc_txqueue_t *queue) {
+  if (req->queue == queue)
+    return;
+
+  if (req->queue != NULL)
+    btc_list_remove(req->queue, req, btc_txreq_t);
+
+  btc_list_push(queue, req, btc_txreq_t);
+
+  req->queue = queue;
+}
+
+static void
+btc_txreq_add(btc_txreq_t *req, btc_peer_t *peer, int64_t time) {
+  btc_txann_t *ann = btc_malloc(sizeof(btc_txann_t));
+
+  ann->req = req;
+  ann->peer = peer;
+  ann->time = time;
+  ann->failed = 0;
+  ann->peer_prev = NULL;
+  ann->peer_next = peer->tx_head;
+
+  if (peer->tx_head != NULL)
+    peer->tx_head->peer_prev = ann;
+
+  peer->tx_head = ann;
+  peer->tx_count++;
+
+  CHECK(btc_hashmap_put(&peer->tx_map, req->hash, ann));
+
+  btc_list_push(req, ann, btc_txann_t);
+
+  req->live++;
+}
+
+static void
+btc_pool_unlink_txann(btc_pool_t *pool, btc_txann_t *ann) {
+  btc_txreq_t *req = ann->req;
+  btc_peer_t *peer = ann->peer;
+
+  /* Remember what we asked for so a reply
+     arriving after the request is gone is
+     not mistaken for an unsolicited tx. */
+  if (req->active == ann || ann->failed)
+    btc_filter_add(&peer->tx_filter, req->hash, 32);
+
+  if (req->active == ann) {
+    peer->tx_inflight--;
+    req->active = NULL;
+
+    btc_txreq_move(req, &pool->tx_pending);
+  }
+
+  if (!ann->failed)
+    req->live--;
+
+  if (ann->peer_prev != NULL)
+    ann->peer_prev->peer_next = ann->peer_next;
+  else
+    peer->tx_head = ann->peer_next;
+
+  if (ann->peer_next != NULL)
+    ann->peer_next->peer_prev = ann->peer_prev;
+
+  peer->tx_count--;
+
+  CHECK(btc_hashmap_del(&peer->tx_map, req->hash) == req->hash);
+
+  btc_list_remove(req, ann, btc_txann_t);
+  btc_free(ann);
+}
+
+static void
+btc_pool_remove_txreq(btc_pool_t *pool, btc_txreq_t *req) {
+  while (req->head != NULL)
+    btc_pool_unlink_txann(pool, req->head);
+
+  if (req->queue != NULL)
+    btc_list_remove(req->queue, req, btc_txreq_t);
+
+  CHECK(btc_hashmap_del(&pool->tx_map, req->hash) == req->hash);
+
+  btc_free(req);
+}
+
+static void
+btc_pool_fail_txann(btc_pool_t *pool, btc_txann_t *ann) {
+  /* Fall back to the next announcer. The failed
+     entry stays so that a late reply is accepted. */
+  btc_txreq_t *req = ann->req;
+
+  if (req->active == ann) {
+    ann->peer->tx_inflight--;
+    req->active = NULL;
 
-    btc_pool_debug(pool, "Connection failed: %s (%S).", msg, &sa);
-    btc_peer_destroy(peer);
+    btc_txreq_move(req, &pool->tx_pending);
+  }
 
-    return;
+  if (!ann->failed) {
+    ann->failed = 1;
+    req->live--;
   }
 
-  btc_peers_add(&pool->peers, peer);
+  if (req->live == 0)
+    btc_pool_remove_txreq(pool, req);
 }
 
 static void
-btc_pool_on_connect(btc_pool_t *pool, btc_peer_t *peer) {
-  btc_pool_info(pool, "Connected to %N.", &peer->addr);
+btc_pool_remove_txann(btc_pool_t *pool, btc_txann_t *ann) {
+  btc_txreq_t *req = ann->req;
 
-  if (peer->outbound)
-    btc_addrman_mark_success(pool->addrman, &peer->addr);
+  btc_pool_unlink_txann(pool, ann);
+
+  if (req->live == 0)
+    btc_pool_remove_txreq(pool, req);
 }
 
 static void
-btc_pool_on_complete(btc_pool_t *pool, btc_peer_t *peer) {
-  const btc_netaddr_t *addr;
+btc_pool_request_tx(btc_pool_t *pool, btc_txann_t *ann, int64_t now) {
+  btc_txreq_t *req = ann->req;
+  btc_peer_t *peer = ann->peer;
 
-  if (peer->outbound) {
-    /* Advertise our address. */
-    if ((pool->flags & BTC_POOL_LISTEN) && btc_chain_synced(pool->chain)) {
-      addr = btc_addrman_get_local(pool->addrman, &peer->addr, pool->services);
+  CHECK(req->active == NULL);
 
-      if (addr != NULL)
-        btc_peer_send_addr_1(peer, addr);
-    }
+  btc_txreq_move(req, &pool->tx_inflight);
 
-    /* Find some more peers. */
-    btc_peer_send_getaddr(peer);
-    peer->getting_addr = 1;
-  }
+  req->active = ann;
+  req->timeout = now + BTC_POOL_TX_TIMEOUT;
 
-  /* We want compact blocks! */
-  if (pool->flags & BTC_POOL_BIP152)
-    btc_peer_send_sendcmpct(peer, pool->block_mode);
+  peer->tx_inflight++;
 
-  if (peer->outbound) {
-    /* Start syncing the chain. */
-    btc_pool_send_sync(pool, peer);
+  btc_zinv_push(&peer->tx_wanted, btc_peer_tx_type(peer), req->hash);
+}
 
-    /* Mark success. */
-    btc_addrman_mark_ack(pool->addrman, &peer->addr, peer->services);
+static void
+btc_pool_send_txreqs(btc_pool_t *pool, btc_peer_t *peer) {
+  if (peer->tx_wanted.length == 0)
+    return;
 
-    /* If we don't have an ack'd loader yet, consider it dead. */
-    if (!peer->loader && pool->peers.load != NULL) {
-      if (pool->peers.load->state != BTC_PEER_CONNECTED) {
-        pool->peers.load->loader = 0;
-        pool->peers.load = NULL;
-      }
-    }
+  btc_pool_debug(pool, "Requesting %zu/%zu txs from peer with getdata (%N).",
+                       peer->tx_wanted.length,
+                       (size_t)pool->tx_map.size,
+                       &peer->addr);
 
-    /* If we do not have a loader, use this peer. */
-    if (pool->peers.load == NULL)
-      btc_pool_set_loader(pool, peer);
-  }
+  btc_peer_send_getdata(peer, &peer->tx_wanted);
+
+  btc_zinv_reset(&peer->tx_wanted);
 }
 
 static void
-btc_pool_resync(btc_pool_t *pool, int force) {
-  btc_vector_t locator;
+btc_pool_schedule_txs(btc_pool_t *pool, int64_t now) {
+  btc_txreq_t *req, *next;
   btc_peer_t *peer;
 
-  btc_vector_init(&locator);
-  btc_chain_get_locator(pool->chain, &locator, NULL);
+  /* Requests are ordered by deadline. */
+  while (pool->tx_inflight.head != NULL) {
+    req = pool->tx_inflight.head;
 
-  for (peer = pool->peers.head; peer != NULL; peer = peer->next) {
-    if (!peer->outbound)
-      continue;
+    if (now < req->timeout)
+      break;
 
-    if (!force && peer->syncing)
-      continue;
+    btc_pool_debug(pool, "Timed out requesting tx %H (%N).",
+                         req->hash, &req->active->peer->addr);
 
-    btc_pool_send_locator(pool, peer, &locator);
+    btc_pool_fail_txann(pool, req->active);
   }
 
-  btc_vector_clear(&locator);
+  /* As are requests waiting out the inbound delay. */
+  while (pool->tx_delayed.head != NULL) {
+    req = pool->tx_delayed.head;
+
+    if (now < req->time)
+      break;
+
+    btc_txreq_move(req, &pool->tx_pending);
+  }
+
+  for (req = pool->tx_pending.head; req != NULL; req = next) {
+    btc_txann_t *ann = btc_txreq_select(req, now);
+
+    next = req->next;
+
+    if (ann != NULL)
+      btc_pool_request_tx(pool, ann, now);
+  }
+
+  for (peer = pool->peers.head; peer != NULL; peer = peer->next)
+    btc_pool_send_txreqs(pool, peer);
 }
 
 static int
@@ -2858,14 +4647,28 @@ static int
 btc_pool_resolve_tx(btc_pool_t *pool,
                     btc_peer_t *peer,
                     const uint8_t *hash) {
-  uint8_t *key = btc_hashtab_del(&peer->tx_map, hash);
+  btc_txann_t *ann = btc_hashmap_get(&peer->tx_map, hash);
 
-  if (key == NULL)
-    return 0;
+  /* The request may have been settled by
+     another announcer after we asked. */
+  if (ann == NULL)
+    return btc_filter_has(&peer->tx_filter, hash, 32);
 
-  CHECK(btc_hashset_del(&pool->tx_map, hash) == key);
+  btc_pool_remove_txreq(pool, ann->req);
 
-  btc_free(key);
+  return 1;
+}
+
+static int
+btc_pool_notfound_tx(btc_pool_t *pool,
+                     btc_peer_t *peer,
+                     const uint8_t *hash) {
+  btc_txann_t *ann = btc_hashmap_get(&peer->tx_map, hash);
+
+  if (ann == NULL)
+    return 0;
+
+  btc_pool_remove_txann(pool, ann);
 
   return 1;
 }
@@ -2877,7 +4680,7 @@ btc_pool_resolve_item(btc_pool_t *pool,
   switch (item->type) {
     case BTC_INV_TX:
     case BTC_INV_WITNESS_TX:
-      return btc_pool_resolve_tx(pool, peer, item->hash);
+      return btc_pool_notfound_tx(pool, peer, item->hash);
     case BTC_INV_BLOCK:
     case BTC_INV_FILTERED_BLOCK:
     case BTC_INV_CMPCT_BLOCK:
@@ -2899,9 +4702,9 @@ btc_pool_remove_peer(btc_pool_t *pool, btc_peer_t *peer) {
   btc_map_each(&peer->block_map, it)
     CHECK(btc_hashset_del(&pool->block_map, peer->block_map.keys[it]));
 
-  /* Remove TXIDs. */
-  btc_map_each(&peer->tx_map, it)
-    CHECK(btc_hashset_del(&pool->tx_map, peer->tx_map.keys[it]));
+  /* Remove tx announcements. */
+  while (peer->tx_head != NULL)
+    btc_pool_remove_txann(pool, peer->tx_head);
 
   /* Remove compact block hashes. */
   btc_map_each(&peer->compact_map, it)
@@ -2922,6 +4725,10 @@ btc_pool_on_close(btc_pool_t *pool, btc_peer_t *peer) {
       btc_pool_reset_chain(pool);
   }
 
+  /* Reassign any blocks the peer was holding. */
+  if (pool->checkpoints && size > 0)
+    btc_pool_fill_window(pool);
+
   btc_nonces_remove(&pool->nonces, peer->nonce);
 
   if (btc_chain_synced(pool->chain) && size > 0) {
@@ -3289,8 +5096,8 @@ btc_pool_on_blockinv(btc_pool_t *pool,
 static void
 btc_pool_request_txs(btc_pool_t *pool,
                      btc_peer_t *peer,
-                     const btc_vector_t *hashes) {
-  btc_zinv_t inv;
+                     const btc_vector_t *hashes,
+                     int64_t delay) {
   int64_t now;
   size_t i;
 
@@ -3302,46 +5109,37 @@ btc_pool_request_txs(btc_pool_t *pool,
 
   now = btc_time_msec();
 
-  btc_zinv_init(&inv);
-  btc_zinv_grow(&inv, hashes->length);
-
   for (i = 0; i < hashes->length; i++) {
     const uint8_t *hash = hashes->items[i];
-    uint8_t *key;
+    btc_txreq_t *req;
 
-    if (btc_hashset_has(&pool->tx_map, hash))
+    if (btc_hashmap_has(&peer->tx_map, hash))
       continue;
 
-    key = btc_hash_clone(hash);
-
-    btc_hashset_put(&pool->tx_map, key);
-    btc_hashtab_put(&peer->tx_map, key, now);
+    if (peer->tx_count >= BTC_NET_MAX_TX_REQUEST) {
+      btc_pool_warn(pool, "Peer advertised too many txs (%N).",
+                          &peer->addr);
+      btc_peer_close(peer);
+      return;
+    }
 
-    if (btc_chain_synced(pool->chain))
-      now += 50;
+    req = btc_pool_get_txreq(pool, hash, now + delay);
 
-    btc_zinv_push(&inv, btc_peer_tx_type(peer), hash);
-  }
+    btc_txreq_add(req, peer, now + delay);
 
-  if (inv.length == 0) {
-    btc_zinv_clear(&inv);
-    return;
-  }
+    /* Other announcers are only fallbacks. */
+    if (req->active != NULL)
+      continue;
 
-  if (peer->tx_map.size >= BTC_NET_MAX_TX_REQUEST) {
-    btc_zinv_clear(&inv);
-    btc_pool_warn(pool, "Peer advertised too many txs (%N).",
-                        &peer->addr);
-    btc_peer_close(peer);
-    return;
+    if (delay == 0 && peer->tx_inflight < BTC_POOL_TX_INFLIGHT)
+      btc_pool_request_tx(pool, req->tail, now);
+    else if (delay == 0)
+      btc_txreq_move(req, &pool->tx_pending);
+    else if (req->queue == NULL)
+      btc_txreq_move(req, &pool->tx_delayed);
   }
 
-  btc_pool_debug(pool, "Requesting %zu/%zu txs from peer with getdata (%N).",
-                       inv.length, (size_t)pool->tx_map.size, &peer->addr);
-
-  btc_peer_send_getdata(peer, &inv);
-
-  btc_zinv_clear(&inv);
+  btc_pool_send_txreqs(pool, peer);
 }
 
 static int
@@ -3354,6 +5152,10 @@ btc_pool_has_tx(btc_pool_t *pool, const uint8_t *hash) {
   if (btc_mempool_has_orphan(pool->mempool, hash))
     return 1;
 
+  /* Check for txs awaiting verification. */
+  if (btc_mempool_has_pending(pool->mempool, hash))
+    return 1;
+
   /* If we recently rejected this item. Ignore. */
   if (btc_mempool_has_reject(pool->mempool, hash)) {
     btc_pool_spam(pool, "Saw known reject of %H.", hash);
@@ -3368,6 +5170,7 @@ btc_pool_on_txinv(btc_pool_t *pool,
                   btc_peer_t *peer,
                   const btc_vector_t *hashes) {
   btc_vector_t out;
+  int64_t delay;
   size_t i;
 
   CHECK(hashes->length > 0);
@@ -3389,7 +5192,10 @@ btc_pool_on_txinv(btc_pool_t *pool,
     btc_vector_push(&out, hash);
   }
 
-  btc_pool_request_txs(pool, peer, &out);
+  /* Inbound announcers wait so that outbound ones are preferred. */
+  delay = peer->outbound ? 0 : BTC_POOL_TX_DELAY;
+
+  btc_pool_request_txs(pool, peer, &out, delay);
 
   btc_vector_clear(&out);
 }
@@ -3605,102 +5411,178 @@ btc_pool_on_getheaders(btc_pool_t *pool,
   btc_headers_clear(&blocks);
 }
 
-static void
+static int
 btc_pool_resolve_headers(btc_pool_t *pool, btc_peer_t *peer) {
   btc_hdrnode_t *node;
   btc_vector_t items;
+  int32_t limit;
+
+  if (!pool->checkpoints)
+    return 0;
+
+  if (!peer->outbound || peer->state != BTC_PEER_CONNECTED)
+    return 0;
+
+  if ((peer->services & pool->required_services) != pool->required_services)
+    return 0;
+
+  if (peer->block_map.size >= BTC_NET_MAX_BLOCKS_IN_FLIGHT)
+    return 0;
+
+  limit = btc_pool_window(pool);
 
   btc_vector_init(&items);
 
-  for (node = pool->header_next; node != NULL; node = node->next) {
-    pool->header_next = node->next;
+  for (node = pool->header_head->next; node != NULL; node = node->next) {
+    if (node->entry.height > limit)
+      break;
+
+    /* Peer may not have the block yet. */
+    if (!peer->loader && node->entry.height > peer->height)
+      break;
+
+    if (node->block != NULL)
+      continue;
+
+    if (btc_hashset_has(&pool->block_map, node->entry.hash))
+      continue;
 
-    btc_vector_push(&items, node->hash);
+    btc_vector_push(&items, node->entry.hash);
 
-    if (items.length == BTC_NET_MAX_INV)
+    if (peer->block_map.size + items.length >= BTC_NET_MAX_BLOCKS_IN_FLIGHT)
       break;
   }
 
-  btc_pool_request_blocks(pool, peer, &items);
+  if (items.length > 0)
+    btc_pool_request_blocks(pool, peer, &items);
+
   btc_vector_clear(&items);
+
+  return 1;
 }
 
 static void
-btc_pool_shift_header(btc_pool_t *pool) {
-  btc_hdrnode_t *node = pool->header_head;
-
-  pool->header_head = node->next;
-
-  if (node == pool->header_next)
-    pool->header_next = NULL;
-
-  btc_hdrnode_destroy(node);
+btc_pool_fill_window(btc_pool_t *pool) {
+  btc_peer_t *peer, *next;
 
-  if (pool->header_head == NULL) {
-    pool->header_tail = NULL;
-    pool->header_next = NULL;
+  for (peer = pool->peers.head; peer != NULL; peer = next) {
+    next = peer->next;
+    btc_pool_resolve_headers(pool, peer);
   }
 }
 
 static void
-btc_pool_resolve_chain(btc_pool_t *pool,
-                       btc_peer_t *peer,
-                       const uint8_t *hash) {
-  btc_hdrnode_t *node;
+btc_pool_request_headers(btc_pool_t *pool, btc_peer_t *peer) {
+  const btc_checkpoint_t *tip = pool->header_tip;
+  const btc_hdrnode_t *tail = pool->header_tail;
 
-  if (!pool->checkpoints)
+  if (pool->headers_done)
     return;
 
-  if (!peer->loader)
+  /* Already waiting on a response. */
+  if (peer->gh_time != -1)
     return;
 
-  if (peer->state != BTC_PEER_CONNECTED)
+  /* Don't let the header chain get too far ahead. */
+  if (tail->entry.height - pool->header_head->entry.height
+      >= BTC_NET_MAX_HEADER_AHEAD) {
     return;
+  }
+
+  btc_peer_send_getheaders_1(peer, tail->entry.hash,
+                             tip != NULL ? tip->hash : NULL);
+}
 
-  node = pool->header_head;
+static void
+btc_pool_shift_header(btc_pool_t *pool) {
+  btc_hdrnode_t *node = pool->header_head;
+  btc_hdrnode_t *head = node->next;
+  const btc_entry_t *entry;
 
-  CHECK(node != NULL);
+  CHECK(head != NULL);
 
-  if (!btc_hash_equal(hash, node->hash)) {
-    btc_pool_warn(pool, "Header hash mismatch %H != %H (%N).",
-                        hash, node->hash, &peer->addr);
+  entry = btc_chain_by_hash(pool->chain, head->entry.hash);
 
-    btc_peer_close(peer);
+  CHECK(entry != NULL);
 
+  /* Ancestors now live in the chain. */
+  head->entry.prev = entry->prev;
+
+  pool->header_head = head;
+
+  CHECK(btc_hashmap_del(&pool->header_map, head->entry.hash));
+
+  btc_hdrnode_destroy(node);
+}
+
+static void
+btc_pool_resolve_chain(btc_pool_t *pool) {
+  btc_peer_t *loader = pool->peers.load;
+  btc_hdrnode_t *node;
+
+  if (!pool->checkpoints)
     return;
-  }
 
-  if (node->height < pool->network->last_checkpoint) {
-    if (node->height == pool->header_tip->height) {
-      btc_pool_info(pool, "Received checkpoint %H (%d).",
-                          node->hash, node->height);
+  /* Connect any buffered blocks. */
+  while ((node = pool->header_head->next) != NULL) {
+    btc_block_t *block = node->block;
+
+    if (block == NULL)
+      break;
 
-      pool->header_tip = btc_pool_next_tip(pool, node->height);
+    node->block = NULL;
 
-      btc_peer_send_getheaders_1(peer, hash, pool->header_tip->hash);
+    pool->header_bytes -= btc_block_size(block);
 
+    if (!btc_chain_add(pool->chain, block, node->flags, node->id)) {
+      btc_pool_handle_reject(pool, "block", btc_chain_error(pool->chain),
+                                            node->id);
+      btc_block_destroy(block);
+      btc_pool_reset_chain(pool);
       return;
     }
 
-    btc_pool_resolve_headers(pool, peer);
+    btc_block_destroy(block);
     btc_pool_shift_header(pool);
+  }
+
+  if (pool->headers_done && pool->header_head == pool->header_tail) {
+    if (loader != NULL) {
+      btc_pool_info(pool, "Switching to getblocks (%N).", &loader->addr);
+      btc_pool_getblocks(pool, loader, btc_chain_tip(pool->chain)->hash, NULL);
+    }
+
+    btc_pool_clear_chain(pool);
 
     return;
   }
 
-  btc_pool_info(pool, "Switching to getblocks (%N).",
-                      &peer->addr);
+  if (loader != NULL)
+    btc_pool_request_headers(pool, loader);
 
-  btc_pool_clear_chain(pool);
+  btc_pool_fill_window(pool);
+}
+
+static int
+btc_pool_check_header(btc_pool_t *pool,
+                      const btc_header_t *hdr,
+                      const btc_entry_t *prev) {
+  /* The same contextual checks the chain runs
+     on the block, minus anything needing its body. */
+  if (hdr->bits != btc_chain_get_target(pool->chain, hdr->time, prev))
+    return 0;
+
+  if (hdr->time <= btc_entry_median_time(prev))
+    return 0;
 
-  btc_pool_getblocks(pool, peer, hash, NULL);
+  return 1;
 }
 
 static void
 btc_pool_on_headers(btc_pool_t *pool,
                     btc_peer_t *peer,
                     const btc_headers_t *msg) {
-  btc_hdrnode_t *node = NULL;
+  const btc_network_t *network = pool->network;
   int checkpoint = 0;
   size_t i;
 
@@ -3712,9 +5594,6 @@ btc_pool_on_headers(btc_pool_t *pool,
   if (!peer->loader)
     return;
 
-  if (msg->length == 0)
-    return;
-
   if (msg->length > 2000) {
     btc_peer_increase_ban(peer, 20);
     return;
@@ -3725,7 +5604,8 @@ btc_pool_on_headers(btc_pool_t *pool,
   for (i = 0; i < msg->length; i++) {
     const btc_header_t *hdr = msg->items[i];
     btc_hdrnode_t *last = pool->header_tail;
-    int32_t height = last->height + 1;
+    int32_t height = last->entry.height + 1;
+    btc_hdrnode_t *node;
     uint8_t hash[32];
 
     if (!btc_header_verify(hdr)) {
@@ -3735,7 +5615,7 @@ btc_pool_on_headers(btc_pool_t *pool,
       return;
     }
 
-    if (!btc_hash_equal(hdr->prev_block, last->hash)) {
+    if (!btc_hash_equal(hdr->prev_block, last->entry.hash)) {
       btc_pool_warn(pool, "Peer sent a bad header chain (%N).",
                           &peer->addr);
       btc_peer_close(peer);
@@ -3744,26 +5624,40 @@ btc_pool_on_headers(btc_pool_t *pool,
 
     btc_header_hash(hash, hdr);
 
-    if (height == pool->header_tip->height) {
+    if (btc_chain_has_invalid(pool->chain, hash)) {
+      btc_pool_warn(pool, "Peer sent an invalid header chain (%N).",
+                          &peer->addr);
+      btc_peer_increase_ban(peer, 100);
+      return;
+    }
+
+    if (pool->header_tip != NULL && height == pool->header_tip->height) {
       if (!btc_hash_equal(hash, pool->header_tip->hash)) {
         btc_pool_warn(pool, "Peer sent an invalid checkpoint (%N).",
                             &peer->addr);
         btc_peer_close(peer);
         return;
       }
+
+      btc_pool_info(pool, "Received checkpoint %H (%d).", hash, height);
+
+      pool->header_tip = btc_pool_next_tip(pool, height);
+
       checkpoint = 1;
     }
 
-    node = btc_hdrnode_create(hash, height);
+    if (!btc_pool_check_header(pool, hdr, &last->entry)) {
+      btc_pool_warn(pool, "Peer sent a header with bad context (%N).",
+                          &peer->addr);
+      btc_peer_increase_ban(peer, 100);
+      return;
+    }
 
-    if (pool->header_next == NULL)
-      pool->header_next = node;
+    node = btc_hdrnode_create(hdr, &last->entry);
 
-    if (pool->header_head == NULL)
-      pool->header_head = node;
+    CHECK(btc_hashmap_put(&pool->header_map, node->entry.hash, node));
 
-    if (pool->header_tail != NULL)
-      pool->header_tail->next = node;
+    last->next = node;
 
     pool->header_tail = node;
   }
@@ -3775,15 +5669,26 @@ btc_pool_on_headers(btc_pool_t *pool,
      chain, consider this a "block". */
   peer->block_time = btc_time_msec();
 
-  /* Request the blocks we just added. */
-  if (checkpoint) {
-    btc_pool_resolve_headers(pool, peer);
-    btc_pool_shift_header(pool);
-    return;
+  /* A short batch means the peer has nothing more to offer. */
+  if (msg->length < 2000 && !checkpoint) {
+    const btc_entry_t *tail = &pool->header_tail->entry;
+
+    /* Nothing past the last checkpoint would ever be downloaded. */
+    if (btc_hash_compare(tail->chainwork, network->pow.chainwork) < 0) {
+      btc_pool_warn(pool, "Peer sent a low-work header chain (%N).",
+                          &peer->addr);
+      btc_peer_close(peer);
+      return;
+    }
+
+    btc_pool_info(pool, "Synced header chain to height %d (%N).",
+                        tail->height, &peer->addr);
+
+    pool->headers_done = 1;
   }
 
-  /* Request more headers. */
-  btc_peer_send_getheaders_1(peer, node->hash, pool->header_tip->hash);
+  /* Request more headers and fill the download window. */
+  btc_pool_resolve_chain(pool);
 }
 
 static void
@@ -3796,26 +5701,75 @@ void
 btc_pool_announce_block(btc_pool_t *pool,
                         const btc_block_t *block,
                         const uint8_t *hash) {
+  /* Frames built here are reused by getdata for the same block. */
+  btc_recent_t *slot = btc_pool_remember(pool, hash);
   btc_peer_t *peer;
 
   for (peer = pool->peers.head; peer != NULL; peer = peer->next) {
     if (peer->state != BTC_PEER_CONNECTED)
       continue;
 
-    btc_peer_announce_block(peer, block, hash);
+    btc_peer_announce_block(peer, block, hash, slot);
   }
 }
 
 void
 btc_pool_announce_tx(btc_pool_t *pool, const btc_mpentry_t *entry) {
-  btc_peer_t *peer;
+  /* Picked up by each peer on its next trickle. */
+  btc_txlog_push(&pool->tx_log, entry->hash);
+}
+
+const btc_traffic_t *
+btc_pool_traffic(const btc_pool_t *pool) {
+  return &pool->traffic;
+}
+
+uint64_t
+btc_pool_maxupload(const btc_pool_t *pool) {
+  return pool->max_upload;
+}
+
+size_t
+btc_pool_size(const btc_pool_t *pool) {
+  return pool->peers.length;
+}
+
+size_t
+btc_pool_peerinfo(const btc_pool_t *pool, btc_peerinfo_t *items, size_t max) {
+  const btc_peer_t *peer;
+  size_t count = 0;
 
   for (peer = pool->peers.head; peer != NULL; peer = peer->next) {
-    if (peer->state != BTC_PEER_CONNECTED)
+    btc_peerinfo_t *item;
+
+    if (peer->state == BTC_PEER_DEAD)
       continue;
 
-    btc_peer_announce_tx(peer, entry);
+    if (count == max)
+      break;
+
+    item = &items[count++];
+
+    item->id = peer->id;
+    item->addr = peer->addr;
+    item->local = peer->local;
+    item->outbound = peer->outbound;
+    item->services = peer->services;
+    item->version = peer->version;
+    item->height = peer->height;
+    item->relay = peer->relay;
+    item->last_send = peer->last_send;
+    item->last_recv = peer->last_recv;
+    item->last_ping = peer->last_ping;
+    item->last_pong = peer->last_pong;
+    item->min_ping = peer->min_ping;
+    item->ban_score = peer->ban_score;
+    item->traffic = peer->traffic;
+
+    memcpy(item->agent, peer->agent, sizeof(item->agent));
   }
+
+  return count;
 }
 
 void
@@ -3838,11 +5792,26 @@ btc_pool_handle_badorphan(btc_pool_t *pool,
   btc_peer_reject(peer, msg, err);
 }
 
+void
+btc_pool_handle_reject(btc_pool_t *pool,
+                       const char *msg,
+                       const btc_verify_error_t *err,
+                       unsigned int id) {
+  btc_peer_t *peer = btc_peers_find(&pool->peers, id);
+
+  /* Peer may have disconnected while we were verifying. */
+  if (peer == NULL)
+    return;
+
+  btc_peer_reject(peer, msg, err);
+}
+
 static void
 btc_pool_add_block(btc_pool_t *pool,
                    btc_peer_t *peer,
                    const btc_block_t *block,
                    unsigned int flags) {
+  btc_hdrnode_t *node = NULL;
   uint8_t hash[32];
   int32_t height;
 
@@ -3858,8 +5827,30 @@ btc_pool_add_block(btc_pool_t *pool,
   peer->block_time = btc_time_msec();
   peer->last_ping = peer->block_time;
 
+  if (pool->checkpoints)
+    node = btc_hashmap_get(&pool->header_map, hash);
+
+  /* Buffer out-of-order blocks until they can connect. */
+  if (node != NULL && node != pool->header_head->next) {
+    if (node->block == NULL) {
+      node->block = btc_block_refconst(block);
+      node->flags = flags;
+      node->id = peer->id;
+
+      pool->header_bytes += btc_block_size(block);
+    }
+
+    btc_pool_resolve_headers(pool, peer);
+
+    return;
+  }
+
   if (!btc_chain_add(pool->chain, block, flags, peer->id)) {
     btc_peer_reject(peer, "block", btc_chain_error(pool->chain));
+
+    if (node != NULL)
+      btc_pool_reset_chain(pool);
+
     return;
   }
 
@@ -3903,7 +5894,10 @@ btc_pool_add_block(btc_pool_t *pool,
                         height, hash);
   }
 
-  btc_pool_resolve_chain(pool, peer, hash);
+  if (node != NULL) {
+    btc_pool_shift_header(pool);
+    btc_pool_resolve_chain(pool);
+  }
 }
 
 static void
@@ -3922,7 +5916,7 @@ btc_pool_on_tx(btc_pool_t *pool, btc_peer_t *peer, const btc_tx_t *tx) {
     return;
   }
 
-  if (!btc_mempool_add(pool->mempool, tx, peer->id)) {
+  if (!btc_mempool_enqueue(pool->mempool, tx, peer->id)) {
     btc_peer_reject(peer, "tx", btc_mempool_error(pool->mempool));
     return;
   }
@@ -3934,7 +5928,7 @@ btc_pool_on_tx(btc_pool_t *pool, btc_peer_t *peer, const btc_tx_t *tx) {
       btc_pool_debug(pool, "Requesting %zu missing transactions (%N).",
                            missing->length, &peer->addr);
 
-      btc_pool_request_txs(pool, peer, missing);
+      btc_pool_request_txs(pool, peer, missing, 0);
     }
 
     btc_vector_destroy(missing);
@@ -4051,7 +6045,6 @@ static void
 btc_pool_on_cmpctblock(btc_pool_t *pool,
                        btc_peer_t *peer,
                        btc_cmpct_t *block) {
-  const btc_hashmap_t *map = btc_mempool_map(pool->mempool);
   int rc;
 
   if (!(pool->flags & BTC_POOL_BIP152)) {
@@ -4124,7 +6117,7 @@ btc_pool_on_cmpctblock(btc_pool_t *pool,
     return;
   }
 
-  if (btc_cmpct_fill_mempool(block, map, peer->compact_witness)) {
+  if (btc_mempool_fill_compact(pool->mempool, block, peer->compact_witness)) {
     btc_block_t *blk = btc_block_create();
 
     btc_pool_debug(pool, "Received full compact block %H (%N).",
@@ -12,6 +12,7 @@
 #include <io/core.h>
 #include <io/http.h>
 #include <io/loop.h>
+#include <io/workers.h>
 
 #include <base/addrman.h>
 #include <node/chain.h>
@@ -50,6 +51,8 @@
 #include <wallet/iterator.h>
 #include <wallet/wallet.h>
 
+#include "../bio.h"
+#include "../impl.h"
 #include "../internal.h"
 
 /*
@@ -99,6 +102,19 @@ enum rpc_error {
   RPC_WALLET_ALREADY_UNLOCKED = -17
 };
 
+enum rest_format {
+  REST_NONE,
+  REST_BINARY,
+  REST_HEX,
+  REST_JSON
+};
+
+enum rpc_flags {
+  /* Never mutates node state. The handler may hand
+     its slow half to a worker (see `rpc_snap_t`). */
+  RPC_READONLY = 1 << 0
+};
+
 /*
  * Types
  */
@@ -114,13 +130,25 @@ typedef struct {
  */
 
 static void
-http_res_send_json(http_res_t *res, json_value *value) {
-  char *body = json_encode(value);
-  size_t length = strlen(body);
+http_res_send_json(http_res_t *res, json_writer *w) {
+  char *data;
+  size_t length;
+
+  json_write_data(w, "\n", 1);
+
+  /* Short responses keep their Content-Length. */
+  if (w->head == w->tail) {
+    json_writer_shift(w, &data, &length);
+    http_res_send_data(res, 200, "application/json", data, length);
+    return;
+  }
 
-  body[length++] = '\n';
+  http_res_begin(res, 200, "application/json");
 
-  http_res_send_data(res, 200, "application/json", body, length);
+  while (json_writer_shift(w, &data, &length))
+    http_res_chunk(res, data, length);
+
+  http_res_end(res);
 }
 
 /*
@@ -194,10 +222,43 @@ rpc_req_set(rpc_req_t *req, const json_value *obj) {
  * RPC Response
  */
 
+struct rpc_res_s;
+struct rpc_call_s;
+
+typedef void rpc_work_f(btc_rpc_t *rpc, struct rpc_res_s *res);
+
+/* State captured on the loop thread for a worker: chain
+   entries are never freed while the node runs, and the
+   coin snapshot pins the tip the handler looked at. */
+typedef struct rpc_snap_s {
+  const btc_entry_t *entry;
+  const btc_entry_t *tip;
+  const btc_snapshot_t *coins;
+  const json_value *arg;
+  const uint8_t *next;
+  int32_t depth;
+  uint8_t hash[32];
+  int index;
+  int verbosity;
+  int64_t fees;
+  uint32_t sequence;
+  int64_t time;
+  btc_tx_t *tx;
+  btc_view_t *view;
+} rpc_snap_t;
+
 typedef struct rpc_res_s {
   json_value *result;
+  json_writer stream;
+  uint8_t *data;
+  size_t length;
   json_int_t code;
   const char *msg;
+  rpc_work_f *work;
+  int wait;
+  int woken;
+  rpc_snap_t snap;
+  struct rpc_call_s *call;
 } rpc_res_t;
 
 static void
@@ -205,6 +266,25 @@ rpc_res_init(rpc_res_t *res) {
   res->result = NULL;
   res->code = 0;
   res->msg = NULL;
+  res->data = NULL;
+  res->length = 0;
+  res->work = NULL;
+  res->wait = 0;
+  res->woken = 0;
+  res->call = NULL;
+
+  json_writer_init(&res->stream);
+
+  memset(&res->snap, 0, sizeof(res->snap));
+}
+
+static void
+rpc_res_run(btc_rpc_t *rpc, rpc_res_t *res) {
+  rpc_work_f *work = res->work;
+
+  res->work = NULL;
+
+  work(rpc, res);
 }
 
 static void
@@ -212,7 +292,14 @@ rpc_res_error(rpc_res_t *res, int code, const char *msg) {
   if (res->result != NULL)
     json_builder_free(res->result);
 
+  json_writer_clear(&res->stream);
+
+  if (res->data != NULL)
+    btc_free(res->data);
+
   res->result = NULL;
+  res->data = NULL;
+  res->length = 0;
   res->code = code;
   res->msg = msg;
 }
@@ -252,6 +339,50 @@ rpc_res_encode(rpc_res_t *res, const json_value *id) {
   return obj;
 }
 
+static void
+rpc_res_write(json_writer *w, rpc_res_t *res, const json_value *id) {
+  json_write_object(w);
+  json_write_key(w, "result");
+
+  /* Streamed results are spliced in without a copy. */
+  if (res->stream.head != NULL)
+    json_writer_concat(w, &res->stream);
+  else
+    json_write_value(w, res->result);
+
+  json_write_key(w, "error");
+
+  if (res->code != 0) {
+    if (res->msg == NULL)
+      res->msg = "Error";
+
+    json_write_object(w);
+    json_write_key(w, "code");
+    json_write_integer(w, res->code);
+    json_write_key(w, "message");
+    json_write_string(w, res->msg);
+    json_write_object_end(w);
+  } else {
+    json_write_null(w);
+  }
+
+  json_write_key(w, "id");
+
+  if (id != NULL && id->type == json_integer)
+    json_write_integer(w, id->u.integer);
+  else if (id != NULL && id->type == json_string)
+    json_write_string(w, id->u.string.ptr);
+  else
+    json_write_null(w);
+
+  json_write_object_end(w);
+
+  if (res->result != NULL)
+    json_builder_free(res->result);
+
+  res->result = NULL;
+}
+
 /*
  * RPC
  */
@@ -271,7 +402,14 @@ struct btc_rpc_s {
   unsigned int flags;
   int port;
   btc_vector_t bind;
+  char path[BTC_PATH_MAX];
+  char file[BTC_PATH_MAX];
   uint8_t auth_hash[32];
+  int threads;
+  btc_workers_t *workers;
+  btc_mutex_t lock;
+  struct rpc_call_s *done;
+  btc_vector_t polls;
 };
 
 BTC_DEFINE_LOGGER(btc_log, btc_rpc_t, "rpc")
@@ -299,8 +437,13 @@ btc_rpc_create(btc_node_t *node) {
   rpc->http = http_server_create(node->loop);
   rpc->flags = BTC_RPC_DEFAULT_FLAGS;
   rpc->port = network->rpc_port;
+  rpc->threads = 0;
+  rpc->workers = NULL;
+  rpc->done = NULL;
 
   btc_vector_init(&rpc->bind);
+  btc_vector_init(&rpc->polls);
+  btc_mutex_init(&rpc->lock);
 
   rpc->http->on_request = on_request;
   rpc->http->data = rpc;
@@ -316,6 +459,8 @@ btc_rpc_destroy(btc_rpc_t *rpc) {
     btc_free(rpc->bind.items[i]);
 
   btc_vector_clear(&rpc->bind);
+  btc_vector_clear(&rpc->polls);
+  btc_mutex_destroy(&rpc->lock);
   http_server_destroy(rpc->http);
   btc_free(rpc);
 }
@@ -335,6 +480,11 @@ btc_rpc_set_bind(btc_rpc_t *rpc, const btc_netaddr_t *addr) {
   btc_vector_push(&rpc->bind, sa);
 }
 
+void
+btc_rpc_set_path(btc_rpc_t *rpc, const char *path) {
+  CHECK(btc_strcpy(rpc->path, sizeof(rpc->path), path));
+}
+
 void
 btc_rpc_set_credentials(btc_rpc_t *rpc, const char *user, const char *pass) {
   if (pass != NULL && *pass != '\0')
@@ -343,11 +493,52 @@ btc_rpc_set_credentials(btc_rpc_t *rpc, const char *user, const char *pass) {
     btc_hash_init(rpc->auth_hash);
 }
 
+void
+btc_rpc_set_threads(btc_rpc_t *rpc, int threads) {
+  rpc->threads = threads;
+}
+
+void
+btc_rpc_set_max_connections(btc_rpc_t *rpc, int max) {
+  CHECK(max >= 0);
+  http_server_set_max_connections(rpc->http, max);
+}
+
+void
+btc_rpc_set_timeout(btc_rpc_t *rpc, int timeout) {
+  CHECK(timeout >= 0);
+  http_server_set_timeout(rpc->http, (int64_t)timeout * 1000);
+}
+
+static void
+btc_rpc_unlink(btc_rpc_t *rpc) {
+  if (*rpc->file != '\0') {
+    btc_fs_unlink(rpc->file);
+    *rpc->file = '\0';
+  }
+}
+
 static int
 btc_rpc_listen(btc_rpc_t *rpc) {
   size_t i;
 
-  if (rpc->bind.length == 0) {
+  if (*rpc->path != '\0') {
+    if (!http_server_listen_unix(rpc->http, rpc->path)) {
+      const char *msg = http_server_strerror(rpc->http);
+
+      btc_log_error(rpc, "Could not listen on %s: %s.", rpc->path, msg);
+
+      http_server_close(rpc->http);
+
+      return 0;
+    }
+
+    strcpy(rpc->file, rpc->path);
+
+    btc_log_info(rpc, "Listening on %s.", rpc->path);
+  }
+
+  if (rpc->bind.length == 0 && *rpc->path == '\0') {
     if (!http_server_listen_local(rpc->http, rpc->port)) {
       const char *msg = http_server_strerror(rpc->http);
 
@@ -374,6 +565,7 @@ btc_rpc_listen(btc_rpc_t *rpc) {
 
       btc_log_error(rpc, "Could not listen on %S: %s.", addr, msg);
 
+      btc_rpc_unlink(rpc);
       http_server_close(rpc->http);
 
       return 0;
@@ -385,6 +577,15 @@ btc_rpc_listen(btc_rpc_t *rpc) {
   return 1;
 }
 
+static void
+on_calls(void *arg);
+
+static void
+on_polls(void *arg);
+
+static void
+btc_rpc_poll(btc_rpc_t *rpc, const char *abort);
+
 int
 btc_rpc_open(btc_rpc_t *rpc, unsigned int flags) {
   rpc->flags = flags;
@@ -394,6 +595,14 @@ btc_rpc_open(btc_rpc_t *rpc, unsigned int flags) {
   if (!btc_rpc_listen(rpc))
     return 0;
 
+  btc_loop_on_tick(rpc->loop, on_polls, rpc);
+
+  if (rpc->threads > 0) {
+    rpc->workers = btc_workers_create(rpc->threads, 1);
+
+    btc_loop_on_tick(rpc->loop, on_calls, rpc);
+  }
+
   return 1;
 }
 
@@ -402,6 +611,24 @@ btc_rpc_close(btc_rpc_t *rpc) {
   btc_log_info(rpc, "Closing RPC.");
 
   http_server_close(rpc->http);
+
+  btc_rpc_unlink(rpc);
+
+  btc_rpc_poll(rpc, "RPC server is shutting down");
+
+  btc_loop_off_tick(rpc->loop, on_polls, rpc);
+
+  if (rpc->workers != NULL) {
+    /* Answer (or drop) whatever is still in flight. */
+    btc_workers_wait(rpc->workers);
+
+    on_calls(rpc);
+
+    btc_loop_off_tick(rpc->loop, on_calls, rpc);
+    btc_workers_destroy(rpc->workers);
+
+    rpc->workers = NULL;
+  }
 }
 
 /*
@@ -459,11 +686,50 @@ btc_rpc_getbestblockhash(btc_rpc_t *rpc,
   res->result = json_hash_new(tip->hash);
 }
 
+static void
+btc_rpc_getblock_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+  const btc_entry_t *entry = snap->entry;
+
+  if (snap->verbosity > 0) {
+    btc_block_t *block = btc_chain_get_block(rpc->chain, entry);
+    btc_view_t *view = NULL;
+
+    if (block == NULL)
+      THROW_MISC("Can't read block from disk");
+
+    if (snap->verbosity > 2)
+      view = btc_chain_get_undo(rpc->chain, entry, block);
+
+    json_block_write(&res->stream,
+                     block,
+                     entry,
+                     view,
+                     snap->depth,
+                     snap->next,
+                     snap->verbosity > 1,
+                     rpc->network);
+
+    btc_block_destroy(block);
+
+    if (view != NULL)
+      btc_view_destroy(view);
+  } else {
+    uint8_t *data;
+    size_t length;
+
+    if (!btc_chain_get_block_data(rpc->chain, &data, &length, entry))
+      THROW_MISC("Can't read block from disk");
+
+    res->result = json_raw_new(data, length);
+
+    btc_free(data);
+  }
+}
+
 static void
 btc_rpc_getblock(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   const btc_entry_t *entry;
-  int32_t confirmations;
-  const uint8_t *next;
   int verbosity = 1;
   uint8_t hash[32];
   int height;
@@ -494,41 +760,10 @@ btc_rpc_getblock(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
       THROW_TYPE(verbosity, integer);
   }
 
-  if (verbosity > 0) {
-    btc_block_t *block = btc_chain_get_block(rpc->chain, entry);
-    btc_view_t *view = NULL;
-
-    if (block == NULL)
-      THROW_MISC("Can't read block from disk");
-
-    confirmations = btc_rpc_get_depth(rpc, entry, &next);
-
-    if (verbosity > 2)
-      view = btc_chain_get_undo(rpc->chain, entry, block);
-
-    res->result = json_block_new_ex(block,
-                                    entry,
-                                    view,
-                                    confirmations,
-                                    next,
-                                    verbosity > 1,
-                                    rpc->network);
-
-    btc_block_destroy(block);
-
-    if (view != NULL)
-      btc_view_destroy(view);
-  } else {
-    uint8_t *data;
-    size_t length;
-
-    if (!btc_chain_get_raw_block(rpc->chain, &data, &length, entry))
-      THROW_MISC("Can't read block from disk");
-
-    res->result = json_raw_new(data, length);
-
-    btc_free(data);
-  }
+  res->snap.entry = entry;
+  res->snap.depth = btc_rpc_get_depth(rpc, entry, &res->snap.next);
+  res->snap.verbosity = verbosity;
+  res->work = btc_rpc_getblock_work;
 }
 
 static void
@@ -594,13 +829,23 @@ btc_rpc_getblockhash(btc_rpc_t *rpc,
   res->result = json_hash_new(entry->hash);
 }
 
+static void
+btc_rpc_getblockheader_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+
+  (void)rpc;
+
+  if (snap->verbosity)
+    res->result = json_entry_new_ex(snap->entry, snap->depth, snap->next);
+  else
+    res->result = json_header_raw(&snap->entry->header);
+}
+
 static void
 btc_rpc_getblockheader(btc_rpc_t *rpc,
                        const json_params *params,
                        rpc_res_t *res) {
   const btc_entry_t *entry;
-  int32_t confirmations;
-  const uint8_t *next;
   uint8_t hash[32];
   int verbose = 1;
   int height;
@@ -631,13 +876,10 @@ btc_rpc_getblockheader(btc_rpc_t *rpc,
       THROW_TYPE(verbose, boolean);
   }
 
-  if (verbose) {
-    confirmations = btc_rpc_get_depth(rpc, entry, &next);
-
-    res->result = json_entry_new_ex(entry, confirmations, next);
-  } else {
-    res->result = json_header_raw(&entry->header);
-  }
+  res->snap.entry = entry;
+  res->snap.depth = btc_rpc_get_depth(rpc, entry, &res->snap.next);
+  res->snap.verbosity = verbose;
+  res->work = btc_rpc_getblockheader_work;
 }
 
 static void
@@ -679,10 +921,25 @@ static void
 btc_rpc_getmempoolinfo(btc_rpc_t *rpc,
                        const json_params *params,
                        rpc_res_t *res) {
-  (void)rpc;
+  btc_mempool_t *mp = rpc->mempool;
+  json_value *obj;
 
   if (params->help || params->length != 0)
     THROW_MISC("getmempoolinfo");
+
+  obj = json_object_new(7);
+
+  json_object_push(obj, "loaded", json_boolean_new(1));
+  json_object_push(obj, "size", json_integer_new(btc_mempool_size(mp)));
+  json_object_push(obj, "bytes", json_integer_new(btc_mempool_bytes(mp)));
+  json_object_push(obj, "usage", json_integer_new(btc_mempool_usage(mp)));
+  json_object_push(obj, "maxmempool", json_integer_new(btc_mempool_limit(mp)));
+  json_object_push(obj, "mempoolminfee",
+                        json_amount_new(rpc->network->min_relay));
+  json_object_push(obj, "minrelaytxfee",
+                        json_amount_new(rpc->network->min_relay));
+
+  res->result = obj;
 }
 
 static void
@@ -695,20 +952,54 @@ btc_rpc_getrawmempool(btc_rpc_t *rpc,
     THROW_MISC("getrawmempool ( verbose mempool_sequence )");
 }
 
+static json_value *
+json_txout_new(const btc_entry_t *tip,
+               const btc_coin_t *coin,
+               const btc_network_t *network) {
+  json_value *obj = json_object_new(6);
+  int32_t depth = 0;
+
+  if (coin->height >= 0)
+    depth = tip->height - coin->height + 1;
+
+  json_object_push(obj, "bestblock", json_hash_new(tip->hash));
+  json_object_push(obj, "confirmations", json_integer_new(depth));
+  json_object_push(obj, "value", json_amount_new(coin->output.value));
+  json_object_push(obj, "scriptPubKey", json_script_new(&coin->output.script,
+                                                        network));
+  json_object_push(obj, "version", json_integer_new(coin->version));
+  json_object_push(obj, "coinbase", json_boolean_new(coin->coinbase));
+
+  return obj;
+}
+
+static void
+btc_rpc_gettxout_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+  btc_coin_t *coin;
+
+  coin = btc_chain_coin_at(rpc->chain, snap->coins, snap->hash, snap->index);
+
+  if (coin == NULL) {
+    res->result = json_null_new();
+    return;
+  }
+
+  res->result = json_txout_new(snap->tip, coin, rpc->network);
+
+  btc_coin_destroy(coin);
+}
+
 static void
 btc_rpc_gettxout(btc_rpc_t *rpc,
                  const json_params *params,
                  rpc_res_t *res) {
   const btc_entry_t *tip = btc_chain_tip(rpc->chain);
   btc_coin_t *coin = NULL;
-  int32_t depth = 0;
   uint8_t hash[32];
   int mempool = 1;
-  json_value *obj;
   int index;
 
-  (void)rpc;
-
   if (params->help || params->length < 2 || params->length > 3)
     THROW_MISC("gettxout \"txid\" n ( include_mempool )");
 
@@ -726,28 +1017,18 @@ btc_rpc_gettxout(btc_rpc_t *rpc,
   if (mempool)
     coin = btc_mempool_coin(rpc->mempool, hash, index);
 
-  if (coin == NULL)
-    coin = btc_chain_coin(rpc->chain, hash, index);
-
   if (coin == NULL) {
-    res->result = json_null_new();
-    return;
-  }
-
-  if (coin->height >= 0)
-    depth = tip->height - coin->height + 1;
+    res->snap.tip = tip;
+    res->snap.coins = btc_chain_snapshot(rpc->chain);
+    res->snap.index = index;
+    res->work = btc_rpc_gettxout_work;
 
-  obj = json_object_new(6);
+    memcpy(res->snap.hash, hash, 32);
 
-  json_object_push(obj, "bestblock", json_hash_new(tip->hash));
-  json_object_push(obj, "confirmations", json_integer_new(depth));
-  json_object_push(obj, "value", json_amount_new(coin->output.value));
-  json_object_push(obj, "scriptPubKey", json_script_new(&coin->output.script,
-                                                        rpc->network));
-  json_object_push(obj, "version", json_integer_new(coin->version));
-  json_object_push(obj, "coinbase", json_boolean_new(coin->coinbase));
+    return;
+  }
 
-  res->result = obj;
+  res->result = json_txout_new(tip, coin, rpc->network);
 
   btc_coin_destroy(coin);
 }
@@ -934,60 +1215,443 @@ btc_rpc_setgenerate(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
  * Mining
  */
 
-static void
-btc_rpc_getblocktemplate(btc_rpc_t *rpc,
-                         const json_params *params,
-                         rpc_res_t *res) {
-  (void)rpc;
+#define RPC_SUBMIT_PREFIX 4096
+#define RPC_LONGPOLL_INTERVAL (60 * 1000)
 
-  if (params->help || params->length > 1)
-    THROW_MISC("getblocktemplate ( \"template_request\" )");
+static void
+btc_rpc_longpollid(char *id, const uint8_t *hash, uint32_t sequence) {
+  btc_hash_export(id, hash);
+  sprintf(id + 64, "%08lx", (unsigned long)sequence);
 }
 
-static void
-btc_rpc_getmininginfo(btc_rpc_t *rpc,
-                      const json_params *params,
-                      rpc_res_t *res) {
-  (void)rpc;
+static int
+btc_rpc_parse_longpollid(uint8_t *hash, uint32_t *sequence, const char *id) {
+  uint8_t raw[4];
+  char tmp[65];
 
-  if (params->help || params->length != 0)
-    THROW_MISC("getmininginfo");
-}
+  if (strlen(id) != 64 + 8)
+    return 0;
 
-static void
-btc_rpc_getnetworkhashps(btc_rpc_t *rpc,
-                         const json_params *params,
-                         rpc_res_t *res) {
-  (void)rpc;
+  memcpy(tmp, id, 64);
 
-  if (params->help || params->length > 2)
-    THROW_MISC("getnetworkhashps ( nblocks height )");
-}
+  tmp[64] = '\0';
 
-static void
-btc_rpc_getwork(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
-  (void)rpc;
+  if (!btc_hash_import(hash, tmp))
+    return 0;
 
-  if (params->help || params->length > 1)
-    THROW_MISC("getwork ( \"data\" )");
-}
+  if (!btc_base16_decode(raw, id + 64, 8))
+    return 0;
 
-static void
-btc_rpc_prioritisetransaction(btc_rpc_t *rpc,
-                              const json_params *params,
-                              rpc_res_t *res) {
-  (void)rpc;
+  *sequence = btc_read32be(raw);
 
-  if (params->help || params->length != 2)
-    THROW_MISC("prioritisetransaction \"txid\" fee_delta");
+  return 1;
+}
+
+static const char *
+btc_rpc_propose(btc_rpc_t *rpc, const btc_block_t *block) {
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+  int64_t now = btc_timedata_now(rpc->timedata);
+  const btc_header_t *hdr = &block->header;
+  btc_verify_error_t err;
+  uint8_t hash[32];
+
+  btc_header_hash(hash, hdr);
+
+  if (btc_chain_has_hash(rpc->chain, hash))
+    return "duplicate";
+
+  if (btc_chain_has_invalid(rpc->chain, hash))
+    return "duplicate-invalid";
+
+  if (!btc_hash_equal(hdr->prev_block, tip->hash))
+    return "inconclusive-not-best-prevblk";
+
+  if (hdr->bits != btc_chain_get_target(rpc->chain, hdr->time, tip))
+    return "bad-diffbits";
+
+  if (hdr->time <= btc_entry_median_time(tip))
+    return "time-too-old";
+
+  if (!btc_block_check_sanity(&err, block, now))
+    return err.reason;
+
+  return NULL;
 }
 
 static void
-btc_rpc_submitblock(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
+btc_rpc_write_template(json_writer *w, const btc_tmpl_t *bt, const char *id) {
+  int witness = btc_tmpl_witness(bt);
+  int scale = witness ? 1 : BTC_WITNESS_SCALE_FACTOR;
+  btc_hashtab_t index;
+  uint8_t target[32];
+  btc_script_t script;
+  btc_buffer_t raw;
+  char bits[9];
+  size_t i, j;
+
+  btc_hashtab_init(&index);
+  btc_buffer_init(&raw);
+
+  CHECK(btc_compact_export(target, bt->bits));
+
+  sprintf(bits, "%08lx", (unsigned long)bt->bits);
+
+  json_write_object(w);
+  json_write_key(w, "capabilities");
+  json_write_array(w);
+  json_write_string(w, "proposal");
+  json_write_array_end(w);
+  json_write_key(w, "version");
+  json_write_integer(w, bt->version);
+  json_write_key(w, "rules");
+  json_write_array(w);
+
+  if (bt->flags & BTC_SCRIPT_VERIFY_CHECKSEQUENCEVERIFY)
+    json_write_string(w, "csv");
+
+  if (witness)
+    json_write_string(w, "!segwit");
+
+  json_write_array_end(w);
+  json_write_key(w, "vbavailable");
+  json_write_object(w);
+  json_write_object_end(w);
+  json_write_key(w, "vbrequired");
+  json_write_integer(w, 0);
+  json_write_key(w, "previousblockhash");
+  json_write_hash(w, bt->prev_block);
+  json_write_key(w, "transactions");
+  json_write_array(w);
+
+  for (i = 0; i < bt->txs.length; i++) {
+    const btc_blockentry_t *item = bt->txs.items[i];
+    const btc_tx_t *tx = item->tx;
+
+    btc_buffer_grow(&raw, btc_tx_size(tx));
+
+    raw.length = btc_tx_write(raw.data, tx) - raw.data;
+
+    json_write_object(w);
+    json_write_key(w, "data");
+    json_write_hex(w, raw.data, raw.length);
+    json_write_key(w, "txid");
+    json_write_hash(w, item->hash);
+    json_write_key(w, "hash");
+    json_write_hash(w, item->whash);
+    json_write_key(w, "depends");
+    json_write_array(w);
+
+    /* Parents always come first (1-based indices). */
+    for (j = 0; j < tx->inputs.length; j++) {
+      const btc_input_t *input = tx->inputs.items[j];
+      uint8_t *hash = (uint8_t *)input->prevout.hash;
+
+      if (btc_hashtab_has(&index, hash))
+        json_write_integer(w, btc_hashtab_get(&index, hash));
+    }
+
+    json_write_array_end(w);
+    json_write_key(w, "fee");
+    json_write_integer(w, item->fee);
+    json_write_key(w, "sigops");
+    json_write_integer(w, item->sigops / scale);
+    json_write_key(w, "weight");
+    json_write_integer(w, item->weight);
+    json_write_object_end(w);
+
+    btc_hashtab_put(&index, (uint8_t *)item->hash, i + 1);
+  }
+
+  json_write_array_end(w);
+  json_write_key(w, "coinbaseaux");
+  json_write_object(w);
+  json_write_key(w, "flags");
+  json_write_hex(w, bt->cbflags.data, bt->cbflags.length);
+  json_write_object_end(w);
+  json_write_key(w, "coinbasevalue");
+  json_write_integer(w, btc_tmpl_reward(bt));
+  json_write_key(w, "longpollid");
+  json_write_string(w, id);
+  json_write_key(w, "target");
+  json_write_hash(w, target);
+  json_write_key(w, "mintime");
+  json_write_integer(w, bt->mtp + 1);
+  json_write_key(w, "mutable");
+  json_write_array(w);
+  json_write_string(w, "time");
+  json_write_string(w, "transactions");
+  json_write_string(w, "prevblock");
+  json_write_array_end(w);
+  json_write_key(w, "noncerange");
+  json_write_string(w, "00000000ffffffff");
+  json_write_key(w, "sigoplimit");
+  json_write_integer(w, BTC_MAX_BLOCK_SIGOPS_COST / scale);
+  json_write_key(w, "sizelimit");
+  json_write_integer(w, witness ? BTC_MAX_BLOCK_WEIGHT : BTC_MAX_BLOCK_SIZE);
+
+  if (witness) {
+    json_write_key(w, "weightlimit");
+    json_write_integer(w, BTC_MAX_BLOCK_WEIGHT);
+  }
+
+  json_write_key(w, "curtime");
+  json_write_integer(w, bt->time);
+  json_write_key(w, "bits");
+  json_write_string(w, bits);
+  json_write_key(w, "height");
+  json_write_integer(w, bt->height);
+
+  if (witness) {
+    btc_script_init(&script);
+    btc_script_set_commitment(&script, bt->commitment);
+
+    json_write_key(w, "default_witness_commitment");
+    json_write_hex(w, script.data, script.length);
+
+    btc_script_clear(&script);
+  }
+
+  json_write_object_end(w);
+
+  btc_buffer_clear(&raw);
+  btc_hashtab_clear(&index);
+}
+
+static void
+btc_rpc_getblocktemplate(btc_rpc_t *rpc,
+                         const json_params *params,
+                         rpc_res_t *res) {
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+  const json_value *opts = NULL;
+  const char *mode = "template";
+  const char *lpid = NULL;
+  const json_value *val;
+  const btc_tmpl_t *bt;
+  uint32_t sequence;
+  char id[64 + 8 + 1];
+  uint8_t hash[32];
+  int segwit = 0;
+  unsigned int i;
+
+  if (params->help || params->length > 1)
+    THROW_MISC("getblocktemplate ( \"template_request\" )");
+
+  if (params->length > 0 && params->values[0]->type != json_null) {
+    opts = params->values[0];
+
+    if (opts->type != json_object)
+      THROW_TYPE(template_request, object);
+  }
+
+  if (opts != NULL && (val = json_object_get(opts, "mode")) != NULL) {
+    if (!json_string_get(&mode, val))
+      THROW_TYPE(mode, string);
+  }
+
+  if (strcmp(mode, "proposal") == 0) {
+    const char *reason;
+    btc_block_t *block;
+
+    val = json_object_get(opts, "data");
+
+    if (val == NULL || !json_block_get(&block, val))
+      THROW(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+
+    reason = btc_rpc_propose(rpc, block);
+
+    if (reason != NULL)
+      res->result = json_string_new(reason);
+    else
+      res->result = json_null_new();
+
+    btc_block_destroy(block);
+
+    return;
+  }
+
+  if (strcmp(mode, "template") != 0)
+    THROW(RPC_INVALID_PARAMETER, "Invalid mode");
+
+  if (opts != NULL && (val = json_object_get(opts, "rules")) != NULL) {
+    if (val->type != json_array)
+      THROW_TYPE(rules, array);
+
+    for (i = 0; i < val->u.array.length; i++) {
+      const json_value *rule = val->u.array.values[i];
+
+      if (rule->type != json_string)
+        THROW_TYPE(rules, array);
+
+      if (strcmp(rule->u.string.ptr, "segwit") == 0)
+        segwit = 1;
+    }
+  }
+
+  if (opts != NULL && (val = json_object_get(opts, "longpollid")) != NULL) {
+    if (!json_string_get(&lpid, val))
+      THROW_TYPE(longpollid, string);
+
+    if (!btc_rpc_parse_longpollid(hash, &sequence, lpid))
+      THROW(RPC_INVALID_PARAMETER, "Invalid longpollid");
+  }
+
+  if (rpc->network->type != BTC_NETWORK_REGTEST) {
+    if (!btc_chain_synced(rpc->chain))
+      THROW(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Mako is downloading blocks...");
+  }
+
+  bt = btc_miner_get_template(rpc->miner);
+
+  /* The caller already has a template on this tip: park
+     the response until the tip moves, or until the mempool
+     has changed and either fees rose or enough time passed. */
+  if (lpid != NULL && !res->woken && btc_hash_equal(hash, tip->hash)) {
+    btc_hash_copy(res->snap.hash, tip->hash);
+
+    res->snap.fees = bt->fees;
+    res->snap.sequence = sequence;
+    res->snap.time = btc_time_msec();
+    res->wait = 1;
+
+    return;
+  }
+
+  sequence = btc_mempool_sequence(rpc->mempool);
+
+  btc_rpc_longpollid(id, tip->hash, sequence);
+
+  if (btc_tmpl_witness(bt) && !segwit) {
+    THROW(RPC_INVALID_PARAMETER, "getblocktemplate must be called "
+                                 "with the segwit rule set");
+  }
+
+  btc_rpc_write_template(&res->stream, bt, id);
+}
+
+static void
+btc_rpc_getmininginfo(btc_rpc_t *rpc,
+                      const json_params *params,
+                      rpc_res_t *res) {
   (void)rpc;
 
-  if (params->help || params->length != 1)
-    THROW_MISC("submitblock \"hexdata\"");
+  if (params->help || params->length != 0)
+    THROW_MISC("getmininginfo");
+}
+
+static void
+btc_rpc_getnetworkhashps(btc_rpc_t *rpc,
+                         const json_params *params,
+                         rpc_res_t *res) {
+  (void)rpc;
+
+  if (params->help || params->length > 2)
+    THROW_MISC("getnetworkhashps ( nblocks height )");
+}
+
+static void
+btc_rpc_getwork(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
+  (void)rpc;
+
+  if (params->help || params->length > 1)
+    THROW_MISC("getwork ( \"data\" )");
+}
+
+static void
+btc_rpc_prioritisetransaction(btc_rpc_t *rpc,
+                              const json_params *params,
+                              rpc_res_t *res) {
+  (void)rpc;
+
+  if (params->help || params->length != 2)
+    THROW_MISC("prioritisetransaction \"txid\" fee_delta");
+}
+
+static btc_block_t *
+btc_rpc_rebuild(btc_rpc_t *rpc, const json_value *obj) {
+  /* Blocks mined from one of our recent templates only
+     need their header and coinbase decoded. */
+  uint8_t raw[RPC_SUBMIT_PREFIX];
+  btc_block_t *block = NULL;
+  const uint8_t *xp = raw;
+  btc_header_t hdr;
+  size_t xn, count;
+  btc_tx_t *cb;
+
+  if (obj->type != json_string || (obj->u.string.length & 1))
+    return NULL;
+
+  xn = obj->u.string.length / 2;
+
+  if (xn > sizeof(raw))
+    xn = sizeof(raw);
+
+  if (!btc_base16_decode(raw, obj->u.string.ptr, xn * 2))
+    return NULL;
+
+  if (!btc_header_read(&hdr, &xp, &xn))
+    return NULL;
+
+  if (!btc_size_read(&count, &xp, &xn))
+    return NULL;
+
+  cb = btc_tx_create();
+
+  if (btc_tx_read(cb, &xp, &xn))
+    block = btc_miner_rebuild(rpc->miner, &hdr, cb);
+
+  btc_tx_destroy(cb);
+
+  if (block == NULL)
+    return NULL;
+
+  /* Anything else in the hex means it isn't our block. */
+  if (block->txs.length != count
+      || btc_block_size(block) != obj->u.string.length / 2) {
+    btc_block_destroy(block);
+    return NULL;
+  }
+
+  return block;
+}
+
+static void
+btc_rpc_submitblock(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
+  const btc_verify_error_t *err;
+  const btc_entry_t *entry;
+  btc_block_t *block;
+  uint8_t hash[32];
+
+  if (params->help || params->length < 1 || params->length > 2)
+    THROW_MISC("submitblock \"hexdata\" ( \"dummy\" )");
+
+  block = btc_rpc_rebuild(rpc, params->values[0]);
+
+  if (block == NULL && !json_block_get(&block, params->values[0]))
+    THROW(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+
+  btc_header_hash(hash, &block->header);
+
+  if (btc_chain_has_hash(rpc->chain, hash)) {
+    res->result = json_string_new("duplicate");
+    btc_block_destroy(block);
+    return;
+  }
+
+  if (!btc_chain_add(rpc->chain, block, BTC_BLOCK_DEFAULT_FLAGS, 0)) {
+    err = btc_chain_error(rpc->chain);
+    res->result = json_string_new(err->reason);
+    btc_block_destroy(block);
+    return;
+  }
+
+  entry = btc_chain_by_hash(rpc->chain, hash);
+
+  if (entry == NULL || !btc_chain_is_main(rpc->chain, entry))
+    res->result = json_string_new("inconclusive");
+  else
+    res->result = json_null_new();
+
+  btc_block_destroy(block);
 }
 
 /*
@@ -1044,10 +1708,31 @@ static void
 btc_rpc_getnettotals(btc_rpc_t *rpc,
                      const json_params *params,
                      rpc_res_t *res) {
-  (void)rpc;
+  const btc_traffic_t *traffic;
+  json_value *obj, *target;
+  uint64_t max_upload;
 
   if (params->help || params->length != 0)
     THROW_MISC("getnettotals");
+
+  traffic = btc_pool_traffic(rpc->pool);
+  max_upload = btc_pool_maxupload(rpc->pool);
+
+  target = json_object_new(2);
+
+  json_object_push(target, "timeframe", json_integer_new(86400));
+  json_object_push(target, "target", json_integer_new(max_upload));
+
+  obj = json_object_new(4);
+
+  json_object_push(obj, "totalbytesrecv",
+                        json_integer_new(traffic->bytes_recv));
+  json_object_push(obj, "totalbytessent",
+                        json_integer_new(traffic->bytes_sent));
+  json_object_push(obj, "timemillis", json_integer_new(btc_time_msec()));
+  json_object_push(obj, "uploadtarget", target);
+
+  res->result = obj;
 }
 
 static void
@@ -1070,12 +1755,93 @@ btc_rpc_getnodeaddresses(btc_rpc_t *rpc,
     THROW_MISC("getnodeaddresses ( count )");
 }
 
+static json_value *
+json_traffic_new(const uint64_t *bytes) {
+  json_value *obj = json_object_new(0);
+  btc_msg_t msg;
+  int type;
+
+  for (type = 0; type <= BTC_MSG_UNKNOWN; type++) {
+    if (bytes[type] == 0)
+      continue;
+
+    btc_msg_set_type(&msg, (enum btc_msgtype)type);
+
+    json_object_push(obj, msg.cmd, json_integer_new(bytes[type]));
+  }
+
+  return obj;
+}
+
+static json_value *
+json_peerinfo_new(const btc_peerinfo_t *item, int64_t skew) {
+  const btc_traffic_t *traffic = &item->traffic;
+  json_value *obj = json_object_new(20);
+  char addr[BTC_ADDRSTRLEN + 1];
+
+  json_object_push(obj, "id", json_integer_new(item->id));
+
+  btc_netaddr_get_str(addr, &item->addr);
+
+  json_object_push(obj, "addr", json_string_new(addr));
+
+  if (!btc_netaddr_is_null(&item->local)) {
+    btc_netaddr_get_str(addr, &item->local);
+    json_object_push(obj, "addrlocal", json_string_new(addr));
+  }
+
+  json_object_push(obj, "services", json_integer_new(item->services));
+  json_object_push(obj, "relaytxes", json_boolean_new(item->relay));
+  json_object_push(obj, "lastsend",
+    json_integer_new(item->last_send ? (item->last_send + skew) / 1000 : 0));
+  json_object_push(obj, "lastrecv",
+    json_integer_new(item->last_recv ? (item->last_recv + skew) / 1000 : 0));
+  json_object_push(obj, "bytessent", json_integer_new(traffic->bytes_sent));
+  json_object_push(obj, "bytesrecv", json_integer_new(traffic->bytes_recv));
+
+  if (item->last_pong != -1 && item->last_pong >= item->last_ping) {
+    double rtt = (double)(item->last_pong - item->last_ping) / 1000.0;
+    json_object_push(obj, "pingtime", json_double_new(rtt));
+  }
+
+  if (item->min_ping != -1) {
+    double rtt = (double)item->min_ping / 1000.0;
+    json_object_push(obj, "minping", json_double_new(rtt));
+  }
+
+  json_object_push(obj, "version", json_integer_new(item->version));
+  json_object_push(obj, "subver", json_string_new(item->agent));
+  json_object_push(obj, "inbound", json_boolean_new(!item->outbound));
+  json_object_push(obj, "startingheight", json_integer_new(item->height));
+  json_object_push(obj, "banscore", json_integer_new(item->ban_score));
+  json_object_push(obj, "bytessent_per_msg", json_traffic_new(traffic->sent));
+  json_object_push(obj, "bytesrecv_per_msg", json_traffic_new(traffic->recv));
+
+  return obj;
+}
+
 static void
 btc_rpc_getpeerinfo(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
-  (void)rpc;
+  btc_peerinfo_t *items;
+  size_t i, length;
+  int64_t skew;
 
   if (params->help || params->length != 0)
     THROW_MISC("getpeerinfo");
+
+  /* Peer timestamps are monotonic; report them as unix time. */
+  skew = btc_now() * 1000 - btc_time_msec();
+
+  length = btc_pool_size(rpc->pool);
+  items = btc_malloc((length + 1) * sizeof(btc_peerinfo_t));
+  length = btc_pool_peerinfo(rpc->pool, items, length);
+
+  res->result = json_array_new(length);
+
+  for (i = 0; i < length; i++)
+    json_array_push(res->result, json_peerinfo_new(&items[i], skew));
+
+  btc_free(items);
 }
 
 static void
@@ -1126,14 +1892,63 @@ btc_rpc_createrawtransaction(btc_rpc_t *rpc,
     THROW_MISC("createrawtransaction inputs outputs ( locktime replaceable )");
 }
 
+static void
+btc_rpc_decoderawtransaction_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+  btc_tx_t *tx;
+  int ok;
+
+  if (snap->verbosity)
+    ok = json_tx_get(&tx, snap->arg);
+  else
+    ok = json_tx_base_get(&tx, snap->arg);
+
+  if (!ok)
+    THROW(RPC_DESERIALIZATION_ERROR, "TX decode failed");
+
+  json_tx_write(&res->stream, tx, NULL, rpc->network);
+
+  btc_tx_destroy(tx);
+}
+
 static void
 btc_rpc_decoderawtransaction(btc_rpc_t *rpc,
                              const json_params *params,
                              rpc_res_t *res) {
+  int witness = 1;
+
   (void)rpc;
 
   if (params->help || params->length < 1 || params->length > 2)
     THROW_MISC("decoderawtransaction \"hexstring\" ( iswitness )");
+
+  if (params->values[0]->type != json_string)
+    THROW_TYPE(hexstring, string);
+
+  if (params->length > 1) {
+    if (!json_boolean_get(&witness, params->values[1]))
+      THROW_TYPE(iswitness, boolean);
+  }
+
+  res->snap.arg = params->values[0];
+  res->snap.verbosity = witness;
+  res->work = btc_rpc_decoderawtransaction_work;
+}
+
+static void
+btc_rpc_decodescript_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  btc_script_t script;
+
+  btc_script_init(&script);
+
+  if (!json_buffer_get(&script, res->snap.arg)) {
+    btc_script_clear(&script);
+    THROW_TYPE(hexstring, hex);
+  }
+
+  res->result = json_script_new(&script, rpc->network);
+
+  btc_script_clear(&script);
 }
 
 static void
@@ -1144,6 +1959,9 @@ btc_rpc_decodescript(btc_rpc_t *rpc,
 
   if (params->help || params->length != 1)
     THROW_MISC("decodescript \"hexstring\"");
+
+  res->snap.arg = params->values[0];
+  res->work = btc_rpc_decodescript_work;
 }
 
 static void
@@ -1219,6 +2037,16 @@ btc_rpc_fundrawtransaction(btc_rpc_t *rpc,
   btc_tx_destroy(tx);
 }
 
+static void
+btc_rpc_getrawtransaction_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+
+  if (snap->verbosity == 0)
+    res->result = json_tx_raw(snap->tx);
+  else
+    json_tx_write(&res->stream, snap->tx, snap->view, rpc->network);
+}
+
 static void
 btc_rpc_getrawtransaction(btc_rpc_t *rpc,
                           const json_params *params,
@@ -1255,15 +2083,11 @@ btc_rpc_getrawtransaction(btc_rpc_t *rpc,
       view = btc_wallet_undo(rpc->wallet, tx);
   }
 
-  if (verbosity == 0)
-    res->result = json_tx_raw(tx);
-  else
-    res->result = json_tx_new(tx, view, rpc->network);
-
-  if (view != NULL)
-    btc_view_destroy(view);
-
-  btc_tx_destroy(tx);
+  /* Freed back on the loop thread (see `rpc_snap_clear`). */
+  res->snap.tx = tx;
+  res->snap.view = view;
+  res->snap.verbosity = verbosity;
+  res->work = btc_rpc_getrawtransaction_work;
 }
 
 static void
@@ -1471,13 +2295,26 @@ json_wtx_new(btc_rpc_t *rpc, const btc_txmeta_t *meta, const btc_tx_t *tx) {
   return wtx;
 }
 
-static json_value *
-json_ltx_new(btc_rpc_t *rpc, const btc_txmeta_t *meta, const btc_tx_t *tx) {
+static void
+json_address_write(json_writer *w,
+                   const btc_address_t *addr,
+                   const btc_network_t *network) {
+  char str[BTC_ADDRESS_MAXLEN + 1];
+
+  btc_address_get_str(str, addr, network);
+
+  json_write_string(w, str);
+}
+
+static void
+json_ltx_write(json_writer *w,
+               btc_rpc_t *rpc,
+               const btc_txmeta_t *meta,
+               const btc_tx_t *tx) {
   const btc_network_t *network = rpc->network;
   int is_send = (meta->resolved != 0);
   btc_wallet_t *wallet = rpc->wallet;
   btc_address_t addr;
-  json_value *wtx;
   int64_t sent = 0;
   int64_t recv = 0;
   char name[64];
@@ -1507,56 +2344,60 @@ json_ltx_new(btc_rpc_t *rpc, const btc_txmeta_t *meta, const btc_tx_t *tx) {
       sent += output->value;
   }
 
-  wtx = json_object_new(8);
+  json_write_object(w);
 
   if (*name) {
-    json_object_push(wtx, "account", json_string_new(name));
-    json_object_push(wtx, "address", json_address_new(&addr, network));
+    json_write_key(w, "account");
+    json_write_string(w, name);
+    json_write_key(w, "address");
+    json_address_write(w, &addr, network);
   }
 
+  json_write_key(w, "category");
+
   if (!btc_tx_is_coinbase(tx)) {
     const char *category = is_send ? "send" : "receive";
 
     if (is_send && *name)
       category = "both";
 
-    json_object_push(wtx, "category", json_string_new(category));
+    json_write_string(w, category);
   } else {
-    json_object_push(wtx, "category", json_string_new("generate"));
+    json_write_string(w, "generate");
   }
 
-  json_object_push(wtx, "amount", json_amount_new(recv - sent));
+  json_write_key(w, "amount");
+  json_write_amount(w, recv - sent);
 
   if (meta->resolved == tx->inputs.length) {
-    int64_t fee = meta->inpval - btc_tx_output_value(tx);
-
-    json_object_push(wtx, "fee", json_amount_new(fee));
+    json_write_key(w, "fee");
+    json_write_amount(w, meta->inpval - btc_tx_output_value(tx));
   }
 
-  if (meta->height >= 0) {
-    int32_t depth = btc_wallet_height(wallet) - meta->height + 1;
-
-    json_object_push(wtx, "confirmations", json_integer_new(depth));
-  } else {
-    json_object_push(wtx, "confirmations", json_integer_new(0));
-  }
+  json_write_key(w, "confirmations");
 
-  json_object_push(wtx, "txid", json_hash_new(tx->hash));
-  json_object_push(wtx, "id", json_integer_new(meta->id));
+  if (meta->height >= 0)
+    json_write_integer(w, btc_wallet_height(wallet) - meta->height + 1);
+  else
+    json_write_integer(w, 0);
 
-  return wtx;
+  json_write_key(w, "txid");
+  json_write_hash(w, tx->hash);
+  json_write_key(w, "id");
+  json_write_integer(w, meta->id);
+  json_write_object_end(w);
 }
 
-static json_value *
-json_wcoin_new(btc_rpc_t *rpc,
-               const btc_outpoint_t *prevout,
-               const btc_coin_t *coin) {
+static void
+json_wcoin_write(json_writer *w,
+                 btc_rpc_t *rpc,
+                 const btc_outpoint_t *prevout,
+                 const btc_coin_t *coin) {
   btc_wallet_t *wallet = rpc->wallet;
   int has_account = 0;
   int spendable = 0;
   btc_address_t addr;
   btc_path_t path;
-  json_value *obj;
   int depth = 0;
   char name[64];
 
@@ -1574,22 +2415,28 @@ json_wcoin_new(btc_rpc_t *rpc,
       spendable = 1;
   }
 
-  obj = json_object_new(8);
-
-  json_object_push(obj, "txid", json_hash_new(prevout->hash));
-  json_object_push(obj, "vout", json_integer_new(prevout->index));
+  json_write_object(w);
+  json_write_key(w, "txid");
+  json_write_hash(w, prevout->hash);
+  json_write_key(w, "vout");
+  json_write_integer(w, prevout->index);
 
   if (has_account) {
-    json_object_push(obj, "account", json_string_new(name));
-    json_object_push(obj, "address", json_address_new(&addr, rpc->network));
+    json_write_key(w, "account");
+    json_write_string(w, name);
+    json_write_key(w, "address");
+    json_address_write(w, &addr, rpc->network);
   }
 
-  json_object_push(obj, "amount", json_amount_new(coin->output.value));
-  json_object_push(obj, "confirmations", json_integer_new(depth));
-  json_object_push(obj, "spendable", json_boolean_new(spendable));
-  json_object_push(obj, "safe", json_boolean_new(coin->safe));
-
-  return obj;
+  json_write_key(w, "amount");
+  json_write_amount(w, coin->output.value);
+  json_write_key(w, "confirmations");
+  json_write_integer(w, depth);
+  json_write_key(w, "spendable");
+  json_write_boolean(w, spendable);
+  json_write_key(w, "safe");
+  json_write_boolean(w, coin->safe);
+  json_write_object_end(w);
 }
 
 /*
@@ -1634,10 +2481,64 @@ btc_rpc_backupwallet(btc_rpc_t *rpc,
 
 static void
 btc_rpc_bumpfee(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
-  (void)rpc;
+  btc_tx_t *orig, *tx;
+  btc_txmeta_t meta;
+  btc_view_t *view;
+  uint8_t hash[32];
+  int64_t rate = 0;
+  json_value *obj;
 
   if (params->help || params->length < 1 || params->length > 2)
     THROW_MISC("bumpfee \"txid\" ( options )");
+
+  if (!json_hash_get(hash, params->values[0]))
+    THROW_TYPE(txid, hash);
+
+  if (params->length > 1) {
+    const json_value *opts = params->values[1];
+    const json_value *val;
+
+    if (opts->type != json_object)
+      THROW_TYPE(options, object);
+
+    val = json_object_get(opts, "fee_rate");
+
+    if (val != NULL && !json_amount_get(&rate, val))
+      THROW_TYPE(fee_rate, amount);
+  }
+
+  if (btc_wallet_locked(rpc->wallet))
+    THROW(RPC_WALLET_UNLOCK_NEEDED, "Wallet is locked");
+
+  if (!btc_wallet_meta(&meta, rpc->wallet, hash))
+    THROW(RPC_INVALID_ADDRESS_OR_KEY, "Invalid or non-wallet transaction id");
+
+  if (meta.height != -1)
+    THROW(RPC_WALLET_ERROR, "Transaction has been mined");
+
+  if (!btc_wallet_tx(&orig, rpc->wallet, hash))
+    THROW(RPC_DATABASE_ERROR, "Database error");
+
+  view = btc_wallet_undo(rpc->wallet, orig);
+
+  if (!btc_wallet_bump(&tx, rpc->wallet, hash, rate)) {
+    btc_view_destroy(view);
+    btc_tx_destroy(orig);
+    THROW(RPC_WALLET_ERROR, "Could not bump transaction fee");
+  }
+
+  obj = json_object_new(4);
+
+  json_object_push(obj, "txid", json_hash_new(tx->hash));
+  json_object_push(obj, "origfee", json_amount_new(btc_tx_fee(orig, view)));
+  json_object_push(obj, "fee", json_amount_new(btc_tx_fee(tx, view)));
+  json_object_push(obj, "errors", json_array_new(0));
+
+  res->result = obj;
+
+  btc_view_destroy(view);
+  btc_tx_destroy(orig);
+  btc_tx_destroy(tx);
 }
 
 static void
@@ -2238,9 +3139,9 @@ btc_rpc_listsinceblock(btc_rpc_t *rpc,
                        rpc_res_t *res) {
   uint32_t account = BTC_NO_ACCOUNT;
   const uint8_t *next = NULL;
+  json_writer *w = &res->stream;
   const btc_entry_t *entry;
   const char *name = NULL;
-  json_value *txs, *obj;
   btc_txiter_t *it;
   uint8_t hash[32];
   int limit = 100;
@@ -2283,14 +3184,16 @@ btc_rpc_listsinceblock(btc_rpc_t *rpc,
       THROW_TYPE(limit, integer);
   }
 
-  txs = json_array_new(limit + 100);
-
   it = btc_wallet_txs(rpc->wallet);
 
   btc_txiter_account(it, account);
   btc_txiter_start(it, height);
   btc_txiter_first(it);
 
+  json_write_object(w);
+  json_write_key(w, "transactions");
+  json_write_array(w);
+
   for (; btc_txiter_valid(it); btc_txiter_next(it), i++) {
     const btc_txmeta_t *meta;
     const btc_tx_t *tx;
@@ -2306,11 +3209,13 @@ btc_rpc_listsinceblock(btc_rpc_t *rpc,
     meta = btc_txiter_meta(it);
     tx = btc_txiter_value(it);
 
-    json_array_push(txs, json_ltx_new(rpc, meta, tx));
+    json_ltx_write(w, rpc, meta, tx);
 
     last = btc_txiter_height(it);
   }
 
+  json_write_array_end(w);
+
   if (last >= 0) {
     entry = btc_chain_by_height(rpc->chain, last + 1);
 
@@ -2324,13 +3229,11 @@ btc_rpc_listsinceblock(btc_rpc_t *rpc,
 
   btc_txiter_destroy(it);
 
-  obj = json_object_new(2);
-
-  json_object_push(obj, "transactions", txs);
-  json_object_push(obj, "nextblock", json_hash_new(next));
-  json_object_push(obj, "nextheight", json_integer_new(last));
-
-  res->result = obj;
+  json_write_key(w, "nextblock");
+  json_write_hash(w, next);
+  json_write_key(w, "nextheight");
+  json_write_integer(w, last);
+  json_write_object_end(w);
 }
 
 static void
@@ -2338,10 +3241,10 @@ btc_rpc_listtransactions(btc_rpc_t *rpc,
                          const json_params *params,
                          rpc_res_t *res) {
   uint32_t account = BTC_NO_ACCOUNT;
+  json_writer *w = &res->stream;
   const char *name = NULL;
   uint64_t after = 0;
   btc_txiter_t *it;
-  json_value *txs;
   int limit = 100;
   int reverse = 0;
   int i = 0;
@@ -2374,8 +3277,6 @@ btc_rpc_listtransactions(btc_rpc_t *rpc,
       THROW_TYPE(after, integer);
   }
 
-  txs = json_array_new(limit);
-
   it = btc_wallet_txs(rpc->wallet);
 
   btc_txiter_account(it, account);
@@ -2392,11 +3293,13 @@ btc_rpc_listtransactions(btc_rpc_t *rpc,
       btc_txiter_first(it);
   }
 
+  json_write_array(w);
+
   while (btc_txiter_valid(it) && i++ < limit) {
     const btc_txmeta_t *meta = btc_txiter_meta(it);
     const btc_tx_t *tx = btc_txiter_value(it);
 
-    json_array_push(txs, json_ltx_new(rpc, meta, tx));
+    json_ltx_write(w, rpc, meta, tx);
 
     if (reverse)
       btc_txiter_prev(it);
@@ -2406,16 +3309,16 @@ btc_rpc_listtransactions(btc_rpc_t *rpc,
 
   btc_txiter_destroy(it);
 
-  res->result = txs;
+  json_write_array_end(w);
 }
 
 static void
 btc_rpc_listunspent(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   uint32_t account = BTC_NO_ACCOUNT;
+  json_writer *w = &res->stream;
   const char *name = NULL;
   btc_outpoint_t after;
   btc_coiniter_t *it;
-  json_value *coins;
   int limit = 100;
   int i = 0;
 
@@ -2439,8 +3342,6 @@ btc_rpc_listunspent(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
       THROW_TYPE(after, outpoint);
   }
 
-  coins = json_array_new(limit);
-
   it = btc_wallet_coins(rpc->wallet);
 
   btc_coiniter_account(it, account);
@@ -2450,6 +3351,8 @@ btc_rpc_listunspent(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   else
     btc_coiniter_first(it);
 
+  json_write_array(w);
+
   for (; btc_coiniter_valid(it) && i < limit; btc_coiniter_next(it), i++) {
     const btc_outpoint_t *prevout = btc_coiniter_key(it);
     const btc_coin_t *coin = btc_coiniter_value(it);
@@ -2457,12 +3360,12 @@ btc_rpc_listunspent(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
     if (account == BTC_NO_ACCOUNT && coin->watch)
       continue;
 
-    json_array_push(coins, json_wcoin_new(rpc, prevout, coin));
+    json_wcoin_write(w, rpc, prevout, coin);
   }
 
   btc_coiniter_destroy(it);
 
-  res->result = coins;
+  json_write_array_end(w);
 }
 
 static void
@@ -2576,6 +3479,7 @@ btc_rpc_send_internal(btc_rpc_t *rpc,
                       btc_tx_t *tx,
                       int depth,
                       int subfee,
+                      int rbf,
                       rpc_res_t *res) {
   btc_selopt_t options;
 
@@ -2584,6 +3488,7 @@ btc_rpc_send_internal(btc_rpc_t *rpc,
   options.depth = depth;
   options.subfee = subfee;
   options.smart = (depth != 0);
+  options.rbf = rbf;
 
   if (!btc_wallet_send(rpc->wallet, account, &options, tx)) {
     btc_tx_destroy(tx);
@@ -2609,12 +3514,15 @@ btc_rpc_sendfrom(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   const char *name;
   uint32_t account;
   int subfee = 0;
+  int rbf = 0;
   int depth = -1;
   int64_t value;
   btc_tx_t *tx;
 
-  if (params->help || params->length < 3 || params->length > 5)
-    THROW_MISC("sendfrom \"account\" \"address\" amount ( minconf subfee )");
+  if (params->help || params->length < 3 || params->length > 6) {
+    THROW_MISC("sendfrom \"account\" \"address\" amount"
+                                   " ( minconf subfee replaceable )");
+  }
 
   if (!json_string_get(&name, params->values[0]) ||
       !btc_wallet_lookup(&account, rpc->wallet, name)) {
@@ -2637,6 +3545,11 @@ btc_rpc_sendfrom(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
       THROW_TYPE(subfee, boolean);
   }
 
+  if (params->length > 5) {
+    if (!json_boolean_get(&rbf, params->values[5]))
+      THROW_TYPE(replaceable, boolean);
+  }
+
   if (btc_wallet_locked(rpc->wallet))
     THROW(RPC_WALLET_UNLOCK_NEEDED, "Wallet is locked");
 
@@ -2644,7 +3557,7 @@ btc_rpc_sendfrom(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
 
   btc_tx_add_output(tx, &addr, value);
 
-  btc_rpc_send_internal(rpc, account, tx, depth, subfee, res);
+  btc_rpc_send_internal(rpc, account, tx, depth, subfee, rbf, res);
 }
 
 static void
@@ -2655,14 +3568,15 @@ btc_rpc_sendmany(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   const char *name;
   uint32_t account;
   int subfee = 0;
+  int rbf = 0;
   int depth = -1;
   int64_t value;
   btc_tx_t *tx;
   size_t i;
 
-  if (params->help || params->length < 2 || params->length > 4) {
+  if (params->help || params->length < 2 || params->length > 5) {
     THROW_MISC("sendmany \"account\" {\"address\":amount,...}"
-                                   " ( minconf subfee )");
+                                   " ( minconf subfee replaceable )");
   }
 
   if (!json_string_get(&name, params->values[0]) ||
@@ -2685,6 +3599,11 @@ btc_rpc_sendmany(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
       THROW_TYPE(subfee, boolean);
   }
 
+  if (params->length > 4) {
+    if (!json_boolean_get(&rbf, params->values[4]))
+      THROW_TYPE(replaceable, boolean);
+  }
+
   if (btc_wallet_locked(rpc->wallet))
     THROW(RPC_WALLET_UNLOCK_NEEDED, "Wallet is locked");
 
@@ -2720,7 +3639,7 @@ btc_rpc_sendmany(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
     btc_tx_add_output(tx, &addr, value);
   }
 
-  btc_rpc_send_internal(rpc, account, tx, depth, subfee, res);
+  btc_rpc_send_internal(rpc, account, tx, depth, subfee, rbf, res);
 }
 
 static void
@@ -2730,12 +3649,15 @@ btc_rpc_sendtoaddress(btc_rpc_t *rpc,
   uint32_t account = BTC_NO_ACCOUNT;
   btc_address_t addr;
   int subfee = 0;
+  int rbf = 0;
   int depth = -1;
   int64_t value;
   btc_tx_t *tx;
 
-  if (params->help || params->length < 2 || params->length > 4)
-    THROW_MISC("sendtoaddress \"address\" amount ( minconf subfee )");
+  if (params->help || params->length < 2 || params->length > 5) {
+    THROW_MISC("sendtoaddress \"address\" amount"
+                           " ( minconf subfee replaceable )");
+  }
 
   if (!json_address_get(&addr, params->values[0], rpc->network))
     THROW_TYPE(address, address);
@@ -2753,6 +3675,11 @@ btc_rpc_sendtoaddress(btc_rpc_t *rpc,
       THROW_TYPE(subfee, boolean);
   }
 
+  if (params->length > 4) {
+    if (!json_boolean_get(&rbf, params->values[4]))
+      THROW_TYPE(replaceable, boolean);
+  }
+
   if (btc_wallet_locked(rpc->wallet))
     THROW(RPC_WALLET_UNLOCK_NEEDED, "Wallet is locked");
 
@@ -2760,7 +3687,7 @@ btc_rpc_sendtoaddress(btc_rpc_t *rpc,
 
   btc_tx_add_output(tx, &addr, value);
 
-  btc_rpc_send_internal(rpc, account, tx, depth, subfee, res);
+  btc_rpc_send_internal(rpc, account, tx, depth, subfee, rbf, res);
 }
 
 static void
@@ -3000,104 +3927,105 @@ static const struct {
   void (*handler)(btc_rpc_t *,
                   const json_params *,
                   rpc_res_t *);
+  unsigned int flags;
 } btc_rpc_methods[] = {
-  { "abandontransaction", btc_rpc_abandontransaction },
-  { "addnode", btc_rpc_addnode },
-  { "backupwallet", btc_rpc_backupwallet },
-  { "bumpfee", btc_rpc_bumpfee },
-  { "clearbanned", btc_rpc_clearbanned },
-  { "createaccount", btc_rpc_createaccount },
-  { "createrawtransaction", btc_rpc_createrawtransaction },
-  { "decoderawtransaction", btc_rpc_decoderawtransaction },
-  { "decodescript", btc_rpc_decodescript },
-  { "deleteaccount", btc_rpc_deleteaccount },
-  { "disconnectnode", btc_rpc_disconnectnode },
-  { "dumpprivkey", btc_rpc_dumpprivkey },
-  { "dumpwallet", btc_rpc_dumpwallet },
-  { "encryptwallet", btc_rpc_encryptwallet },
-  { "estimatesmartfee", btc_rpc_estimatesmartfee },
-  { "fundhwtransaction", btc_rpc_fundhwtransaction },
-  { "fundrawtransaction", btc_rpc_fundrawtransaction },
-  { "generate", btc_rpc_generate },
-  { "generateblock", btc_rpc_generateblock },
-  { "generatetoaddress", btc_rpc_generatetoaddress },
-  { "getaccount", btc_rpc_getaccount },
-  { "getaccountaddress", btc_rpc_getaccountaddress },
-  { "getaccountinfo", btc_rpc_getaccountinfo },
-  { "getaddednodeinfo", btc_rpc_getaddednodeinfo },
-  { "getaddressesbyaccount", btc_rpc_getaddressesbyaccount },
-  { "getaddressinfo", btc_rpc_getaddressinfo },
-  { "getbalance", btc_rpc_getbalance },
-  { "getbalances", btc_rpc_getbalances },
-  { "getbestblockhash", btc_rpc_getbestblockhash },
-  { "getblock", btc_rpc_getblock },
-  { "getblockchaininfo", btc_rpc_getblockchaininfo },
-  { "getblockcount", btc_rpc_getblockcount },
-  { "getblockhash", btc_rpc_getblockhash },
-  { "getblockheader", btc_rpc_getblockheader },
-  { "getblocktemplate", btc_rpc_getblocktemplate },
-  { "getchaintips", btc_rpc_getchaintips },
-  { "getconnectioncount", btc_rpc_getconnectioncount },
-  { "getdifficulty", btc_rpc_getdifficulty },
-  { "getgenerate", btc_rpc_getgenerate },
-  { "getmemoryinfo", btc_rpc_getmemoryinfo },
-  { "getmempoolentry", btc_rpc_getmempoolentry },
-  { "getmempoolinfo", btc_rpc_getmempoolinfo },
-  { "getmininginfo", btc_rpc_getmininginfo },
-  { "getnettotals", btc_rpc_getnettotals },
-  { "getnetworkhashps", btc_rpc_getnetworkhashps },
-  { "getnetworkinfo", btc_rpc_getnetworkinfo },
-  { "getnewaddress", btc_rpc_getnewaddress },
-  { "getnodeaddresses", btc_rpc_getnodeaddresses },
-  { "getpeerinfo", btc_rpc_getpeerinfo },
-  { "getrawchangeaddress", btc_rpc_getrawchangeaddress },
-  { "getrawmempool", btc_rpc_getrawmempool },
-  { "getrawtransaction", btc_rpc_getrawtransaction },
-  { "gettransaction", btc_rpc_gettransaction },
-  { "gettxout", btc_rpc_gettxout },
-  { "gettxoutsetinfo", btc_rpc_gettxoutsetinfo },
-  { "getwalletinfo", btc_rpc_getwalletinfo },
-  { "getwork", btc_rpc_getwork },
-  { "help", btc_rpc_help },
-  { "listaccounts", btc_rpc_listaccounts },
-  { "listbanned", btc_rpc_listbanned },
-  { "listlockunspent", btc_rpc_listlockunspent },
-  { "listsinceblock", btc_rpc_listsinceblock },
-  { "listtransactions", btc_rpc_listtransactions },
-  { "listunspent", btc_rpc_listunspent },
-  { "lockunspent", btc_rpc_lockunspent },
-  { "ping", btc_rpc_ping },
-  { "prioritisetransaction", btc_rpc_prioritisetransaction },
-  { "pruneblockchain", btc_rpc_pruneblockchain },
-  { "renameaccount", btc_rpc_renameaccount },
-  { "rescanblockchain", btc_rpc_rescanblockchain },
-  { "resendwallettransactions", btc_rpc_resendwallettransactions },
-  { "savemempool", btc_rpc_savemempool },
-  { "send", btc_rpc_send },
-  { "sendfrom", btc_rpc_sendfrom },
-  { "sendmany", btc_rpc_sendmany },
-  { "sendrawtransaction", btc_rpc_sendrawtransaction },
-  { "sendtoaddress", btc_rpc_sendtoaddress },
-  { "setban", btc_rpc_setban },
-  { "setgenerate", btc_rpc_setgenerate },
-  { "setloglevel", btc_rpc_setloglevel },
-  { "setnetworkactive", btc_rpc_setnetworkactive },
-  { "settxfee", btc_rpc_settxfee },
-  { "signmessage", btc_rpc_signmessage },
-  { "signmessagewithprivkey", btc_rpc_signmessagewithprivkey },
-  { "signrawtransactionwithkey", btc_rpc_signrawtransactionwithkey },
-  { "signrawtransactionwithwallet", btc_rpc_signrawtransactionwithwallet },
-  { "stop", btc_rpc_stop },
-  { "submitblock", btc_rpc_submitblock },
-  { "testmempoolaccept", btc_rpc_testmempoolaccept },
-  { "uptime", btc_rpc_uptime },
-  { "validateaddress", btc_rpc_validateaddress },
-  { "verifychain", btc_rpc_verifychain },
-  { "verifymessage", btc_rpc_verifymessage },
-  { "walletlock", btc_rpc_walletlock },
-  { "walletpassphrase", btc_rpc_walletpassphrase },
-  { "walletpassphrasechange", btc_rpc_walletpassphrasechange },
-  { "watchaccount", btc_rpc_watchaccount }
+  { "abandontransaction", btc_rpc_abandontransaction, 0 },
+  { "addnode", btc_rpc_addnode, 0 },
+  { "backupwallet", btc_rpc_backupwallet, 0 },
+  { "bumpfee", btc_rpc_bumpfee, 0 },
+  { "clearbanned", btc_rpc_clearbanned, 0 },
+  { "createaccount", btc_rpc_createaccount, 0 },
+  { "createrawtransaction", btc_rpc_createrawtransaction, 0 },
+  { "decoderawtransaction", btc_rpc_decoderawtransaction, RPC_READONLY },
+  { "decodescript", btc_rpc_decodescript, RPC_READONLY },
+  { "deleteaccount", btc_rpc_deleteaccount, 0 },
+  { "disconnectnode", btc_rpc_disconnectnode, 0 },
+  { "dumpprivkey", btc_rpc_dumpprivkey, 0 },
+  { "dumpwallet", btc_rpc_dumpwallet, 0 },
+  { "encryptwallet", btc_rpc_encryptwallet, 0 },
+  { "estimatesmartfee", btc_rpc_estimatesmartfee, 0 },
+  { "fundhwtransaction", btc_rpc_fundhwtransaction, 0 },
+  { "fundrawtransaction", btc_rpc_fundrawtransaction, 0 },
+  { "generate", btc_rpc_generate, 0 },
+  { "generateblock", btc_rpc_generateblock, 0 },
+  { "generatetoaddress", btc_rpc_generatetoaddress, 0 },
+  { "getaccount", btc_rpc_getaccount, 0 },
+  { "getaccountaddress", btc_rpc_getaccountaddress, 0 },
+  { "getaccountinfo", btc_rpc_getaccountinfo, 0 },
+  { "getaddednodeinfo", btc_rpc_getaddednodeinfo, 0 },
+  { "getaddressesbyaccount", btc_rpc_getaddressesbyaccount, 0 },
+  { "getaddressinfo", btc_rpc_getaddressinfo, 0 },
+  { "getbalance", btc_rpc_getbalance, 0 },
+  { "getbalances", btc_rpc_getbalances, 0 },
+  { "getbestblockhash", btc_rpc_getbestblockhash, 0 },
+  { "getblock", btc_rpc_getblock, RPC_READONLY },
+  { "getblockchaininfo", btc_rpc_getblockchaininfo, 0 },
+  { "getblockcount", btc_rpc_getblockcount, 0 },
+  { "getblockhash", btc_rpc_getblockhash, 0 },
+  { "getblockheader", btc_rpc_getblockheader, RPC_READONLY },
+  { "getblocktemplate", btc_rpc_getblocktemplate, 0 },
+  { "getchaintips", btc_rpc_getchaintips, 0 },
+  { "getconnectioncount", btc_rpc_getconnectioncount, 0 },
+  { "getdifficulty", btc_rpc_getdifficulty, 0 },
+  { "getgenerate", btc_rpc_getgenerate, 0 },
+  { "getmemoryinfo", btc_rpc_getmemoryinfo, 0 },
+  { "getmempoolentry", btc_rpc_getmempoolentry, 0 },
+  { "getmempoolinfo", btc_rpc_getmempoolinfo, 0 },
+  { "getmininginfo", btc_rpc_getmininginfo, 0 },
+  { "getnettotals", btc_rpc_getnettotals, 0 },
+  { "getnetworkhashps", btc_rpc_getnetworkhashps, 0 },
+  { "getnetworkinfo", btc_rpc_getnetworkinfo, 0 },
+  { "getnewaddress", btc_rpc_getnewaddress, 0 },
+  { "getnodeaddresses", btc_rpc_getnodeaddresses, 0 },
+  { "getpeerinfo", btc_rpc_getpeerinfo, 0 },
+  { "getrawchangeaddress", btc_rpc_getrawchangeaddress, 0 },
+  { "getrawmempool", btc_rpc_getrawmempool, 0 },
+  { "getrawtransaction", btc_rpc_getrawtransaction, RPC_READONLY },
+  { "gettransaction", btc_rpc_gettransaction, 0 },
+  { "gettxout", btc_rpc_gettxout, RPC_READONLY },
+  { "gettxoutsetinfo", btc_rpc_gettxoutsetinfo, 0 },
+  { "getwalletinfo", btc_rpc_getwalletinfo, 0 },
+  { "getwork", btc_rpc_getwork, 0 },
+  { "help", btc_rpc_help, 0 },
+  { "listaccounts", btc_rpc_listaccounts, 0 },
+  { "listbanned", btc_rpc_listbanned, 0 },
+  { "listlockunspent", btc_rpc_listlockunspent, 0 },
+  { "listsinceblock", btc_rpc_listsinceblock, 0 },
+  { "listtransactions", btc_rpc_listtransactions, 0 },
+  { "listunspent", btc_rpc_listunspent, 0 },
+  { "lockunspent", btc_rpc_lockunspent, 0 },
+  { "ping", btc_rpc_ping, 0 },
+  { "prioritisetransaction", btc_rpc_prioritisetransaction, 0 },
+  { "pruneblockchain", btc_rpc_pruneblockchain, 0 },
+  { "renameaccount", btc_rpc_renameaccount, 0 },
+  { "rescanblockchain", btc_rpc_rescanblockchain, 0 },
+  { "resendwallettransactions", btc_rpc_resendwallettransactions, 0 },
+  { "savemempool", btc_rpc_savemempool, 0 },
+  { "send", btc_rpc_send, 0 },
+  { "sendfrom", btc_rpc_sendfrom, 0 },
+  { "sendmany", btc_rpc_sendmany, 0 },
+  { "sendrawtransaction", btc_rpc_sendrawtransaction, 0 },
+  { "sendtoaddress", btc_rpc_sendtoaddress, 0 },
+  { "setban", btc_rpc_setban, 0 },
+  { "setgenerate", btc_rpc_setgenerate, 0 },
+  { "setloglevel", btc_rpc_setloglevel, 0 },
+  { "setnetworkactive", btc_rpc_setnetworkactive, 0 },
+  { "settxfee", btc_rpc_settxfee, 0 },
+  { "signmessage", btc_rpc_signmessage, 0 },
+  { "signmessagewithprivkey", btc_rpc_signmessagewithprivkey, 0 },
+  { "signrawtransactionwithkey", btc_rpc_signrawtransactionwithkey, 0 },
+  { "signrawtransactionwithwallet", btc_rpc_signrawtransactionwithwallet, 0 },
+  { "stop", btc_rpc_stop, 0 },
+  { "submitblock", btc_rpc_submitblock, 0 },
+  { "testmempoolaccept", btc_rpc_testmempoolaccept, 0 },
+  { "uptime", btc_rpc_uptime, 0 },
+  { "validateaddress", btc_rpc_validateaddress, 0 },
+  { "verifychain", btc_rpc_verifychain, 0 },
+  { "verifymessage", btc_rpc_verifymessage, 0 },
+  { "walletlock", btc_rpc_walletlock, 0 },
+  { "walletpassphrase", btc_rpc_walletpassphrase, 0 },
+  { "walletpassphrasechange", btc_rpc_walletpassphrasechange, 0 },
+  { "watchaccount", btc_rpc_watchaccount, 0 }
 };
 
 static int
@@ -3151,6 +4079,9 @@ btc_rpc_handle(btc_rpc_t *rpc, const rpc_req_t *req, rpc_res_t *res) {
   params.help = 0;
 
   btc_rpc_methods[index].handler(rpc, &params, res);
+
+  if (res->work != NULL)
+    CHECK(btc_rpc_methods[index].flags & RPC_READONLY);
 }
 
 static void
@@ -3177,15 +4108,863 @@ btc_rpc_help(btc_rpc_t *rpc, const json_params *params, rpc_res_t *res) {
   btc_rpc_methods[index].handler(rpc, &dummy, res);
 }
 
+/*
+ * Calls
+ */
+
+typedef struct rpc_call_s {
+  btc_rpc_t *rpc;
+  http_res_t *http;
+  json_value *input;
+  rpc_req_t *reqs;
+  rpc_res_t *items;
+  unsigned int length;
+  int batch;
+  int format;
+  int pending;
+  unsigned int waits;
+  struct rpc_call_s *next;
+} rpc_call_t;
+
+static void
+rpc_snap_clear(btc_rpc_t *rpc, rpc_snap_t *snap) {
+  if (snap->coins != NULL)
+    btc_chain_release(rpc->chain, snap->coins);
+
+  if (snap->view != NULL)
+    btc_view_destroy(snap->view);
+
+  if (snap->tx != NULL)
+    btc_tx_destroy(snap->tx);
+}
+
+static rpc_call_t *
+rpc_call_create(btc_rpc_t *rpc, json_value *input, unsigned int length) {
+  rpc_call_t *call = btc_malloc(sizeof(rpc_call_t));
+  unsigned int i;
+
+  call->rpc = rpc;
+  call->http = NULL;
+  call->input = input;
+  call->reqs = NULL;
+  call->items = NULL;
+  call->length = length;
+  call->batch = (input != NULL && input->type == json_array);
+  call->format = REST_NONE;
+  call->pending = 0;
+  call->waits = 0;
+  call->next = NULL;
+
+  if (length > 0) {
+    call->reqs = btc_malloc(length * sizeof(rpc_req_t));
+    call->items = btc_malloc(length * sizeof(rpc_res_t));
+  }
+
+  for (i = 0; i < length; i++) {
+    rpc_req_init(&call->reqs[i]);
+    rpc_res_init(&call->items[i]);
+
+    call->items[i].call = call;
+  }
+
+  return call;
+}
+
+static void
+rpc_call_destroy(rpc_call_t *call) {
+  unsigned int i;
+
+  for (i = 0; i < call->length; i++) {
+    rpc_snap_clear(call->rpc, &call->items[i].snap);
+    json_writer_clear(&call->items[i].stream);
+
+    if (call->items[i].result != NULL)
+      json_builder_free(call->items[i].result);
+
+    if (call->items[i].data != NULL)
+      btc_free(call->items[i].data);
+  }
+
+  json_value_free(call->input); /* Accepts NULL. */
+
+  if (call->length > 0) {
+    btc_free(call->reqs);
+    btc_free(call->items);
+  }
+
+  btc_free(call);
+}
+
+static void
+rest_respond(rpc_call_t *call, http_res_t *res);
+
+static void
+rpc_call_respond(rpc_call_t *call, http_res_t *res) {
+  json_writer output;
+  unsigned int i;
+
+  if (call->format != REST_NONE) {
+    rest_respond(call, res);
+    return;
+  }
+
+  json_writer_init(&output);
+
+  if (call->batch) {
+    json_write_array(&output);
+
+    for (i = 0; i < call->length; i++)
+      rpc_res_write(&output, &call->items[i], call->reqs[i].id);
+
+    json_write_array_end(&output);
+  } else {
+    rpc_res_write(&output, &call->items[0], call->reqs[0].id);
+  }
+
+  http_res_send_json(res, &output);
+
+  json_writer_clear(&output);
+}
+
+static void
+rpc_call_work(void *arg) {
+  rpc_res_t *res = arg;
+  rpc_call_t *call = res->call;
+  btc_rpc_t *rpc = call->rpc;
+  int wake = 0;
+
+  rpc_res_run(rpc, res);
+
+  btc_mutex_lock(&rpc->lock);
+
+  if (--call->pending == 0) {
+    wake = (rpc->done == NULL);
+
+    call->next = rpc->done;
+
+    rpc->done = call;
+  }
+
+  btc_mutex_unlock(&rpc->lock);
+
+  if (wake)
+    btc_loop_wakeup(rpc->loop);
+}
+
+static void
+btc_rpc_dispatch(btc_rpc_t *rpc, rpc_call_t *call, http_res_t *res) {
+  btc_workq_t batch;
+  unsigned int i;
+
+  btc_workq_init(&batch);
+
+  for (i = 0; i < call->length; i++) {
+    rpc_res_t *item = &call->items[i];
+
+    if (item->wait) {
+      call->waits++;
+      continue;
+    }
+
+    if (item->work == NULL)
+      continue;
+
+    if (rpc->workers != NULL)
+      btc_workq_push(&batch, rpc_call_work, item);
+    else
+      rpc_res_run(rpc, item);
+  }
+
+  if (batch.length == 0 && call->waits == 0) {
+    rpc_call_respond(call, res);
+    rpc_call_destroy(call);
+    return;
+  }
+
+  /* Batch elements run in parallel; the response
+     goes out once the last of them has finished. */
+  call->http = res;
+  call->pending = batch.length + call->waits;
+
+  http_res_defer(res);
+
+  /* Parked long polls are woken by `on_polls`. */
+  if (call->waits > 0)
+    btc_vector_push(&rpc->polls, call);
+
+  if (batch.length > 0)
+    btc_workers_batch(rpc->workers, &batch);
+}
+
+static void
+rpc_call_finish(rpc_call_t *call) {
+  http_res_t *res = call->http;
+
+  rpc_call_respond(call, res);
+  rpc_call_destroy(call);
+
+  http_res_finish(res);
+}
+
+static void
+on_calls(void *arg) {
+  btc_rpc_t *rpc = arg;
+  rpc_call_t *call, *next;
+
+  btc_mutex_lock(&rpc->lock);
+
+  call = rpc->done;
+
+  rpc->done = NULL;
+
+  btc_mutex_unlock(&rpc->lock);
+
+  for (; call != NULL; call = next) {
+    next = call->next;
+    rpc_call_finish(call);
+  }
+}
+
+/*
+ * Long Polling
+ */
+
+static int
+btc_rpc_poll_ready(btc_rpc_t *rpc,
+                   const rpc_snap_t *snap,
+                   const btc_tmpl_t **bt) {
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+
+  if (!btc_hash_equal(snap->hash, tip->hash))
+    return 1;
+
+  if (btc_mempool_sequence(rpc->mempool) == snap->sequence)
+    return 0;
+
+  if (btc_time_msec() >= snap->time + RPC_LONGPOLL_INTERVAL)
+    return 1;
+
+  if (*bt == NULL)
+    *bt = btc_miner_get_template(rpc->miner);
+
+  /* Only wake for a significant (10%) fee increase. */
+  return (*bt)->fees > snap->fees + snap->fees / 10;
+}
+
+static int
+btc_rpc_poll_call(btc_rpc_t *rpc,
+                  rpc_call_t *call,
+                  const btc_tmpl_t **bt,
+                  const char *abort) {
+  unsigned int i, woken = 0;
+  int done;
+
+  /* Nobody is listening for this one anymore. */
+  if (call->http->socket == NULL && abort == NULL)
+    abort = "Client disconnected";
+
+  for (i = 0; i < call->length; i++) {
+    rpc_res_t *item = &call->items[i];
+
+    if (!item->wait)
+      continue;
+
+    if (abort != NULL) {
+      item->wait = 0;
+      rpc_res_error(item, RPC_CLIENT_NOT_CONNECTED, abort);
+    } else if (btc_rpc_poll_ready(rpc, &item->snap, bt)) {
+      item->wait = 0;
+      item->woken = 1;
+
+      btc_rpc_handle(rpc, &call->reqs[i], item);
+    } else {
+      continue;
+    }
+
+    woken++;
+  }
+
+  if (woken == 0)
+    return 1;
+
+  call->waits -= woken;
+
+  btc_mutex_lock(&rpc->lock);
+
+  call->pending -= woken;
+
+  done = (call->pending == 0);
+
+  btc_mutex_unlock(&rpc->lock);
+
+  if (done) {
+    rpc_call_finish(call);
+    return 0;
+  }
+
+  return call->waits > 0;
+}
+
+static void
+btc_rpc_poll(btc_rpc_t *rpc, const char *abort) {
+  const btc_tmpl_t *bt = NULL;
+  size_t i, j = 0;
+
+  for (i = 0; i < rpc->polls.length; i++) {
+    rpc_call_t *call = rpc->polls.items[i];
+
+    if (btc_rpc_poll_call(rpc, call, &bt, abort))
+      rpc->polls.items[j++] = call;
+  }
+
+  rpc->polls.length = j;
+}
+
+static void
+on_polls(void *arg) {
+  btc_rpc_t *rpc = arg;
+
+  if (rpc->polls.length > 0)
+    btc_rpc_poll(rpc, NULL);
+}
+
+/*
+ * REST
+ */
+
+#define REST_MAX_PATH 4096
+#define REST_MAX_PARTS 20
+#define REST_MAX_HEADERS 2000
+#define REST_MAX_OUTPOINTS 15
+
+static const char *rest_formats = "output format not found "
+                                  "(available: .bin, .hex, .json)";
+
+static int
+rest_parse_format(char *path) {
+  char *ext = strrchr(path, '.');
+
+  if (ext == NULL || strchr(ext, '/') != NULL)
+    return REST_NONE;
+
+  *ext++ = '\0';
+
+  if (strcmp(ext, "bin") == 0)
+    return REST_BINARY;
+
+  if (strcmp(ext, "hex") == 0)
+    return REST_HEX;
+
+  if (strcmp(ext, "json") == 0)
+    return REST_JSON;
+
+  return REST_NONE;
+}
+
+static int
+rest_parse_int(int *z, const char *xp) {
+  int x = 0;
+
+  if (*xp == '\0' || strlen(xp) > 9)
+    return 0;
+
+  while (*xp) {
+    if (*xp < '0' || *xp > '9')
+      return 0;
+
+    x = x * 10 + (*xp++ - '0');
+  }
+
+  *z = x;
+
+  return 1;
+}
+
+static int
+rest_parse_outpoint(uint8_t *hash, int *index, char *xp) {
+  char *sep = strchr(xp, '-');
+
+  if (sep == NULL)
+    return 0;
+
+  *sep++ = '\0';
+
+  return btc_hash_import(hash, xp) && rest_parse_int(index, sep);
+}
+
+static void
+rest_block_work(btc_rpc_t *rpc, rpc_res_t *res) {
+  const rpc_snap_t *snap = &res->snap;
+  const btc_entry_t *entry = snap->entry;
+  btc_block_t *block;
+
+  /* Block files hold the serialized block as-is. */
+  if (res->call->format != REST_JSON) {
+    if (!btc_chain_get_block_data(rpc->chain, &res->data,
+                                  &res->length, entry)) {
+      THROW(404, "Block not available (pruned data)");
+    }
+
+    return;
+  }
+
+  block = btc_chain_get_block(rpc->chain, entry);
+
+  if (block == NULL)
+    THROW(404, "Block not available (pruned data)");
+
+  json_block_write(&res->stream,
+                   block,
+                   entry,
+                   NULL,
+                   snap->depth,
+                   snap->next,
+                   snap->verbosity,
+                   rpc->network);
+
+  btc_block_destroy(block);
+}
+
+static void
+rest_block(btc_rpc_t *rpc, char **parts, int length, rpc_res_t *res) {
+  const btc_entry_t *entry;
+  uint8_t hash[32];
+  int details = 1;
+
+  if (length == 2 && strcmp(parts[0], "notxdetails") == 0) {
+    details = 0;
+    parts++;
+    length--;
+  }
+
+  if (length != 1 || !btc_hash_import(hash, parts[0]))
+    THROW(400, "Invalid hash");
+
+  entry = btc_chain_by_hash(rpc->chain, hash);
+
+  if (entry == NULL)
+    THROW(404, "Block not found");
+
+  res->snap.entry = entry;
+  res->snap.depth = btc_rpc_get_depth(rpc, entry, &res->snap.next);
+  res->snap.verbosity = details;
+  res->work = rest_block_work;
+}
+
+static void
+rest_headers(btc_rpc_t *rpc, char **parts, int length, rpc_res_t *res) {
+  const btc_entry_t *entry;
+  const btc_entry_t *tip;
+  int count, height;
+  uint8_t hash[32];
+  json_value *arr;
+  uint8_t *zp;
+  int32_t depth;
+
+  if (length != 2 || !rest_parse_int(&count, parts[0]))
+    THROW(400, "Invalid header count");
+
+  if (count < 1 || count > REST_MAX_HEADERS)
+    THROW(400, "Header count out of range");
+
+  /* A height allows ranged fetches without
+     knowing the hash of the first header. */
+  if (btc_hash_import(hash, parts[1]))
+    entry = btc_chain_by_hash(rpc->chain, hash);
+  else if (rest_parse_int(&height, parts[1]))
+    entry = btc_chain_by_height(rpc->chain, height);
+  else
+    THROW(400, "Invalid hash");
+
+  if (entry == NULL)
+    THROW(404, "Block not found");
+
+  /* Headers off the main chain are returned singly. */
+  if (btc_chain_by_height(rpc->chain, entry->height) != entry)
+    count = 1;
+
+  tip = btc_chain_tip(rpc->chain);
+
+  if (count > tip->height - entry->height + 1)
+    count = BTC_MAX(1, tip->height - entry->height + 1);
+
+  if (res->call->format == REST_JSON) {
+    arr = json_array_new(count);
+
+    while (entry != NULL && count--) {
+      depth = tip->height - entry->height + 1;
+
+      json_array_push(arr, json_entry_new_ex(entry, depth,
+                           entry->next ? entry->next->hash : NULL));
+
+      entry = entry->next;
+    }
+
+    res->result = arr;
+
+    return;
+  }
+
+  res->data = btc_malloc(count * 80);
+
+  zp = res->data;
+
+  while (entry != NULL && count--) {
+    zp = btc_header_write(zp, &entry->header);
+    entry = entry->next;
+  }
+
+  res->length = zp - res->data;
+}
+
+static btc_tx_t *
+rest_chain_tx(btc_rpc_t *rpc, const uint8_t *hash) {
+  /* Without a tx index, a confirmed transaction
+     can be located only while it has unspent outputs. */
+  const btc_entry_t *entry;
+  btc_tx_t *tx = NULL;
+  btc_block_t *block;
+  btc_coin_t *coin;
+  size_t i;
+
+  coin = btc_chain_tx_coin(rpc->chain, hash);
+
+  if (coin == NULL)
+    return NULL;
+
+  entry = btc_chain_by_height(rpc->chain, coin->height);
+
+  btc_coin_destroy(coin);
+
+  if (entry == NULL)
+    return NULL;
+
+  block = btc_chain_get_block(rpc->chain, entry);
+
+  if (block == NULL)
+    return NULL;
+
+  for (i = 0; i < block->txs.length; i++) {
+    btc_tx_t *item = block->txs.items[i];
+
+    if (btc_hash_equal(item->hash, hash)) {
+      tx = btc_tx_ref(item);
+      break;
+    }
+  }
+
+  btc_block_destroy(block);
+
+  return tx;
+}
+
+static void
+rest_tx(btc_rpc_t *rpc, char **parts, int length, rpc_res_t *res) {
+  const btc_mpentry_t *entry;
+  uint8_t hash[32];
+  btc_tx_t *tx;
+
+  if (length != 1 || !btc_hash_import(hash, parts[0]))
+    THROW(400, "Invalid hash");
+
+  entry = btc_mempool_get(rpc->mempool, hash);
+
+  if (entry != NULL)
+    tx = btc_tx_ref(entry->tx);
+  else
+    tx = rest_chain_tx(rpc, hash);
+
+  if (tx == NULL)
+    THROW(404, "Transaction not found");
+
+  if (res->call->format == REST_JSON) {
+    json_tx_write(&res->stream, tx, NULL, rpc->network);
+  } else {
+    res->length = btc_tx_size(tx);
+    res->data = btc_malloc(res->length);
+
+    btc_tx_write(res->data, tx);
+  }
+
+  btc_tx_destroy(tx);
+}
+
+static void
+rest_getutxos(btc_rpc_t *rpc, char **parts, int length, rpc_res_t *res) {
+  const btc_entry_t *tip = btc_chain_tip(rpc->chain);
+  btc_coin_t *coins[REST_MAX_OUTPOINTS];
+  uint8_t hashes[REST_MAX_OUTPOINTS][32];
+  int indexes[REST_MAX_OUTPOINTS];
+  size_t size, bytes;
+  int mempool = 0;
+  int i, total = 0;
+  uint8_t *zp;
+
+  if (length > 0 && strcmp(parts[0], "checkmempool") == 0) {
+    mempool = 1;
+    parts++;
+    length--;
+  }
+
+  if (length == 0)
+    THROW(400, "Error: empty request");
+
+  if (length > REST_MAX_OUTPOINTS)
+    THROW(400, "Error: max outpoints exceeded");
+
+  for (i = 0; i < length; i++) {
+    if (!rest_parse_outpoint(hashes[i], &indexes[i], parts[i]))
+      THROW(400, "Parse error");
+  }
+
+  for (i = 0; i < length; i++) {
+    const uint8_t *hash = hashes[i];
+    btc_coin_t *coin = NULL;
+
+    if (mempool) {
+      if (!btc_mempool_is_spent(rpc->mempool, hash, indexes[i])) {
+        coin = btc_mempool_coin(rpc->mempool, hash, indexes[i]);
+
+        if (coin == NULL)
+          coin = btc_chain_coin(rpc->chain, hash, indexes[i]);
+      }
+    } else {
+      coin = btc_chain_coin(rpc->chain, hash, indexes[i]);
+    }
+
+    coins[i] = coin;
+    total += (coin != NULL);
+  }
+
+  bytes = (length + 7) / 8;
+
+  if (res->call->format == REST_JSON) {
+    char bitmap[REST_MAX_OUTPOINTS + 1];
+    json_writer *w = &res->stream;
+
+    for (i = 0; i < length; i++)
+      bitmap[i] = '0' + (coins[i] != NULL);
+
+    bitmap[length] = '\0';
+
+    json_write_object(w);
+    json_write_key(w, "chainHeight");
+    json_write_integer(w, tip->height);
+    json_write_key(w, "chaintipHash");
+    json_write_hash(w, tip->hash);
+    json_write_key(w, "bitmap");
+    json_write_string(w, bitmap);
+    json_write_key(w, "utxos");
+    json_write_array(w);
+
+    for (i = 0; i < length; i++) {
+      const btc_coin_t *coin = coins[i];
+
+      if (coin == NULL)
+        continue;
+
+      json_write_object(w);
+      json_write_key(w, "height");
+      json_write_integer(w, coin->height);
+      json_write_key(w, "value");
+      json_write_amount(w, coin->output.value);
+      json_write_key(w, "scriptPubKey");
+      json_write_hex(w, coin->output.script.data,
+                        coin->output.script.length);
+      json_write_object_end(w);
+    }
+
+    json_write_array_end(w);
+    json_write_object_end(w);
+  } else {
+    /* Serialized as in BIP64. */
+    size = 4 + 32 + btc_size_size(bytes) + bytes + btc_size_size(total);
+
+    for (i = 0; i < length; i++) {
+      if (coins[i] != NULL)
+        size += 8 + btc_output_size(&coins[i]->output);
+    }
+
+    res->data = btc_malloc(size);
+    res->length = size;
+
+    zp = btc_int32_write(res->data, tip->height);
+    zp = btc_raw_write(zp, tip->hash, 32);
+    zp = btc_size_write(zp, bytes);
+
+    memset(zp, 0, bytes);
+
+    for (i = 0; i < length; i++) {
+      if (coins[i] != NULL)
+        zp[i / 8] |= 1 << (i % 8);
+    }
+
+    zp += bytes;
+    zp = btc_size_write(zp, total);
+
+    for (i = 0; i < length; i++) {
+      const btc_coin_t *coin = coins[i];
+
+      if (coin == NULL)
+        continue;
+
+      /* Mempool coins carry the BIP64 magic height. */
+      zp = btc_uint32_write(zp, 0);
+      zp = btc_uint32_write(zp, coin->height < 0 ? 0x7fffffff : coin->height);
+      zp = btc_output_write(zp, &coin->output);
+    }
+  }
+
+  for (i = 0; i < length; i++) {
+    if (coins[i] != NULL)
+      btc_coin_destroy(coins[i]);
+  }
+}
+
+static void
+rest_respond(rpc_call_t *call, http_res_t *res) {
+  rpc_res_t *item = &call->items[0];
+  char *data;
+
+  if (item->code != 0) {
+    char body[128 + 3];
+
+    CHECK(strlen(item->msg) <= 128);
+
+    sprintf(body, "%s\r\n", item->msg);
+
+    http_res_send(res, item->code, "text/plain", body);
+
+    return;
+  }
+
+  switch (call->format) {
+    case REST_BINARY: {
+      http_res_send_data(res, 200, "application/octet-stream",
+                         item->data, item->length);
+      item->data = NULL;
+      break;
+    }
+
+    case REST_HEX: {
+      data = btc_malloc(item->length * 2 + 2);
+
+      btc_base16_encode(data, item->data, item->length);
+
+      data[item->length * 2] = '\n';
+
+      http_res_send_data(res, 200, "text/plain", data, item->length * 2 + 1);
+
+      break;
+    }
+
+    case REST_JSON: {
+      if (item->stream.head == NULL) {
+        json_write_value(&item->stream, item->result);
+        json_builder_free(item->result);
+        item->result = NULL;
+      }
+
+      http_res_send_json(res, &item->stream);
+
+      break;
+    }
+
+    default: {
+      btc_abort(); /* LCOV_EXCL_LINE */
+      break;
+    }
+  }
+}
+
+static void
+btc_rpc_rest(btc_rpc_t *rpc, http_req_t *req, http_res_t *res) {
+  char path[REST_MAX_PATH + 1];
+  char *parts[REST_MAX_PARTS];
+  rpc_call_t *call;
+  rpc_res_t *item;
+  int length = 0;
+  char *ptr;
+  int format;
+
+  if (req->method != HTTP_METHOD_GET) {
+    http_res_error(res, 405);
+    return;
+  }
+
+  if (req->path.length > REST_MAX_PATH) {
+    http_res_error(res, 414);
+    return;
+  }
+
+  /* Skip the "/rest/" prefix. */
+  memcpy(path, req->path.data + 6, req->path.length - 6 + 1);
+
+  ptr = strchr(path, '?');
+
+  if (ptr != NULL)
+    *ptr = '\0';
+
+  format = rest_parse_format(path);
+
+  btc_log_debug(rpc, "Handling REST request: %s.", req->path.data);
+
+  call = rpc_call_create(rpc, NULL, 1);
+  call->format = format;
+
+  item = &call->items[0];
+
+  if (format == REST_NONE) {
+    call->format = REST_JSON;
+    rpc_res_error(item, 404, rest_formats);
+    btc_rpc_dispatch(rpc, call, res);
+    return;
+  }
+
+  for (ptr = path; ptr != NULL && length < REST_MAX_PARTS; length++) {
+    parts[length] = ptr;
+
+    ptr = strchr(ptr, '/');
+
+    if (ptr != NULL)
+      *ptr++ = '\0';
+  }
+
+  if (ptr != NULL)
+    rpc_res_error(item, 400, "Too many path segments");
+  else if (strcmp(parts[0], "block") == 0)
+    rest_block(rpc, parts + 1, length - 1, item);
+  else if (strcmp(parts[0], "headers") == 0)
+    rest_headers(rpc, parts + 1, length - 1, item);
+  else if (strcmp(parts[0], "tx") == 0)
+    rest_tx(rpc, parts + 1, length - 1, item);
+  else if (strcmp(parts[0], "getutxos") == 0)
+    rest_getutxos(rpc, parts + 1, length - 1, item);
+  else
+    rpc_res_error(item, 404, "Not found");
+
+  btc_rpc_dispatch(rpc, call, res);
+}
+
+/*
+ * Server
+ */
+
 static int
 on_request(http_server_t *server, http_req_t *req, http_res_t *res) {
   btc_rpc_t *rpc = server->data;
-  json_value *input, *output;
   json_settings settings;
-  rpc_req_t rreq;
-  rpc_res_t rres;
+  json_value *input;
+  rpc_call_t *call;
   unsigned int i;
 
+  /* REST is public data only; no credentials. */
+  if ((rpc->flags & BTC_RPC_REST) && req->path.length >= 6
+      && memcmp(req->path.data, "/rest/", 6) == 0) {
+    btc_rpc_rest(rpc, req, res);
+    return 1;
+  }
+
   if (req->method != HTTP_METHOD_POST) {
     http_res_error(res, 400);
     return 1;
@@ -3214,35 +4993,24 @@ on_request(http_server_t *server, http_req_t *req, http_res_t *res) {
   input = json_parse_ex(&settings, req->body.data, req->body.length, NULL);
 
   if (input != NULL && input->type == json_array) {
-    output = json_array_new(input->u.array.length);
+    call = rpc_call_create(rpc, input, input->u.array.length);
 
-    for (i = 0; i < input->u.array.length; i++) {
-      rpc_req_init(&rreq);
-      rpc_res_init(&rres);
-
-      if (!rpc_req_set(&rreq, input->u.array.values[i]))
-        rpc_res_error(&rres, RPC_INVALID_PARAMS, "Invalid params");
+    for (i = 0; i < call->length; i++) {
+      if (!rpc_req_set(&call->reqs[i], input->u.array.values[i]))
+        rpc_res_error(&call->items[i], RPC_INVALID_PARAMS, "Invalid params");
       else
-        btc_rpc_handle(rpc, &rreq, &rres);
-
-      json_array_push(output, rpc_res_encode(&rres, rreq.id));
+        btc_rpc_handle(rpc, &call->reqs[i], &call->items[i]);
     }
   } else {
-    rpc_req_init(&rreq);
-    rpc_res_init(&rres);
+    call = rpc_call_create(rpc, input, 1);
 
-    if (!rpc_req_set(&rreq, input))
-      rpc_res_error(&rres, RPC_INVALID_REQUEST, "Invalid request");
+    if (!rpc_req_set(&call->reqs[0], input))
+      rpc_res_error(&call->items[0], RPC_INVALID_REQUEST, "Invalid request");
     else
-      btc_rpc_handle(rpc, &rreq, &rres);
-
-    output = rpc_res_encode(&rres, rreq.id);
+      btc_rpc_handle(rpc, &call->reqs[0], &call->items[0]);
   }
 
-  http_res_send_json(res, output);
-
-  json_value_free(input); /* Accepts NULL. */
-  json_builder_free(output);
+  btc_rpc_dispatch(rpc, call, res);
 
   return 1;
 }
@@ -3254,6 +5022,7 @@ on_request(http_server_t *server, http_req_t *req, http_res_t *res) {
 json_value *
 btc_rpc_call(btc_rpc_t *rpc, const char *method, const json_value *params) {
   int index = btc_rpc_find_handler(method);
+  json_value *result;
   rpc_res_t res;
 
   rpc_res_init(&res);
@@ -3276,7 +5045,23 @@ btc_rpc_call(btc_rpc_t *rpc, const char *method, const json_value *params) {
     parms.help = 0;
 
     btc_rpc_methods[index].handler(rpc, &parms, &res);
+
+    if (res.work != NULL)
+      rpc_res_run(rpc, &res);
+
+    if (res.stream.head != NULL) {
+      size_t length;
+      char *data = json_writer_encode(&res.stream, &length);
+
+      res.result = json_decode(data, length);
+
+      free(data);
+    }
   }
 
-  return rpc_res_encode(&res, NULL);
+  result = rpc_res_encode(&res, NULL);
+
+  rpc_snap_clear(rpc, &res.snap);
+
+  return result;
 }
@@ -0,0 +1,911 @@
+/*!
+ * stratum.c - stratum job server for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/chain.h>
+#include <node/miner.h>
+#include <node/stratum.h>
+
+#include <mako/block.h>
+#include <mako/consensus.h>
+#include <mako/crypto/hash.h>
+#include <mako/crypto/rand.h>
+#include <mako/entry.h>
+#include <mako/header.h>
+#include <mako/json.h>
+#include <mako/list.h>
+#include <mako/map.h>
+#include <mako/network.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+#include <mako/vector.h>
+
+#include "../bio.h"
+#include "../impl.h"
+#include "../internal.h"
+
+/*
+ * Constants
+ */
+
+#define STRATUM_MAX_LINE (16 << 10)
+#define STRATUM_MAX_BUFFER (8 << 20)
+#define STRATUM_MAX_JOBS 8
+#define STRATUM_JOB_TIME 30
+#define STRATUM_NONCE_SIZE 4
+
+/*
+ * Types
+ */
+
+typedef struct stratum_job_s {
+  char id[9];
+  uint32_t version;
+  uint8_t prev_block[32];
+  uint32_t bits;
+  int64_t mtp;
+  int64_t time;
+  double difficulty;
+  uint8_t share[32];
+  uint8_t target[32];
+  btc_steps_t steps;
+  btc_sha256_t midstate;
+  uint8_t *raw;
+  size_t length;
+  size_t offset;
+  btc_tx_t *coinbase;
+  btc_vector_t txs;
+  btc_hashset_t shares;
+} stratum_job_t;
+
+typedef struct stratum_client_s {
+  struct btc_stratum_s *stratum;
+  btc_socket_t *socket;
+  uint32_t nonce1;
+  int subscribed;
+  int authorized;
+  double difficulty;
+  char line[STRATUM_MAX_LINE];
+  size_t length;
+  struct stratum_client_s *prev;
+  struct stratum_client_s *next;
+} stratum_client_t;
+
+typedef struct stratum_clients_s {
+  stratum_client_t *head;
+  stratum_client_t *tail;
+  size_t length;
+} stratum_clients_t;
+
+struct btc_stratum_s {
+  const btc_network_t *network;
+  btc_loop_t *loop;
+  btc_logger_t *logger;
+  btc_chain_t *chain;
+  btc_miner_t *miner;
+  btc_server_t *server;
+  int port;
+  double difficulty;
+  stratum_clients_t clients;
+  btc_vector_t jobs;
+  uint32_t job_id;
+  int64_t updated;
+  uint32_t nonce1;
+};
+
+BTC_DEFINE_LOGGER(btc_log, btc_stratum_t, "stratum")
+
+/*
+ * Helpers
+ */
+
+static void
+stratum_hex32(char *zp, uint32_t x) {
+  sprintf(zp, "%08lx", (unsigned long)x);
+}
+
+static int
+stratum_raw_get(uint8_t *zp, size_t zn, const json_value *obj) {
+  size_t len = zn;
+
+  if (obj == NULL)
+    return 0;
+
+  if (!json_raw_get(zp, &len, obj))
+    return 0;
+
+  return len == zn;
+}
+
+/*
+ * Job
+ */
+
+static stratum_job_t *
+stratum_job_create(btc_stratum_t *stratum, const btc_tmpl_t *bt) {
+  stratum_job_t *job = btc_malloc(sizeof(stratum_job_t));
+  double difficulty = btc_difficulty(bt->bits);
+  const btc_input_t *input;
+  size_t i;
+
+  sprintf(job->id, "%lx", (unsigned long)stratum->job_id++);
+
+  job->version = bt->version;
+  btc_hash_copy(job->prev_block, bt->prev_block);
+  job->bits = bt->bits;
+  job->mtp = bt->mtp;
+  job->time = bt->time;
+  job->difficulty = stratum->difficulty;
+
+  /* A block is always a valid share. */
+  if (difficulty < job->difficulty)
+    job->difficulty = difficulty;
+
+  btc_difficulty_target(job->share, job->difficulty);
+
+  CHECK(btc_compact_export(job->target, bt->bits));
+
+  job->steps = bt->steps;
+
+  /* Split the stripped coinbase around the 8 byte extra
+     nonce which ends its input script: coinb1 and coinb2
+     are everything before and after nonce1 || nonce2. */
+  job->coinbase = btc_tmpl_coinbase(bt, 0, 0);
+  job->length = btc_tx_base_size(job->coinbase);
+  job->raw = btc_malloc(job->length);
+
+  btc_tx_base_write(job->raw, job->coinbase);
+
+  input = job->coinbase->inputs.items[0];
+
+  job->offset = 4 + 1 + 36 + 1 + input->script.length - 8;
+
+  CHECK(job->raw[job->offset - 1] == 8);
+
+  /* Every share hashes coinb1 first. */
+  btc_sha256_init(&job->midstate);
+  btc_sha256_update(&job->midstate, job->raw, job->offset);
+
+  btc_vector_init(&job->txs);
+
+  for (i = 0; i < bt->txs.length; i++) {
+    const btc_blockentry_t *item = bt->txs.items[i];
+
+    btc_vector_push(&job->txs, btc_tx_ref(item->tx));
+  }
+
+  btc_hashset_init(&job->shares);
+
+  return job;
+}
+
+static void
+stratum_job_destroy(stratum_job_t *job) {
+  btc_mapiter_t it;
+  size_t i;
+
+  for (i = 0; i < job->txs.length; i++)
+    btc_tx_destroy(job->txs.items[i]);
+
+  btc_map_each(&job->shares, it)
+    btc_free(job->shares.keys[it]);
+
+  btc_hashset_clear(&job->shares);
+  btc_vector_clear(&job->txs);
+  btc_tx_destroy(job->coinbase);
+  btc_free(job->raw);
+  btc_free(job);
+}
+
+static void
+stratum_job_header(btc_header_t *hdr,
+                   const stratum_job_t *job,
+                   const uint8_t *extra,
+                   int64_t time,
+                   uint32_t nonce) {
+  const uint8_t *coinb2 = job->raw + job->offset + 8;
+  size_t length = job->length - job->offset - 8;
+  btc_sha256_t ctx;
+  uint8_t hash[32];
+  size_t i;
+
+  ctx = job->midstate;
+
+  btc_sha256_update(&ctx, extra, 8);
+  btc_sha256_update(&ctx, coinb2, length);
+  btc_sha256_final(&ctx, hash);
+  btc_sha256(hash, hash, 32);
+
+  for (i = 0; i < job->steps.length; i++)
+    btc_hash256_root(hash, hash, &job->steps.hashes[i * 32]);
+
+  hdr->version = job->version;
+  btc_hash_copy(hdr->prev_block, job->prev_block);
+  btc_hash_copy(hdr->merkle_root, hash);
+  hdr->time = time;
+  hdr->bits = job->bits;
+  hdr->nonce = nonce;
+}
+
+static btc_block_t *
+stratum_job_commit(const stratum_job_t *job,
+                   const btc_header_t *hdr,
+                   const uint8_t *extra) {
+  btc_block_t *block = btc_block_create();
+  btc_tx_t *cb = btc_tx_clone(job->coinbase);
+  btc_input_t *input = cb->inputs.items[0];
+  size_t i;
+
+  memcpy(input->script.data + input->script.length - 8, extra, 8);
+
+  btc_tx_refresh(cb);
+
+  btc_header_copy(&block->header, hdr);
+  btc_txvec_push(&block->txs, cb);
+
+  for (i = 0; i < job->txs.length; i++)
+    btc_txvec_push(&block->txs, btc_tx_ref(job->txs.items[i]));
+
+  return block;
+}
+
+static void
+stratum_write_notify(json_writer *w, const stratum_job_t *job, int clean) {
+  uint8_t prev[32];
+  char str[9];
+  size_t i;
+
+  /* The previous hash goes out as eight byte-swapped words. */
+  for (i = 0; i < 32; i += 4)
+    btc_write32be(prev + i, btc_read32le(job->prev_block + i));
+
+  json_write_object(w);
+  json_write_key(w, "id");
+  json_write_null(w);
+  json_write_key(w, "method");
+  json_write_string(w, "mining.notify");
+  json_write_key(w, "params");
+  json_write_array(w);
+  json_write_string(w, job->id);
+  json_write_hex(w, prev, 32);
+  json_write_hex(w, job->raw, job->offset);
+  json_write_hex(w, job->raw + job->offset + 8,
+                    job->length - job->offset - 8);
+  json_write_array(w);
+
+  for (i = 0; i < job->steps.length; i++)
+    json_write_hex(w, &job->steps.hashes[i * 32], 32);
+
+  json_write_array_end(w);
+
+  stratum_hex32(str, job->version);
+  json_write_string(w, str);
+
+  stratum_hex32(str, job->bits);
+  json_write_string(w, str);
+
+  stratum_hex32(str, job->time);
+  json_write_string(w, str);
+
+  json_write_boolean(w, clean);
+  json_write_array_end(w);
+  json_write_object_end(w);
+}
+
+static void
+stratum_write_difficulty(json_writer *w, double difficulty) {
+  /* Shares are checked against the exact value. */
+  char str[32];
+
+  json_write_object(w);
+  json_write_key(w, "id");
+  json_write_null(w);
+  json_write_key(w, "method");
+  json_write_string(w, "mining.set_difficulty");
+  json_write_key(w, "params");
+  json_write_array(w);
+  json_write_data(w, str, sprintf(str, "%.17g", difficulty));
+  json_write_array_end(w);
+  json_write_object_end(w);
+}
+
+static void
+stratum_write_id(json_writer *w, const json_value *id) {
+  if (id != NULL && id->type == json_integer)
+    json_write_integer(w, id->u.integer);
+  else if (id != NULL && id->type == json_string)
+    json_write_string_length(w, id->u.string.ptr, id->u.string.length);
+  else
+    json_write_null(w);
+}
+
+/*
+ * Client
+ */
+
+static void
+stratum_send(stratum_client_t *client, json_writer *w) {
+  size_t length;
+  char *data = json_writer_encode(w, &length);
+
+  /* Replaces the terminator. */
+  data[length++] = '\n';
+
+  btc_socket_write(client->socket, data, length);
+}
+
+static void
+stratum_respond(stratum_client_t *client, const json_value *id, int result) {
+  json_writer w;
+
+  json_writer_init(&w);
+  json_write_object(&w);
+  json_write_key(&w, "id");
+  stratum_write_id(&w, id);
+  json_write_key(&w, "result");
+  json_write_boolean(&w, result);
+  json_write_key(&w, "error");
+  json_write_null(&w);
+  json_write_object_end(&w);
+
+  stratum_send(client, &w);
+}
+
+static void
+stratum_error(stratum_client_t *client,
+              const json_value *id,
+              int code,
+              const char *msg) {
+  json_writer w;
+
+  json_writer_init(&w);
+  json_write_object(&w);
+  json_write_key(&w, "id");
+  stratum_write_id(&w, id);
+  json_write_key(&w, "result");
+  json_write_null(&w);
+  json_write_key(&w, "error");
+  json_write_array(&w);
+  json_write_integer(&w, code);
+  json_write_string(&w, msg);
+  json_write_null(&w);
+  json_write_array_end(&w);
+  json_write_object_end(&w);
+
+  stratum_send(client, &w);
+}
+
+static void
+stratum_notify(stratum_client_t *client, const stratum_job_t *job, int clean) {
+  json_writer w;
+
+  json_writer_init(&w);
+
+  if (client->difficulty != job->difficulty) {
+    stratum_write_difficulty(&w, job->difficulty);
+    stratum_send(client, &w);
+    client->difficulty = job->difficulty;
+  }
+
+  stratum_write_notify(&w, job, clean);
+
+  stratum_send(client, &w);
+}
+
+static stratum_job_t *
+stratum_job(btc_stratum_t *stratum, const char *id) {
+  size_t i;
+
+  for (i = 0; i < stratum->jobs.length; i++) {
+    stratum_job_t *job = stratum->jobs.items[i];
+
+    if (strcmp(job->id, id) == 0)
+      return job;
+  }
+
+  return NULL;
+}
+
+static void
+stratum_update(btc_stratum_t *stratum);
+
+static void
+stratum_subscribe(stratum_client_t *client,
+                  const json_value *id,
+                  const json_value *params) {
+  btc_stratum_t *stratum = client->stratum;
+  const stratum_job_t *job;
+  uint8_t nonce1[4];
+  char subid[9];
+  json_writer w;
+
+  (void)params;
+
+  stratum_hex32(subid, client->nonce1);
+  btc_write32be(nonce1, client->nonce1);
+
+  json_writer_init(&w);
+  json_write_object(&w);
+  json_write_key(&w, "id");
+  stratum_write_id(&w, id);
+  json_write_key(&w, "result");
+  json_write_array(&w);
+  json_write_array(&w);
+  json_write_array(&w);
+  json_write_string(&w, "mining.set_difficulty");
+  json_write_string(&w, subid);
+  json_write_array_end(&w);
+  json_write_array(&w);
+  json_write_string(&w, "mining.notify");
+  json_write_string(&w, subid);
+  json_write_array_end(&w);
+  json_write_array_end(&w);
+  json_write_hex(&w, nonce1, 4);
+  json_write_integer(&w, STRATUM_NONCE_SIZE);
+  json_write_array_end(&w);
+  json_write_key(&w, "error");
+  json_write_null(&w);
+  json_write_object_end(&w);
+
+  stratum_send(client, &w);
+
+  stratum_update(stratum);
+
+  client->subscribed = 1;
+
+  if (stratum->jobs.length > 0) {
+    job = btc_vector_top(&stratum->jobs);
+    stratum_notify(client, job, 1);
+  }
+}
+
+static void
+stratum_submit(stratum_client_t *client,
+               const json_value *id,
+               const json_value *params) {
+  btc_stratum_t *stratum = client->stratum;
+  const json_value *values[5];
+  stratum_job_t *job;
+  const char *name;
+  btc_block_t *block;
+  btc_header_t hdr;
+  uint8_t extra[8];
+  uint8_t hash[32];
+  uint8_t raw[4];
+  int64_t time;
+  uint32_t nonce;
+  size_t i;
+
+  if (!client->subscribed) {
+    stratum_error(client, id, 25, "Not subscribed");
+    return;
+  }
+
+  if (!client->authorized) {
+    stratum_error(client, id, 24, "Unauthorized worker");
+    return;
+  }
+
+  if (params == NULL || params->type != json_array
+                     || params->u.array.length < 5) {
+    stratum_error(client, id, 20, "Invalid parameters");
+    return;
+  }
+
+  for (i = 0; i < 5; i++)
+    values[i] = params->u.array.values[i];
+
+  if (!json_string_get(&name, values[1])) {
+    stratum_error(client, id, 20, "Invalid parameters");
+    return;
+  }
+
+  job = stratum_job(stratum, name);
+
+  if (job == NULL) {
+    stratum_error(client, id, 21, "Job not found");
+    return;
+  }
+
+  btc_write32be(extra, client->nonce1);
+
+  if (!stratum_raw_get(extra + 4, 4, values[2])) {
+    stratum_error(client, id, 20, "Invalid extranonce2");
+    return;
+  }
+
+  if (!stratum_raw_get(raw, 4, values[3])) {
+    stratum_error(client, id, 20, "Invalid ntime");
+    return;
+  }
+
+  time = btc_read32be(raw);
+
+  if (time <= job->mtp || time > job->time + 2 * 60 * 60) {
+    stratum_error(client, id, 20, "Invalid ntime");
+    return;
+  }
+
+  if (!stratum_raw_get(raw, 4, values[4])) {
+    stratum_error(client, id, 20, "Invalid nonce");
+    return;
+  }
+
+  nonce = btc_read32be(raw);
+
+  stratum_job_header(&hdr, job, extra, time, nonce);
+  btc_header_hash(hash, &hdr);
+
+  if (btc_hash_compare(hash, job->share) > 0) {
+    stratum_error(client, id, 23, "Low difficulty share");
+    return;
+  }
+
+  /* The header commits to the extra nonce, so
+     this covers resubmissions from any worker. */
+  if (btc_hashset_has(&job->shares, hash)) {
+    stratum_error(client, id, 22, "Duplicate share");
+    return;
+  }
+
+  btc_hashset_put(&job->shares, btc_hash_clone(hash));
+
+  if (btc_hash_compare(hash, job->target) > 0) {
+    stratum_respond(client, id, 1);
+    return;
+  }
+
+  btc_log_info(stratum, "Found block: %H (job=%s).", hash, job->id);
+
+  block = stratum_job_commit(job, &hdr, extra);
+
+  if (!btc_chain_add(stratum->chain, block, BTC_BLOCK_DEFAULT_FLAGS, 0)) {
+    const btc_verify_error_t *err = btc_chain_error(stratum->chain);
+
+    btc_log_error(stratum, "Block rejected: %s.", err->reason);
+
+    stratum_error(client, id, 20, err->reason);
+  } else {
+    stratum_respond(client, id, 1);
+  }
+
+  btc_block_destroy(block);
+}
+
+static int
+stratum_handle(stratum_client_t *client, const char *line, size_t length) {
+  const json_value *id, *method, *params;
+  json_value *msg = json_decode(line, length);
+  const char *name;
+
+  if (msg == NULL)
+    return 0;
+
+  if (msg->type != json_object) {
+    json_value_free(msg);
+    return 0;
+  }
+
+  id = json_object_get(msg, "id");
+  method = json_object_get(msg, "method");
+  params = json_object_get(msg, "params");
+
+  if (method == NULL || !json_string_get(&name, method)) {
+    json_value_free(msg);
+    return 0;
+  }
+
+  if (strcmp(name, "mining.subscribe") == 0) {
+    stratum_subscribe(client, id, params);
+  } else if (strcmp(name, "mining.authorize") == 0) {
+    client->authorized = 1;
+    stratum_respond(client, id, 1);
+  } else if (strcmp(name, "mining.submit") == 0) {
+    stratum_submit(client, id, params);
+  } else {
+    stratum_error(client, id, 20, "Method not found");
+  }
+
+  json_value_free(msg);
+
+  return 1;
+}
+
+static void
+on_close(btc_socket_t *socket) {
+  stratum_client_t *client = btc_socket_get_data(socket);
+  btc_stratum_t *stratum = client->stratum;
+
+  btc_list_remove(&stratum->clients, client, stratum_client_t);
+
+  btc_free(client);
+}
+
+static void
+on_error(btc_socket_t *socket) {
+  btc_socket_close(socket);
+}
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  stratum_client_t *client = btc_socket_get_data(socket);
+  const char *raw = data;
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    int ch = raw[i];
+
+    if (ch == '\r')
+      continue;
+
+    if (ch != '\n') {
+      if (client->length == STRATUM_MAX_LINE) {
+        btc_socket_close(socket);
+        return 0;
+      }
+
+      client->line[client->length++] = ch;
+
+      continue;
+    }
+
+    if (client->length == 0)
+      continue;
+
+    if (!stratum_handle(client, client->line, client->length)) {
+      btc_socket_close(socket);
+      return 0;
+    }
+
+    client->length = 0;
+  }
+
+  return 1;
+}
+
+static void
+on_socket(btc_socket_t *parent, btc_socket_t *child) {
+  btc_stratum_t *stratum = btc_socket_get_data(parent);
+  stratum_client_t *client = btc_malloc(sizeof(stratum_client_t));
+
+  client->stratum = stratum;
+  client->socket = child;
+  client->nonce1 = stratum->nonce1++;
+  client->subscribed = 0;
+  client->authorized = 0;
+  client->difficulty = 0;
+  client->length = 0;
+  client->prev = NULL;
+  client->next = NULL;
+
+  btc_list_push(&stratum->clients, client, stratum_client_t);
+
+  btc_socket_set_data(child, client);
+  btc_socket_on_close(child, on_close);
+  btc_socket_on_error(child, on_error);
+  btc_socket_on_data(child, on_data);
+}
+
+/*
+ * Jobs
+ */
+
+static void
+stratum_flush(btc_stratum_t *stratum) {
+  size_t i;
+
+  for (i = 0; i < stratum->jobs.length; i++)
+    stratum_job_destroy(stratum->jobs.items[i]);
+
+  btc_vector_reset(&stratum->jobs);
+}
+
+static void
+stratum_broadcast(btc_stratum_t *stratum, const stratum_job_t *job, int clean) {
+  stratum_client_t *client, *next;
+  btc_iobuf_t *buf;
+  json_writer w;
+  size_t length;
+  char *data;
+
+  json_writer_init(&w);
+
+  stratum_write_notify(&w, job, clean);
+
+  data = json_writer_encode(&w, &length);
+
+  /* Serialized once, queued to every worker. */
+  buf = btc_iobuf_create(stratum->loop, length + 1);
+
+  memcpy(buf->data, data, length);
+
+  buf->data[length] = '\n';
+
+  free(data);
+
+  for (client = stratum->clients.head; client != NULL; client = next) {
+    btc_socket_t *socket = client->socket;
+
+    next = client->next;
+
+    if (!client->subscribed)
+      continue;
+
+    if (btc_socket_buffered(socket) > STRATUM_MAX_BUFFER) {
+      btc_log_debug(stratum, "Dropping slow worker.");
+      btc_socket_close(socket);
+      continue;
+    }
+
+    if (client->difficulty != job->difficulty)
+      stratum_notify(client, job, clean);
+    else
+      btc_socket_write_buf(socket, buf);
+  }
+
+  btc_iobuf_destroy(buf);
+}
+
+static void
+stratum_update(btc_stratum_t *stratum) {
+  const btc_entry_t *tip = btc_chain_tip(stratum->chain);
+  btc_vector_t *jobs = &stratum->jobs;
+  int64_t now = btc_now();
+  stratum_job_t *job;
+  int clean = 1;
+
+  if (stratum->network->type != BTC_NETWORK_REGTEST) {
+    if (!btc_chain_synced(stratum->chain))
+      return;
+  }
+
+  /* A new tip obsoletes every job at once; otherwise
+     pick up fresh transactions every so often. */
+  if (jobs->length > 0) {
+    job = btc_vector_top(jobs);
+
+    if (!btc_hash_equal(job->prev_block, tip->hash))
+      stratum_flush(stratum);
+    else if (now < stratum->updated + STRATUM_JOB_TIME)
+      return;
+    else
+      clean = 0;
+  }
+
+  if (jobs->length == STRATUM_MAX_JOBS) {
+    stratum_job_destroy(jobs->items[0]);
+
+    memmove(jobs->items, jobs->items + 1,
+            (jobs->length - 1) * sizeof(void *));
+
+    jobs->length--;
+  }
+
+  job = stratum_job_create(stratum, btc_miner_get_template(stratum->miner));
+
+  btc_vector_push(jobs, job);
+
+  stratum->updated = now;
+
+  btc_log_debug(stratum, "New job %s (height=%d, clean=%d).",
+                job->id, tip->height + 1, clean);
+
+  stratum_broadcast(stratum, job, clean);
+}
+
+static void
+on_tick(void *arg) {
+  btc_stratum_t *stratum = arg;
+
+  if (stratum->clients.length > 0)
+    stratum_update(stratum);
+}
+
+/*
+ * Stratum
+ */
+
+btc_stratum_t *
+btc_stratum_create(const btc_network_t *network,
+                   btc_loop_t *loop,
+                   btc_chain_t *chain,
+                   btc_miner_t *miner) {
+  btc_stratum_t *stratum = btc_malloc(sizeof(btc_stratum_t));
+
+  memset(stratum, 0, sizeof(*stratum));
+
+  stratum->network = network;
+  stratum->loop = loop;
+  stratum->logger = NULL;
+  stratum->chain = chain;
+  stratum->miner = miner;
+  stratum->server = btc_server_create(loop);
+  stratum->port = 0;
+  stratum->difficulty = 1.0;
+  stratum->job_id = 0;
+  stratum->updated = 0;
+  stratum->nonce1 = btc_random();
+
+  btc_list_init(&stratum->clients);
+  btc_vector_init(&stratum->jobs);
+
+  btc_server_set_data(stratum->server, stratum);
+  btc_server_on_socket(stratum->server, on_socket);
+
+  return stratum;
+}
+
+void
+btc_stratum_destroy(btc_stratum_t *stratum) {
+  stratum_flush(stratum);
+  btc_vector_clear(&stratum->jobs);
+  btc_server_destroy(stratum->server);
+  btc_free(stratum);
+}
+
+void
+btc_stratum_set_logger(btc_stratum_t *stratum, btc_logger_t *logger) {
+  stratum->logger = logger;
+}
+
+void
+btc_stratum_set_port(btc_stratum_t *stratum, int port) {
+  CHECK(port >= 0 && port <= 0xffff);
+  stratum->port = port;
+}
+
+void
+btc_stratum_set_difficulty(btc_stratum_t *stratum, double difficulty) {
+  CHECK(difficulty > 0.0);
+  stratum->difficulty = difficulty;
+}
+
+int
+btc_stratum_open(btc_stratum_t *stratum) {
+  int port = stratum->port;
+
+  if (port == 0)
+    return 1;
+
+  btc_log_info(stratum, "Opening stratum server.");
+
+  if (!btc_server_listen_local(stratum->server, port)) {
+    const char *msg = btc_server_strerror(stratum->server);
+
+    btc_log_error(stratum, "Could not listen on port %d: %s.", port, msg);
+
+    return 0;
+  }
+
+  btc_log_info(stratum, "Listening on port %d.", port);
+
+  btc_loop_on_tick(stratum->loop, on_tick, stratum);
+
+  return 1;
+}
+
+void
+btc_stratum_close(btc_stratum_t *stratum) {
+  stratum_client_t *client;
+
+  if (stratum->port != 0)
+    btc_loop_off_tick(stratum->loop, on_tick, stratum);
+
+  btc_server_close(stratum->server);
+
+  for (client = stratum->clients.head; client != NULL; client = client->next)
+    btc_socket_close(client->socket);
+
+  stratum_flush(stratum);
+}
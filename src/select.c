@@ -248,6 +248,7 @@ btc_selopt_init(btc_selopt_t *opt) {
   opt->round = 0;
   opt->smart = 0;
   opt->watch = 0;
+  opt->rbf = 0;
 }
 
 /*
@@ -486,6 +487,12 @@ btc_selector_fund(btc_selector_t *sel, int64_t fee) {
 
     btc_tx_add_outpoint(sel->tx, &utxo->prevout);
 
+    if (sel->opt->rbf) {
+      btc_input_t *input = sel->tx->inputs.items[sel->tx->inputs.length - 1];
+
+      input->sequence = BTC_MAX_RBF_SEQUENCE;
+    }
+
     sel->inpval += utxo->value;
     sel->size += utxo->size;
 
@@ -262,3 +262,34 @@ btc_difficulty(uint32_t bits) {
 
   return diff;
 }
+
+void
+btc_difficulty_target(uint8_t *target, double difficulty) {
+  /* target = 0xffff * 2^208 / difficulty */
+  double x = 65535.0 / difficulty;
+  int top = 26;
+  int i, ch;
+
+  memset(target, 0, 32);
+
+  while (x >= 256.0 && top < 32) {
+    x /= 256.0;
+    top++;
+  }
+
+  if (top == 32) {
+    memset(target, 0xff, 32);
+    return;
+  }
+
+  while (x < 1.0 && top > 0) {
+    x *= 256.0;
+    top--;
+  }
+
+  for (i = top; i >= 0 && x > 0.0; i--) {
+    ch = (int)x;
+    target[i] = ch;
+    x = (x - ch) * 256.0;
+  }
+}
@@ -1184,6 +1184,108 @@ btc_wallet_send(btc_wallet_t *wallet,
   return 1;
 }
 
+int
+btc_wallet_bump(btc_tx_t **result,
+                btc_wallet_t *wallet,
+                const uint8_t *hash,
+                int64_t rate) {
+  const btc_wclient_t *client = &wallet->client;
+  unsigned int flags = BTC_SCRIPT_STANDARD_VERIFY_FLAGS;
+  btc_output_t *change = NULL;
+  int64_t fee, minfee, size;
+  btc_view_t *view = NULL;
+  btc_tx_t *tx = NULL;
+  btc_txmeta_t meta;
+  btc_path_t path;
+  int ret = 0;
+  size_t i;
+
+  *result = NULL;
+
+  if (wallet->master.locked)
+    return 0;
+
+  if (!btc_wallet_meta(&meta, wallet, hash) || meta.height != -1)
+    return 0;
+
+  if (!btc_wallet_tx(&tx, wallet, hash))
+    return 0;
+
+  /* Original must be replaceable (BIP125). */
+  if (!btc_tx_is_rbf(tx))
+    goto fail;
+
+  view = btc_wallet_undo(wallet, tx);
+  fee = btc_tx_fee(tx, view);
+
+  /* We must own every input. */
+  if (fee < 0)
+    goto fail;
+
+  for (i = 0; i < tx->outputs.length; i++) {
+    btc_output_t *output = tx->outputs.items[i];
+
+    if (!btc_wallet_output_path(&path, wallet, output))
+      continue;
+
+    if (path.change) {
+      change = output;
+      break;
+    }
+  }
+
+  if (change == NULL)
+    goto fail;
+
+  if (rate <= 0)
+    rate = wallet->rate;
+
+  /* Signatures are re-created with the same
+     templates, so the size barely changes. */
+  size = btc_tx_virtual_size(tx);
+  minfee = fee + btc_get_fee(BTC_MIN_RELAY, size);
+
+  if (btc_get_fee(rate, size) > minfee)
+    minfee = btc_get_fee(rate, size);
+
+  change->value -= (minfee - fee);
+
+  if (btc_output_is_dust(change, BTC_MIN_RELAY))
+    goto fail;
+
+  if (btc_wallet_sign(wallet, tx, view) != (int)tx->inputs.length)
+    goto fail;
+
+  btc_tx_refresh(tx);
+
+  /* Policy sanity checks. */
+  if (btc_tx_weight(tx) > BTC_MAX_TX_WEIGHT ||
+      btc_tx_sigops_cost(tx, view, flags) > BTC_MAX_TX_SIGOPS_COST ||
+      btc_tx_verify(tx, view, flags) == 0) {
+    goto fail;
+  }
+
+  /* Replaces the original in our txdb. */
+  if (!btc_wallet_add_tx(wallet, tx))
+    goto fail;
+
+  btc_log(wallet, LOG_INFO, "Bumped transaction %H to %H.", hash, tx->hash);
+
+  btc_wclient_send(client, tx);
+
+  *result = tx;
+  tx = NULL;
+  ret = 1;
+fail:
+  if (view != NULL)
+    btc_view_destroy(view);
+
+  if (tx != NULL)
+    btc_tx_destroy(tx);
+
+  return ret;
+}
+
 static void
 btc_wallet_set_tip(btc_wallet_t *wallet, const btc_entry_t *tip) {
   int32_t keep = wallet->network->block.keep_blocks;
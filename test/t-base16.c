@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-base16.c - base16 test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,102 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/encoding.h>
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Base16 Tests
+ */
+
+static int
+hex_value(int ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+
+  return -1;
+}
+
+static void
+test_base16_encode(void) {
+  static const char *charset = "0123456789abcdef";
+  uint8_t data[67];
+  char str[67 * 2 + 1];
+  size_t i, n;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (i * 151) ^ 0x5a;
+
+  for (n = 0; n <= sizeof(data); n++) {
+    memset(str, 'x', sizeof(str));
+
+    btc_base16_encode(str, data, n);
+
+    for (i = 0; i < n; i++) {
+      ASSERT(str[i * 2 + 0] == charset[data[i] >> 4]);
+      ASSERT(str[i * 2 + 1] == charset[data[i] & 15]);
+    }
+
+    ASSERT(str[n * 2] == '\0');
+  }
+}
+
+static void
+test_base16_decode(void) {
+  static const char *str = "00ff10Ab9fAAbbCCddeEFf0123456789"
+                           "aBcDeF7e80c3";
+  size_t len = strlen(str);
+  uint8_t data[64];
+  size_t i, n;
+
+  for (n = 0; n <= len; n += 2) {
+    memset(data, 0xee, sizeof(data));
+
+    ASSERT(btc_base16_decode(data, str, n));
+
+    for (i = 0; i < n / 2; i++) {
+      int hi = hex_value(str[i * 2 + 0]);
+      int lo = hex_value(str[i * 2 + 1]);
+
+      ASSERT(data[i] == ((hi << 4) | lo));
+    }
+  }
+
+  ASSERT(!btc_base16_decode(data, str, len - 1));
+}
+
+static void
+test_base16_invalid(void) {
+  static const char bad[] = "/:@G`g \xb0";
+  char str[33];
+  uint8_t data[16];
+  size_t i, j;
+
+  for (i = 0; i < 32; i++) {
+    for (j = 0; j < sizeof(bad) - 1; j++) {
+      memset(str, 'a', 32);
+
+      str[i] = bad[j];
+      str[32] = '\0';
+
+      ASSERT(!btc_base16_decode(data, str, 32));
+    }
+  }
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_base16_encode();
+  test_base16_decode();
+  test_base16_invalid();
   return 0;
 }
@@ -5,18 +5,40 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <node/chaindb.h>
+#include <mako/entry.h>
 #include <mako/network.h>
 #include "lib/tests.h"
 
 int main(void) {
   btc_chaindb_t *db = btc_chaindb_create(btc_mainnet);
+  const btc_entry_t *entry;
+  uint8_t *data;
+  size_t length;
 
   btc_rimraf(BTC_PREFIX);
 
   ASSERT(btc_chaindb_open(db, BTC_PREFIX, BTC_CHAIN_DEFAULT_FLAGS));
 
+  entry = btc_chaindb_by_height(db, 0);
+
+  ASSERT(entry != NULL);
+
+  /* Framed as a network message. */
+  ASSERT(btc_chaindb_get_raw_block(db, &data, &length, entry));
+  ASSERT(length == 24 + btc_mainnet->genesis.length);
+  ASSERT(memcmp(data + 24, btc_mainnet->genesis.data, length - 24) == 0);
+
+  free(data);
+
+  ASSERT(btc_chaindb_get_block_data(db, &data, &length, entry));
+  ASSERT(length == btc_mainnet->genesis.length);
+  ASSERT(memcmp(data, btc_mainnet->genesis.data, length) == 0);
+
+  free(data);
+
   btc_chaindb_close(db);
   btc_chaindb_destroy(db);
 
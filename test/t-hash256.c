@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-hash256.c - hash256 test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,122 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/crypto/hash.h>
+#include <mako/util.h>
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Helpers
+ */
+
+static void
+set_nonce(uint8_t *raw, uint32_t nonce) {
+  raw[76] = nonce >> 0;
+  raw[77] = nonce >> 8;
+  raw[78] = nonce >> 16;
+  raw[79] = nonce >> 24;
+}
+
+static uint32_t
+get_nonce(const uint8_t *raw) {
+  return ((uint32_t)raw[76] << 0)
+       | ((uint32_t)raw[77] << 8)
+       | ((uint32_t)raw[78] << 16)
+       | ((uint32_t)raw[79] << 24);
+}
+
+static uint32_t
+ref_scan(uint8_t *hash, const uint8_t *raw, const uint8_t *target) {
+  uint8_t tmp[80];
+  uint32_t nonce = get_nonce(raw);
+
+  memcpy(tmp, raw, 80);
+
+  for (;;) {
+    set_nonce(tmp, nonce);
+
+    btc_hash256(hash, tmp, 80);
+
+    if (btc_hash_compare(hash, target) <= 0)
+      return nonce;
+
+    nonce++;
+  }
+}
+
+/*
+ * Scan Tests
+ */
+
+static void
+test_scan(void) {
+  uint8_t expect[32];
+  uint8_t target[32];
+  uint8_t hash[32];
+  uint8_t raw[80];
+  uint32_t nonce;
+  size_t i;
+  int j;
+
+  for (i = 0; i < 80; i++)
+    raw[i] = i * 13 + 1;
+
+  /* Roughly one in 4096 hashes. */
+  memset(target, 0xff, 32);
+  target[31] = 0x00;
+  target[30] = 0x0f;
+
+  for (j = 0; j < 4; j++) {
+    raw[0] = j;
+
+    set_nonce(raw, j * 1000);
+
+    nonce = ref_scan(expect, raw, target);
+
+    ASSERT(btc_hash256_scan(hash, raw, target, 0));
+    ASSERT(get_nonce(raw) == nonce);
+    ASSERT(memcmp(hash, expect, 32) == 0);
+
+    /* Stops short of the solution. */
+    set_nonce(raw, j * 1000);
+
+    ASSERT(!btc_hash256_scan(hash, raw, target, nonce - j * 1000));
+    ASSERT(get_nonce(raw) == nonce);
+  }
+
+  /* The target is inclusive and lower words decide ties. */
+  set_nonce(raw, 7);
+  btc_hash256(hash, raw, 80);
+  memcpy(target, hash, 32);
+
+  ASSERT(btc_hash256_scan(hash, raw, target, 1));
+  ASSERT(get_nonce(raw) == 7);
+
+  for (i = 0; i < 32 && target[i] == 0; i++)
+    target[i] = 0xff;
+
+  target[i] -= 1;
+
+  set_nonce(raw, 7);
+
+  ASSERT(!btc_hash256_scan(hash, raw, target, 1));
+  ASSERT(get_nonce(raw) == 8);
+
+  /* Gives up when the nonce wraps. */
+  memset(target, 0, 32);
+
+  set_nonce(raw, 0xfffffffa);
+
+  ASSERT(!btc_hash256_scan(hash, raw, target, 0));
+  ASSERT(get_nonce(raw) == 0);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_scan();
   return 0;
 }
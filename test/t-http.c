@@ -17,6 +17,7 @@
 
 static int g_sent = 0;
 static int g_recv = 0;
+static http_res_t *g_deferred = NULL;
 
 static void
 inc_recv(btc_mutex_t *lock) {
@@ -38,6 +39,19 @@ static int
 on_request(http_server_t *server, http_req_t *req, http_res_t *res) {
   (void)server;
 
+  if (g_sent == 2) {
+    ASSERT(req->method == HTTP_METHOD_GET);
+    ASSERT(strcmp(req->path.data, "/defer") == 0);
+
+    /* Answered later from the poll loop. */
+    http_res_defer(res);
+
+    g_deferred = res;
+    g_sent++;
+
+    return 1;
+  }
+
   if (g_sent == 0) {
     ASSERT(req->method == HTTP_METHOD_GET);
     ASSERT(strcmp(req->path.data, "/") == 0);
@@ -171,10 +185,41 @@ send_request2(btc_mutex_t *lock) {
   inc_recv(lock);
 }
 
+static void
+send_request3(btc_mutex_t *lock) {
+  http_msg_t *msg = http_get("localhost", 1337, "/defer", BTC_AF_INET);
+
+  ASSERT(msg != NULL);
+  ASSERT(msg->status == 200);
+  ASSERT(msg->headers.length == 4);
+
+  ASSERT(strcmp(msg->headers.items[2]->field.data, "transfer-encoding") == 0);
+  ASSERT(strcmp(msg->headers.items[2]->value.data, "chunked") == 0);
+
+  ASSERT(strcmp(msg->body.data, "Deferred\n") == 0);
+
+  http_msg_destroy(msg);
+
+  inc_recv(lock);
+}
+
 static void
 send_requests(void *lock) {
   send_request1(lock);
   send_request2(lock);
+  send_request3(lock);
+}
+
+static void *
+send_chunk(const char *str) {
+  size_t len = strlen(str);
+  void *data = malloc(len);
+
+  ASSERT(data != NULL);
+
+  memcpy(data, str, len);
+
+  return data;
 }
 
 int main(void) {
@@ -201,10 +246,20 @@ int main(void) {
 
   start = btc_time_msec();
 
-  while (get_recv(&lock) < 2) {
+  while (get_recv(&lock) < 3) {
     ASSERT(btc_time_msec() < start + 10 * 1000);
 
-    btc_loop_poll(loop, 1000);
+    btc_loop_poll(loop, 100);
+
+    if (g_deferred != NULL) {
+      http_res_begin(g_deferred, 200, "text/plain");
+      http_res_chunk(g_deferred, send_chunk("Defer"), 5);
+      http_res_chunk(g_deferred, send_chunk("red\n"), 4);
+      http_res_end(g_deferred);
+      http_res_finish(g_deferred);
+
+      g_deferred = NULL;
+    }
   }
 
   btc_thread_join(&thread);
@@ -218,8 +273,8 @@ int main(void) {
 
   btc_loop_destroy(loop);
 
-  ASSERT(g_sent == 2);
-  ASSERT(g_recv == 2);
+  ASSERT(g_sent == 3);
+  ASSERT(g_recv == 3);
 
   btc_net_cleanup();
 
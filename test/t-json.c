@@ -0,0 +1,81 @@
+/*!
+ * t-json.c - json test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mako/encoding.h>
+#include <mako/json.h>
+#include "lib/tests.h"
+
+/*
+ * JSON Tests
+ */
+
+static void
+test_json_strings(void) {
+  static const char *json = "[\"abcdefghijklmnopqrstuvwxyz\","
+                            "\"0123456789abcdef\\n\\\"\\u0041xyz\","
+                            "\"\",\"x\"]";
+  uint8_t data[37];
+  json_writer w;
+  json_value *obj;
+  char *out;
+  size_t i;
+
+  obj = json_decode(json, strlen(json));
+
+  ASSERT(obj != NULL);
+  ASSERT(obj->type == json_array);
+  ASSERT(obj->u.array.length == 4);
+
+  ASSERT(strcmp(obj->u.array.values[0]->u.string.ptr,
+                "abcdefghijklmnopqrstuvwxyz") == 0);
+
+  ASSERT(strcmp(obj->u.array.values[1]->u.string.ptr,
+                "0123456789abcdef\n\"Axyz") == 0);
+
+  ASSERT(obj->u.array.values[2]->u.string.length == 0);
+  ASSERT(strcmp(obj->u.array.values[3]->u.string.ptr, "x") == 0);
+
+  json_builder_free(obj);
+
+  ASSERT(json_decode("[\"0123456789abcdef", 17) == NULL);
+  ASSERT(json_decode("[\"0123456789\0abcdef\"]", 21) == NULL);
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = i * 7;
+
+  json_writer_init(&w);
+  json_write_hex(&w, data, sizeof(data));
+
+  out = json_writer_encode(&w, NULL);
+  obj = json_decode(out, strlen(out));
+
+  ASSERT(obj != NULL);
+  ASSERT(obj->type == json_string);
+  ASSERT(obj->u.string.length == sizeof(data) * 2);
+
+  memset(data, 0, sizeof(data));
+
+  ASSERT(btc_base16_decode(data, obj->u.string.ptr, sizeof(data) * 2));
+
+  for (i = 0; i < sizeof(data); i++)
+    ASSERT(data[i] == ((i * 7) & 0xff));
+
+  json_builder_free(obj);
+  free(out);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_json_strings();
+  return 0;
+}
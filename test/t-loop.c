@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-loop.c - event loop test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,238 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <io/core.h>
+#include <io/loop.h>
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Timer Tests
+ */
+
+typedef struct order_s {
+  int items[8];
+  int length;
+  btc_timer_t *stop;
+} order_t;
+
+static order_t g_order;
+
+static void
+on_first(void *arg) {
+  (void)arg;
+  g_order.items[g_order.length++] = 1;
+}
+
+static void
+on_second(void *arg) {
+  (void)arg;
+  g_order.items[g_order.length++] = 2;
+}
+
+static void
+on_repeat(void *arg) {
+  int *count = arg;
+
+  *count += 1;
+
+  if (*count == 3)
+    btc_timer_stop(g_order.stop);
+}
+
+static void
+on_stopped(void *arg) {
+  (void)arg;
+  ASSERT(0);
+}
+
+static void
+test_timers(void) {
+  btc_loop_t *loop = btc_loop_create();
+  btc_timer_t *first = btc_timer_create(loop, on_first, NULL);
+  btc_timer_t *second = btc_timer_create(loop, on_second, NULL);
+  btc_timer_t *stopped = btc_timer_create(loop, on_stopped, NULL);
+  btc_timer_t *repeat;
+  int64_t start;
+  int count = 0;
+
+  repeat = btc_timer_create(loop, on_repeat, &count);
+
+  g_order.length = 0;
+  g_order.stop = repeat;
+
+  btc_timer_start(second, 40, 0);
+  btc_timer_start(first, 10, 0);
+  btc_timer_start(stopped, 20, 0);
+  btc_timer_start(repeat, 5, 5);
+
+  btc_timer_stop(stopped);
+
+  ASSERT(btc_timer_active(first));
+  ASSERT(!btc_timer_active(stopped));
+
+  start = btc_time_msec();
+
+  /* No sockets: each poll sleeps until the next deadline. */
+  while (btc_timer_active(first) || btc_timer_active(second)
+                                 || btc_timer_active(repeat)) {
+    ASSERT(btc_time_msec() < start + 5000);
+    btc_loop_poll(loop, -1);
+  }
+
+  ASSERT(btc_time_msec() >= start + 40);
+  ASSERT(g_order.length == 2);
+  ASSERT(g_order.items[0] == 1);
+  ASSERT(g_order.items[1] == 2);
+  ASSERT(count == 3);
+
+  btc_timer_destroy(first);
+  btc_timer_destroy(second);
+  btc_timer_destroy(stopped);
+  btc_timer_destroy(repeat);
+  btc_loop_destroy(loop);
+}
+
+/*
+ * Write Tests
+ */
+
+static size_t g_received = 0;
+static unsigned char g_last = 0;
+static int g_ordered = 1;
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  const unsigned char *raw = data;
+  size_t i;
+
+  (void)socket;
+
+  for (i = 0; i < size; i++) {
+    if (raw[i] < g_last)
+      g_ordered = 0;
+
+    g_last = raw[i];
+  }
+
+  g_received += size;
+
+  return 1;
+}
+
+static void
+on_socket(btc_socket_t *server, btc_socket_t *socket) {
+  (void)server;
+  btc_socket_on_data(socket, on_data);
+}
+
+static void
+on_connect(btc_socket_t *socket) {
+  btc_loop_t *loop = btc_socket_loop(socket);
+  btc_iobuf_t *buf = btc_iobuf_create(loop, 4096);
+  unsigned char *data;
+  int i;
+
+  /* Many small chunks followed by one shared buffer queued twice. */
+  for (i = 0; i < 1000; i++) {
+    data = malloc(10);
+
+    ASSERT(data != NULL);
+
+    memset(data, i / 4, 10);
+
+    ASSERT(btc_socket_write(socket, data, 10) != -1);
+  }
+
+  memset(buf->data, 250, buf->length);
+
+  ASSERT(btc_socket_write_buf(socket, buf) != -1);
+  ASSERT(btc_socket_write_buf(socket, buf) != -1);
+
+  btc_iobuf_destroy(buf);
+}
+
+static void
+test_writev(void) {
+  btc_loop_t *loop = btc_loop_create();
+  btc_socket_t *server, *client;
+  btc_sockaddr_t addr;
+  int64_t start;
+
+  ASSERT(btc_sockaddr_import(&addr, "127.0.0.1", 1338));
+
+  server = btc_loop_listen(loop, &addr);
+
+  ASSERT(server != NULL);
+
+  btc_socket_on_socket(server, on_socket);
+
+  client = btc_loop_connect(loop, &addr);
+
+  ASSERT(client != NULL);
+
+  btc_socket_on_connect(client, on_connect);
+
+  start = btc_time_msec();
+
+  while (g_received < 10000 + 2 * 4096) {
+    ASSERT(btc_time_msec() < start + 5000);
+    btc_loop_poll(loop, 100);
+  }
+
+  ASSERT(g_received == 10000 + 2 * 4096);
+  ASSERT(g_ordered);
+
+  btc_loop_close(loop);
+  btc_loop_destroy(loop);
+}
+
+/*
+ * Wakeup Tests
+ */
+
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+static void
+wake_loop(void *arg) {
+  btc_time_sleep(50);
+  btc_loop_stop((btc_loop_t *)arg);
+}
+
+static void
+test_wakeup(void) {
+  btc_loop_t *loop = btc_loop_create();
+  btc_thread_t thread;
+  int64_t start;
+
+  start = btc_time_msec();
+
+  btc_thread_create(&thread, wake_loop, loop);
+
+  /* Blocks with no timeout until the other thread stops us. */
+  btc_loop_start(loop);
+
+  btc_thread_join(&thread);
+
+  ASSERT(btc_time_msec() < start + 5000);
+
+  btc_loop_destroy(loop);
+}
+#endif
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  btc_net_startup();
+
+  test_timers();
+  test_writev();
+#if defined(_WIN32) || defined(BTC_PTHREAD)
+  test_wakeup();
+#endif
+
+  btc_net_cleanup();
+
   return 0;
 }
@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-mempool.c - mempool test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,467 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/chain.h>
+#include <node/mempool.h>
+#include <node/miner.h>
+
+#include <mako/address.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/consensus.h>
+#include <mako/crypto/ecc.h>
+#include <mako/entry.h>
+#include <mako/network.h>
+#include <mako/policy.h>
+#include <mako/tx.h>
+
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Constants
+ */
+
+#define FINAL 0xffffffff
+#define RBF BTC_MAX_RBF_SEQUENCE
+
+/*
+ * Context
+ */
+
+static btc_logger_t *test_logger;
+static btc_chain_t *test_chain;
+static btc_mempool_t *test_mp;
+static btc_address_t test_addr;
+static uint8_t test_priv[32];
+static int32_t test_height;
+
+/*
+ * Helpers
+ */
+
+static btc_tx_t *
+get_coinbase(void) {
+  const btc_entry_t *entry = btc_chain_by_height(test_chain, ++test_height);
+  btc_block_t *block;
+  btc_tx_t *tx;
+
+  ASSERT(entry != NULL);
+
+  block = btc_chain_get_block(test_chain, entry);
+
+  ASSERT(block != NULL);
+
+  tx = btc_tx_clone(block->txs.items[0]);
+
+  btc_block_destroy(block);
+
+  return tx;
+}
+
+static btc_tx_t *
+create_tx(const btc_tx_t **prevs,
+          const uint32_t *indices,
+          size_t count,
+          uint32_t sequence,
+          int64_t fee,
+          int outputs) {
+  btc_view_t *view = btc_view_create();
+  btc_tx_t *tx = btc_tx_create();
+  btc_tx_cache_t cache;
+  btc_outpoint_t prevout;
+  int64_t total = 0;
+  int64_t value;
+  size_t i;
+  int j;
+
+  for (i = 0; i < count; i++) {
+    const btc_output_t *output = prevs[i]->outputs.items[indices[i]];
+    btc_input_t *input;
+
+    btc_outpoint_set(&prevout, prevs[i]->hash, indices[i]);
+    btc_view_put(view, &prevout, btc_tx_coin(prevs[i], indices[i], 1));
+
+    btc_tx_add_outpoint(tx, &prevout);
+
+    input = tx->inputs.items[i];
+    input->sequence = sequence;
+
+    total += output->value;
+  }
+
+  value = (total - fee) / outputs;
+
+  for (j = 0; j < outputs; j++)
+    btc_tx_add_output(tx, &test_addr, value);
+
+  /* Pay the exact fee. */
+  tx->outputs.items[0]->value += (total - fee) % outputs;
+
+  memset(&cache, 0, sizeof(cache));
+
+  ASSERT(btc_tx_sign_step(tx, view, test_priv, &cache) == (int)count);
+
+  btc_tx_refresh(tx);
+  btc_view_destroy(view);
+
+  return tx;
+}
+
+static btc_tx_t *
+create_spend(const btc_tx_t *prev,
+             uint32_t index,
+             uint32_t sequence,
+             int64_t fee,
+             int outputs) {
+  return create_tx(&prev, &index, 1, sequence, fee, outputs);
+}
+
+static void
+add_tx(const btc_tx_t *tx) {
+  ASSERT(btc_mempool_add(test_mp, tx, 0));
+  ASSERT(btc_mempool_has(test_mp, tx->hash));
+}
+
+static void
+reject_tx(const btc_tx_t *tx, const char *reason) {
+  ASSERT(!btc_mempool_add(test_mp, tx, 0));
+  ASSERT(strcmp(btc_mempool_error(test_mp)->reason, reason) == 0);
+  ASSERT(!btc_mempool_has(test_mp, tx->hash));
+}
+
+/*
+ * Replacement Tests
+ */
+
+static void
+test_replace_signal(void) {
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *a = create_spend(cb, 0, FINAL, 10000, 1);
+  btc_tx_t *b = create_spend(cb, 0, FINAL, 20000, 1);
+  btc_tx_t *c;
+
+  /* Originals must opt in. */
+  add_tx(a);
+  reject_tx(b, "bad-txns-inputs-spent");
+
+  ASSERT(btc_mempool_has(test_mp, a->hash));
+
+  btc_tx_destroy(a);
+  btc_tx_destroy(b);
+  btc_tx_destroy(cb);
+
+  cb = get_coinbase();
+  a = create_spend(cb, 0, RBF, 10000, 1);
+  b = create_spend(cb, 0, FINAL, 20000, 1);
+
+  add_tx(a);
+  add_tx(b);
+
+  ASSERT(!btc_mempool_has(test_mp, a->hash));
+
+  /* The replacement itself does not signal. */
+  c = create_spend(cb, 0, RBF, 30000, 1);
+
+  reject_tx(c, "bad-txns-inputs-spent");
+
+  ASSERT(btc_mempool_has(test_mp, b->hash));
+
+  btc_tx_destroy(a);
+  btc_tx_destroy(b);
+  btc_tx_destroy(c);
+  btc_tx_destroy(cb);
+}
+
+static void
+test_replace_inherit(void) {
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *p = create_spend(cb, 0, RBF, 10000, 2);
+  btc_tx_t *q = create_spend(p, 0, FINAL, 10000, 1);
+  btc_tx_t *r = create_spend(p, 0, FINAL, 20000, 1);
+
+  /* The child inherits its parent's signal. */
+  add_tx(p);
+  add_tx(q);
+
+  ASSERT(!btc_tx_is_rbf(q));
+
+  add_tx(r);
+
+  ASSERT(btc_mempool_has(test_mp, p->hash));
+  ASSERT(!btc_mempool_has(test_mp, q->hash));
+
+  btc_tx_destroy(p);
+  btc_tx_destroy(q);
+  btc_tx_destroy(r);
+  btc_tx_destroy(cb);
+
+  /* Neither signals. */
+  cb = get_coinbase();
+  p = create_spend(cb, 0, FINAL, 10000, 2);
+  q = create_spend(p, 0, FINAL, 10000, 1);
+  r = create_spend(p, 0, FINAL, 20000, 1);
+
+  add_tx(p);
+  add_tx(q);
+  reject_tx(r, "bad-txns-inputs-spent");
+
+  ASSERT(btc_mempool_has(test_mp, q->hash));
+
+  btc_tx_destroy(p);
+  btc_tx_destroy(q);
+  btc_tx_destroy(r);
+  btc_tx_destroy(cb);
+}
+
+static void
+test_replace_fee(void) {
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *x = create_spend(cb, 0, RBF, 10000, 2);
+  btc_tx_t *y = create_spend(x, 0, RBF, 50000, 1);
+  btc_tx_t *r;
+
+  add_tx(x);
+  add_tx(y);
+
+  /* Higher rate than the conflict, but less
+     than the sum of everything it evicts. */
+  r = create_spend(cb, 0, RBF, 20000, 2);
+
+  reject_tx(r, "insufficient fee");
+
+  btc_tx_destroy(r);
+
+  /* Must also pay for its own relay. */
+  r = create_spend(cb, 0, RBF, 60001, 2);
+
+  reject_tx(r, "insufficient fee");
+
+  btc_tx_destroy(r);
+
+  ASSERT(btc_mempool_has(test_mp, x->hash));
+  ASSERT(btc_mempool_has(test_mp, y->hash));
+
+  r = create_spend(cb, 0, RBF, 70000, 2);
+
+  add_tx(r);
+
+  ASSERT(!btc_mempool_has(test_mp, x->hash));
+  ASSERT(!btc_mempool_has(test_mp, y->hash));
+
+  btc_tx_destroy(r);
+  btc_tx_destroy(x);
+  btc_tx_destroy(y);
+  btc_tx_destroy(cb);
+}
+
+static void
+test_replace_rate(void) {
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *x = create_spend(cb, 0, RBF, 10000, 1);
+  btc_tx_t *r = create_spend(cb, 0, RBF, 12000, 10);
+
+  add_tx(x);
+
+  /* Enough in total, but a lower fee rate. */
+  ASSERT(btc_tx_virtual_size(r) > 2 * btc_tx_virtual_size(x));
+
+  reject_tx(r, "insufficient fee");
+
+  ASSERT(btc_mempool_has(test_mp, x->hash));
+
+  btc_tx_destroy(r);
+  btc_tx_destroy(x);
+  btc_tx_destroy(cb);
+}
+
+static void
+test_replace_unconfirmed(void) {
+  btc_tx_t *cb1 = get_coinbase();
+  btc_tx_t *cb2 = get_coinbase();
+  btc_tx_t *x = create_spend(cb1, 0, RBF, 10000, 1);
+  btc_tx_t *u = create_spend(cb2, 0, RBF, 10000, 1);
+  const btc_tx_t *prevs[2];
+  uint32_t indices[2];
+  btc_tx_t *r;
+
+  add_tx(x);
+  add_tx(u);
+
+  prevs[0] = cb1;
+  prevs[1] = u;
+  indices[0] = 0;
+  indices[1] = 0;
+
+  r = create_tx(prevs, indices, 2, RBF, 100000, 1);
+
+  reject_tx(r, "replacement-adds-unconfirmed");
+
+  ASSERT(btc_mempool_has(test_mp, x->hash));
+
+  btc_tx_destroy(r);
+  btc_tx_destroy(x);
+  btc_tx_destroy(u);
+  btc_tx_destroy(cb1);
+  btc_tx_destroy(cb2);
+}
+
+static void
+test_replace_limit(int children) {
+  int total = 1 + children;
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *x = create_spend(cb, 0, RBF, 10000, children);
+  btc_tx_t *r = create_spend(cb, 0, RBF, 200000, 1);
+  btc_tx_t **txs = malloc(children * sizeof(btc_tx_t *));
+  size_t size;
+  int i;
+
+  ASSERT(txs != NULL);
+
+  add_tx(x);
+
+  for (i = 0; i < children; i++) {
+    txs[i] = create_spend(x, i, RBF, 1000, 1);
+    add_tx(txs[i]);
+  }
+
+  size = btc_mempool_size(test_mp);
+
+  if (total > BTC_MEMPOOL_MAX_REPLACEMENTS) {
+    reject_tx(r, "too many potential replacements");
+
+    ASSERT(btc_mempool_size(test_mp) == size);
+    ASSERT(btc_mempool_has(test_mp, x->hash));
+  } else {
+    add_tx(r);
+
+    ASSERT(btc_mempool_size(test_mp) == size - total + 1);
+    ASSERT(!btc_mempool_has(test_mp, x->hash));
+  }
+
+  for (i = 0; i < children; i++)
+    btc_tx_destroy(txs[i]);
+
+  free(txs);
+
+  btc_tx_destroy(r);
+  btc_tx_destroy(x);
+  btc_tx_destroy(cb);
+}
+
+/*
+ * Limit Tests
+ */
+
+static void
+test_limit_orphans(void) {
+  btc_mempool_t *mp = btc_mempool_create(btc_regtest, test_chain);
+  btc_tx_t *cb = get_coinbase();
+  btc_tx_t *tx;
+  int i, j;
+
+  btc_mempool_set_logger(mp, test_logger);
+
+  ASSERT(btc_mempool_open(mp, NULL, 0));
+
+  for (i = 0; i < 50; i++) {
+    uint8_t hash[32];
+
+    memset(hash, i + 1, 32);
+
+    tx = btc_tx_create();
+
+    btc_tx_add_input(tx, hash, 0);
+
+    for (j = 0; j < 20; j++)
+      btc_tx_add_output(tx, &test_addr, 10000);
+
+    btc_tx_refresh(tx);
+
+    ASSERT(btc_mempool_add(mp, tx, 0));
+    ASSERT(btc_mempool_has_orphan(mp, tx->hash));
+
+    btc_tx_destroy(tx);
+  }
+
+  /* Orphans alone fill the pool. Evicting
+     entries cannot help, so none are evicted. */
+  btc_mempool_set_limit(mp, btc_mempool_usage(mp) / 2);
+
+  tx = create_spend(cb, 0, FINAL, 10000, 1);
+
+  ASSERT(btc_mempool_add(mp, tx, 0));
+  ASSERT(btc_mempool_has(mp, tx->hash));
+
+  btc_tx_destroy(tx);
+  btc_tx_destroy(cb);
+
+  btc_mempool_close(mp);
+  btc_mempool_destroy(mp);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  const btc_network_t *network = btc_regtest;
+  btc_miner_t *miner;
+  btc_loop_t *loop;
+  uint8_t pub[33];
+
+  memset(test_priv, 0x01, sizeof(test_priv));
+
+  ASSERT(btc_ecdsa_pubkey_create(pub, test_priv, 1));
+
+  btc_address_set_p2pk(&test_addr, pub, 33);
+
+  btc_rimraf(BTC_PREFIX);
+
+  loop = btc_loop_create();
+  test_logger = btc_logger_create();
+  test_chain = btc_chain_create(network);
+  test_mp = btc_mempool_create(network, test_chain);
+  miner = btc_miner_create(network, loop, test_chain, test_mp);
+
+  btc_logger_set_silent(test_logger, 1);
+
+  btc_chain_set_logger(test_chain, test_logger);
+  btc_mempool_set_logger(test_mp, test_logger);
+  btc_miner_set_logger(miner, test_logger);
+
+  ASSERT(btc_chain_open(test_chain, BTC_PREFIX, 0));
+  ASSERT(btc_mempool_open(test_mp, NULL, 0));
+  ASSERT(btc_miner_open(miner, 0));
+
+  /* Mature some coinbases. */
+  btc_miner_generate(miner, 100 + 16, &test_addr);
+
+  test_replace_signal();
+  test_replace_inherit();
+  test_replace_fee();
+  test_replace_rate();
+  test_replace_unconfirmed();
+  test_replace_limit(BTC_MEMPOOL_MAX_REPLACEMENTS - 1);
+  test_replace_limit(BTC_MEMPOOL_MAX_REPLACEMENTS);
+  test_limit_orphans();
+
+  btc_miner_close(miner);
+  btc_mempool_close(test_mp);
+  btc_chain_close(test_chain);
+
+  btc_miner_destroy(miner);
+  btc_mempool_destroy(test_mp);
+  btc_chain_destroy(test_chain);
+  btc_logger_destroy(test_logger);
+  btc_loop_destroy(loop);
+
+  btc_rimraf(BTC_PREFIX);
+
   return 0;
 }
@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-miner.c - miner test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,187 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+
+#include <node/miner.h>
+
+#include <mako/address.h>
+#include <mako/block.h>
+#include <mako/header.h>
+#include <mako/script.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Helpers
+ */
+
+static btc_tx_t *
+create_tx(int seed) {
+  btc_tx_t *tx = btc_tx_create();
+  btc_outpoint_t prevout;
+  btc_address_t addr;
+  btc_input_t *input;
+  uint8_t hash[32];
+
+  memset(hash, seed, 32);
+
+  btc_outpoint_set(&prevout, hash, 0);
+  btc_tx_add_outpoint(tx, &prevout);
+
+  /* Give the transaction a distinct wtxid. */
+  input = tx->inputs.items[0];
+
+  btc_stack_push_data(&input->witness, hash, 32);
+
+  btc_address_set_p2wpkh(&addr, hash);
+  btc_tx_add_output(tx, &addr, 100000);
+
+  btc_tx_refresh(tx);
+
+  return tx;
+}
+
+static btc_tmpl_t *
+create_template(size_t count) {
+  btc_tmpl_t *bt = btc_tmpl_create();
+  uint8_t hash[32];
+  size_t i;
+
+  memset(hash, 0xaa, 32);
+
+  btc_hash_copy(bt->prev_block, hash);
+  btc_address_set_p2wpkh(&bt->address, hash);
+
+  bt->height = 1;
+
+  for (i = 0; i < count; i++) {
+    btc_tx_t *tx = create_tx(i + 1);
+
+    btc_tmpl_push(bt, tx, NULL);
+    btc_tx_destroy(tx);
+  }
+
+  btc_tmpl_refresh(bt);
+
+  return bt;
+}
+
+static void
+assert_same_block(const btc_block_t *x, const btc_block_t *y) {
+  size_t xn = btc_block_size(x);
+  size_t yn = btc_block_size(y);
+  uint8_t *xp, *yp;
+
+  ASSERT(xn == yn);
+
+  xp = malloc(xn);
+  yp = malloc(yn);
+
+  ASSERT(xp != NULL && yp != NULL);
+
+  btc_block_write(xp, x);
+  btc_block_write(yp, y);
+
+  ASSERT(memcmp(xp, yp, xn) == 0);
+
+  free(xp);
+  free(yp);
+}
+
+/*
+ * Template Tests
+ */
+
+static void
+test_tmpl_rebuild(size_t count) {
+  btc_tmpl_t *bt = create_template(count);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  btc_tx_t *cb = block->txs.items[0];
+  btc_block_t *rebuilt;
+
+  rebuilt = btc_tmpl_rebuild(bt, &block->header, cb);
+
+  ASSERT(rebuilt != NULL);
+  ASSERT(rebuilt->txs.length == count + 1);
+
+  assert_same_block(block, rebuilt);
+
+  btc_block_destroy(rebuilt);
+  btc_block_destroy(block);
+  btc_tmpl_destroy(bt);
+}
+
+static void
+test_tmpl_rebuild_prev(void) {
+  btc_tmpl_t *bt = create_template(3);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  btc_header_t hdr = block->header;
+
+  hdr.prev_block[0] ^= 1;
+
+  ASSERT(btc_tmpl_rebuild(bt, &hdr, block->txs.items[0]) == NULL);
+
+  btc_block_destroy(block);
+  btc_tmpl_destroy(bt);
+}
+
+static void
+test_tmpl_rebuild_root(void) {
+  /* A coinbase from other work does not match the header. */
+  btc_tmpl_t *bt = create_template(3);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  btc_tx_t *cb = btc_tmpl_coinbase(bt, 1, 2);
+
+  ASSERT(btc_tmpl_rebuild(bt, &block->header, cb) == NULL);
+
+  btc_tx_destroy(cb);
+  btc_block_destroy(block);
+  btc_tmpl_destroy(bt);
+}
+
+static void
+test_tmpl_rebuild_commitment(void) {
+  /* A matching root is not enough if the coinbase
+     commits to some other set of witnesses. */
+  btc_tmpl_t *bt = create_template(3);
+  btc_tx_t *cb = btc_tmpl_coinbase(bt, 0, 0);
+  btc_output_t *output;
+  uint8_t hash[32];
+  uint8_t root[32];
+  btc_header_t hdr;
+
+  ASSERT(btc_tmpl_witness(bt));
+  ASSERT(cb->outputs.length == 2);
+
+  memset(hash, 0x11, 32);
+
+  output = cb->outputs.items[1];
+
+  btc_script_set_commitment(&output->script, hash);
+  btc_tx_refresh(cb);
+
+  btc_tmpl_compute(root, bt, cb->hash);
+  btc_tmpl_header(&hdr, bt, root, bt->time, 0);
+
+  ASSERT(btc_tmpl_rebuild(bt, &hdr, cb) == NULL);
+
+  btc_tx_destroy(cb);
+  btc_tmpl_destroy(bt);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_tmpl_rebuild(0);
+  test_tmpl_rebuild(1);
+  test_tmpl_rebuild(7);
+  test_tmpl_rebuild_prev();
+  test_tmpl_rebuild_root();
+  test_tmpl_rebuild_commitment();
   return 0;
 }
@@ -0,0 +1,447 @@
+/*!
+ * t-pool.c - pool test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <base/timedata.h>
+#include <node/chain.h>
+#include <node/mempool.h>
+#include <node/pool.h>
+
+#include <mako/address.h>
+#include <mako/crypto/hash.h>
+#include <mako/net.h>
+#include <mako/netmsg.h>
+#include <mako/network.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include "lib/tests.h"
+
+/*
+ * Constants
+ */
+
+#define TEST_PORT 28444
+
+/*
+ * Types
+ */
+
+typedef struct test_peer_s {
+  btc_socket_t *socket;
+  uint8_t *data;
+  size_t length;
+  int verack;
+  int pong;
+  int closed;
+  uint8_t wanted[16][32];
+  size_t count;
+} test_peer_t;
+
+/*
+ * Context
+ */
+
+static const btc_network_t *test_network;
+static btc_loop_t *test_loop;
+
+/*
+ * Helpers
+ */
+
+static void
+write32(uint8_t *zp, uint32_t x) {
+  zp[0] = x >> 0;
+  zp[1] = x >> 8;
+  zp[2] = x >> 16;
+  zp[3] = x >> 24;
+}
+
+static uint32_t
+read32(const uint8_t *xp) {
+  return ((uint32_t)xp[0] << 0)
+       | ((uint32_t)xp[1] << 8)
+       | ((uint32_t)xp[2] << 16)
+       | ((uint32_t)xp[3] << 24);
+}
+
+static btc_tx_t *
+create_orphan(int seed) {
+  btc_tx_t *tx = btc_tx_create();
+  btc_outpoint_t prevout;
+  btc_address_t addr;
+  uint8_t hash[32];
+
+  memset(hash, seed, 32);
+
+  btc_outpoint_set(&prevout, hash, 0);
+  btc_tx_add_outpoint(tx, &prevout);
+
+  btc_address_set_p2wpkh(&addr, hash);
+  btc_tx_add_output(tx, &addr, 100000);
+
+  btc_tx_refresh(tx);
+
+  return tx;
+}
+
+/*
+ * Peer
+ */
+
+static void
+peer_send(test_peer_t *peer, enum btc_msgtype type, const void *body) {
+  size_t length;
+  btc_msg_t msg;
+  uint8_t *data;
+
+  btc_msg_set_type(&msg, type);
+
+  msg.body = (void *)body;
+
+  length = btc_msg_size(&msg);
+  data = malloc(24 + length);
+
+  ASSERT(data != NULL);
+
+  btc_msg_export(data + 24, &msg);
+
+  memset(data, 0, 24);
+
+  write32(data + 0, test_network->magic);
+  memcpy(data + 4, msg.cmd, strlen(msg.cmd));
+  write32(data + 16, length);
+  write32(data + 20, btc_checksum(data + 24, length));
+
+  ASSERT(btc_socket_write(peer->socket, data, 24 + length) != -1);
+}
+
+static void
+peer_handle(test_peer_t *peer, const btc_msg_t *msg) {
+  switch (msg->type) {
+    case BTC_MSG_VERACK: {
+      peer->verack = 1;
+      break;
+    }
+
+    case BTC_MSG_PONG: {
+      peer->pong = 1;
+      break;
+    }
+
+    case BTC_MSG_GETDATA: {
+      const btc_zinv_t *inv = msg->body;
+      size_t i;
+
+      for (i = 0; i < inv->length; i++) {
+        if (peer->count == lengthof(peer->wanted))
+          break;
+
+        memcpy(peer->wanted[peer->count++], inv->items[i].hash, 32);
+      }
+
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+}
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  test_peer_t *peer = btc_socket_get_data(socket);
+  uint32_t length;
+  char cmd[13];
+  btc_msg_t msg;
+
+  if (size == 0) {
+    peer->closed = 1;
+    btc_socket_close(socket);
+    return 0;
+  }
+
+  peer->data = realloc(peer->data, peer->length + size);
+
+  ASSERT(peer->data != NULL);
+
+  memcpy(peer->data + peer->length, data, size);
+
+  peer->length += size;
+
+  while (peer->length >= 24) {
+    memcpy(cmd, peer->data + 4, 12);
+
+    cmd[12] = '\0';
+    length = read32(peer->data + 16);
+
+    if (peer->length < 24 + length)
+      break;
+
+    btc_msg_set_cmd(&msg, cmd);
+    btc_msg_alloc(&msg);
+
+    ASSERT(btc_msg_import(&msg, peer->data + 24, length));
+
+    peer_handle(peer, &msg);
+
+    btc_msg_clear(&msg);
+
+    peer->length -= 24 + length;
+
+    memmove(peer->data, peer->data + 24 + length, peer->length);
+  }
+
+  return 1;
+}
+
+static void
+on_close(btc_socket_t *socket) {
+  test_peer_t *peer = btc_socket_get_data(socket);
+  peer->closed = 1;
+}
+
+static void
+on_connect(btc_socket_t *socket) {
+  test_peer_t *peer = btc_socket_get_data(socket);
+  btc_version_t version;
+
+  btc_version_init(&version);
+
+  version.version = BTC_NET_PROTOCOL_VERSION;
+  version.services = BTC_NET_LOCAL_SERVICES;
+  version.time = btc_now();
+  version.nonce = (uint64_t)(uintptr_t)peer;
+  version.relay = 1;
+
+  strcpy(version.agent, "/test/");
+
+  peer_send(peer, BTC_MSG_VERSION, &version);
+}
+
+static int
+wait_for(const int *flag, int64_t timeout) {
+  int64_t start = btc_time_msec();
+
+  while (!*flag) {
+    if (btc_time_msec() > start + timeout)
+      return 0;
+
+    btc_loop_poll(test_loop, 50);
+  }
+
+  return 1;
+}
+
+static void
+peer_open(test_peer_t *peer) {
+  btc_sockaddr_t addr;
+
+  memset(peer, 0, sizeof(*peer));
+
+  ASSERT(btc_sockaddr_import(&addr, "127.0.0.1", TEST_PORT));
+
+  peer->socket = btc_loop_connect(test_loop, &addr);
+
+  ASSERT(peer->socket != NULL);
+
+  btc_socket_set_data(peer->socket, peer);
+  btc_socket_on_connect(peer->socket, on_connect);
+  btc_socket_on_data(peer->socket, on_data);
+  btc_socket_on_close(peer->socket, on_close);
+
+  ASSERT(wait_for(&peer->verack, 5000));
+
+  peer_send(peer, BTC_MSG_VERACK, NULL);
+}
+
+static void
+peer_close(test_peer_t *peer) {
+  if (!peer->closed)
+    btc_socket_close(peer->socket);
+
+  /* Let the loop release the socket. */
+  while (!peer->closed)
+    btc_loop_poll(test_loop, 50);
+
+  free(peer->data);
+}
+
+static void
+peer_sync(test_peer_t *peer) {
+  /* The pong arrives after everything sent before the ping. */
+  btc_ping_t ping;
+
+  ping.nonce = 1;
+  peer->pong = 0;
+
+  peer_send(peer, BTC_MSG_PING, &ping);
+
+  ASSERT(wait_for(&peer->pong, 5000));
+}
+
+static void
+peer_announce(test_peer_t *peer, const btc_tx_t **txs, size_t count) {
+  btc_zinv_t inv;
+  size_t i;
+
+  btc_zinv_init(&inv);
+
+  for (i = 0; i < count; i++)
+    btc_zinv_push(&inv, BTC_INV_TX, txs[i]->hash);
+
+  peer_send(peer, BTC_MSG_INV, &inv);
+
+  btc_zinv_clear(&inv);
+}
+
+static int
+peer_wants(const test_peer_t *peer, const uint8_t *hash) {
+  size_t i;
+
+  for (i = 0; i < peer->count; i++) {
+    if (memcmp(peer->wanted[i], hash, 32) == 0)
+      return 1;
+  }
+
+  return 0;
+}
+
+static void
+wait_wanted(const test_peer_t *peer, const uint8_t *hash, int64_t timeout) {
+  int64_t start = btc_time_msec();
+
+  while (!peer_wants(peer, hash)) {
+    ASSERT(btc_time_msec() < start + timeout);
+    btc_loop_poll(test_loop, 50);
+  }
+}
+
+/*
+ * Request Tests
+ */
+
+static void
+test_request_failover(void) {
+  btc_tx_t *tx1 = create_orphan(1);
+  btc_tx_t *tx2 = create_orphan(2);
+  const btc_tx_t *both[2];
+  test_peer_t a, b, c;
+
+  both[0] = tx1;
+  both[1] = tx2;
+
+  peer_open(&a);
+  peer_open(&b);
+  peer_open(&c);
+
+  /* The first announcer is asked once the inbound delay passes. */
+  peer_announce(&a, both, 2);
+  peer_sync(&a);
+
+  peer_announce(&b, both, 1);
+  peer_sync(&b);
+
+  wait_wanted(&a, tx1->hash, 5000);
+  wait_wanted(&a, tx2->hash, 5000);
+
+  ASSERT(!peer_wants(&b, tx1->hash));
+
+  /* A times out and the next announcer is tried. */
+  wait_wanted(&b, tx1->hash, 15000);
+
+  /* A replies late to both: one request is still open,
+     the other was dropped when A was its only source. */
+  peer_send(&a, BTC_MSG_TX, tx1);
+  peer_send(&a, BTC_MSG_TX, tx2);
+  peer_sync(&a);
+
+  ASSERT(!a.closed);
+
+  /* B's reply arrives after A settled the request. */
+  peer_send(&b, BTC_MSG_TX, tx1);
+  peer_sync(&b);
+
+  ASSERT(!b.closed);
+
+  /* C was never asked. */
+  peer_send(&c, BTC_MSG_TX, tx1);
+
+  ASSERT(wait_for(&c.closed, 5000));
+
+  peer_close(&a);
+  peer_close(&b);
+  peer_close(&c);
+
+  btc_tx_destroy(tx1);
+  btc_tx_destroy(tx2);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  btc_timedata_t *timedata;
+  btc_logger_t *logger;
+  btc_mempool_t *mempool;
+  btc_chain_t *chain;
+  btc_pool_t *pool;
+
+  test_network = btc_regtest;
+
+  btc_rimraf(BTC_PREFIX);
+
+  test_loop = btc_loop_create();
+  logger = btc_logger_create();
+  timedata = btc_timedata_create();
+  chain = btc_chain_create(test_network);
+  mempool = btc_mempool_create(test_network, chain);
+  pool = btc_pool_create(test_network, test_loop, chain, mempool);
+
+  btc_logger_set_silent(logger, 1);
+
+  btc_chain_set_logger(chain, logger);
+  btc_mempool_set_logger(mempool, logger);
+  btc_pool_set_logger(pool, logger);
+
+  btc_chain_set_timedata(chain, timedata);
+  btc_mempool_set_timedata(mempool, timedata);
+  btc_pool_set_timedata(pool, timedata);
+
+  btc_pool_set_port(pool, TEST_PORT);
+
+  ASSERT(btc_chain_open(chain, BTC_PREFIX, 0));
+  ASSERT(btc_mempool_open(mempool, NULL, 0));
+  ASSERT(btc_pool_open(pool, BTC_PREFIX, BTC_POOL_LISTEN | BTC_POOL_CONNECT));
+
+  test_request_failover();
+
+  btc_pool_close(pool);
+  btc_mempool_close(mempool);
+  btc_chain_close(chain);
+  btc_loop_close(test_loop);
+
+  btc_pool_destroy(pool);
+  btc_mempool_destroy(mempool);
+  btc_chain_destroy(chain);
+  btc_timedata_destroy(timedata);
+  btc_logger_destroy(logger);
+  btc_loop_destroy(test_loop);
+
+  btc_rimraf(BTC_PREFIX);
+
+  return 0;
+}
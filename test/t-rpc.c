@@ -1,14 +1,660 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-rpc.c - rpc test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/chain.h>
+#include <node/mempool.h>
+#include <node/miner.h>
+#include <node/node.h>
+#include <node/rpc.h>
+
+#include <mako/address.h>
+#include <mako/block.h>
+#include <mako/coins.h>
+#include <mako/crypto/ecc.h>
+#include <mako/encoding.h>
+#include <mako/entry.h>
+#include <mako/header.h>
+#include <mako/json.h>
+#include <mako/network.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Constants
+ */
+
+#define TEST_PORT 28445
+
+/*
+ * Types
+ */
+
+typedef struct test_client_s {
+  btc_socket_t *socket;
+  char *data;
+  size_t length;
+  int connected;
+  int closed;
+} test_client_t;
+
+/*
+ * Context
+ */
+
+static btc_node_t *test_node;
+static btc_address_t test_addr;
+static uint8_t test_priv[32];
+
+/*
+ * Helpers
+ */
+
+static json_value *
+rpc_call(const char *method, const char *params) {
+  json_value *args = NULL;
+  json_value *res;
+
+  if (params != NULL) {
+    args = json_decode(params, strlen(params));
+
+    ASSERT(args != NULL);
+  }
+
+  res = btc_rpc_call(test_node->rpc, method, args);
+
+  ASSERT(res != NULL);
+
+  if (args != NULL)
+    json_builder_free(args);
+
+  return res;
+}
+
+static int
+rpc_error(const json_value *res) {
+  const json_value *err = json_object_get(res, "error");
+
+  ASSERT(err != NULL);
+
+  if (err->type == json_null)
+    return 0;
+
+  err = json_object_get(err, "code");
+
+  ASSERT(err != NULL && err->type == json_integer);
+
+  return err->u.integer;
+}
+
+static const json_value *
+rpc_result(const json_value *res) {
+  const json_value *result = json_object_get(res, "result");
+
+  ASSERT(result != NULL);
+
+  return result;
+}
+
+static char *
+block_hex(const btc_block_t *block) {
+  size_t length = btc_block_size(block);
+  uint8_t *data = malloc(length);
+  char *str = malloc(length * 2 + 1);
+
+  ASSERT(data != NULL && str != NULL);
+
+  btc_block_write(data, block);
+  btc_base16_encode(str, data, length);
+
+  free(data);
+
+  return str;
+}
+
+static char *
+block_params(const btc_block_t *block, const char *fmt) {
+  char *hex = block_hex(block);
+  char *str = malloc(strlen(fmt) + strlen(hex) + 1);
+
+  ASSERT(str != NULL);
+
+  sprintf(str, fmt, hex);
+
+  free(hex);
+
+  return str;
+}
+
+static json_value *
+submit_block(const btc_block_t *block) {
+  char *params = block_params(block, "[\"%s\"]");
+  json_value *res = rpc_call("submitblock", params);
+
+  free(params);
+
+  return res;
+}
+
+static json_value *
+propose_block(const btc_block_t *block) {
+  char *params = block_params(block, "[{\"mode\":\"proposal\","
+                                     "\"data\":\"%s\"}]");
+  json_value *res = rpc_call("getblocktemplate", params);
+
+  free(params);
+
+  return res;
+}
+
+static void
+assert_result(const json_value *res, const char *reason) {
+  const json_value *result = rpc_result(res);
+
+  ASSERT(rpc_error(res) == 0);
+
+  if (reason == NULL) {
+    ASSERT(result->type == json_null);
+  } else {
+    ASSERT(result->type == json_string);
+    ASSERT(strcmp(result->u.string.ptr, reason) == 0);
+  }
+}
+
+static void
+assert_tip(const btc_block_t *block) {
+  const btc_entry_t *tip = btc_chain_tip(test_node->chain);
+  uint8_t hash[32];
+
+  btc_header_hash(hash, &block->header);
+
+  ASSERT(btc_hash_equal(tip->hash, hash));
+}
+
+static void
+remine(btc_header_t *hdr) {
+  hdr->nonce = 0;
+
+  ASSERT(btc_header_mine(hdr, 0));
+}
+
+static btc_tx_t *
+create_orphan(int seed) {
+  btc_tx_t *tx = btc_tx_create();
+  btc_outpoint_t prevout;
+  btc_address_t addr;
+  uint8_t hash[32];
+
+  memset(hash, seed, 32);
+
+  btc_outpoint_set(&prevout, hash, 0);
+  btc_tx_add_outpoint(tx, &prevout);
+
+  btc_address_set_p2wpkh(&addr, hash);
+  btc_tx_add_output(tx, &addr, 100000);
+
+  btc_tx_refresh(tx);
+
+  return tx;
+}
+
+static void
+get_longpollid(char *id) {
+  json_value *res = rpc_call("getblocktemplate", "[{\"rules\":[\"segwit\"]}]");
+  const json_value *val = json_object_get(rpc_result(res), "longpollid");
+
+  ASSERT(val != NULL && val->type == json_string);
+  ASSERT(val->u.string.length == 72);
+
+  strcpy(id, val->u.string.ptr);
+
+  json_builder_free(res);
+}
+
+/*
+ * Client
+ */
+
+static void
+on_connect(btc_socket_t *socket) {
+  test_client_t *client = btc_socket_get_data(socket);
+  client->connected = 1;
+}
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  test_client_t *client = btc_socket_get_data(socket);
+
+  if (size == 0) {
+    client->closed = 1;
+    btc_socket_close(socket);
+    return 0;
+  }
+
+  client->data = realloc(client->data, client->length + size + 1);
+
+  ASSERT(client->data != NULL);
+
+  memcpy(client->data + client->length, data, size);
+
+  client->length += size;
+  client->data[client->length] = '\0';
+
+  return 1;
+}
+
+static void
+on_close(btc_socket_t *socket) {
+  test_client_t *client = btc_socket_get_data(socket);
+  client->closed = 1;
+}
+
+static const char *
+client_body(const test_client_t *client) {
+  /* HTTP/1.0 responses are never chunked. */
+  const char *body, *len;
+
+  if (client->data == NULL)
+    return NULL;
+
+  body = strstr(client->data, "\r\n\r\n");
+  len = strstr(client->data, "Content-Length: ");
+
+  if (body == NULL || len == NULL)
+    return NULL;
+
+  body += 4;
+
+  if (strlen(body) < strtoul(len + 16, NULL, 10))
+    return NULL;
+
+  return body;
+}
+
+static void
+client_poll(int64_t ms) {
+  int64_t start = btc_time_msec();
+
+  while (btc_time_msec() < start + ms)
+    btc_loop_poll(test_node->loop, 50);
+}
+
+static const char *
+client_wait(const test_client_t *client, int64_t timeout) {
+  int64_t start = btc_time_msec();
+  const char *body;
+
+  while ((body = client_body(client)) == NULL) {
+    ASSERT(btc_time_msec() < start + timeout);
+    btc_loop_poll(test_node->loop, 50);
+  }
+
+  return body;
+}
+
+static void
+client_open(test_client_t *client) {
+  btc_sockaddr_t addr;
+
+  memset(client, 0, sizeof(*client));
+
+  ASSERT(btc_sockaddr_import(&addr, "127.0.0.1", TEST_PORT));
+
+  client->socket = btc_loop_connect(test_node->loop, &addr);
+
+  ASSERT(client->socket != NULL);
+
+  btc_socket_set_data(client->socket, client);
+  btc_socket_on_connect(client->socket, on_connect);
+  btc_socket_on_data(client->socket, on_data);
+  btc_socket_on_close(client->socket, on_close);
+}
+
+static void
+client_close(test_client_t *client) {
+  if (!client->closed)
+    btc_socket_close(client->socket);
+
+  while (!client->closed)
+    btc_loop_poll(test_node->loop, 50);
+
+  free(client->data);
+}
+
+static void
+client_longpoll(test_client_t *client, const char *id) {
+  static const char *fmt = "{\"method\":\"getblocktemplate\",\"params\":"
+                           "[{\"rules\":[\"segwit\"],\"longpollid\":\"%s\"}]}";
+  char body[256];
+  char *data;
+  int len;
+
+  len = sprintf(body, fmt, id);
+  data = malloc(len + 256);
+
+  ASSERT(data != NULL);
+
+  len = sprintf(data, "POST / HTTP/1.0\r\n"
+                      "Authorization: Basic dTpw\r\n"
+                      "Content-Type: application/json\r\n"
+                      "Content-Length: %d\r\n"
+                      "\r\n"
+                      "%s", len, body);
+
+  client_open(client);
+
+  ASSERT(btc_socket_write(client->socket, data, len) != -1);
+}
+
+/*
+ * Submit Tests
+ */
+
+static void
+test_submitblock_decode(void) {
+  /* Templates we never handed out take the full decode. */
+  btc_tmpl_t *bt = btc_miner_template(test_node->miner);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  json_value *res;
+
+  res = submit_block(block);
+
+  assert_result(res, NULL);
+  assert_tip(block);
+
+  json_builder_free(res);
+  btc_block_destroy(block);
+  btc_tmpl_destroy(bt);
+}
+
+static void
+test_submitblock_rebuild(void) {
+  /* Blocks from a served template are rebuilt from it. */
+  const btc_tmpl_t *bt = btc_miner_get_template(test_node->miner);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  json_value *res;
+
+  res = submit_block(block);
+
+  assert_result(res, NULL);
+  assert_tip(block);
+
+  json_builder_free(res);
+
+  res = submit_block(block);
+
+  assert_result(res, "duplicate");
+
+  json_builder_free(res);
+  btc_block_destroy(block);
+}
+
+static void
+test_submitblock_invalid(void) {
+  btc_tmpl_t *bt = btc_miner_template(test_node->miner);
+  btc_tx_t *tx = create_orphan(1);
+  btc_block_t *block;
+  json_value *res;
+
+  btc_tmpl_push(bt, tx, NULL);
+  btc_tmpl_refresh(bt);
+
+  block = btc_tmpl_mine(bt);
+  res = submit_block(block);
+
+  assert_result(res, "bad-txns-inputs-missingorspent");
+
+  json_builder_free(res);
+
+  res = rpc_call("submitblock", "[\"00\"]");
+
+  ASSERT(rpc_error(res) == -22);
+
+  json_builder_free(res);
+  btc_block_destroy(block);
+  btc_tx_destroy(tx);
+  btc_tmpl_destroy(bt);
+}
+
+/*
+ * Proposal Tests
+ */
+
+static void
+test_proposal(void) {
+  const btc_entry_t *tip = btc_chain_tip(test_node->chain);
+  btc_tmpl_t *bt = btc_miner_template(test_node->miner);
+  btc_block_t *block = btc_tmpl_mine(bt);
+  btc_header_t hdr = block->header;
+  json_value *res;
+
+  res = propose_block(block);
+  assert_result(res, NULL);
+  json_builder_free(res);
+
+  block->header.bits = 0x207ffffe;
+  remine(&block->header);
+
+  res = propose_block(block);
+  assert_result(res, "bad-diffbits");
+  json_builder_free(res);
+
+  block->header = hdr;
+  block->header.time = btc_entry_median_time(tip);
+  remine(&block->header);
+
+  res = propose_block(block);
+  assert_result(res, "time-too-old");
+  json_builder_free(res);
+
+  block->header = hdr;
+  block->header.prev_block[0] ^= 1;
+  remine(&block->header);
+
+  res = propose_block(block);
+  assert_result(res, "inconclusive-not-best-prevblk");
+  json_builder_free(res);
+
+  block->header = hdr;
+  block->header.merkle_root[0] ^= 1;
+  remine(&block->header);
+
+  res = propose_block(block);
+  assert_result(res, "bad-txnmrklroot");
+  json_builder_free(res);
+
+  block->header = hdr;
+
+  res = submit_block(block);
+  assert_result(res, NULL);
+  json_builder_free(res);
+
+  res = propose_block(block);
+  assert_result(res, "duplicate");
+  json_builder_free(res);
+
+  btc_block_destroy(block);
+  btc_tmpl_destroy(bt);
+}
+
+/*
+ * Long Polling Tests
+ */
+
+static void
+test_longpoll_tip(void) {
+  test_client_t current, stale;
+  const btc_tmpl_t *bt;
+  btc_block_t *block;
+  json_value *res;
+  char hash[65];
+  char id[73];
+
+  get_longpollid(id);
+
+  client_longpoll(&current, id);
+
+  /* A stale mempool sequence alone does not answer. */
+  id[71] = (id[71] == '0') ? '1' : '0';
+
+  client_longpoll(&stale, id);
+  client_poll(1000);
+
+  ASSERT(current.connected && client_body(&current) == NULL);
+  ASSERT(stale.connected && client_body(&stale) == NULL);
+
+  bt = btc_miner_get_template(test_node->miner);
+  block = btc_tmpl_mine(bt);
+
+  res = submit_block(block);
+  assert_result(res, NULL);
+  json_builder_free(res);
+
+  btc_hash_export(hash, btc_chain_tip(test_node->chain)->hash);
+
+  ASSERT(strstr(client_wait(&current, 5000), hash) != NULL);
+  ASSERT(strstr(client_wait(&stale, 5000), hash) != NULL);
+
+  client_close(&current);
+  client_close(&stale);
+
+  btc_block_destroy(block);
+}
+
+static btc_tx_t *
+create_spend(int64_t fee) {
+  /* Spend the first (long matured) coinbase to ourselves. */
+  const btc_entry_t *entry = btc_chain_by_height(test_node->chain, 1);
+  btc_view_t *view = btc_view_create();
+  btc_tx_t *tx = btc_tx_create();
+  const btc_tx_t *cb;
+  btc_tx_cache_t cache;
+  btc_outpoint_t prevout;
+  btc_block_t *block;
+
+  ASSERT(entry != NULL);
+
+  block = btc_chain_get_block(test_node->chain, entry);
+
+  ASSERT(block != NULL);
+
+  cb = block->txs.items[0];
+
+  btc_outpoint_set(&prevout, cb->hash, 0);
+  btc_view_put(view, &prevout, btc_tx_coin(cb, 0, entry->height));
+
+  btc_tx_add_outpoint(tx, &prevout);
+  btc_tx_add_output(tx, &test_addr, cb->outputs.items[0]->value - fee);
+
+  memset(&cache, 0, sizeof(cache));
+
+  ASSERT(btc_tx_sign_step(tx, view, test_priv, &cache) == 1);
+
+  btc_tx_refresh(tx);
+  btc_view_destroy(view);
+  btc_block_destroy(block);
+
+  return tx;
+}
+
+static void
+test_longpoll_fees(void) {
+  test_client_t client;
+  btc_tx_t *tx;
+  char id[73];
+
+  get_longpollid(id);
+
+  client_longpoll(&client, id);
+  client_poll(500);
+
+  ASSERT(client.connected && client_body(&client) == NULL);
+
+  tx = create_spend(100000);
+
+  ASSERT(btc_mempool_add(test_node->mempool, tx, 0));
+
+  /* The template cache lags the mempool by a few seconds. */
+  ASSERT(strstr(client_wait(&client, 10000), "\"fee\":100000") != NULL);
+
+  client_close(&client);
+
+  btc_tx_destroy(tx);
+}
+
+static void
+test_longpoll_abort(void) {
+  test_client_t client;
+  char id[73];
+
+  get_longpollid(id);
+
+  client_longpoll(&client, id);
+  client_poll(500);
+
+  ASSERT(client.connected && client_body(&client) == NULL);
+
+  btc_rpc_close(test_node->rpc);
+
+  ASSERT(strstr(client_wait(&client, 5000), "shutting down") != NULL);
+
+  client_close(&client);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  uint8_t pub[33];
+
+  memset(test_priv, 0x01, sizeof(test_priv));
+
+  ASSERT(btc_ecdsa_pubkey_create(pub, test_priv, 1));
+
+  btc_address_set_p2pk(&test_addr, pub, 33);
+
+  btc_rimraf(BTC_PREFIX);
+
+  test_node = btc_node_create(btc_regtest);
+
+  btc_logger_set_silent(test_node->logger, 1);
+
+  btc_rpc_set_port(test_node->rpc, TEST_PORT);
+  btc_rpc_set_credentials(test_node->rpc, "u", "p");
+
+  ASSERT(btc_node_open(test_node, BTC_PREFIX, 0));
+
+  /* Mature a coinbase. */
+  btc_miner_generate(test_node->miner, 100, &test_addr);
+
+  test_submitblock_decode();
+  test_submitblock_rebuild();
+  test_submitblock_invalid();
+  test_proposal();
+  test_longpoll_tip();
+  test_longpoll_fees();
+  test_longpoll_abort();
+
+  btc_node_close(test_node);
+  btc_loop_close(test_node->loop);
+  btc_node_destroy(test_node);
+
+  btc_rimraf(BTC_PREFIX);
+
   return 0;
 }
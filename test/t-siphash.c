@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-siphash.c - siphash test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,38 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/crypto/siphash.h>
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * Siphash Tests
+ */
+
+static void
+test_siphash_batch(void) {
+  uint8_t data[11 * 32];
+  uint64_t out[11];
+  uint8_t key[32];
+  size_t i;
+
+  for (i = 0; i < sizeof(key); i++)
+    key[i] = i;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (i * 7) ^ (i >> 3);
+
+  btc_siphash_batch(out, data, 11, key);
+
+  for (i = 0; i < 11; i++)
+    ASSERT(out[i] == btc_siphash_sum(data + i * 32, 32, key));
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_siphash_batch();
   return 0;
 }
@@ -0,0 +1,596 @@
+/*!
+ * t-stratum.c - stratum test for mako
+ * Copyright (c) 2021, Christopher Jeffrey (MIT License).
+ * https://github.com/chjj/mako
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <io/core.h>
+#include <io/loop.h>
+
+#include <base/logger.h>
+#include <node/chain.h>
+#include <node/mempool.h>
+#include <node/miner.h>
+#include <node/stratum.h>
+
+#include <mako/address.h>
+#include <mako/crypto/hash.h>
+#include <mako/encoding.h>
+#include <mako/entry.h>
+#include <mako/header.h>
+#include <mako/json.h>
+#include <mako/network.h>
+#include <mako/tx.h>
+#include <mako/util.h>
+
+#include "lib/tests.h"
+
+/*
+ * Constants
+ */
+
+#define TEST_PORT 28446
+
+/*
+ * Types
+ */
+
+typedef struct test_job_s {
+  char id[16];
+  uint8_t prev_block[32];
+  uint8_t coinb1[1024];
+  size_t coinb1_len;
+  uint8_t coinb2[1024];
+  size_t coinb2_len;
+  uint8_t branches[16][32];
+  size_t count;
+  uint32_t version;
+  uint32_t bits;
+  uint32_t time;
+} test_job_t;
+
+typedef struct test_client_s {
+  btc_socket_t *socket;
+  char *data;
+  size_t length;
+  int closed;
+  uint8_t nonce1[4];
+  int have_job;
+  test_job_t job;
+  json_value *reply;
+} test_client_t;
+
+/*
+ * Context
+ */
+
+static btc_loop_t *test_loop;
+static btc_chain_t *test_chain;
+static btc_miner_t *test_miner;
+
+/*
+ * Helpers
+ */
+
+static uint32_t
+read32be(const uint8_t *xp) {
+  return ((uint32_t)xp[0] << 24)
+       | ((uint32_t)xp[1] << 16)
+       | ((uint32_t)xp[2] << 8)
+       | ((uint32_t)xp[3] << 0);
+}
+
+static void
+write32be(uint8_t *zp, uint32_t x) {
+  zp[0] = x >> 24;
+  zp[1] = x >> 16;
+  zp[2] = x >> 8;
+  zp[3] = x >> 0;
+}
+
+static size_t
+hex_get(uint8_t *zp, size_t zn, const json_value *val) {
+  size_t len;
+
+  ASSERT(val != NULL && val->type == json_string);
+
+  len = val->u.string.length / 2;
+
+  ASSERT(len <= zn);
+  ASSERT(btc_base16_decode(zp, val->u.string.ptr, len * 2));
+
+  return len;
+}
+
+static uint32_t
+hex32_get(const json_value *val) {
+  uint8_t raw[4];
+
+  ASSERT(hex_get(raw, 4, val) == 4);
+
+  return read32be(raw);
+}
+
+/*
+ * Client
+ */
+
+static void
+client_notify(test_client_t *client, const json_value *params) {
+  test_job_t *job = &client->job;
+  const json_value *branches;
+  uint8_t prev[32];
+  size_t i;
+
+  ASSERT(params->type == json_array && params->u.array.length == 9);
+
+  ASSERT(params->u.array.values[0]->type == json_string);
+  ASSERT(params->u.array.values[0]->u.string.length < sizeof(job->id));
+
+  strcpy(job->id, params->u.array.values[0]->u.string.ptr);
+
+  /* Undo the word swap. */
+  ASSERT(hex_get(prev, 32, params->u.array.values[1]) == 32);
+
+  for (i = 0; i < 32; i += 4) {
+    uint32_t w = read32be(prev + i);
+
+    job->prev_block[i + 0] = w >> 0;
+    job->prev_block[i + 1] = w >> 8;
+    job->prev_block[i + 2] = w >> 16;
+    job->prev_block[i + 3] = w >> 24;
+  }
+
+  job->coinb1_len = hex_get(job->coinb1, sizeof(job->coinb1),
+                            params->u.array.values[2]);
+
+  job->coinb2_len = hex_get(job->coinb2, sizeof(job->coinb2),
+                            params->u.array.values[3]);
+
+  branches = params->u.array.values[4];
+
+  ASSERT(branches->type == json_array);
+  ASSERT(branches->u.array.length <= lengthof(job->branches));
+
+  job->count = branches->u.array.length;
+
+  for (i = 0; i < job->count; i++)
+    ASSERT(hex_get(job->branches[i], 32, branches->u.array.values[i]) == 32);
+
+  job->version = hex32_get(params->u.array.values[5]);
+  job->bits = hex32_get(params->u.array.values[6]);
+  job->time = hex32_get(params->u.array.values[7]);
+
+  client->have_job = 1;
+}
+
+static void
+client_handle(test_client_t *client, json_value *msg) {
+  const json_value *method = json_object_get(msg, "method");
+
+  if (method != NULL && method->type == json_string) {
+    if (strcmp(method->u.string.ptr, "mining.notify") == 0)
+      client_notify(client, json_object_get(msg, "params"));
+
+    json_builder_free(msg);
+
+    return;
+  }
+
+  ASSERT(client->reply == NULL);
+
+  client->reply = msg;
+}
+
+static int
+on_data(btc_socket_t *socket, const void *data, size_t size) {
+  test_client_t *client = btc_socket_get_data(socket);
+  char *line, *end;
+  json_value *msg;
+
+  if (size == 0) {
+    client->closed = 1;
+    btc_socket_close(socket);
+    return 0;
+  }
+
+  client->data = realloc(client->data, client->length + size + 1);
+
+  ASSERT(client->data != NULL);
+
+  memcpy(client->data + client->length, data, size);
+
+  client->length += size;
+  client->data[client->length] = '\0';
+
+  line = client->data;
+
+  while ((end = strchr(line, '\n')) != NULL) {
+    msg = json_decode(line, end - line);
+
+    ASSERT(msg != NULL);
+
+    client_handle(client, msg);
+
+    line = end + 1;
+  }
+
+  client->length -= line - client->data;
+
+  memmove(client->data, line, client->length + 1);
+
+  return 1;
+}
+
+static void
+on_close(btc_socket_t *socket) {
+  test_client_t *client = btc_socket_get_data(socket);
+  client->closed = 1;
+}
+
+static json_value *
+client_call(test_client_t *client, const char *fmt, ...) {
+  json_value *reply;
+  char line[512];
+  char *data;
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsprintf(line, fmt, ap);
+  va_end(ap);
+
+  line[len++] = '\n';
+
+  data = malloc(len);
+
+  ASSERT(data != NULL);
+
+  memcpy(data, line, len);
+
+  ASSERT(btc_socket_write(client->socket, data, len) != -1);
+
+  while (client->reply == NULL) {
+    ASSERT(!client->closed);
+    btc_loop_poll(test_loop, 50);
+  }
+
+  reply = client->reply;
+
+  client->reply = NULL;
+
+  return reply;
+}
+
+static void
+client_open(test_client_t *client) {
+  const json_value *result;
+  btc_sockaddr_t addr;
+  json_value *reply;
+
+  memset(client, 0, sizeof(*client));
+
+  ASSERT(btc_sockaddr_import(&addr, "127.0.0.1", TEST_PORT));
+
+  client->socket = btc_loop_connect(test_loop, &addr);
+
+  ASSERT(client->socket != NULL);
+
+  btc_socket_set_data(client->socket, client);
+  btc_socket_on_data(client->socket, on_data);
+  btc_socket_on_close(client->socket, on_close);
+
+  reply = client_call(client, "{\"id\":1,\"method\":\"mining.subscribe\","
+                              "\"params\":[]}");
+
+  result = json_object_get(reply, "result");
+
+  ASSERT(result != NULL && result->type == json_array);
+  ASSERT(result->u.array.length == 3);
+  ASSERT(hex_get(client->nonce1, 4, result->u.array.values[1]) == 4);
+  ASSERT(result->u.array.values[2]->u.integer == 4);
+
+  json_builder_free(reply);
+
+  reply = client_call(client, "{\"id\":2,\"method\":\"mining.authorize\","
+                              "\"params\":[\"worker\",\"x\"]}");
+
+  ASSERT(json_object_get(reply, "result")->type == json_boolean);
+
+  json_builder_free(reply);
+
+  while (!client->have_job)
+    btc_loop_poll(test_loop, 50);
+}
+
+static void
+client_close(test_client_t *client) {
+  if (!client->closed)
+    btc_socket_close(client->socket);
+
+  while (!client->closed)
+    btc_loop_poll(test_loop, 50);
+
+  free(client->data);
+}
+
+static btc_tx_t *
+client_coinbase(const test_client_t *client, const uint8_t *nonce2) {
+  const test_job_t *job = &client->job;
+  size_t length = job->coinb1_len + 8 + job->coinb2_len;
+  uint8_t *data = malloc(length);
+  btc_tx_t *tx = btc_tx_create();
+
+  ASSERT(data != NULL);
+
+  memcpy(data, job->coinb1, job->coinb1_len);
+  memcpy(data + job->coinb1_len, client->nonce1, 4);
+  memcpy(data + job->coinb1_len + 4, nonce2, 4);
+  memcpy(data + job->coinb1_len + 8, job->coinb2, job->coinb2_len);
+
+  ASSERT(btc_tx_import(tx, data, length));
+
+  free(data);
+
+  return tx;
+}
+
+static void
+client_header(btc_header_t *hdr,
+              const test_client_t *client,
+              const uint8_t *nonce2,
+              uint32_t nonce) {
+  const test_job_t *job = &client->job;
+  btc_tx_t *cb = client_coinbase(client, nonce2);
+  uint8_t root[32];
+  size_t i;
+
+  btc_hash_copy(root, cb->hash);
+
+  for (i = 0; i < job->count; i++)
+    btc_hash256_root(root, root, job->branches[i]);
+
+  hdr->version = job->version;
+  btc_hash_copy(hdr->prev_block, job->prev_block);
+  btc_hash_copy(hdr->merkle_root, root);
+  hdr->time = job->time;
+  hdr->bits = job->bits;
+  hdr->nonce = nonce;
+
+  btc_tx_destroy(cb);
+}
+
+static int
+client_submit(test_client_t *client, const uint8_t *nonce2, uint32_t nonce) {
+  const json_value *result, *error;
+  char en2[9], ntime[9], hex[9];
+  json_value *reply;
+  uint8_t raw[4];
+  int code = 0;
+
+  btc_base16_encode(en2, nonce2, 4);
+
+  write32be(raw, client->job.time);
+  btc_base16_encode(ntime, raw, 4);
+
+  write32be(raw, nonce);
+  btc_base16_encode(hex, raw, 4);
+
+  reply = client_call(client, "{\"id\":3,\"method\":\"mining.submit\","
+                              "\"params\":[\"worker\",\"%s\",\"%s\","
+                              "\"%s\",\"%s\"]}",
+                              client->job.id, en2, ntime, hex);
+
+  result = json_object_get(reply, "result");
+  error = json_object_get(reply, "error");
+
+  ASSERT(result != NULL && error != NULL);
+
+  if (error->type == json_array) {
+    ASSERT(error->u.array.length >= 1);
+    ASSERT(error->u.array.values[0]->type == json_integer);
+
+    code = error->u.array.values[0]->u.integer;
+  } else {
+    ASSERT(result->type == json_boolean && result->u.boolean);
+  }
+
+  json_builder_free(reply);
+
+  return code;
+}
+
+static uint32_t
+client_mine(const test_client_t *client,
+            const uint8_t *nonce2,
+            const uint8_t *min,
+            const uint8_t *max) {
+  /* Find a nonce with min < hash <= max. */
+  uint8_t hash[32];
+  btc_header_t hdr;
+  uint32_t nonce;
+
+  for (nonce = 0; nonce < 1000; nonce++) {
+    client_header(&hdr, client, nonce2, nonce);
+    btc_header_hash(hash, &hdr);
+
+    if (min != NULL && btc_hash_compare(hash, min) <= 0)
+      continue;
+
+    if (max != NULL && btc_hash_compare(hash, max) > 0)
+      continue;
+
+    return nonce;
+  }
+
+  ASSERT(0 && "no nonce found");
+
+  return 0;
+}
+
+/*
+ * Job Tests
+ */
+
+static void
+test_job_coinbase(void) {
+  static const uint8_t nonce2[4] = {0x01, 0x02, 0x03, 0x04};
+  const btc_tmpl_t *bt = btc_miner_get_template(test_miner);
+  test_client_t client;
+  uint8_t *expect;
+  uint8_t root[32];
+  btc_header_t hdr;
+  btc_tx_t *cb, *tx;
+  size_t length;
+
+  client_open(&client);
+
+  ASSERT(btc_hash_equal(client.job.prev_block, bt->prev_block));
+  ASSERT(client.job.version == bt->version);
+  ASSERT(client.job.bits == bt->bits);
+  ASSERT(client.job.count == bt->steps.length);
+
+  /* coinb1 || nonce1 || nonce2 || coinb2 is our coinbase. */
+  cb = btc_tmpl_coinbase(bt, read32be(client.nonce1), read32be(nonce2));
+  tx = client_coinbase(&client, nonce2);
+
+  length = btc_tx_base_size(cb);
+  expect = malloc(length);
+
+  ASSERT(expect != NULL);
+
+  btc_tx_base_write(expect, cb);
+
+  ASSERT(client.job.coinb1_len + 8 + client.job.coinb2_len == length);
+  ASSERT(memcmp(client.job.coinb1, expect, client.job.coinb1_len) == 0);
+  ASSERT(memcmp(client.job.coinb2, expect + length - client.job.coinb2_len,
+                client.job.coinb2_len) == 0);
+  ASSERT(btc_hash_equal(tx->hash, cb->hash));
+
+  /* And the branches lead to the template's root. */
+  btc_tmpl_compute(root, bt, cb->hash);
+  client_header(&hdr, &client, nonce2, 0);
+
+  ASSERT(btc_hash_equal(hdr.merkle_root, root));
+
+  free(expect);
+  btc_tx_destroy(tx);
+  btc_tx_destroy(cb);
+
+  client_close(&client);
+}
+
+static void
+test_job_submit(void) {
+  static const uint8_t nonce2[4] = {0x00, 0x00, 0x00, 0x07};
+  const btc_entry_t *tip = btc_chain_tip(test_chain);
+  uint8_t target[32], share[32], hash[32];
+  test_client_t client;
+  btc_header_t hdr;
+  uint32_t nonce;
+
+  client_open(&client);
+
+  ASSERT(btc_compact_export(target, client.job.bits));
+
+  btc_difficulty_target(share, btc_difficulty(client.job.bits) / 1.5);
+
+  /* Below the share target. */
+  nonce = client_mine(&client, nonce2, share, NULL);
+
+  ASSERT(client_submit(&client, nonce2, nonce) == 23);
+
+  /* A share, but not a block. */
+  nonce = client_mine(&client, nonce2, target, share);
+
+  ASSERT(client_submit(&client, nonce2, nonce) == 0);
+  ASSERT(client_submit(&client, nonce2, nonce) == 22);
+  ASSERT(btc_chain_tip(test_chain) == tip);
+
+  /* A block: the server's header must match ours. */
+  nonce = client_mine(&client, nonce2, NULL, target);
+
+  client_header(&hdr, &client, nonce2, nonce);
+  btc_header_hash(hash, &hdr);
+
+  ASSERT(client_submit(&client, nonce2, nonce) == 0);
+
+  tip = btc_chain_tip(test_chain);
+
+  ASSERT(btc_hash_equal(tip->hash, hash));
+
+  client_close(&client);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  const btc_network_t *network = btc_regtest;
+  btc_stratum_t *stratum;
+  btc_mempool_t *mempool;
+  btc_logger_t *logger;
+  btc_address_t addr;
+  uint8_t hash[20];
+
+  btc_rimraf(BTC_PREFIX);
+
+  memset(hash, 0x01, sizeof(hash));
+
+  btc_address_set_p2wpkh(&addr, hash);
+
+  test_loop = btc_loop_create();
+  logger = btc_logger_create();
+  test_chain = btc_chain_create(network);
+  mempool = btc_mempool_create(network, test_chain);
+  test_miner = btc_miner_create(network, test_loop, test_chain, mempool);
+  stratum = btc_stratum_create(network, test_loop, test_chain, test_miner);
+
+  btc_logger_set_silent(logger, 1);
+
+  btc_chain_set_logger(test_chain, logger);
+  btc_mempool_set_logger(mempool, logger);
+  btc_miner_set_logger(test_miner, logger);
+  btc_stratum_set_logger(stratum, logger);
+
+  btc_miner_add_address(test_miner, &addr);
+
+  /* Shares at 1.5x the block target. */
+  btc_stratum_set_port(stratum, TEST_PORT);
+  btc_stratum_set_difficulty(stratum, btc_difficulty(0x207fffff) / 1.5);
+
+  ASSERT(btc_chain_open(test_chain, BTC_PREFIX, 0));
+  ASSERT(btc_mempool_open(mempool, NULL, 0));
+  ASSERT(btc_miner_open(test_miner, 0));
+  ASSERT(btc_stratum_open(stratum));
+
+  btc_miner_generate(test_miner, 3, &addr);
+
+  test_job_coinbase();
+  test_job_submit();
+
+  btc_stratum_close(stratum);
+  btc_miner_close(test_miner);
+  btc_mempool_close(mempool);
+  btc_chain_close(test_chain);
+  btc_loop_close(test_loop);
+
+  btc_stratum_destroy(stratum);
+  btc_miner_destroy(test_miner);
+  btc_mempool_destroy(mempool);
+  btc_chain_destroy(test_chain);
+  btc_logger_destroy(logger);
+  btc_loop_destroy(test_loop);
+
+  btc_rimraf(BTC_PREFIX);
+
+  return 0;
+}
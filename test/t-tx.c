@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <mako/coins.h>
+#include <mako/json.h>
 #include <mako/network.h>
 #include <mako/script.h>
 #include <mako/tx.h>
@@ -17,6 +18,76 @@
 #include "data/tx_invalid_vectors.h"
 #include "lib/tests.h"
 
+static void
+test_tx_json(const btc_tx_t *tx, const btc_view_t *view) {
+  json_value *obj = json_tx_new(tx, view, btc_mainnet);
+  char *expect = json_encode(obj);
+  char *result;
+  json_writer w;
+
+  json_writer_init(&w);
+  json_tx_write(&w, tx, view, btc_mainnet);
+
+  result = json_writer_encode(&w, NULL);
+
+  ASSERT(strcmp(result, expect) == 0);
+
+  json_builder_free(obj);
+  free(expect);
+  free(result);
+}
+
+static void
+test_json_value(void) {
+  /* json_measure overestimates doubles; the writer
+     must only keep what json_serialize produced. */
+  json_value *obj = json_object_new(0);
+  json_value *arr = json_array_new(0);
+  const json_value *item;
+  json_value *result;
+  json_writer w;
+  double x;
+  char *str;
+
+  json_array_push(arr, json_double_new(0.5));
+  json_array_push(arr, json_double_new(123456.75));
+
+  json_object_push(obj, "difficulty", json_double_new(4.656e-10));
+  json_object_push(obj, "values", arr);
+
+  json_writer_init(&w);
+  json_write_object(&w);
+  json_write_key(&w, "result");
+  json_write_value(&w, obj);
+  json_write_key(&w, "error");
+  json_write_null(&w);
+  json_write_object_end(&w);
+
+  str = json_writer_encode(&w, NULL);
+  result = json_decode(str, strlen(str));
+
+  ASSERT(result != NULL);
+  ASSERT(result->type == json_object);
+
+  item = json_object_get(result, "result");
+
+  ASSERT(item != NULL);
+  ASSERT(json_double_get(&x, json_object_get(item, "difficulty")));
+
+  item = json_object_get(item, "values");
+
+  ASSERT(item != NULL && item->type == json_array);
+  ASSERT(item->u.array.length == 2);
+
+  item = json_object_get(result, "error");
+
+  ASSERT(item != NULL && item->type == json_null);
+
+  json_value_free(result);
+  json_builder_free(obj);
+  free(str);
+}
+
 static void
 test_tx_valid_vector(const test_valid_vector_t *vec, size_t index) {
   uint8_t hash[32];
@@ -59,6 +130,8 @@ test_tx_valid_vector(const test_valid_vector_t *vec, size_t index) {
   else
     ASSERT(btc_tx_verify(&tx, view, vec->flags));
 
+  test_tx_json(&tx, view);
+
   btc_tx_clear(&tx);
   btc_view_destroy(view);
 }
@@ -120,6 +193,8 @@ int
 main(void) {
   size_t i;
 
+  test_json_value();
+
   for (i = 0; i < lengthof(test_valid_vectors); i++)
     test_tx_valid_vector(&test_valid_vectors[i], i);
 
@@ -1,5 +1,5 @@
 /*!
- * t-stub.c - stub test for mako
+ * t-util.c - util test for mako
  * Copyright (c) 2021, Christopher Jeffrey (MIT License).
  * https://github.com/chjj/mako
  */
@@ -7,8 +7,67 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mako/util.h>
 #include "lib/tests.h"
 
-int main(void) {
+/*
+ * PoW Tests
+ */
+
+static void
+test_difficulty(void) {
+  ASSERT(btc_difficulty(0x1d00ffff) == 1.0);
+  ASSERT(btc_difficulty(0x1b0404cb) > 16307.42);
+  ASSERT(btc_difficulty(0x1b0404cb) < 16307.43);
+}
+
+static void
+test_difficulty_target(void) {
+  static const uint32_t bits[] = {
+    0x1d00ffff,
+    0x1c00ffff,
+    0x1b00ffff
+  };
+  uint8_t expect[32];
+  uint8_t target[32];
+  size_t i;
+
+  /* Difficulty 1 is 0x00000000ffff0000...0000. */
+  btc_difficulty_target(target, 1.0);
+
+  memset(expect, 0, 32);
+
+  expect[26] = 0xff;
+  expect[27] = 0xff;
+
+  ASSERT(memcmp(target, expect, 32) == 0);
+
+  for (i = 0; i < lengthof(bits); i++) {
+    btc_difficulty_target(target, btc_difficulty(bits[i]));
+
+    memset(expect, 0, 32);
+
+    expect[26 - i] = 0xff;
+    expect[27 - i] = 0xff;
+
+    ASSERT(memcmp(target, expect, 32) == 0);
+  }
+
+  /* Easier than anything representable. */
+  btc_difficulty_target(target, 1e-60);
+
+  memset(expect, 0xff, 32);
+
+  ASSERT(memcmp(target, expect, 32) == 0);
+}
+
+/*
+ * Main
+ */
+
+int
+main(void) {
+  test_difficulty();
+  test_difficulty_target();
   return 0;
 }
@@ -11,8 +11,12 @@
 #include <mako/crypto/rand.h>
 
 #include <mako/address.h>
+#include <mako/coins.h>
 #include <mako/consensus.h>
 #include <mako/network.h>
+#include <mako/policy.h>
+#include <mako/script.h>
+#include <mako/select.h>
 #include <mako/tx.h>
 #include <mako/util.h>
 
@@ -101,7 +105,108 @@ test_simple(void) {
   btc_rimraf(BTC_PREFIX);
 }
 
+static void
+test_bump(void) {
+  unsigned int flags = BTC_SCRIPT_STANDARD_VERIFY_FLAGS;
+  const btc_network_t *network = btc_mainnet;
+  btc_wallet_t *w = btc_wallet_create(network, 0);
+  int64_t rate = 50000;
+  int64_t fee, size, spent;
+  btc_tx_t *tx, *bump;
+  btc_address_t addr;
+  btc_balance_t bal;
+  btc_selopt_t opt;
+  btc_txmeta_t meta;
+  btc_view_t *view;
+  size_t i;
+
+  ASSERT(btc_wallet_open(w, BTC_PREFIX));
+
+  ASSERT(btc_wallet_receive(&addr, w, 0));
+
+  tx = create_funding(&addr, 50);
+
+  ASSERT(btc_wallet_add_tx(w, tx));
+
+  btc_tx_destroy(tx);
+
+  /* Not replaceable. */
+  ASSERT(btc_wallet_receive(&addr, w, 0));
+
+  tx = create_tbs(&addr, 10);
+
+  ASSERT(btc_wallet_send(w, 0, NULL, tx));
+  ASSERT(!btc_tx_is_rbf(tx));
+  ASSERT(!btc_wallet_bump(&bump, w, tx->hash, rate));
+  ASSERT(bump == NULL);
+
+  view = btc_wallet_undo(w, tx);
+  spent = btc_tx_fee(tx, view);
+
+  btc_view_destroy(view);
+  btc_tx_destroy(tx);
+
+  /* Replaceable. */
+  tx = create_funding(&addr, 50);
+
+  ASSERT(btc_wallet_add_tx(w, tx));
+
+  btc_tx_destroy(tx);
+
+  btc_selopt_init(&opt);
+
+  opt.rbf = 1;
+
+  tx = create_tbs(&addr, 20);
+
+  ASSERT(btc_wallet_send(w, 0, &opt, tx));
+  ASSERT(btc_tx_is_rbf(tx));
+
+  view = btc_wallet_undo(w, tx);
+  fee = btc_tx_fee(tx, view);
+  size = btc_tx_virtual_size(tx);
+
+  ASSERT(fee > 0);
+
+  ASSERT(btc_wallet_bump(&bump, w, tx->hash, rate));
+  ASSERT(bump != NULL);
+
+  /* Same inputs, higher fee, still signalling. */
+  ASSERT(!btc_hash_equal(bump->hash, tx->hash));
+  ASSERT(bump->inputs.length == tx->inputs.length);
+
+  for (i = 0; i < tx->inputs.length; i++) {
+    const btc_input_t *x = tx->inputs.items[i];
+    const btc_input_t *y = bump->inputs.items[i];
+
+    ASSERT(btc_outpoint_equal(&x->prevout, &y->prevout));
+  }
+
+  ASSERT(btc_tx_is_rbf(bump));
+  ASSERT(btc_tx_verify(bump, view, flags));
+  ASSERT(btc_tx_fee(bump, view) >= fee + btc_get_fee(BTC_MIN_RELAY, size));
+  ASSERT(btc_tx_fee(bump, view) >= btc_get_fee(rate, size));
+
+  /* The original is gone from the txdb. */
+  ASSERT(!btc_wallet_meta(&meta, w, tx->hash));
+  ASSERT(btc_wallet_meta(&meta, w, bump->hash));
+
+  ASSERT(btc_wallet_balance(&bal, w, 0));
+  ASSERT(bal.tx == 4);
+  ASSERT(bal.unconfirmed == 100 * BTC_COIN - spent - btc_tx_fee(bump, view));
+
+  btc_view_destroy(view);
+  btc_tx_destroy(bump);
+  btc_tx_destroy(tx);
+
+  btc_wallet_close(w);
+  btc_wallet_destroy(w);
+
+  btc_rimraf(BTC_PREFIX);
+}
+
 int main(void) {
   test_simple();
+  test_bump();
   return 0;
 }